@@ -0,0 +1,61 @@
+#ifndef affine_matrix_H
+#define affine_matrix_H
+
+#include <algorithm>
+
+// host和device代码共用，yolo_decode.cu中的kernel与cpu的decode使用同一份投影
+#ifdef __CUDACC__
+#define AFFINE_HOST_DEVICE __host__ __device__
+#else
+#define AFFINE_HOST_DEVICE
+#endif
+
+namespace Detection {
+
+    // matrix为2x3的仿射矩阵，(ox, oy) = matrix * (x, y, 1)
+    AFFINE_HOST_DEVICE inline void affine_project(const float* matrix, float x, float y, float* ox, float* oy) {
+        *ox = matrix[0] * x + matrix[1] * y + matrix[2];
+        *oy = matrix[3] * x + matrix[4] * y + matrix[5];
+    }
+
+    // 与cv::invertAffineTransform相同
+    AFFINE_HOST_DEVICE inline void invert_affine(const float* m, float* inverse) {
+        float d = m[0] * m[4] - m[1] * m[3];
+        d = d != 0 ? 1.0f / d : 0.0f;
+        float a11 = m[4] * d, a12 = -m[1] * d;
+        float a21 = -m[3] * d, a22 = m[0] * d;
+        inverse[0] = a11; inverse[1] = a12; inverse[2] = -a11 * m[2] - a12 * m[5];
+        inverse[3] = a21; inverse[4] = a22; inverse[5] = -a21 * m[2] - a22 * m[5];
+    }
+
+    // 原图到网络输入的变换i2d，以及把网络输出的框映射回原图的d2i，默认为单位矩阵
+    struct AffineMatrix {
+        float i2d[6] = {1, 0, 0, 0, 1, 0};     // image to dst(network), 2x3 matrix
+        float d2i[6] = {1, 0, 0, 0, 1, 0};     // dst to image, 2x3 matrix
+
+        AffineMatrix() = default;
+        AffineMatrix(int from_width, int from_height, int to_width, int to_height, bool keep_ratio = true) {
+            compute(from_width, from_height, to_width, to_height, keep_ratio);
+        }
+
+        /* keep_ratio为true时等比缩放并居中（letterbox，与tutorial/1.0framework/yolo.cpp相同）
+           为false时宽高各自拉伸，对应Tensor::set_norm_mat的resize
+        */
+        void compute(int from_width, int from_height, int to_width, int to_height, bool keep_ratio = true) {
+            float scale_x = to_width / (float)from_width;
+            float scale_y = to_height / (float)from_height;
+            if (keep_ratio) {
+                float scale = std::min(scale_x, scale_y);
+                i2d[0] = scale;  i2d[1] = 0;      i2d[2] = -scale * from_width  * 0.5f + to_width  * 0.5f;
+                i2d[3] = 0;      i2d[4] = scale;  i2d[5] = -scale * from_height * 0.5f + to_height * 0.5f;
+            } else {
+                i2d[0] = scale_x;  i2d[1] = 0;        i2d[2] = 0;
+                i2d[3] = 0;        i2d[4] = scale_y;  i2d[5] = 0;
+            }
+            invert_affine(i2d, d2i);
+        }
+    };
+
+}; // namespace Detection
+
+#endif // affine_matrix_H
@@ -7,15 +7,21 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 // #include <plugin/amirInferPlugin.h>
 #include <infer/trt_infer.hpp>
 #include <opencv2/opencv.hpp>
 #include <ilogger.hpp>
+#include <thread_pool.hpp>
 
 namespace App {
     #define CREATE_AMIRSTAN_PLUGIN_DET_INFER(path) App::create_infer<Detection::DetResult>(path, std::dynamic_pointer_cast<App::BaseParser<Detection::DetResult>>(Detection::amirstan_det_plg_parser))
     #define CREATE_MMDEPLOY_PLUGIN_DET_INFER(path) App::create_infer<Detection::DetResult>(path, std::dynamic_pointer_cast<App::BaseParser<Detection::DetResult>>(Detection::mmdeploy_det_plg_parser))
+    #define CREATE_YOLO_DET_INFER(path)            App::create_infer<Detection::DetResult>(path, std::dynamic_pointer_cast<App::BaseParser<Detection::DetResult>>(Detection::yolo_det_parser))
+    // 根据引擎的输出从ParserRegistry中自动选择parser
+    #define CREATE_DET_INFER(path)                 App::create_infer<Detection::DetResult>(path)
 
     class Result {
     public:
@@ -44,8 +50,12 @@ namespace App {
         // device: 0->cpu; 1->gpu
         int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, std::vector<std::shared_ptr<R>>& result, int device=0) const override {
             TRT::Tensor buffer(TRT::DataType::Float);
+            // buffer2struct只读取output2buffer写入的目标，不需要清零
+            buffer.set_memory_init(TRT::MemoryInit::Uninitialized);
             std::vector<int> defect_nums;
             if (device == 0) {
+                // 所有输出一起下载，只等待一次，而不是每个输出的to_cpu各同步一次stream
+                TRT::to_cpu_async(output).wait();
                 defect_nums = output2buffer_cpu(output, buffer);
             } else {
                 defect_nums = output2buffer_gpu(output, buffer);
@@ -75,13 +85,109 @@ namespace App {
         const std::string plugin_name_;
     };
     
+    /* 结果类型为R的全局parser注册表
+       每个parser以get_plugin_name()为名字注册，也可以同时绑定一个输出签名（见signature）
+       find按输出自动选择parser：先查签名绑定和缓存，没有命中时按注册顺序调用check_valid，结果按签名缓存
+       注意：check_valid不匹配时会打印原因，每种新签名的第一次find可能产生若干条警告
+    */
+    template<typename R>
+    class ParserRegistry {
+    public:
+        static ParserRegistry& instance() {
+            static ParserRegistry registry;
+            return registry;
+        }
+
+        // 同名的parser已经存在时返回false
+        bool add(const std::shared_ptr<BaseParser<R>>& parser, const std::string& signature = "") {
+            if (! parser) return false;
+            std::unique_lock<std::mutex> l(lock_);
+            std::string name = parser->get_plugin_name();
+            for (auto& item : parsers_) {
+                if (name == item->get_plugin_name()) {
+                    INFOW("parser %s already registered", name.c_str());
+                    return false;
+                }
+            }
+            parsers_.push_back(parser);
+            if (! signature.empty()) {
+                signature_parsers_[signature] = parser;
+            }
+            return true;
+        }
+
+        std::shared_ptr<BaseParser<R>> get(const std::string& name) const {
+            std::unique_lock<std::mutex> l(lock_);
+            for (auto& item : parsers_) {
+                if (name == item->get_plugin_name()) return item;
+            }
+            return nullptr;
+        }
+
+        std::shared_ptr<BaseParser<R>> find(const std::vector<std::shared_ptr<TRT::Tensor>>& outputs) const {
+            std::string key = signature(outputs);
+            std::unique_lock<std::mutex> l(lock_);
+            auto iter = signature_parsers_.find(key);
+            if (iter != signature_parsers_.end()) return iter->second;
+
+            for (auto& item : parsers_) {
+                if (item->check_valid(outputs)) {
+                    signature_parsers_[key] = item;
+                    return item;
+                }
+            }
+            INFOE("no registered parser matches outputs %s", key.c_str());
+            return nullptr;
+        }
+
+        std::vector<std::string> names() const {
+            std::unique_lock<std::mutex> l(lock_);
+            std::vector<std::string> ret;
+            for (auto& item : parsers_) ret.push_back(item->get_plugin_name());
+            return ret;
+        }
+
+        // 每个输出的 dtype[shape]，用逗号分隔，第0维是动态batch，不参与签名，例如 Float[100x5],Int32[100]
+        static std::string signature(const std::vector<std::shared_ptr<TRT::Tensor>>& outputs) {
+            std::string ret;
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                if (i > 0) ret += ",";
+                ret += TRT::data_type_string(outputs[i]->type());
+                ret += "[";
+                for (int j = 1; j < outputs[i]->ndims(); ++j) {
+                    if (j > 1) ret += "x";
+                    ret += std::to_string(outputs[i]->size(j));
+                }
+                ret += "]";
+            }
+            return ret;
+        }
+
+    private:
+        ParserRegistry() = default;
+
+    private:
+        mutable std::mutex lock_;
+        std::vector<std::shared_ptr<BaseParser<R>>> parsers_;
+        mutable std::unordered_map<std::string, std::shared_ptr<BaseParser<R>>> signature_parsers_;
+    };
+
+    // 在全局变量的初始化中注册parser，用法见detection.cpp
+    template<typename R>
+    struct ParserRegistrar {
+        ParserRegistrar(const std::shared_ptr<BaseParser<R>>& parser, const std::string& signature = "") {
+            ParserRegistry<R>::instance().add(parser, signature);
+        }
+    };
+
     // 某一任务的推理引擎，该任务以R为结果类型
     template<typename R>
     class Engine {
     public:
         Engine() = default;
-        Engine(const std::string& path, const std::shared_ptr<BaseParser<R>> parser) :
-            engine_(TRT::load_infer(path)), parser_(parser) {
+        // parser为空时按输出从ParserRegistry<R>中自动选择
+        Engine(const std::string& path, const std::shared_ptr<BaseParser<R>> parser = nullptr) :
+            engine_(TRT::load_infer(path)), parser_(parser ? parser : find_parser(engine_)) {
             if (! parser_) {
                 INFOF("parser load fail, please check your parser!");
             }
@@ -148,32 +254,45 @@ namespace App {
             return ret[0];
         }
 
-        // TODO: 推理多张图片（batch_size > 1）
+        /* 推理任意数量的图片，按引擎的max batch size切块：
+           每块在线程池中并行预处理，直接写入input tensor的pinned host内存；
+           两个input tensor交替使用，当前块在GPU上推理时，CPU预处理下一块
+           返回的结果与images一一对应
+        */
         std::vector<std::shared_ptr<R>> run(std::vector<cv::Mat>& images, std::array<float, 3>& mean, std::array<float, 3>& std) {
+            std::vector<std::shared_ptr<R>> ret;
             if (! engine_) {
                 INFOF("Engine load fail, please check the path of plan file!");
+                return ret;
             }
-            int images_size = images.size();
-            int max_batch_size = engine_->get_max_batch_size();
-            // 图片数量大于引擎最大批处理数量，assert；TODO:更温和的策略
-            if (images_size > max_batch_size) {
-                FMT_INFOF("batch images(%d) > infer max_batch_size(%d), please RECOMPILE MODEL or check your input vector!", images_size, max_batch_size);
-            } else if (images_size < max_batch_size) {
-                FMT_INFOW("batch images(%d) < infer max_batch_size(%d), the performance of engine can be better!", images_size, max_batch_size);
+            if (images.empty()) {
+                INFOW("Input images is empty, please check input vector!");
+                return ret;
             }
 
+            int images_size = images.size();
+            int max_batch_size = engine_->get_max_batch_size();
+            int min_batch_size = engine_->get_min_batch_size();
             auto input = engine_->input(0);
             auto image_w = input->width();
             auto image_h = input->height();
             for (int i = 0; i < images.size(); ++i) {
                 if (images[i].empty()) {
                     INFOW("index %d in current batch is empty!", i);
-                    images[i] = cv::Mat(image_w, image_h, CV_8UC3, cv::Scalar(0, 0, 0));
+                    images[i] = cv::Mat(image_h, image_w, CV_8UC3, cv::Scalar(0, 0, 0));
                 }
             }
-            int n = 0;
-            for (const auto& image : images) {
-                input->set_norm_mat(n++, image, mean.data(), std.data());
+
+            if (! preprocess_pool_) {
+                preprocess_pool_ = std::make_shared<ThreadPool>();
+            }
+            for (auto& buffer : input_buffers_) {
+                if (! buffer) {
+                    buffer = std::make_shared<TRT::Tensor>(input->dims(), input->type());
+                    buffer->set_stream(engine_->get_stream());
+                    // 有效的batch会被预处理完整覆盖，padding的batch由fill_batch清零
+                    buffer->set_memory_init(TRT::MemoryInit::Uninitialized);
+                }
             }
 
             int num_output = engine_->num_output();
@@ -183,19 +302,82 @@ namespace App {
                 output.push_back(engine_->output(i));
             }
 
-            engine_->forward();
+            int num_chunks = (images_size + max_batch_size - 1) / max_batch_size;
+            if (num_chunks > 1) {
+                FMT_INFOD("batch images(%d) > infer max_batch_size(%d), split into %d chunks", images_size, max_batch_size, num_chunks);
+            }
 
-            std::vector<std::shared_ptr<R>> ret;
-            ret.reserve(max_batch_size);
-            parser_->parse(output, ret);
-            if (ret.size() != max_batch_size) {
-                INFOW("Unexpected result number!");
+            ret.reserve(images_size);
+            fill_input_batch(*input_buffers_[0], images, 0, std::min(max_batch_size, images_size), mean, std, min_batch_size);
+            for (int chunk = 0; chunk < num_chunks; ++chunk) {
+                engine_->set_input(0, input_buffers_[chunk % 2]);
+                engine_->forward(false);
+
+                // GPU推理当前块的同时，预处理下一块到另一个input tensor
+                int next_begin = (chunk + 1) * max_batch_size;
+                if (next_begin < images_size) {
+                    fill_input_batch(*input_buffers_[(chunk + 1) % 2], images, next_begin, std::min(max_batch_size, images_size - next_begin), mean, std, min_batch_size);
+                }
+
+                engine_->synchronize();
+                std::vector<std::shared_ptr<R>> chunk_ret;
+                parser_->parse(output, chunk_ret);
+
+                // 丢弃padding的batch的结果
+                int chunk_size = std::min(max_batch_size, images_size - chunk * max_batch_size);
+                if ((int)chunk_ret.size() > chunk_size) {
+                    chunk_ret.resize(chunk_size);
+                }
+                ret.insert(ret.end(), chunk_ret.begin(), chunk_ret.end());
+            }
+            engine_->set_input(0, input);
+
+            if ((int)ret.size() != images_size) {
+                FMT_INFOW("Unexpected result number, expect %d, but got %d!", images_size, (int)ret.size());
             }
             return ret;
         }
+
+        // 设置批量预处理的线程数，0表示使用CPU核数
+        void set_preprocess_threads(int num_threads) {
+            preprocess_pool_ = std::make_shared<ThreadPool>(num_threads);
+        }
+
+        /* 并行预处理images[begin, begin + count)，写入tensor的第[0, count)个batch，tensor的batch维会被调整为max(count, min_batch)
+           count不足min_batch（没有动态batch的engine）时，[count, min_batch)的padding槽位清零，之前已经清零且没有被写过的槽位不再重复清理
+        */
+        static void fill_input_batch(TRT::Tensor& tensor, const std::vector<cv::Mat>& images, int begin, int count,
+                                     std::array<float, 3>& mean, std::array<float, 3>& std, ThreadPool& pool, int min_batch = 0) {
+            int batch = std::max(count, min_batch);
+            tensor.resize_single_dim(0, batch);
+            // 预先把数据头切到host，之后各线程的set_norm_mat只写各自batch的内存
+            tensor.to_cpu(false);
+            pool.parallel_for(0, count, [&](int i) {
+                tensor.set_norm_mat(i, images[begin + i], mean.data(), std.data());
+            });
+            tensor.fill_batch(count, batch);
+        }
+
+    private:
+        void fill_input_batch(TRT::Tensor& tensor, const std::vector<cv::Mat>& images, int begin, int count,
+                              std::array<float, 3>& mean, std::array<float, 3>& std, int min_batch) {
+            fill_input_batch(tensor, images, begin, count, mean, std, *preprocess_pool_, min_batch);
+        }
+
+        static std::shared_ptr<BaseParser<R>> find_parser(const std::shared_ptr<TRT::Infer>& engine) {
+            if (! engine) return nullptr;
+            std::vector<std::shared_ptr<TRT::Tensor>> output;
+            for (int i = 0; i < engine->num_output(); ++i) {
+                output.push_back(engine->output(i));
+            }
+            return ParserRegistry<R>::instance().find(output);
+        }
+
     private:
         std::shared_ptr<TRT::Infer> engine_;
         const std::shared_ptr<BaseParser<R>> parser_;
+        std::shared_ptr<ThreadPool> preprocess_pool_;
+        std::shared_ptr<TRT::Tensor> input_buffers_[2];
     };
     
     // 创建引擎函数，推理结果类型为R
@@ -206,6 +388,12 @@ namespace App {
         return std::make_shared<Engine<R>>(path, parser);
     }
 
+    // 按引擎的输出从ParserRegistry<R>中自动选择parser
+    template<typename R>
+    std::shared_ptr<Engine<R>> create_infer(const std::string& path) {
+        return std::make_shared<Engine<R>>(path);
+    }
+
     template<typename R>
     class AmirstanPluginParser : public PluginParser<R> {
     public:
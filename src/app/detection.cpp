@@ -1,17 +1,71 @@
 
 #include "detection.h"
+#include "post_processing.h"
+#include <cuda_tools.hpp>
 
 namespace Detection {
+    const std::shared_ptr<AmirstanDetectionParser> amirstan_det_plg_parser {std::make_shared<AmirstanDetectionParser>()};
+    const std::shared_ptr<MMDeployDetectionParser> mmdeploy_det_plg_parser {std::make_shared<MMDeployDetectionParser>()};
+    const std::shared_ptr<YoloDetectionParser>     yolo_det_parser         {std::make_shared<YoloDetectionParser>()};
+
+    static App::ParserRegistrar<DetResult> amirstan_registrar(amirstan_det_plg_parser);
+    static App::ParserRegistrar<DetResult> mmdeploy_registrar(mmdeploy_det_plg_parser);
+    static App::ParserRegistrar<DetResult> yolo_registrar(yolo_det_parser);
+
+    void DetectionArena::reset(int batch_size, int capacity) {
+        batch_size_ = batch_size;
+        capacity_   = capacity;
+        // vector缩小时不释放内存，只有第一次或者变大时才申请
+        data_.resize((size_t)NumField * batch_size * capacity);
+        counts_.assign(batch_size, 0);
+    }
+
+    DetectionView DetectionArena::view(int ibatch) const {
+        DetectionView view;
+        view.left       = field(Left, ibatch);
+        view.top        = field(Top, ibatch);
+        view.right      = field(Right, ibatch);
+        view.bottom     = field(Bottom, ibatch);
+        view.confidence = field(Confidence, ibatch);
+        view.label      = field(Label, ibatch);
+        view.count      = counts_[ibatch];
+        return view;
+    }
+
     DetResult::DetResult(const std::vector<BBox>& bboxes) : bboxes_(bboxes) { }
 
+    DetResult::DetResult(std::shared_ptr<const DetectionArena> arena, int ibatch) : arena_(arena) {
+        if (arena_) view_ = arena_->view(ibatch);
+    }
+
+    std::vector<BBox>& DetResult::materialize() {
+        if (arena_) {
+            bboxes_ = to_vector();
+            arena_.reset();
+            view_ = DetectionView();
+        }
+        return bboxes_;
+    }
+
+    std::vector<BBox> DetResult::to_vector() const {
+        if (!arena_) return bboxes_;
+        std::vector<BBox> bboxes;
+        bboxes.reserve(view_.size());
+        for (int i = 0; i < view_.size(); ++i) {
+            bboxes.emplace_back(view_[i]);
+        }
+        return bboxes;
+    }
+
     std::string DetResult::format() {
         std::string ret_str = "result is:\n" ;
-        if (bboxes_.size() == 0) {
+        if (size() == 0) {
             ret_str.append("empty.");
         }
-        for (int i = 0; i < defect_num(); ++i) {
+        for (int i = 0; i < size(); ++i) {
+            auto b = bbox(i);
             ret_str.append(iLogger::string_format("obj%d: left=%f, top=%f, right=%f, bottom=%f, confidence=%f, label=%f\n",
-                                        i + 1, bboxes_[i].left, bboxes_[i].top, bboxes_[i].right, bboxes_[i].bottom, bboxes_[i].confidence, bboxes_[i].label));
+                                        i + 1, b.left, b.top, b.right, b.bottom, b.confidence, b.label));
         }
         return ret_str;
     }
@@ -21,7 +75,8 @@ namespace Detection {
             INFOW("Format input image is empty, may cause core when you try to save the image!");
         }
         cv::Mat dst { src };
-        for (const auto& bbox : bboxes_) {
+        for (int i = 0; i < size(); ++i) {
+            auto bbox = this->bbox(i);
             if ((bbox.right - bbox.left) != 0 &&
                 (bbox.bottom - bbox.top) != 0) {
                 auto rect = cv::Rect(bbox.left, bbox.top, bbox.right - bbox.left, bbox.bottom - bbox.top);
@@ -33,18 +88,47 @@ namespace Detection {
         return dst;
     }
 
+    int DetectionParser::parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const {
+        if (output.empty() || output[0] == nullptr) {
+            INFOE("parse failed, output is empty");
+            return -1;
+        }
+
+        // 所有输出一起下载，只等待一次
+        TRT::to_cpu_async(output).wait();
+        return output2arena(output, arena);
+    }
+
+    int DetectionParser::parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, std::vector<std::shared_ptr<DetResult>>& result, int device) const {
+        if (device != 0) {
+            return App::OutputParser<DetResult>::parse(output, result, device);
+        }
+
+        // result持有arena，arena不能复用，每次parse一个
+        auto arena = std::make_shared<DetectionArena>();
+        int batch_size = parse(output, *arena);
+        if (batch_size < 0) return -1;
+
+        result.reserve(result.size() + batch_size);
+        for (int i = 0; i < batch_size; ++i) {
+            result.emplace_back(std::make_shared<DetResult>(arena, i));
+        }
+        return 0;
+    }
+
     int DetectionParser::buffer2struct(std::vector<std::shared_ptr<DetResult>>& result, TRT::Tensor& buffer, const std::vector<int>& defect_nums) const {
         // if buffer is on gpu: buffer.to_cpu();
         int batch_size = buffer.shape(0);
         // if batch_size != defect_nums.size(): 报错
         // if batch_size > 0: 报错
         result.reserve(batch_size);
+        auto values = buffer.accessor<float, 2>();
+        auto labels = buffer.accessor<int, 2>();
         for (int i = 0; i < batch_size; ++i) {
             std::vector<BBox> bboxes;
             for (int j = 0; j < defect_nums[i] * NUM_BBOX_ELEMENT; j += NUM_BBOX_ELEMENT) {
-                bboxes.emplace_back(buffer.at<float>(i, j), buffer.at<float>(i, j + 1),
-                                        buffer.at<float>(i, j + 2), buffer.at<float>(i, j + 3), 
-                                        buffer.at<float>(i, j + 4), buffer.at<int>(i, j + 5));
+                bboxes.emplace_back(values(i, j), values(i, j + 1), values(i, j + 2), values(i, j + 3),
+                                    values(i, j + 4), labels(i, j + 5));
             }
             result.emplace_back(std::make_shared<DetResult>(bboxes));
         }
@@ -52,40 +136,43 @@ namespace Detection {
     }
 
     std::vector<int> AmirstanDetectionParser::output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const {
-        auto& defects_info = output[0]; // shape: batch*1
-        auto& bboxes_info = output[1]->to_cpu(); // shape: batch*100*4
-        auto& scores_info = output[2]->to_cpu(); // shape: batch*100
-        auto& classes_info = output[3]->to_cpu(); // shape: batch*100
+        auto defects_info = output[0]->accessor<int, 2>(); // shape: batch*1
+        auto bboxes_info = output[1]->accessor<float, 3>(); // shape: batch*100*4
+        auto scores_info = output[2]->accessor<float, 2>(); // shape: batch*100
+        auto classes_info = output[3]->accessor<float, 2>(); // shape: batch*100
         std::vector<int> defect_nums;
-        int batch_size = defects_info->shape(0);
+        int batch_size = defects_info.size(0);
         FMT_INFOD("parse batch_size: %d", batch_size);
         buffer.resize(batch_size, MAX_IMAGE_BBOX * NUM_BBOX_ELEMENT).to_cpu();
+        auto values = buffer.accessor<float, 2>();
         for (int i = 0; i < batch_size; ++i) { // batch
-            int defect_num = defects_info->at<int>(i, 0);
+            int defect_num = defects_info(i, 0);
             FMT_INFOD("parse defect_num: %d", defect_num);
             defect_nums.push_back(defect_num);
             for (int j = 0; j < defect_num; ++j) { // defect
                 for (int k = 0; k < 4; ++k) { // left, top, right, bottom
-                    buffer.at<float>(i, j * NUM_BBOX_ELEMENT + k) = bboxes_info.at<float>(i, j, k);
+                    values(i, j * NUM_BBOX_ELEMENT + k) = bboxes_info(i, j, k);
                 }
-                buffer.at<float>(i, j * NUM_BBOX_ELEMENT + 4) = scores_info.at<float>(i, j);
-                buffer.at<float>(i, j * NUM_BBOX_ELEMENT + 5) = classes_info.at<float>(i, j);
+                values(i, j * NUM_BBOX_ELEMENT + 4) = scores_info(i, j);
+                values(i, j * NUM_BBOX_ELEMENT + 5) = classes_info(i, j);
             }
         }
         return defect_nums;
     }
 
     std::vector<int> MMDeployDetectionParser::output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const {
-        auto& defs_info = output[0]->to_cpu(); // shape: batch*100*5, (left, top, right, bottom, score)
-        auto& labels_info = output[1]->to_cpu(); // shape: batch*100
+        auto defs_info = output[0]->accessor<float, 3>(); // shape: batch*100*5, (left, top, right, bottom, score)
+        auto labels_info = output[1]->accessor<int, 2>(); // shape: batch*100
         std::vector<int> defect_nums;
-        int batch_size = defs_info.shape(0);
+        int batch_size = defs_info.size(0);
         FMT_INFOD("parse batch_size: %d", batch_size);
         buffer.resize(batch_size, MAX_IMAGE_BBOX * NUM_BBOX_ELEMENT).to_cpu();
+        auto values = buffer.accessor<float, 2>();
+        auto labels = buffer.accessor<int, 2>();
         for (int i = 0; i < batch_size; ++i) { // batch
         int defect_num { 0 };
             for (int z = 0; z < MAX_IMAGE_BBOX; ++z) {
-                if (defs_info.at<float>(i, z, 4) > 0.) {
+                if (defs_info(i, z, 4) > 0.) {
                     ++defect_num;
                 } else {
                     break;
@@ -95,13 +182,232 @@ namespace Detection {
             defect_nums.push_back(defect_num);
             for (int j = 0; j < defect_num; ++j) { // defect
                 for (int k = 0; k < 4; ++k) { // left, top, right, bottom
-                    buffer.at<float>(i, j * NUM_BBOX_ELEMENT + k) = defs_info.at<float>(i, j, k);
+                    values(i, j * NUM_BBOX_ELEMENT + k) = defs_info(i, j, k);
                 }
-                buffer.at<float>(i, j * NUM_BBOX_ELEMENT + 4) = defs_info.at<float>(i, j, 4);
-                buffer.at<int>(i, j * NUM_BBOX_ELEMENT + 5) = labels_info.at<int>(i, j);
+                values(i, j * NUM_BBOX_ELEMENT + 4) = defs_info(i, j, 4);
+                labels(i, j * NUM_BBOX_ELEMENT + 5) = labels_info(i, j);
             }
         }
         return defect_nums;
     }
     
-}; // namespace Detection
\ No newline at end of file
+    const int YoloDetectionParser::MAX_CANDIDATES;
+
+    const int YOLO_NUM_BOX_ELEMENT = 7;      // left, top, right, bottom, confidence, class, keepflag
+
+    // 定义在yolo_decode.cu
+    void yolo_decode_kernel_invoker(float* predict, int num_bboxes, int num_classes, float confidence_threshold, float nms_threshold,
+                                    float* invert_affine_matrix, float* pcandidates, float* parray, int max_objects, cudaStream_t stream);
+
+    YoloDetectionParser::YoloDetectionParser(float confidence_threshold, float nms_threshold, int num_threads) :
+        App::PluginParser<DetResult>("yolo"),
+        params_(confidence_threshold, nms_threshold),
+        pool_(std::make_shared<ThreadPool>(num_threads)) { }
+
+    const float* YoloParseParams::d2i(int ibatch) const {
+        static const AffineMatrix identity;
+        return ibatch < (int)affine_matrices.size() ? affine_matrices[ibatch].d2i : identity.d2i;
+    }
+
+    bool YoloDetectionParser::check_valid(const std::vector<std::shared_ptr<TRT::Tensor>>& outputs) const {
+        const std::string err_info = "network output format is not matched with yolo, detail msg: %s";
+        CHECK_OUTPUTS_NUM(outputs, 1);
+        // tensor name: output
+        // tensor data type: FLoat32
+        // tensor shape:{batch, N, 5 + num_classes}
+        CHECK_TENSOR_DATA_TYPE_RET_ASSERT(outputs[0], 0, err_info, TRT::DataType::Float);
+        CHECK_TENSOR_NDIMS_RET_ASSERT(outputs[0], 0, err_info, 3);
+        if (outputs[0]->shape(2) <= 5) {
+            FMT_INFOW(err_info, iLogger::string_format("output tensor 0 shape error, expect {batch, N, 5 + num_classes}, but got %s",
+                                                       outputs[0]->shape_string()).c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<std::vector<BBox>> YoloDetectionParser::decode_cpu(TRT::Tensor& predict, const YoloParseParams& params) const {
+        const int block_size = 4096;
+        int batch_size  = predict.size(0);
+        int num_bboxes  = predict.size(1);
+        int item_size   = predict.size(2);
+        int num_blocks  = (num_bboxes + block_size - 1) / block_size;
+        auto items = predict.accessor<float, 3>();
+        float confidence_threshold = params.confidence_threshold;
+
+        // 每张图切成num_blocks块，所有图的所有块一起并行decode
+        std::vector<std::vector<BBox>> block_bboxes(batch_size * num_blocks);
+        pool_->parallel_for(0, batch_size * num_blocks, [&](int task) {
+            int ibatch = task / num_blocks;
+            int begin  = task % num_blocks * block_size;
+            int end    = std::min(begin + block_size, num_bboxes);
+            const float* pbegin = items.ptr(ibatch, begin);
+            const float* matrix = params.d2i(ibatch);
+
+            // 先按objectness选出候选行，大部分行在这一步被跳过
+            int rows[block_size];
+            int num_rows = PostProcessing::select_rows(pbegin + 4, item_size, end - begin, confidence_threshold, rows);
+
+            auto& bboxes = block_bboxes[task];
+            for (int i = 0; i < num_rows; ++i) {
+                auto pitem = items.row(ibatch, begin + rows[i]);
+                float* class_confidence = pitem.begin() + 5;
+                int label = std::max_element(class_confidence, pitem.end()) - class_confidence;
+                float confidence = class_confidence[label] * pitem[4];
+                if (confidence < confidence_threshold) continue;
+
+                float left   = pitem[0] - pitem[2] * 0.5f;
+                float top    = pitem[1] - pitem[3] * 0.5f;
+                float right  = pitem[0] + pitem[2] * 0.5f;
+                float bottom = pitem[1] + pitem[3] * 0.5f;
+                affine_project(matrix, left,  top,    &left,  &top);
+                affine_project(matrix, right, bottom, &right, &bottom);
+                bboxes.emplace_back(left, top, right, bottom, confidence, label);
+            }
+        });
+
+        std::vector<std::vector<BBox>> result(batch_size);
+        pool_->parallel_for(0, batch_size, [&](int ibatch) {
+            std::vector<BBox> candidates;
+            for (int i = 0; i < num_blocks; ++i) {
+                auto& bboxes = block_bboxes[ibatch * num_blocks + i];
+                candidates.insert(candidates.end(), bboxes.begin(), bboxes.end());
+            }
+            PostProcessing::filter_topk(candidates, confidence_threshold, MAX_CANDIDATES);
+            result[ibatch] = PostProcessing::nms(candidates, params.nms_threshold, false, MAX_IMAGE_BBOX);
+        });
+        return result;
+    }
+
+    static int bboxes2arena(const std::vector<std::vector<BBox>>& image_bboxes, DetectionArena& arena) {
+        int batch_size = image_bboxes.size();
+        arena.reset(batch_size, MAX_IMAGE_BBOX);
+        for (int i = 0; i < batch_size; ++i) {
+            auto& bboxes = image_bboxes[i];
+            for (int j = 0; j < (int)bboxes.size(); ++j) {
+                arena.field(DetectionArena::Left, i)[j]       = bboxes[j].left;
+                arena.field(DetectionArena::Top, i)[j]        = bboxes[j].top;
+                arena.field(DetectionArena::Right, i)[j]      = bboxes[j].right;
+                arena.field(DetectionArena::Bottom, i)[j]     = bboxes[j].bottom;
+                arena.field(DetectionArena::Confidence, i)[j] = bboxes[j].confidence;
+                arena.field(DetectionArena::Label, i)[j]      = bboxes[j].label;
+            }
+            arena.set_count(i, bboxes.size());
+        }
+        return batch_size;
+    }
+
+    // buffer的格式与其他parser相同，label按int写入，见buffer2struct
+    static std::vector<int> bboxes2buffer(const std::vector<std::vector<BBox>>& image_bboxes, TRT::Tensor& buffer) {
+        int batch_size = image_bboxes.size();
+        std::vector<int> defect_nums;
+        buffer.resize(batch_size, MAX_IMAGE_BBOX * NUM_BBOX_ELEMENT).to_cpu(false);
+        auto values = buffer.accessor<float, 2>();
+        for (int i = 0; i < batch_size; ++i) {
+            auto& bboxes = image_bboxes[i];
+            float* pbuffer = values.ptr(i);
+            for (int j = 0; j < (int)bboxes.size(); ++j, pbuffer += NUM_BBOX_ELEMENT) {
+                pbuffer[0] = bboxes[j].left;
+                pbuffer[1] = bboxes[j].top;
+                pbuffer[2] = bboxes[j].right;
+                pbuffer[3] = bboxes[j].bottom;
+                pbuffer[4] = bboxes[j].confidence;
+                ((int*)pbuffer)[5] = (int)bboxes[j].label;
+            }
+            defect_nums.push_back(bboxes.size());
+        }
+        return defect_nums;
+    }
+
+    int YoloDetectionParser::output2arena(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const {
+        return bboxes2arena(decode_cpu(*output[0], params_), arena);
+    }
+
+    std::vector<int> YoloDetectionParser::output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const {
+        return bboxes2buffer(decode_cpu(*output[0], params_), buffer);
+    }
+
+    std::vector<int> YoloDetectionParser::output2buffer_gpu(const std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const {
+        return bboxes2buffer(decode_gpu(*output[0], params_), buffer);
+    }
+
+    int YoloDetectionParser::parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena, const YoloParseParams& params) const {
+        if (output.empty() || output[0] == nullptr) {
+            INFOE("parse failed, output is empty");
+            return -1;
+        }
+        return bboxes2arena(decode_cpu(output[0]->to_cpu(), params), arena);
+    }
+
+    int YoloDetectionParser::parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, std::vector<std::shared_ptr<DetResult>>& result,
+                                   const YoloParseParams& params, int device) const {
+        if (output.empty() || output[0] == nullptr) {
+            INFOE("parse failed, output is empty");
+            return -1;
+        }
+
+        // result持有arena，arena不能复用，每次parse一个
+        auto arena = std::make_shared<DetectionArena>();
+        int batch_size = bboxes2arena(device == 0 ? decode_cpu(output[0]->to_cpu(), params) : decode_gpu(*output[0], params), *arena);
+        result.reserve(result.size() + batch_size);
+        for (int i = 0; i < batch_size; ++i) {
+            result.emplace_back(std::make_shared<DetResult>(arena, i));
+        }
+        return 0;
+    }
+
+    std::vector<std::vector<BBox>> YoloDetectionParser::decode_gpu(TRT::Tensor& predict, const YoloParseParams& params) const {
+        predict.to_gpu();
+        auto stream     = predict.get_stream();
+        int batch_size  = predict.size(0);
+        int num_bboxes  = predict.size(1);
+        int num_classes = predict.size(2) - 5;
+
+        // why 8 ? : 8 * sizeof(float) % 32 == 0
+        TRT::Tensor affine_matrix_device(TRT::DataType::Float);
+        affine_matrix_device.set_stream(stream);
+        affine_matrix_device.resize(batch_size, 8).to_cpu(false);
+        for (int i = 0; i < batch_size; ++i) {
+            memcpy(affine_matrix_device.cpu<float>(i), params.d2i(i), sizeof(float) * 6);
+        }
+        affine_matrix_device.to_gpu();
+
+        // 每张图所有超过阈值的候选: count, num_bboxes * (left, top, right, bottom, confidence, class, keepflag)
+        // 与cpu的filter_topk一样，按confidence取前MAX_CANDIDATES个进入NMS，而不是decode时先到先得的前MAX_CANDIDATES个
+        TRT::Tensor candidates_device(TRT::DataType::Float);
+        candidates_device.set_stream(stream);
+        candidates_device.set_memory_init(TRT::MemoryInit::Uninitialized);
+        candidates_device.resize(batch_size, 1 + num_bboxes * YOLO_NUM_BOX_ELEMENT).to_gpu(false);
+
+        // 每张图: count, MAX_CANDIDATES * (left, top, right, bottom, confidence, class, keepflag)
+        TRT::Tensor output_array_device(TRT::DataType::Float);
+        output_array_device.set_stream(stream);
+        output_array_device.set_memory_init(TRT::MemoryInit::Uninitialized);
+        output_array_device.resize(batch_size, 1 + MAX_CANDIDATES * YOLO_NUM_BOX_ELEMENT).to_gpu(false);
+        for (int i = 0; i < batch_size; ++i) {
+            float* pcandidates = candidates_device.gpu<float>(i);
+            float* parray      = output_array_device.gpu<float>(i);
+            checkCudaRuntime(cudaMemsetAsync(pcandidates, 0, sizeof(float), stream));
+            checkCudaRuntime(cudaMemsetAsync(parray, 0, sizeof(float), stream));
+            yolo_decode_kernel_invoker(predict.gpu<float>(i), num_bboxes, num_classes, params.confidence_threshold, params.nms_threshold,
+                                       affine_matrix_device.gpu<float>(i), pcandidates, parray, MAX_CANDIDATES, stream);
+        }
+
+        // 保留的框按confidence排序后取前MAX_IMAGE_BBOX个
+        output_array_device.to_cpu();
+        std::vector<std::vector<BBox>> image_bboxes(batch_size);
+        for (int i = 0; i < batch_size; ++i) {
+            float* parray = output_array_device.cpu<float>(i);
+            int count = std::min(MAX_CANDIDATES, (int)*parray);
+            auto& bboxes = image_bboxes[i];
+            for (int j = 0; j < count; ++j) {
+                float* pbox = parray + 1 + j * YOLO_NUM_BOX_ELEMENT;
+                if (pbox[6] == 1) {
+                    bboxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], pbox[5]);
+                }
+            }
+            PostProcessing::filter_topk(bboxes, params.confidence_threshold, MAX_IMAGE_BBOX);
+        }
+        return image_bboxes;
+    }
+
+}; // namespace Detection
@@ -4,6 +4,9 @@
 #define detection_H
 
 #include "app.hpp"
+#include "affine_matrix.h"
+#include <algorithm>
+#include <string.h>
 
 namespace Detection {
 
@@ -22,56 +25,275 @@ namespace Detection {
         float left, top, right, bottom, confidence, label, area;
     };
     
+    // 不拥有内存的一张图的检测结果，每个字段是一段连续的数组
+    struct DetectionView {
+        const float* left       = nullptr;
+        const float* top        = nullptr;
+        const float* right      = nullptr;
+        const float* bottom     = nullptr;
+        const float* confidence = nullptr;
+        const float* label      = nullptr;
+        int count = 0;
+
+        int  size() const { return count; }
+        BBox operator[](int i) const { return BBox(left[i], top[i], right[i], bottom[i], confidence[i], label[i]); }
+    };
+
+    /* structure-of-arrays的检测结果，left/top/right/bottom/confidence/label各自连续存放
+       每张图占capacity个位置，第ibatch张图的第i个框在ibatch * capacity + i
+       reset只在容量不够时重新申请内存，同一个arena反复用于解析时没有堆内存申请
+    */
+    class DetectionArena {
+    public:
+        enum Field : int { Left = 0, Top, Right, Bottom, Confidence, Label, NumField };
+
+        DetectionArena() = default;
+        DetectionArena(int batch_size, int capacity) { reset(batch_size, capacity); }
+
+        // 所有图的目标数清零
+        void reset(int batch_size, int capacity);
+
+        int batch_size() const { return batch_size_; }
+        int capacity()   const { return capacity_; }
+        int count(int ibatch) const { return counts_[ibatch]; }
+        void set_count(int ibatch, int count) { counts_[ibatch] = count; }
+
+        float*       field(Field f, int ibatch)       { return data_.data() + ((size_t)f * batch_size_ + ibatch) * capacity_; }
+        const float* field(Field f, int ibatch) const { return data_.data() + ((size_t)f * batch_size_ + ibatch) * capacity_; }
+
+        DetectionView view(int ibatch) const;
+
+    private:
+        int batch_size_ = 0;
+        int capacity_   = 0;
+        std::vector<float> data_;   // NumField * batch_size * capacity
+        std::vector<int>   counts_;
+    };
+
     // 检测任务的结果
     // TODO: 加上confidence_threshold
     class DetResult : public App::Result {
     public:
         DetResult() = default;
         DetResult(const std::vector<BBox>& bboxes);
+
+        // 作为arena中第ibatch张图的视图，不拷贝；第一次调用mutable_*时才拷贝到内部的vector
+        DetResult(std::shared_ptr<const DetectionArena> arena, int ibatch);
         
         virtual std::string format() override;
         virtual cv::Mat     format(const cv::Mat& src) override;
 
-        std::vector<BBox>&  mutable_defects()         { return bboxes_; }
-        std::vector<BBox>&  mutable_objects()         { return bboxes_; }
-        std::vector<BBox>&  mutable_bboxes()          { return bboxes_; }
+        std::vector<BBox>&  mutable_defects()         { return materialize(); }
+        std::vector<BBox>&  mutable_objects()         { return materialize(); }
+        std::vector<BBox>&  mutable_bboxes()          { return materialize(); }
 
-        std::vector<BBox>   immutable_defects() const { return bboxes_; }
-        std::vector<BBox>   immutable_objects() const { return bboxes_; }
-        std::vector<BBox>   immutable_bboxes()  const { return bboxes_; }
+        std::vector<BBox>   immutable_defects() const { return to_vector(); }
+        std::vector<BBox>   immutable_objects() const { return to_vector(); }
+        std::vector<BBox>   immutable_bboxes()  const { return to_vector(); }
 
-        uint32_t defect_num() { return bboxes_.size(); }
+        // 不产生拷贝的访问方式
+        int      size()       const { return arena_ ? view_.size() : (int)bboxes_.size(); }
+        BBox     bbox(int i)  const { return arena_ ? view_[i] : bboxes_[i]; }
+        bool     is_view()    const { return arena_ != nullptr; }
+
+        uint32_t defect_num() { return size(); }
         bool     ok()         { return defect_num() == 0; } // 没有缺陷，良品
         bool     negative()   { return defect_num() == 0; } // 没有目标
+    private:
+        std::vector<BBox>& materialize();
+        std::vector<BBox>  to_vector() const;
+
     private:
         std::vector<BBox> bboxes_;
+        std::shared_ptr<const DetectionArena> arena_;
+        DetectionView view_;
     };
     
     /// 各个算子库的 output parser
     class DetectionParser : public App::OutputParser<DetResult> {
+    public:
+        /* 直接从output tensor解析到arena，不经过buffer tensor，也不构造DetResult
+           arena容量足够时整个过程没有堆内存申请，适合每帧复用同一个arena
+           return: batch size，失败返回-1
+        */
+        int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const;
+
+        // cpu解析时走arena，result中的DetResult是同一个arena的视图
+        virtual int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, std::vector<std::shared_ptr<DetResult>>& result, int device=0) const override;
     protected:
+        virtual int output2arena(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const = 0;
+
         virtual std::vector<int> output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer)       const = 0;
         virtual std::vector<int> output2buffer_gpu(const std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const = 0;
         virtual int              buffer2struct(std::vector<std::shared_ptr<DetResult>>& result, TRT::Tensor& buffer, const std::vector<int>& defect_nums) const;
     };
 
-    class AmirstanDetectionParser : public DetectionParser, public App::AmirstanPluginParser<DetResult> {
+    /* 各模型族的解码器：decode直接从output tensor解析到arena，返回batch size
+       实现是内联的，通过StaticDetectionParser<Decoder>调用时没有虚函数，取指针、循环和写arena在调用处展开
+    */
+    struct AmirstanDecoder {
+        static int decode(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena);
+    };
+
+    struct MMDeployDecoder {
+        static int decode(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena);
+    };
+
+    // 编译期分发的解析，已知模型族时代替BaseParser<DetResult>的虚函数调用
+    template<typename Decoder>
+    class StaticDetectionParser {
+    public:
+        int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const {
+            return Decoder::decode(output, arena);
+        }
+    };
+
+    // 用Decoder实现output2arena的插件parser，Plugin提供插件名和check_valid
+    template<typename Decoder, typename Plugin>
+    class DecoderDetectionParser : public DetectionParser, public Plugin {
+    protected:
+        virtual int output2arena(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) const override {
+            return Decoder::decode(output, arena);
+        }
+    };
+
+    class AmirstanDetectionParser : public DecoderDetectionParser<AmirstanDecoder, App::AmirstanPluginParser<DetResult>> {
     protected:
         virtual std::vector<int> output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer)       const override;
         virtual std::vector<int> output2buffer_gpu(const std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const override { return {}; }
     };
 
-    class MMDeployDetectionParser : public DetectionParser, public App::MMDeployPluginParser<DetResult> {
+    class MMDeployDetectionParser : public DecoderDetectionParser<MMDeployDecoder, App::MMDeployPluginParser<DetResult>> {
     protected:
         virtual std::vector<int> output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer)       const override;
         virtual std::vector<int> output2buffer_gpu(const std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const override { return {}; }
     };
+
+    /* 导出时没有带NMS插件的YOLO（v3/v5/v7/X），parser自己做decode + NMS
+       output[0]: Float, [batch, N, 5 + C]，每行为cx, cy, width, height, objectness, C个类别的score
+       cpu：按候选切块在线程池上decode，用AVX2一次判断8行的objectness，之后走PostProcessing的top-K + NMS
+       gpu：与tutorial/1.0framework/yolo_decode.cu相同的decode/nms kernel，见src/app/yolo_decode.cu
+       两条路径都用AffineMatrix::d2i把框映射回原图，没有给出时为单位矩阵，即框在网络输入的坐标系下
+    */
+    struct YoloParseParams {
+        float confidence_threshold = 0.25f;
+        float nms_threshold        = 0.45f;
+        // 第i个对应这次parse的output中的第i张图，不足batch的图使用单位矩阵
+        std::vector<AffineMatrix> affine_matrices;
+
+        YoloParseParams() = default;
+        YoloParseParams(float confidence_threshold, float nms_threshold, const std::vector<AffineMatrix>& affine_matrices = {}) :
+            confidence_threshold(confidence_threshold), nms_threshold(nms_threshold), affine_matrices(affine_matrices) { }
+
+        const float* d2i(int ibatch) const;
+    };
+
+    /* 注册到ParserRegistry的全局实例被所有Engine共享，构造之后不再修改
+       BaseParser的parse使用构造时的阈值和单位矩阵；每张图的仿射矩阵、不同的阈值随每次parse调用传入
+    */
+    class YoloDetectionParser : public DetectionParser, public App::PluginParser<DetResult> {
+    public:
+        static const int MAX_CANDIDATES = 1024;    // 每张图进入NMS的候选数上限
+
+        // num_threads：cpu decode的线程数，0表示使用CPU核数
+        YoloDetectionParser(float confidence_threshold = 0.25f, float nms_threshold = 0.45f, int num_threads = 0);
+
+        const YoloParseParams& default_params() const { return params_; }
+
+        using DetectionParser::parse;
+        int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena, const YoloParseParams& params) const;
+        int parse(std::vector<std::shared_ptr<TRT::Tensor>>& output, std::vector<std::shared_ptr<DetResult>>& result,
+                  const YoloParseParams& params, int device = 0) const;
+
+        virtual bool check_valid(const std::vector<std::shared_ptr<TRT::Tensor>>& outputs) const override;
+
+    protected:
+        virtual int              output2arena(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena)           const override;
+        virtual std::vector<int> output2buffer_cpu(std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer)       const override;
+        virtual std::vector<int> output2buffer_gpu(const std::vector<std::shared_ptr<TRT::Tensor>>& output, TRT::Tensor& buffer) const override;
+
+    private:
+        // 每张图NMS后的结果，按confidence从大到小，最多MAX_IMAGE_BBOX个
+        std::vector<std::vector<BBox>> decode_cpu(TRT::Tensor& predict, const YoloParseParams& params) const;
+        std::vector<std::vector<BBox>> decode_gpu(TRT::Tensor& predict, const YoloParseParams& params) const;
+
+    private:
+        const YoloParseParams params_;
+        const std::shared_ptr<ThreadPool> pool_;
+    };
     // and so on ...
 
-    /// 各个parser的全局实例化，todo: 改成全局注册
-    const static std::shared_ptr<AmirstanDetectionParser> amirstan_det_plg_parser {std::make_shared<AmirstanDetectionParser>()};
-    const static std::shared_ptr<MMDeployDetectionParser> mmdeploy_det_plg_parser {std::make_shared<MMDeployDetectionParser>()};
+    /// 各个parser的全局实例，定义在detection.cpp中，同时注册到App::ParserRegistry<DetResult>
+    extern const std::shared_ptr<AmirstanDetectionParser> amirstan_det_plg_parser;
+    extern const std::shared_ptr<MMDeployDetectionParser> mmdeploy_det_plg_parser;
+    extern const std::shared_ptr<YoloDetectionParser>     yolo_det_parser;
     // and so on ...
+
+    inline int AmirstanDecoder::decode(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) {
+        auto& defects_info = output[0]->to_cpu(); // shape: batch*1
+        auto& bboxes_info = output[1]->to_cpu(); // shape: batch*100*4
+        auto& scores_info = output[2]->to_cpu(); // shape: batch*100
+        auto& classes_info = output[3]->to_cpu(); // shape: batch*100
+        int batch_size = defects_info.shape(0);
+        int capacity = bboxes_info.shape(1);
+        arena.reset(batch_size, capacity);
+
+        const int* nums = defects_info.cpu<int>();
+        for (int i = 0; i < batch_size; ++i) { // batch
+            int defect_num = std::max(0, std::min(nums[i * defects_info.count(1)], capacity));
+            const float* boxes   = bboxes_info.cpu<float>(i);
+            const float* scores  = scores_info.cpu<float>(i);
+            const float* classes = classes_info.cpu<float>(i);
+            float* left   = arena.field(DetectionArena::Left, i);
+            float* top    = arena.field(DetectionArena::Top, i);
+            float* right  = arena.field(DetectionArena::Right, i);
+            float* bottom = arena.field(DetectionArena::Bottom, i);
+            for (int j = 0; j < defect_num; ++j) { // defect
+                left[j]   = boxes[j * 4 + 0];
+                top[j]    = boxes[j * 4 + 1];
+                right[j]  = boxes[j * 4 + 2];
+                bottom[j] = boxes[j * 4 + 3];
+            }
+            memcpy(arena.field(DetectionArena::Confidence, i), scores, defect_num * sizeof(float));
+            memcpy(arena.field(DetectionArena::Label, i), classes, defect_num * sizeof(float));
+            arena.set_count(i, defect_num);
+        }
+        return batch_size;
+    }
+
+    inline int MMDeployDecoder::decode(std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) {
+        auto& defs_info = output[0]->to_cpu(); // shape: batch*100*5, (left, top, right, bottom, score)
+        auto& labels_info = output[1]->to_cpu(); // shape: batch*100
+        int batch_size = defs_info.shape(0);
+        int capacity = defs_info.shape(1);
+        arena.reset(batch_size, capacity);
+
+        for (int i = 0; i < batch_size; ++i) { // batch
+            const float* defs  = defs_info.cpu<float>(i);
+            const int* labels  = labels_info.cpu<int>(i);
+            float* left       = arena.field(DetectionArena::Left, i);
+            float* top        = arena.field(DetectionArena::Top, i);
+            float* right      = arena.field(DetectionArena::Right, i);
+            float* bottom     = arena.field(DetectionArena::Bottom, i);
+            float* confidence = arena.field(DetectionArena::Confidence, i);
+            float* label      = arena.field(DetectionArena::Label, i);
+
+            // 有效的框排在前面，遇到score <= 0就结束
+            int defect_num = 0;
+            for (; defect_num < capacity; ++defect_num) {
+                const float* def = defs + defect_num * 5;
+                if (!(def[4] > 0.f)) break;
+                left[defect_num]       = def[0];
+                top[defect_num]        = def[1];
+                right[defect_num]      = def[2];
+                bottom[defect_num]     = def[3];
+                confidence[defect_num] = def[4];
+                label[defect_num]      = (float)labels[defect_num];
+            }
+            arena.set_count(i, defect_num);
+        }
+        return batch_size;
+    }
     
 }; // namespace Detection
 
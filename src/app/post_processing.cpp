@@ -0,0 +1,293 @@
+
+#include "post_processing.h"
+#include <preprocess_kernel_cpu.hpp>
+#include <ilogger.hpp>
+#include <algorithm>
+#include <math.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define POST_PROCESSING_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace PostProcessing {
+
+    using Detection::BBox;
+
+    // 一组框的SoA排列，NMS时IoU按列连续读取
+    struct BoxArray {
+        std::vector<float> left, top, right, bottom, confidence, label;
+
+        explicit BoxArray(const std::vector<BBox>& bboxes) {
+            int n = bboxes.size();
+            left.resize(n); top.resize(n); right.resize(n); bottom.resize(n); confidence.resize(n); label.resize(n);
+            for (int i = 0; i < n; ++i) {
+                left[i]       = bboxes[i].left;
+                top[i]        = bboxes[i].top;
+                right[i]      = bboxes[i].right;
+                bottom[i]     = bboxes[i].bottom;
+                confidence[i] = bboxes[i].confidence;
+                label[i]      = bboxes[i].label;
+            }
+        }
+
+        int  size() const { return left.size(); }
+        BBox bbox(int i) const { return BBox(left[i], top[i], right[i], bottom[i], confidence[i], label[i]); }
+
+        void swap(int i, int j) {
+            std::swap(left[i], left[j]);
+            std::swap(top[i], top[j]);
+            std::swap(right[i], right[j]);
+            std::swap(bottom[i], bottom[j]);
+            std::swap(confidence[i], confidence[j]);
+            std::swap(label[i], label[j]);
+        }
+    };
+
+    static inline float box_area(float left, float top, float right, float bottom) {
+        return std::max(0.0f, right - left) * std::max(0.0f, bottom - top);
+    }
+
+    // 与tutorial中nms_kernel的box_iou相同
+    static inline float box_iou(float aleft, float atop, float aright, float abottom, float a_area,
+                                float bleft, float btop, float bright, float bbottom) {
+        float cleft   = std::max(aleft, bleft);
+        float ctop    = std::max(atop, btop);
+        float cright  = std::min(aright, bright);
+        float cbottom = std::min(abottom, bbottom);
+
+        float c_area = std::max(cright - cleft, 0.0f) * std::max(cbottom - ctop, 0.0f);
+        if (c_area == 0.0f)
+            return 0.0f;
+
+        float b_area = box_area(bleft, btop, bright, bbottom);
+        return c_area / (a_area + b_area - c_area);
+    }
+
+    static void box_iou_scalar(const BBox& box, const float* left, const float* top, const float* right, const float* bottom, int n, float* iou) {
+        float area = box_area(box.left, box.top, box.right, box.bottom);
+        for (int i = 0; i < n; ++i) {
+            iou[i] = box_iou(box.left, box.top, box.right, box.bottom, area, left[i], top[i], right[i], bottom[i]);
+        }
+    }
+
+#ifdef POST_PROCESSING_HAS_AVX2
+    __attribute__((target("avx2,fma")))
+    static void box_iou_avx2(const BBox& box, const float* left, const float* top, const float* right, const float* bottom, int n, float* iou) {
+        __m256 zero   = _mm256_setzero_ps();
+        __m256 aleft  = _mm256_set1_ps(box.left);
+        __m256 atop   = _mm256_set1_ps(box.top);
+        __m256 aright = _mm256_set1_ps(box.right);
+        __m256 abot   = _mm256_set1_ps(box.bottom);
+        __m256 a_area = _mm256_set1_ps(box_area(box.left, box.top, box.right, box.bottom));
+
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 bleft  = _mm256_loadu_ps(left + i);
+            __m256 btop   = _mm256_loadu_ps(top + i);
+            __m256 bright = _mm256_loadu_ps(right + i);
+            __m256 bbot   = _mm256_loadu_ps(bottom + i);
+
+            __m256 cw     = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(aright, bright), _mm256_max_ps(aleft, bleft)), zero);
+            __m256 ch     = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(abot, bbot), _mm256_max_ps(atop, btop)), zero);
+            __m256 c_area = _mm256_mul_ps(cw, ch);
+            __m256 b_area = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(bright, bleft), zero), _mm256_max_ps(_mm256_sub_ps(bbot, btop), zero));
+            __m256 value  = _mm256_div_ps(c_area, _mm256_sub_ps(_mm256_add_ps(a_area, b_area), c_area));
+
+            // 不相交时为0，避免0 / 0
+            _mm256_storeu_ps(iou + i, _mm256_and_ps(value, _mm256_cmp_ps(c_area, zero, _CMP_NEQ_OQ)));
+        }
+        box_iou_scalar(box, left + i, top + i, right + i, bottom + i, n - i, iou + i);
+    }
+#endif
+
+    float box_iou(const BBox& a, const BBox& b) {
+        return box_iou(a.left, a.top, a.right, a.bottom, box_area(a.left, a.top, a.right, a.bottom), b.left, b.top, b.right, b.bottom);
+    }
+
+    void box_iou(const BBox& box, const float* left, const float* top, const float* right, const float* bottom, int n, float* iou) {
+#ifdef POST_PROCESSING_HAS_AVX2
+        if (CPUKernel::avx2_enabled()) {
+            box_iou_avx2(box, left, top, right, bottom, n, iou);
+            return;
+        }
+#endif
+        box_iou_scalar(box, left, top, right, bottom, n, iou);
+    }
+
+    static int select_rows_scalar(const float* data, int stride, int n, float threshold, int* rows) {
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (data[(size_t)i * stride] >= threshold) rows[count++] = i;
+        }
+        return count;
+    }
+
+#ifdef POST_PROCESSING_HAS_AVX2
+    __attribute__((target("avx2,fma")))
+    static int select_rows_avx2(const float* data, int stride, int n, float threshold, int* rows) {
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+        __m256 thres = _mm256_set1_ps(threshold);
+        int count = 0;
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            // 一次取8行的值，大部分行都低于阈值，整组跳过
+            __m256 value = _mm256_i32gather_ps(data + (size_t)i * stride, offsets, 4);
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(value, thres, _CMP_GE_OQ));
+            while (mask) {
+                int lane = __builtin_ctz(mask);
+                rows[count++] = i + lane;
+                mask &= mask - 1;
+            }
+        }
+        int tail = select_rows_scalar(data + (size_t)i * stride, stride, n - i, threshold, rows + count);
+        for (int k = 0; k < tail; ++k) rows[count + k] += i;
+        return count + tail;
+    }
+#endif
+
+    int select_rows(const float* data, int stride, int n, float threshold, int* rows) {
+#ifdef POST_PROCESSING_HAS_AVX2
+        if (CPUKernel::avx2_enabled()) {
+            return select_rows_avx2(data, stride, n, threshold, rows);
+        }
+#endif
+        return select_rows_scalar(data, stride, n, threshold, rows);
+    }
+
+    static bool confidence_greater(const BBox& a, const BBox& b) {
+        return a.confidence > b.confidence;
+    }
+
+    void filter_topk(std::vector<BBox>& bboxes, float confidence_threshold, int top_k) {
+        bboxes.erase(std::remove_if(bboxes.begin(), bboxes.end(), [&](const BBox& b) { return !(b.confidence >= confidence_threshold); }),
+                     bboxes.end());
+
+        if (top_k > 0 && top_k < (int)bboxes.size()) {
+            std::partial_sort(bboxes.begin(), bboxes.begin() + top_k, bboxes.end(), confidence_greater);
+            bboxes.resize(top_k);
+        } else {
+            std::sort(bboxes.begin(), bboxes.end(), confidence_greater);
+        }
+    }
+
+    std::vector<BBox> nms(const std::vector<BBox>& bboxes, float iou_threshold, bool class_agnostic, int max_output) {
+        std::vector<BBox> sorted(bboxes);
+        std::stable_sort(sorted.begin(), sorted.end(), confidence_greater);
+
+        BoxArray boxes(sorted);
+        int n = boxes.size();
+        std::vector<unsigned char> removed(n, 0);
+        std::vector<float> iou(n);
+        std::vector<BBox> keep;
+        for (int i = 0; i < n; ++i) {
+            if (removed[i]) continue;
+
+            keep.emplace_back(sorted[i]);
+            if (max_output > 0 && (int)keep.size() >= max_output) break;
+
+            // 只需要和后面（confidence更低）的框比较
+            int rest = n - i - 1;
+            box_iou(sorted[i], &boxes.left[i + 1], &boxes.top[i + 1], &boxes.right[i + 1], &boxes.bottom[i + 1], rest, iou.data());
+
+            const float* label = &boxes.label[i + 1];
+            unsigned char* prest = &removed[i + 1];
+            float current_label = sorted[i].label;
+            for (int j = 0; j < rest; ++j) {
+                prest[j] |= (iou[j] > iou_threshold) & (class_agnostic | (label[j] == current_label));
+            }
+        }
+        return keep;
+    }
+
+    std::vector<BBox> soft_nms(const std::vector<BBox>& bboxes, float iou_threshold, float sigma, float score_threshold,
+                               SoftNMSMethod method, bool class_agnostic, int max_output) {
+        BoxArray boxes(bboxes);
+        int n = boxes.size();
+        std::vector<float> iou(n);
+        std::vector<BBox> keep;
+
+        // [0, i)为已经选出的框，[i, n)为剩余的候选
+        for (int i = 0; i < n; ++i) {
+            int best = std::max_element(boxes.confidence.begin() + i, boxes.confidence.begin() + n) - boxes.confidence.begin();
+            if (!(boxes.confidence[best] >= score_threshold)) break;
+
+            boxes.swap(i, best);
+            BBox picked = boxes.bbox(i);
+            keep.emplace_back(picked);
+            if (max_output > 0 && (int)keep.size() >= max_output) break;
+
+            int rest = n - i - 1;
+            box_iou(picked, &boxes.left[i + 1], &boxes.top[i + 1], &boxes.right[i + 1], &boxes.bottom[i + 1], rest, iou.data());
+
+            float* confidence  = &boxes.confidence[i + 1];
+            const float* label = &boxes.label[i + 1];
+            for (int j = 0; j < rest; ++j) {
+                if (!class_agnostic && label[j] != picked.label) continue;
+
+                float weight = 1.0f;
+                if (method == SoftNMSMethod::Linear) {
+                    if (iou[j] > iou_threshold) weight = 1.0f - iou[j];
+                } else {
+                    weight = expf(-iou[j] * iou[j] / sigma);
+                }
+                confidence[j] *= weight;
+            }
+        }
+
+        // 衰减后的confidence仍然是从大到小
+        return keep;
+    }
+
+    static inline void decode_box(const float* pitem, BoxFormat format, float& left, float& top, float& right, float& bottom) {
+        if (format == BoxFormat::CXCYWH) {
+            left   = pitem[0] - pitem[2] * 0.5f;
+            top    = pitem[1] - pitem[3] * 0.5f;
+            right  = pitem[0] + pitem[2] * 0.5f;
+            bottom = pitem[1] + pitem[3] * 0.5f;
+        } else {
+            left   = pitem[0];
+            top    = pitem[1];
+            right  = pitem[2];
+            bottom = pitem[3];
+        }
+    }
+
+    int batched_nms(TRT::Tensor& predict, const NMSParam& param, std::vector<std::shared_ptr<Detection::DetResult>>& result) {
+        if (predict.type() != TRT::DataType::Float || predict.ndims() != 3 || predict.size(2) <= 4) {
+            INFOE("batched_nms expect a Float tensor of [batch, N, 4 + C], but got %s %s",
+                  TRT::data_type_string(predict.type()), predict.shape_string());
+            return -1;
+        }
+
+        int batch_size  = predict.size(0);
+        int num_bboxes  = predict.size(1);
+        int item_size   = predict.size(2);
+        int num_classes = item_size - 4;
+        const float* pdata = predict.to_cpu().cpu<float>();
+
+        std::vector<BBox> candidates;
+        result.reserve(result.size() + batch_size);
+        for (int ibatch = 0; ibatch < batch_size; ++ibatch) {
+            candidates.clear();
+            const float* pimage = pdata + (size_t)ibatch * num_bboxes * item_size;
+            for (int i = 0; i < num_bboxes; ++i) {
+                const float* pitem  = pimage + (size_t)i * item_size;
+                const float* scores = pitem + 4;
+                int label = std::max_element(scores, scores + num_classes) - scores;
+                float confidence = scores[label];
+                if (!(confidence >= param.confidence_threshold)) continue;
+
+                float left, top, right, bottom;
+                decode_box(pitem, param.box_format, left, top, right, bottom);
+                candidates.emplace_back(left, top, right, bottom, confidence, label);
+            }
+
+            filter_topk(candidates, param.confidence_threshold, param.top_k);
+            result.emplace_back(std::make_shared<Detection::DetResult>(
+                nms(candidates, param.iou_threshold, param.class_agnostic, param.max_output)));
+        }
+        return 0;
+    }
+
+}; // PostProcessing
@@ -0,0 +1,64 @@
+#ifndef post_processing_H
+#define post_processing_H
+
+#include "detection.h"
+
+/* 检测任务的CPU后处理，用于导出时没有带NMS插件的模型
+   IoU按SoA每次计算一个框与一组框，x86上支持AVX2时8个一组计算，是否启用跟随CPUKernel::avx2_enabled()
+   所有输出都按confidence从大到小排列
+*/
+namespace PostProcessing {
+
+    enum class SoftNMSMethod : int {
+        Linear   = 0,   // iou > iou_threshold时 score *= 1 - iou
+        Gaussian = 1    // score *= exp(-iou * iou / sigma)
+    };
+
+    enum class BoxFormat : int {
+        XYXY   = 0,     // left, top, right, bottom
+        CXCYWH = 1      // center_x, center_y, width, height
+    };
+
+    float box_iou(const Detection::BBox& a, const Detection::BBox& b);
+
+    // box与n个SoA排列的框逐个计算IoU，写入iou[0, n)
+    void box_iou(const Detection::BBox& box,
+                 const float* left, const float* top, const float* right, const float* bottom,
+                 int n, float* iou);
+
+    // data按行排列，每行stride个float，找出第[0, n)行中data[row * stride] >= threshold的行，行号写入rows，返回行数
+    int select_rows(const float* data, int stride, int n, float threshold, int* rows);
+
+    // 去掉confidence < confidence_threshold的框，剩下的按confidence从大到小排序
+    // top_k > 0时只保留前top_k个，用partial sort，只有前top_k个参与排序
+    void filter_topk(std::vector<Detection::BBox>& bboxes, float confidence_threshold, int top_k = -1);
+
+    // 贪心NMS，class_agnostic为false时只抑制同一类的框；max_output > 0时保留够max_output个就结束
+    std::vector<Detection::BBox> nms(const std::vector<Detection::BBox>& bboxes, float iou_threshold,
+                                     bool class_agnostic = false, int max_output = -1);
+
+    // Soft-NMS：与已选中的框重叠的框衰减confidence而不是直接删除，衰减到score_threshold以下时丢弃
+    std::vector<Detection::BBox> soft_nms(const std::vector<Detection::BBox>& bboxes, float iou_threshold,
+                                          float sigma, float score_threshold,
+                                          SoftNMSMethod method = SoftNMSMethod::Gaussian,
+                                          bool class_agnostic = false, int max_output = -1);
+
+    struct NMSParam {
+        float     confidence_threshold = 0.25f;
+        float     iou_threshold        = 0.45f;
+        int       top_k                = 1000;     // 每张图进入NMS的候选数上限，<= 0不限制
+        int       max_output           = Detection::MAX_IMAGE_BBOX;
+        bool      class_agnostic       = false;
+        BoxFormat box_format           = BoxFormat::XYXY;
+    };
+
+    /* 对整个batch做 confidence过滤 + top-K + NMS
+       predict: Float, [batch, N, 4 + C]，前4个为box，后C个为每一类的score，每个候选取score最大的类
+       result中追加batch个DetResult
+       return: 0成功，输入格式不对返回-1
+    */
+    int batched_nms(TRT::Tensor& predict, const NMSParam& param, std::vector<std::shared_ptr<Detection::DetResult>>& result);
+
+}; // PostProcessing
+
+#endif // post_processing_H
@@ -1,7 +1,7 @@
 #include "pre_processing.h"
 #include <ilogger.hpp>
 
-cv::Size2f preprocessing::resize_keep_aspect_ratio(const cv::Mat& input, const cv::Size& dst_size, cv::Mat& output) {
+cv::Size2f PreProcessing::resize_keep_aspect_ratio(const cv::Mat& input, const cv::Size& dst_size, cv::Mat& output) {
     if (dst_size.width % 32 != 0 || dst_size.height % 32 != 0) {
         FMT_INFOF("Error: input layer size must be mod of 32");
     }
@@ -0,0 +1,161 @@
+
+#include <cuda_tools.hpp>
+#include "affine_matrix.h"
+
+namespace Detection {
+
+    const int YOLO_NUM_BOX_ELEMENT = 7;      // left, top, right, bottom, confidence, class, keepflag
+    const int YOLO_TOPK_BLOCK      = 256;
+
+    static __global__ void yolo_decode_kernel(float* predict, int num_bboxes, int num_classes, float confidence_threshold, float* invert_affine_matrix, float* parray, int max_objects){
+
+        int position = blockDim.x * blockIdx.x + threadIdx.x;
+        if (position >= num_bboxes) return;
+
+        float* pitem     = predict + (5 + num_classes) * position;
+        float objectness = pitem[4];
+        if(objectness < confidence_threshold)
+            return;
+
+        float* class_confidence = pitem + 5;
+        float confidence        = *class_confidence++;
+        int label               = 0;
+        for(int i = 1; i < num_classes; ++i, ++class_confidence){
+            if(*class_confidence > confidence){
+                confidence = *class_confidence;
+                label      = i;
+            }
+        }
+
+        confidence *= objectness;
+        if(confidence < confidence_threshold)
+            return;
+
+        int index = atomicAdd(parray, 1);
+        if(index >= max_objects)
+            return;
+
+        float cx     = *pitem++;
+        float cy     = *pitem++;
+        float width  = *pitem++;
+        float height = *pitem++;
+        float left   = cx - width * 0.5f;
+        float top    = cy - height * 0.5f;
+        float right  = cx + width * 0.5f;
+        float bottom = cy + height * 0.5f;
+        affine_project(invert_affine_matrix, left,  top,    &left,  &top);
+        affine_project(invert_affine_matrix, right, bottom, &right, &bottom);
+
+        float* pout_item = parray + 1 + index * YOLO_NUM_BOX_ELEMENT;
+        *pout_item++ = left;
+        *pout_item++ = top;
+        *pout_item++ = right;
+        *pout_item++ = bottom;
+        *pout_item++ = confidence;
+        *pout_item++ = label;
+        *pout_item++ = 1; // 1 = keep, 0 = ignore
+    }
+
+    /* 按confidence从大到小选出前max_objects个候选，写到parray中名次对应的位置，与cpu的filter_topk选出相同的框
+       每个线程统计比自己大的候选数作为名次，confidence相同时序号小的在前；候选的confidence按块读入shared memory
+    */
+    static __global__ void yolo_topk_kernel(const float* pcandidates, float* parray, int max_objects){
+
+        __shared__ float tile[YOLO_TOPK_BLOCK];
+        int count    = (int)*pcandidates;
+        int position = blockDim.x * blockIdx.x + threadIdx.x;
+        if (blockDim.x * blockIdx.x >= count)
+            return;
+
+        const float* pcurrent = pcandidates + 1 + position * YOLO_NUM_BOX_ELEMENT;
+        float confidence = position < count ? pcurrent[4] : 0.0f;
+        int rank = 0;
+        for(int base = 0; base < count; base += YOLO_TOPK_BLOCK){
+            int i = base + threadIdx.x;
+            tile[threadIdx.x] = i < count ? pcandidates[1 + i * YOLO_NUM_BOX_ELEMENT + 4] : 0.0f;
+            __syncthreads();
+
+            int n = min(YOLO_TOPK_BLOCK, count - base);
+            for(int j = 0; j < n; ++j)
+                rank += tile[j] > confidence || (tile[j] == confidence && base + j < position);
+            __syncthreads();
+        }
+
+        if(position == 0)
+            *parray = min(count, max_objects);
+
+        if(position >= count || rank >= max_objects)
+            return;
+
+        float* pout_item = parray + 1 + rank * YOLO_NUM_BOX_ELEMENT;
+        for(int i = 0; i < YOLO_NUM_BOX_ELEMENT; ++i)
+            pout_item[i] = pcurrent[i];
+    }
+
+    static __device__ float box_iou(
+        float aleft, float atop, float aright, float abottom,
+        float bleft, float btop, float bright, float bbottom
+    ){
+
+        float cleft   = max(aleft, bleft);
+        float ctop    = max(atop, btop);
+        float cright  = min(aright, bright);
+        float cbottom = min(abottom, bbottom);
+
+        float c_area = max(cright - cleft, 0.0f) * max(cbottom - ctop, 0.0f);
+        if(c_area == 0.0f)
+            return 0.0f;
+
+        float a_area = max(0.0f, aright - aleft) * max(0.0f, abottom - atop);
+        float b_area = max(0.0f, bright - bleft) * max(0.0f, bbottom - btop);
+        return c_area / (a_area + b_area - c_area);
+    }
+
+    static __global__ void yolo_nms_kernel(float* bboxes, int max_objects, float threshold){
+
+        int position = (blockDim.x * blockIdx.x + threadIdx.x);
+        int count = min((int)*bboxes, max_objects);
+        if (position >= count)
+            return;
+
+        // left, top, right, bottom, confidence, class, keepflag
+        float* pcurrent = bboxes + 1 + position * YOLO_NUM_BOX_ELEMENT;
+        for(int i = 0; i < count; ++i){
+            float* pitem = bboxes + 1 + i * YOLO_NUM_BOX_ELEMENT;
+            if(i == position || pcurrent[5] != pitem[5]) continue;
+
+            float iou = box_iou(
+                pcurrent[0], pcurrent[1], pcurrent[2], pcurrent[3],
+                   pitem[0],    pitem[1],    pitem[2],    pitem[3]
+            );
+
+            if(iou > threshold){
+                // confidence相同时保留序号小的，避免两个框互相抑制
+                if(pitem[4] > pcurrent[4] || (pitem[4] == pcurrent[4] && i < position)){
+                    pcurrent[6] = 0;  // 1=keep, 0=ignore
+                    return;
+                }
+            }
+        }
+    }
+
+    /* pcandidates: [count, num_bboxes * (left, top, right, bottom, confidence, class, keepflag)]，所有超过阈值的候选
+       parray: [count, max_objects * (...)]，按confidence从大到小的前max_objects个候选及NMS的keepflag
+       调用前两者的count都需要清零
+    */
+    void yolo_decode_kernel_invoker(float* predict, int num_bboxes, int num_classes, float confidence_threshold, float nms_threshold, float* invert_affine_matrix, float* pcandidates, float* parray, int max_objects, cudaStream_t stream){
+
+        auto grid = CUDATools::grid_dims(num_bboxes);
+        auto block = CUDATools::block_dims(num_bboxes);
+        checkCudaKernel(yolo_decode_kernel<<<grid, block, 0, stream>>>(predict, num_bboxes, num_classes, confidence_threshold, invert_affine_matrix, pcandidates, num_bboxes));
+
+        // 候选数不超过max_objects时只是按confidence排序
+        grid = dim3((num_bboxes + YOLO_TOPK_BLOCK - 1) / YOLO_TOPK_BLOCK);
+        checkCudaKernel(yolo_topk_kernel<<<grid, YOLO_TOPK_BLOCK, 0, stream>>>(pcandidates, parray, max_objects));
+
+        grid = CUDATools::grid_dims(max_objects);
+        block = CUDATools::block_dims(max_objects);
+        checkCudaKernel(yolo_nms_kernel<<<grid, block, 0, stream>>>(parray, max_objects, nms_threshold));
+    }
+
+}; // namespace Detection
@@ -0,0 +1,371 @@
+
+#include "plan_cache.hpp"
+#include <common/ilogger.hpp>
+#include <onnx/onnx_pb.h>
+#include <onnx_parser/MappedFile.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace TRT {
+
+	static const uint32_t SHA256_K[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+	static inline uint32_t rotr(uint32_t x, int n){
+		return (x >> n) | (x << (32 - n));
+	}
+
+	SHA256::SHA256(){
+		const uint32_t init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+		memcpy(state_, init, sizeof(state_));
+	}
+
+	void SHA256::transform(const uint8_t* block){
+
+		uint32_t w[64];
+		for(int i = 0; i < 16; ++i)
+			w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+
+		for(int i = 16; i < 64; ++i){
+			uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+		uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+		for(int i = 0; i < 64; ++i){
+			uint32_t s1    = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+			uint32_t ch    = (e & f) ^ (~e & g);
+			uint32_t temp1 = h + s1 + ch + SHA256_K[i] + w[i];
+			uint32_t s0    = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+			uint32_t maj   = (a & b) ^ (a & c) ^ (b & c);
+			uint32_t temp2 = s0 + maj;
+			h = g; g = f; f = e; e = d + temp1;
+			d = c; c = b; b = a; a = temp1 + temp2;
+		}
+
+		state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+		state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+	}
+
+	void SHA256::update(const void* data, size_t size){
+
+		const uint8_t* p = (const uint8_t*)data;
+		total_bytes_ += size;
+		while(size > 0){
+			size_t n = min(size, sizeof(buffer_) - buffer_size_);
+			memcpy(buffer_ + buffer_size_, p, n);
+			buffer_size_ += n;
+			p    += n;
+			size -= n;
+			if(buffer_size_ == sizeof(buffer_)){
+				transform(buffer_);
+				buffer_size_ = 0;
+			}
+		}
+	}
+
+	string SHA256::hex_digest(){
+
+		uint64_t total_bits = total_bytes_ * 8;
+		uint8_t padding[72] = {0x80};
+		size_t padding_size = (buffer_size_ < 56 ? 56 : 120) - buffer_size_;
+		for(int i = 0; i < 8; ++i)
+			padding[padding_size + i] = (uint8_t)(total_bits >> (56 - i * 8));
+		update(padding, padding_size + 8);
+
+		char hex[65];
+		for(int i = 0; i < 8; ++i)
+			snprintf(hex + i * 8, 9, "%08x", state_[i]);
+		return string(hex, 64);
+	}
+
+	string sha256_hex(const void* data, size_t size){
+		SHA256 sha;
+		sha.update(data, size);
+		return sha.hex_digest();
+	}
+
+	string sha256_file(const string& file){
+
+		FILE* f = fopen(file.c_str(), "rb");
+		if(f == nullptr){
+			INFOE("Open %s failed.", file.c_str());
+			return "";
+		}
+
+		SHA256 sha;
+		vector<uint8_t> block(1 << 20);
+		size_t n = 0;
+		while((n = fread(block.data(), 1, block.size(), f)) > 0)
+			sha.update(block.data(), n);
+
+		bool ok = ferror(f) == 0;
+		fclose(f);
+		return ok ? sha.hex_digest() : "";
+	}
+
+	static void collect_external_locations(const onnx::GraphProto& graph, vector<string>& locations);
+
+	static void collect_external_locations(const onnx::TensorProto& tensor, vector<string>& locations){
+		if(tensor.data_location() != onnx::TensorProto::EXTERNAL)
+			return;
+
+		for(auto& entry : tensor.external_data()){
+			if(entry.key() == "location")
+				locations.push_back(entry.value());
+		}
+	}
+
+	// 初始化器之外，Constant等节点的属性和If/Loop的子图中也可能有外部数据
+	static void collect_external_locations(const onnx::GraphProto& graph, vector<string>& locations){
+		for(auto& tensor : graph.initializer())
+			collect_external_locations(tensor, locations);
+
+		for(auto& sparse : graph.sparse_initializer()){
+			collect_external_locations(sparse.values(), locations);
+			collect_external_locations(sparse.indices(), locations);
+		}
+
+		for(auto& node : graph.node()){
+			for(auto& attribute : node.attribute()){
+				if(attribute.has_t())
+					collect_external_locations(attribute.t(), locations);
+				for(auto& tensor : attribute.tensors())
+					collect_external_locations(tensor, locations);
+				if(attribute.has_g())
+					collect_external_locations(attribute.g(), locations);
+				for(auto& subgraph : attribute.graphs())
+					collect_external_locations(subgraph, locations);
+			}
+		}
+	}
+
+	static vector<string> external_locations(const onnx::ModelProto& model){
+		vector<string> locations;
+		collect_external_locations(model.graph(), locations);
+		std::sort(locations.begin(), locations.end());
+		locations.erase(std::unique(locations.begin(), locations.end()), locations.end());
+		return locations;
+	}
+
+	bool onnx_external_data_files(const string& onnx_file, vector<string>& files){
+
+		files.clear();
+		onnx2trt::MappedFile file(onnx_file);
+		onnx::ModelProto model;
+		if(!file.isOpen() || !onnx2trt::parseFromMappedFile(file, &model)){
+			INFOE("Parse onnx %s failed.", onnx_file.c_str());
+			return false;
+		}
+
+		auto directory = onnx_file;
+		size_t slash = directory.rfind('/');
+		directory = slash == string::npos ? "" : directory.substr(0, slash + 1);
+		for(auto& location : external_locations(model))
+			files.push_back(directory + location);
+		return true;
+	}
+
+	bool onnx_external_data_locations(const void* data, size_t size, vector<string>& locations){
+
+		locations.clear();
+		onnx::ModelProto model;
+		if(size > INT_MAX || !model.ParseFromArray(data, (int)size)){
+			INFOE("Parse onnx data failed.");
+			return false;
+		}
+
+		locations = external_locations(model);
+		return true;
+	}
+
+	string PlanKey::canonical() const{
+
+		auto sorted_plugins = plugins;
+		std::sort(sorted_plugins.begin(), sorted_plugins.end());
+
+		string output = "onnx=" + onnx_hash + "\n";
+		output += "mode=" + mode + "\n";
+		output += iLogger::format("max_batch_size=%u\n", max_batch_size);
+		output += "inputs_dims=";
+		for(int i = 0; i < inputs_dims.size(); ++i){
+			output += i == 0 ? "[" : ",[";
+			for(int j = 0; j < inputs_dims[i].size(); ++j)
+				output += iLogger::format(j == 0 ? "%d" : "x%d", inputs_dims[i][j]);
+			output += "]";
+		}
+		output += iLogger::format("\nmax_workspace_size=%zu\n", max_workspace_size);
+		output += "plugins=";
+		for(int i = 0; i < sorted_plugins.size(); ++i)
+			output += (i == 0 ? "" : ",") + sorted_plugins[i];
+		output += "\ndevice=" + device + "\n";
+		// 没有外部数据时不出现，保持原有模型的key不变
+		for(auto& hash : external_data)
+			output += "external_data=" + hash + "\n";
+		output += "extra=" + extra + "\n";
+		return output;
+	}
+
+	string PlanKey::key() const{
+		auto text = canonical();
+		return sha256_hex(text.data(), text.size());
+	}
+
+	bool save_file_atomically(const string& file, const void* data, size_t size){
+
+		// 临时文件名包含pid和计数，多个进程、线程同时写同一个文件也不会冲突
+		static atomic<int> counter{0};
+		auto temp = iLogger::format("%s.tmp.%d.%d", file.c_str(), (int)getpid(), counter++);
+		if(!iLogger::save_file(temp, data, size)){
+			iLogger::delete_file(temp);
+			return false;
+		}
+
+		if(rename(temp.c_str(), file.c_str()) != 0){
+			INFOE("Rename %s to %s failed.", temp.c_str(), file.c_str());
+			iLogger::delete_file(temp);
+			return false;
+		}
+		return true;
+	}
+
+	static long long now_ns(){
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	static long long modify_time_ns(const string& file){
+		struct stat st;
+		if(stat(file.c_str(), &st) != 0)
+			return 0;
+		return (long long)st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+	}
+
+	PlanCache::PlanCache(const string& directory, size_t max_size){
+		directory_ = directory;
+		max_size_  = max_size;
+		if(!directory_.empty() && directory_.back() != '/')
+			directory_ += "/";
+
+		if(!iLogger::exists(directory_) && !iLogger::mkdirs(directory_))
+			INFOE("Create plan cache directory %s failed.", directory_.c_str());
+	}
+
+	string PlanCache::file(const string& key) const{
+		return directory_ + key + ".plan";
+	}
+
+	void PlanCache::touch(const string& file){
+
+		// 文件系统的时间戳精度较粗，同一进程内保证严格递增，LRU顺序才稳定
+		long long t = max(now_ns(), last_touch_ns_ + 1);
+		last_touch_ns_ = t;
+
+		struct timespec times[2];
+		times[0].tv_sec  = t / 1000000000ll;
+		times[0].tv_nsec = t % 1000000000ll;
+		times[1] = times[0];
+		utimensat(AT_FDCWD, file.c_str(), times, 0);
+	}
+
+	bool PlanCache::contains(const string& key) const{
+		return iLogger::isfile(file(key));
+	}
+
+	bool PlanCache::load(const string& key, vector<uint8_t>& plan){
+
+		auto path = file(key);
+		if(!iLogger::isfile(path))
+			return false;
+
+		plan = iLogger::load_file(path);
+		if(plan.empty()){
+			INFOW("Plan cache %s is empty, remove it.", path.c_str());
+			iLogger::delete_file(path);
+			return false;
+		}
+
+		touch(path);
+		return true;
+	}
+
+	bool PlanCache::save(const string& key, const void* data, size_t size){
+
+		if(data == nullptr || size == 0)
+			return false;
+
+		auto path = file(key);
+		if(!save_file_atomically(path, data, size))
+			return false;
+
+		touch(path);
+		if(max_size_ > 0)
+			evict(max_size_);
+		return true;
+	}
+
+	bool PlanCache::remove(const string& key){
+		return iLogger::delete_file(file(key));
+	}
+
+	vector<string> PlanCache::keys() const{
+
+		vector<pair<long long, string>> files;
+		for(auto& path : iLogger::find_files(directory_, "*.plan"))
+			files.emplace_back(modify_time_ns(path), iLogger::file_name(path, false));
+
+		std::sort(files.begin(), files.end());
+		vector<string> output;
+		for(auto& item : files)
+			output.push_back(item.second);
+		return output;
+	}
+
+	size_t PlanCache::total_size() const{
+		size_t size = 0;
+		for(auto& path : iLogger::find_files(directory_, "*.plan"))
+			size += iLogger::file_size(path);
+		return size;
+	}
+
+	int PlanCache::evict(size_t max_size){
+
+		auto all_keys = keys();
+		vector<size_t> sizes(all_keys.size());
+		size_t total = 0;
+		for(int i = 0; i < all_keys.size(); ++i){
+			sizes[i] = iLogger::file_size(file(all_keys[i]));
+			total   += sizes[i];
+		}
+
+		// 最新的一个总是保留，即使它本身已经超过max_size
+		int removed = 0;
+		for(int i = 0; i + 1 < all_keys.size() && total > max_size; ++i){
+			if(remove(all_keys[i])){
+				INFO("Plan cache evict %s [%.2f MB]", all_keys[i].c_str(), sizes[i] / 1024.0f / 1024.0f);
+				total -= sizes[i];
+				removed++;
+			}
+		}
+		return removed;
+	}
+
+};	// TRT
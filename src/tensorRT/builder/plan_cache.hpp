@@ -0,0 +1,101 @@
+#ifndef PLAN_CACHE_HPP
+#define PLAN_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace TRT {
+
+	class SHA256 {
+	public:
+		SHA256();
+		void update(const void* data, size_t size);
+
+		// 结束计算，返回64个字符的小写十六进制，之后不能再update
+		std::string hex_digest();
+
+	private:
+		void transform(const uint8_t* block);
+
+	private:
+		uint32_t state_[8];
+		uint8_t  buffer_[64];
+		size_t   buffer_size_ = 0;
+		uint64_t total_bytes_ = 0;
+	};
+
+	std::string sha256_hex(const void* data, size_t size);
+
+	// 按块读取文件计算，不会把整个文件读入内存；失败返回空字符串
+	std::string sha256_file(const std::string& file);
+
+	/* onnx模型通过external_data引用的外部数据文件（大模型的权重），location相对于模型文件所在目录，与onnx_parser一致
+	   files按location排序去重；模型无法解析时返回false
+	*/
+	bool onnx_external_data_files(const std::string& onnx_file, std::vector<std::string>& files);
+
+	// 内存中的模型没有所在目录，只返回排序去重后的location
+	bool onnx_external_data_locations(const void* data, size_t size, std::vector<std::string>& locations);
+
+	// 先写临时文件再rename，其他进程要么读到旧文件，要么读到完整的新文件
+	bool save_file_atomically(const std::string& file, const void* data, size_t size);
+
+	/* 决定engine内容的所有编译条件，任一项不同都会得到不同的key
+	   onnx_hash：onnx内容的sha256，与文件名、路径无关
+	   plugins：已注册插件的"名字/版本"，顺序无关
+	   device：计算能力 + TensorRT版本，例如"sm_86 TRT8.2.2"
+	   external_data：onnx引用的外部数据文件的sha256，按location排序，没有外部数据时为空
+	   extra：其他影响结果的内容，例如INT8的calibrator数据hash
+	*/
+	struct PlanKey {
+		std::string onnx_hash;
+		std::vector<std::string> external_data;
+		std::string mode;
+		unsigned int max_batch_size = 0;
+		std::vector<std::vector<int>> inputs_dims;
+		size_t max_workspace_size = 0;
+		std::vector<std::string> plugins;
+		std::string device;
+		std::string extra;
+
+		// 可读的规范化描述，key()是它的sha256
+		std::string canonical() const;
+		std::string key() const;
+	};
+
+	/* 按key缓存序列化后的engine，每个engine一个文件：directory/<key>.plan
+	   写入时先写临时文件再rename，其他进程不会读到写了一半的文件
+	   max_size大于0时，save之后按最近使用时间（文件mtime，load时更新）删除最旧的文件，直到总大小不超过max_size
+	*/
+	class PlanCache {
+	public:
+		PlanCache(const std::string& directory, size_t max_size = 0);
+
+		bool load(const std::string& key, std::vector<uint8_t>& plan);
+		bool save(const std::string& key, const void* data, size_t size);
+		bool remove(const std::string& key);
+		bool contains(const std::string& key) const;
+
+		// 按最近使用时间从旧到新
+		std::vector<std::string> keys() const;
+		size_t total_size() const;
+
+		// 删除最旧的文件直到总大小不超过max_size，返回删除的个数
+		int evict(size_t max_size);
+
+		const std::string& directory() const{return directory_;}
+		std::string file(const std::string& key) const;
+
+	private:
+		void touch(const std::string& file);
+
+	private:
+		std::string directory_;
+		size_t max_size_ = 0;
+		long long last_touch_ns_ = 0;
+	};
+
+};	// TRT
+
+#endif // PLAN_CACHE_HPP
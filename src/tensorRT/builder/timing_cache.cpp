@@ -0,0 +1,121 @@
+
+#include "timing_cache.hpp"
+#include "plan_cache.hpp"
+#include <common/ilogger.hpp>
+#include <string.h>
+
+using namespace std;
+
+namespace TRT {
+
+	// magic(8) + version(4) + device长度(4) + device + 数据长度(8) + sha256(64) + 数据
+	static const char TIMING_CACHE_MAGIC[8] = {'T', 'R', 'T', 'T', 'I', 'M', 'E', '\0'};
+	static const uint32_t TIMING_CACHE_VERSION = 1;
+
+	const char* timing_cache_status_string(TimingCacheStatus status){
+		switch(status){
+			case TimingCacheStatus::Success:   return "Success";
+			case TimingCacheStatus::NotExists: return "NotExists";
+			case TimingCacheStatus::Corrupted: return "Corrupted";
+			case TimingCacheStatus::Mismatch:  return "Mismatch";
+			default: return "Unknow";
+		}
+	}
+
+	static void write(vector<uint8_t>& output, size_t& cursor, const void* data, size_t size){
+		memcpy(output.data() + cursor, data, size);
+		cursor += size;
+	}
+
+	template<typename _T>
+	static bool read(const vector<uint8_t>& input, size_t& cursor, _T& value){
+		if(input.size() - cursor < sizeof(value))
+			return false;
+
+		memcpy(&value, input.data() + cursor, sizeof(value));
+		cursor += sizeof(value);
+		return true;
+	}
+
+	vector<uint8_t> encode_timing_cache(const string& device, const void* data, size_t size){
+
+		auto digest = sha256_hex(data, size);
+		uint32_t device_size = device.size();
+		uint64_t data_size   = size;
+		vector<uint8_t> output(sizeof(TIMING_CACHE_MAGIC) + sizeof(TIMING_CACHE_VERSION) + sizeof(device_size) + device.size() + sizeof(data_size) + digest.size() + size);
+
+		size_t cursor = 0;
+		write(output, cursor, TIMING_CACHE_MAGIC, sizeof(TIMING_CACHE_MAGIC));
+		write(output, cursor, &TIMING_CACHE_VERSION, sizeof(TIMING_CACHE_VERSION));
+		write(output, cursor, &device_size, sizeof(device_size));
+		write(output, cursor, device.data(), device.size());
+		write(output, cursor, &data_size, sizeof(data_size));
+		write(output, cursor, digest.data(), digest.size());
+		write(output, cursor, data, size);
+		return output;
+	}
+
+	TimingCacheStatus decode_timing_cache(const vector<uint8_t>& file_data, const string& device, vector<uint8_t>& data){
+
+		data.clear();
+		if(file_data.size() < sizeof(TIMING_CACHE_MAGIC) || memcmp(file_data.data(), TIMING_CACHE_MAGIC, sizeof(TIMING_CACHE_MAGIC)) != 0)
+			return TimingCacheStatus::Corrupted;
+
+		size_t cursor = sizeof(TIMING_CACHE_MAGIC);
+		uint32_t version = 0, device_size = 0;
+		if(!read(file_data, cursor, version) || !read(file_data, cursor, device_size))
+			return TimingCacheStatus::Corrupted;
+
+		if(version != TIMING_CACHE_VERSION)
+			return TimingCacheStatus::Mismatch;
+
+		if(file_data.size() - cursor < device_size)
+			return TimingCacheStatus::Corrupted;
+
+		string file_device((const char*)file_data.data() + cursor, device_size);
+		cursor += device_size;
+
+		uint64_t size = 0;
+		const size_t digest_size = 64;
+		if(!read(file_data, cursor, size) || file_data.size() - cursor < digest_size || file_data.size() - cursor - digest_size != size)
+			return TimingCacheStatus::Corrupted;
+
+		string digest((const char*)file_data.data() + cursor, digest_size);
+		cursor += digest_size;
+		if(sha256_hex(file_data.data() + cursor, size) != digest)
+			return TimingCacheStatus::Corrupted;
+
+		// 数据完好才比较设备，避免把损坏的文件报告为mismatch
+		if(file_device != device)
+			return TimingCacheStatus::Mismatch;
+
+		data.assign(file_data.begin() + cursor, file_data.end());
+		return TimingCacheStatus::Success;
+	}
+
+	TimingCacheStatus load_timing_cache(const string& file, const string& device, vector<uint8_t>& data){
+
+		data.clear();
+		if(!iLogger::isfile(file))
+			return TimingCacheStatus::NotExists;
+
+		return decode_timing_cache(iLogger::load_file(file), device, data);
+	}
+
+	bool save_timing_cache(const string& file, const string& device, const void* data, size_t size){
+
+		if(data == nullptr || size == 0)
+			return false;
+
+		auto pos = file.rfind('/');
+		if(pos != string::npos){
+			auto directory = file.substr(0, pos + 1);
+			if(!iLogger::exists(directory))
+				iLogger::mkdirs(directory);
+		}
+
+		auto file_data = encode_timing_cache(device, data, size);
+		return save_file_atomically(file, file_data.data(), file_data.size());
+	}
+
+};	// TRT
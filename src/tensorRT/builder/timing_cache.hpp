@@ -0,0 +1,33 @@
+#ifndef TIMING_CACHE_HPP
+#define TIMING_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace TRT {
+
+	enum class TimingCacheStatus : int{
+		Success   = 0,
+		NotExists = 1,
+		Corrupted = 2,   // 文件被截断、头部不对或者校验失败
+		Mismatch  = 3    // 来自其他设备或者其他版本的TensorRT
+	};
+
+	const char* timing_cache_status_string(TimingCacheStatus status);
+
+	/* timing cache文件 = 头部 + TensorRT序列化的ITimingCache
+	   头部记录device（计算能力 + TensorRT版本）和数据的sha256，
+	   TensorRT反序列化损坏的数据时可能直接崩溃，因此交给TensorRT之前先在这里检查，不通过的文件当作不存在
+	*/
+	std::vector<uint8_t> encode_timing_cache(const std::string& device, const void* data, size_t size);
+	TimingCacheStatus decode_timing_cache(const std::vector<uint8_t>& file_data, const std::string& device, std::vector<uint8_t>& data);
+
+	TimingCacheStatus load_timing_cache(const std::string& file, const std::string& device, std::vector<uint8_t>& data);
+
+	// 原子写入，多个进程同时build时不会写出半个文件
+	bool save_timing_cache(const std::string& file, const std::string& device, const void* data, size_t size);
+
+};	// TRT
+
+#endif // TIMING_CACHE_HPP
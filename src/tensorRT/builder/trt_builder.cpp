@@ -1,5 +1,7 @@
 
 #include "trt_builder.hpp"
+#include "plan_cache.hpp"
+#include "timing_cache.hpp"
 
 #include <cuda_runtime_api.h>
 #include <cublas_v2.h>
@@ -255,7 +257,11 @@ namespace TRT {
 		}
 	}
 
+	// layer hook会改变网络结构，设置后不能使用plan缓存
+	static bool g_has_layer_hook_reshape = false;
+
 	void set_layer_hook_reshape(const LayerHookFuncReshape& func){
+		g_has_layer_hook_reshape = func != nullptr;
 		register_layerhook_reshape(func);
 	}
 
@@ -286,6 +292,36 @@ namespace TRT {
 		:dims_(dims){
 	}
 
+	OptimizationProfile::OptimizationProfile(int minBatch, int optBatch, int maxBatch)
+		:min_batch_(minBatch), opt_batch_(optBatch), max_batch_(maxBatch){
+	}
+
+	OptimizationProfile& OptimizationProfile::set_input(int index, const InputDims& min, const InputDims& opt, const InputDims& max){
+		inputs_[index] = {min, opt, max};
+		return *this;
+	}
+
+	bool OptimizationProfile::input(int index, InputDims& min, InputDims& opt, InputDims& max) const{
+		auto iter = inputs_.find(index);
+		if(iter == inputs_.end())
+			return false;
+
+		min = iter->second[0];
+		opt = iter->second[1];
+		max = iter->second[2];
+		return true;
+	}
+
+	std::string OptimizationProfile::descript() const{
+		auto output = format("batch=%d/%d/%d", min_batch_, opt_batch_, max_batch_);
+		for(auto& item : inputs_){
+			output += format(" input%d=[%s]/[%s]/[%s]", item.first,
+				join_dims(item.second[0].dims()).c_str(), join_dims(item.second[1].dims()).c_str(), join_dims(item.second[2].dims()).c_str()
+			);
+		}
+		return output;
+	}
+
 	ModelSource::ModelSource(const char* onnxmodel){
 		this->type_ = ModelSourceType::OnnX;
 		this->onnxmodel_ = onnxmodel;
@@ -319,6 +355,213 @@ namespace TRT {
 	void CompileOutput::set_data(const std::vector<uint8_t>& data){data_ = data;}
 
 	void CompileOutput::set_data(std::vector<uint8_t>&& data){data_ = std::move(data);}
+
+	static bool save_compile_output(const CompileOutput& saveto, const void* data, size_t size){
+		if(saveto.type() == CompileOutputType::File){
+			return iLogger::save_file(saveto.file(), data, size);
+		}else{
+			((CompileOutput&)saveto).set_data(vector<uint8_t>((uint8_t*)data, (uint8_t*)data + size));
+			return true;
+		}
+	}
+
+	// 计算能力 + TensorRT版本，同一型号不同驱动下engine通常可以通用，因此不包括驱动版本
+	static string device_capability_string(){
+		int device = 0;
+		cudaDeviceProp prop;
+		checkCudaRuntime(cudaGetDevice(&device));
+		checkCudaRuntime(cudaGetDeviceProperties(&prop, device));
+		return format("sm_%d%d %s TRT%d.%d.%d", prop.major, prop.minor, prop.name, NV_TENSORRT_MAJOR, NV_TENSORRT_MINOR, NV_TENSORRT_PATCH);
+	}
+
+	static vector<string> registered_plugins(){
+		int num_creators = 0;
+		vector<string> output;
+		auto creators = getPluginRegistry()->getPluginCreatorList(&num_creators);
+		for(int i = 0; i < num_creators; ++i){
+			if(creators[i] == nullptr) continue;
+			output.push_back(format("%s/%s", creators[i]->getPluginName(), creators[i]->getPluginVersion()));
+		}
+		return output;
+	}
+
+	// entropyCalibratorData：INT8时已有的calibrator数据，为空时INT8需要重新校准，结果无法预先确定，不使用缓存
+	static bool make_plan_key(
+		Mode mode, unsigned int maxBatchSize, const ModelSource& source, const vector<InputDims>& inputsDimsSetup,
+		size_t maxWorkspaceSize, const vector<uint8_t>& entropyCalibratorData, const vector<OptimizationProfile>& profiles, string& output){
+
+		if (g_has_layer_hook_reshape) {
+			INFOW("Plan cache is disabled, because layer hook is set.");
+			return false;
+		}
+
+		if (mode == Mode::INT8 && entropyCalibratorData.empty()) {
+			INFOW("Plan cache is disabled, because int8EntropyCalibratorFile is not available.");
+			return false;
+		}
+
+		PlanKey key;
+		if (source.type() == ModelSourceType::OnnX)
+			key.onnx_hash = sha256_file(source.onnxmodel());
+		else
+			key.onnx_hash = sha256_hex(source.onnx_data(), source.onnx_data_size());
+
+		if (key.onnx_hash.empty())
+			return false;
+
+		// 权重在外部数据文件中时，只改权重不会改变onnx文件本身，外部数据也要计入key
+		vector<string> external_files;
+		if (source.type() == ModelSourceType::OnnX) {
+			if (!onnx_external_data_files(source.onnxmodel(), external_files))
+				return false;
+
+			for (auto& file : external_files) {
+				auto hash = sha256_file(file);
+				if (hash.empty()) {
+					INFOW("Plan cache is disabled, because external data %s is not readable.", file.c_str());
+					return false;
+				}
+				key.external_data.push_back(hash);
+			}
+		} else {
+			// 内存中的模型无法确定外部数据文件的位置，不使用缓存
+			if (!onnx_external_data_locations(source.onnx_data(), source.onnx_data_size(), external_files))
+				return false;
+
+			if (!external_files.empty()) {
+				INFOW("Plan cache is disabled, because the onnx data references %d external data files.", (int)external_files.size());
+				return false;
+			}
+		}
+
+		key.mode               = mode_string(mode);
+		key.max_batch_size     = maxBatchSize;
+		key.max_workspace_size = maxWorkspaceSize;
+		key.plugins            = registered_plugins();
+		key.device             = device_capability_string();
+		for (auto& dims : inputsDimsSetup)
+			key.inputs_dims.push_back(dims.dims());
+
+		if (mode == Mode::INT8)
+			key.extra = "calibrator=" + sha256_hex(entropyCalibratorData.data(), entropyCalibratorData.size());
+
+		for (auto& profile : profiles)
+			key.extra += " profile=" + profile.descript();
+
+		output = key.key();
+		return true;
+	}
+
+	// 按网络的输入维度补全profile中的-1，检查与网络中的静态维度一致，且min <= opt <= max
+	static bool resolve_profile_dims(const OptimizationProfile& profile, int index, const nvinfer1::Dims& network_dims, nvinfer1::Dims output[3]){
+
+		InputDims dims[3];
+		if (!profile.input(index, dims[0], dims[1], dims[2])) {
+			vector<int> shape(network_dims.d, network_dims.d + network_dims.nbDims);
+			int batch[] = {profile.min_batch(), profile.opt_batch(), profile.max_batch()};
+			for (int s = 0; s < 3; ++s) {
+				shape[0] = batch[s];
+				dims[s]  = shape;
+			}
+		}
+
+		for (int s = 0; s < 3; ++s) {
+			auto& shape = dims[s].dims();
+			if (shape.size() != network_dims.nbDims) {
+				INFOE("Profile dims [%s] mismatch the network input dims [%s]", join_dims(shape).c_str(), dims_str(network_dims).c_str());
+				return false;
+			}
+
+			output[s] = network_dims;
+			for (int j = 0; j < shape.size(); ++j) {
+				int value = shape[j] == -1 ? network_dims.d[j] : shape[j];
+				if (value <= 0) {
+					INFOE("Dim %d of the network input [%s] is dynamic, it must be set in profile.", j, dims_str(network_dims).c_str());
+					return false;
+				}
+
+				if (j > 0 && network_dims.d[j] != -1 && value != network_dims.d[j]) {
+					INFOE("Dim %d of the network input [%s] is static, but profile set %d.", j, dims_str(network_dims).c_str(), value);
+					return false;
+				}
+				output[s].d[j] = value;
+			}
+		}
+
+		for (int j = 0; j < network_dims.nbDims; ++j) {
+			if (output[0].d[j] > output[1].d[j] || output[1].d[j] > output[2].d[j]) {
+				INFOE("Profile requires min <= opt <= max, but dim %d is %d, %d, %d.", j, output[0].d[j], output[1].d[j], output[2].d[j]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ITimingCache没有destroy，直接delete
+	typedef shared_ptr<ITimingCache> TimingCachePtr;
+
+	static TimingCachePtr create_timing_cache(IBuilderConfig* config, const void* data, size_t size){
+		return TimingCachePtr(config->createTimingCache(data, size), [](ITimingCache* ptr){delete ptr;});
+	}
+
+	/* 加载timing cache并设置到config，文件不可用或者TensorRT拒绝时从空cache开始
+	   loaded_size：实际使用的已有数据大小，从空cache开始时为0
+	   返回nullptr表示当前平台无法使用timing cache（例如部分jetson），按原来的方式build
+	*/
+	static TimingCachePtr setup_timing_cache(IBuilderConfig* config, const string& file, const string& device, size_t& loaded_size){
+
+		vector<uint8_t> data;
+		auto status = load_timing_cache(file, device, data);
+		if (status == TimingCacheStatus::Corrupted || status == TimingCacheStatus::Mismatch)
+			INFOW("Timing cache %s is %s, ignore it.", file.c_str(), timing_cache_status_string(status));
+
+		TimingCachePtr cache;
+		if (!data.empty()) {
+			cache = create_timing_cache(config, data.data(), data.size());
+			if (cache == nullptr || !config->setTimingCache(*cache, false)) {
+				INFOW("TensorRT can not use timing cache %s, ignore it.", file.c_str());
+				cache.reset();
+			}
+		}
+
+		if (cache == nullptr) {
+			data.clear();
+			cache = create_timing_cache(config, nullptr, 0);
+			if (cache == nullptr || !config->setTimingCache(*cache, false)) {
+				INFOW("Timing cache is not supported on this platform.");
+				return nullptr;
+			}
+		}
+
+		loaded_size = data.size();
+		if (loaded_size > 0)
+			INFO("Load timing cache %s [%.2f KB]", file.c_str(), loaded_size / 1024.0f);
+		return cache;
+	}
+
+	// build期间其他进程可能也更新了文件，合并之后再写回，避免互相覆盖对方新增的计时
+	static void save_merged_timing_cache(IBuilderConfig* config, ITimingCache* cache, const string& file, const string& device, size_t loaded_size){
+
+		vector<uint8_t> data;
+		if (load_timing_cache(file, device, data) == TimingCacheStatus::Success) {
+			auto other = create_timing_cache(config, data.data(), data.size());
+			if (other == nullptr || !cache->combine(*other, false))
+				INFOW("Merge timing cache %s failed, overwrite it.", file.c_str());
+		}
+
+		shared_ptr<IHostMemory> serialized(cache->serialize(), destroy_nvidia_pointer<IHostMemory>);
+		if (serialized == nullptr || !save_timing_cache(file, device, serialized->data(), serialized->size())) {
+			INFOW("Save timing cache %s failed.", file.c_str());
+			return;
+		}
+
+		// TensorRT不提供查询条目数的接口，用序列化后的大小表示复用和新增的计时
+		size_t total_size = serialized->size();
+		size_t new_size   = total_size > loaded_size ? total_size - loaded_size : 0;
+		INFO("Save timing cache %s [%.2f KB], reused %.2f KB of tactic timings, %.2f KB newly measured.",
+			file.c_str(), total_size / 1024.0f, loaded_size / 1024.0f, new_size / 1024.0f
+		);
+	}
 	/////////////////////////////////////////////////////////////////////////////////////////
 	class Int8EntropyCalibrator : public IInt8EntropyCalibrator2
 	{
@@ -417,7 +660,11 @@ namespace TRT {
 		Int8Process int8process,
 		const std::string& int8ImageDirectory,
 		const std::string& int8EntropyCalibratorFile,
-		const size_t maxWorkspaceSize) {
+		const size_t maxWorkspaceSize,
+		const std::string& planCacheDirectory,
+		const size_t planCacheMaxSize,
+		const std::string& timingCacheFile,
+		const std::vector<OptimizationProfile>& profiles) {
 
 		if (mode == Mode::INT8 && int8process == nullptr) {
 			INFOE("int8process must not nullptr, when in int8 mode.");
@@ -471,6 +718,19 @@ namespace TRT {
 			}
 		}
 
+		shared_ptr<PlanCache> planCache;
+		string planKey;
+		if (!planCacheDirectory.empty() && make_plan_key(mode, maxBatchSize, source, inputsDimsSetup, maxWorkspaceSize, entropyCalibratorData, profiles, planKey)) {
+			planCache.reset(new PlanCache(planCacheDirectory, planCacheMaxSize));
+
+			vector<uint8_t> plan;
+			if (planCache->load(planKey, plan)) {
+				INFO("Plan cache hit %s, skip building.", planCache->file(planKey).c_str());
+				return save_compile_output(saveto, plan.data(), plan.size());
+			}
+			INFO("Plan cache miss %s", planCache->file(planKey).c_str());
+		}
+
 		INFO("Compile %s %s.", mode_string(mode), source.descript().c_str());
 		shared_ptr<IBuilder> builder(createInferBuilder(gLogger), destroy_nvidia_pointer<IBuilder>);
 		if (builder == nullptr) {
@@ -619,15 +879,31 @@ namespace TRT {
 		builder->setMaxBatchSize(maxBatchSize);
 		config->setMaxWorkspaceSize(maxWorkspaceSize);
 
-		auto profile = builder->createOptimizationProfile();
-		for(int i = 0; i < net_num_input; ++i){
-			auto input = network->getInput(i);
-			auto input_dims = input->getDimensions();
-			input_dims.d[0] = 1;
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, input_dims);
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, input_dims);
-			input_dims.d[0] = maxBatchSize;
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, input_dims);
+		auto optimizationProfiles = profiles;
+		if (optimizationProfiles.empty())
+			optimizationProfiles.push_back(OptimizationProfile(1, 1, maxBatchSize));
+
+		INFO("Set %d optimization profiles:", optimizationProfiles.size());
+		for(int k = 0; k < optimizationProfiles.size(); ++k){
+			auto profile = builder->createOptimizationProfile();
+			for(int i = 0; i < net_num_input; ++i){
+				auto input = network->getInput(i);
+				nvinfer1::Dims dims[3];
+				if(!resolve_profile_dims(optimizationProfiles[k], i, input->getDimensions(), dims)){
+					INFOE("Invalid optimization profile %d for input %d.[%s]", k, i, input->getName());
+					return false;
+				}
+
+				INFO("      %d.[%s] min %s, opt %s, max %s", k, input->getName(), dims_str(dims[0]).c_str(), dims_str(dims[1]).c_str(), dims_str(dims[2]).c_str());
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, dims[0]);
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, dims[1]);
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, dims[2]);
+			}
+
+			if(config->addOptimizationProfile(profile) < 0){
+				INFOE("Add optimization profile %d failed.", k);
+				return false;
+			}
 		}
 
 		// not need
@@ -640,11 +916,12 @@ namespace TRT {
 		// 	output_dims.d[0] = maxBatchSize;
 		// 	profile->setDimensions(output->getName(), nvinfer1::OptProfileSelector::kMAX, output_dims);
 		// }
-		config->addOptimizationProfile(profile);
 
-		// error on jetson
-		// auto timing_cache = shared_ptr<nvinfer1::ITimingCache>(config->createTimingCache(nullptr, 0), [](nvinfer1::ITimingCache* ptr){ptr->reset();});
-		// config->setTimingCache(*timing_cache, false);
+		TimingCachePtr timingCache;
+		size_t loadedTimingCacheSize = 0;
+		if (!timingCacheFile.empty())
+			timingCache = setup_timing_cache(config.get(), timingCacheFile, device_capability_string(), loadedTimingCacheSize);
+
 		// config->setFlag(BuilderFlag::kGPU_FALLBACK);
 		// config->setDefaultDeviceType(DeviceType::kDLA);
 		// config->setDLACore(0);
@@ -670,14 +947,55 @@ namespace TRT {
 		}
 
 		INFO("Build done %lld ms !", iLogger::timestamp_now() - time_start);
+		if (timingCache)
+			save_merged_timing_cache(config.get(), timingCache.get(), timingCacheFile, device_capability_string(), loadedTimingCacheSize);
 		
 		// serialize the engine, then close everything down
 		shared_ptr<IHostMemory> seridata(engine->serialize(), destroy_nvidia_pointer<IHostMemory>);
-		if(saveto.type() == CompileOutputType::File){
-			return iLogger::save_file(saveto.file(), seridata->data(), seridata->size());
-		}else{
-			((CompileOutput&)saveto).set_data(vector<uint8_t>((uint8_t*)seridata->data(), (uint8_t*)seridata->data()+seridata->size()));
-			return true;
+		if (planCache) {
+			if (!planCache->save(planKey, seridata->data(), seridata->size()))
+				INFOW("Save plan cache %s failed.", planCache->file(planKey).c_str());
+		}
+		return save_compile_output(saveto, seridata->data(), seridata->size());
+	}
+
+	std::shared_ptr<Infer> load_infer_or_compile(
+		const ModelSource& source,
+		const std::string& planCacheDirectory,
+		Mode mode,
+		unsigned int maxBatchSize,
+		const std::vector<InputDims> inputsDimsSetup,
+		Int8Process int8process,
+		const std::string& int8ImageDirectory,
+		const std::string& int8EntropyCalibratorFile,
+		const size_t maxWorkspaceSize,
+		const size_t planCacheMaxSize,
+		const std::string& timingCacheFile,
+		const std::vector<OptimizationProfile>& profiles) {
+
+		// 缓存的文件损坏或者与当前环境不兼容时，第一次加载失败，重新build一次
+		for (int itry = 0; itry < 2; ++itry) {
+			CompileOutput output(CompileOutputType::Memory);
+			if (!compile(mode, maxBatchSize, source, output, inputsDimsSetup, int8process, int8ImageDirectory, int8EntropyCalibratorFile,
+				maxWorkspaceSize, planCacheDirectory, planCacheMaxSize, timingCacheFile, profiles)) {
+				return nullptr;
+			}
+
+			auto infer = load_infer_from_memory(output.data().data(), output.data().size());
+			if (infer != nullptr || itry == 1)
+				return infer;
+
+			vector<uint8_t> entropyCalibratorData;
+			if (mode == Mode::INT8 && iLogger::exists(int8EntropyCalibratorFile))
+				entropyCalibratorData = iLogger::load_file(int8EntropyCalibratorFile);
+
+			string key;
+			if (!make_plan_key(mode, maxBatchSize, source, inputsDimsSetup, maxWorkspaceSize, entropyCalibratorData, profiles, key))
+				return nullptr;
+
+			INFOW("Load plan failed, remove the plan cache and rebuild.");
+			PlanCache(planCacheDirectory).remove(key);
 		}
+		return nullptr;
 	}
 }; //namespace TRTBuilder
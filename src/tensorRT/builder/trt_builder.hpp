@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <map>
 #include <infer/trt_infer.hpp>
 
 namespace TRT {
@@ -88,6 +89,32 @@ namespace TRT {
 		std::vector<int> dims_;
 	};
 
+	/* 动态shape的优化配置，compile可以指定多个，推理时Infer按实际输入形状选择（见infer/optimization_profile.hpp）
+	   只指定batch范围时，所有输入的其他维度使用网络中的大小
+	   set_input为某个输入指定完整的min/opt/max（包括batch），-1表示使用网络中该维的大小，网络中为动态的维度必须指定
+	**/
+	class OptimizationProfile {
+	public:
+		OptimizationProfile() = default;
+		OptimizationProfile(int minBatch, int optBatch, int maxBatch);
+
+		OptimizationProfile& set_input(int index, const InputDims& min, const InputDims& opt, const InputDims& max);
+
+		int min_batch() const{return min_batch_;}
+		int opt_batch() const{return opt_batch_;}
+		int max_batch() const{return max_batch_;}
+
+		// 没有通过set_input指定时返回false
+		bool input(int index, InputDims& min, InputDims& opt, InputDims& max) const;
+		std::string descript() const;
+
+	private:
+		int min_batch_ = 1;
+		int opt_batch_ = 1;
+		int max_batch_ = 1;
+		std::map<int, std::vector<InputDims>> inputs_;    // {min, opt, max}
+	};
+
 	enum class Mode : int {
 		FP32,
 		FP16,
@@ -105,6 +132,14 @@ namespace TRT {
 	          从int8ImageDirectory读取图片再重新生成
 		当处于FP32或者FP16时，int8process、int8ImageDirectory、int8EntropyCalibratorFile都不需要指定 
 		对于嵌入式设备，请把maxWorkspaceSize设置小一点，比如128MB = 1ul << 27
+		planCacheDirectory不为空时启用engine缓存（见plan_cache.hpp），onnx内容、mode、batch、输入尺寸、workspace、插件、
+		     设备和TensorRT版本都相同时直接使用缓存，不再build；planCacheMaxSize > 0时缓存目录按LRU限制总大小
+		     设置了layer hook，或者INT8模式下没有可用的calibrator文件时，无法判断结果是否相同，不使用缓存
+		timingCacheFile不为空时启用tactic的timing cache（见timing_cache.hpp），build前加载，build后合并写回
+		     修改了部分层的模型再次build时，已经计时过的tactic不再重新计时；文件损坏或者来自其他设备、版本时忽略
+		profiles为空时只有一个优化配置：batch的min、opt为1，max为maxBatchSize
+		     指定多个时，例如{OptimizationProfile(1, 1, 1), OptimizationProfile(1, 8, 16)}，同一个engine
+		     既能以低延迟处理单张，也能以高吞吐处理批量
 	**/
 	bool compile(
 		Mode mode,
@@ -115,7 +150,27 @@ namespace TRT {
 		Int8Process int8process = nullptr,
 		const std::string& int8ImageDirectory = "",
 		const std::string& int8EntropyCalibratorFile = "",
-		const size_t maxWorkspaceSize = 1ul << 30                // 1ul << 30 = 1GB
+		const size_t maxWorkspaceSize = 1ul << 30,               // 1ul << 30 = 1GB
+		const std::string& planCacheDirectory = "",
+		const size_t planCacheMaxSize = 0,
+		const std::string& timingCacheFile = "",
+		const std::vector<OptimizationProfile>& profiles = {}
+	);
+
+	// 通过plan缓存编译（命中时只是读取缓存）并加载，参数同compile
+	std::shared_ptr<Infer> load_infer_or_compile(
+		const ModelSource& source,
+		const std::string& planCacheDirectory,
+		Mode mode = Mode::FP32,
+		unsigned int maxBatchSize = 1,
+		const std::vector<InputDims> inputsDimsSetup = {},
+		Int8Process int8process = nullptr,
+		const std::string& int8ImageDirectory = "",
+		const std::string& int8EntropyCalibratorFile = "",
+		const size_t maxWorkspaceSize = 1ul << 30,
+		const size_t planCacheMaxSize = 0,
+		const std::string& timingCacheFile = "",
+		const std::vector<OptimizationProfile>& profiles = {}
 	);
 };
 
@@ -6,11 +6,63 @@
 #include <memory>
 #include <mutex>
 #include <thread>
-#include <queue>
+#include <deque>
+#include <vector>
+#include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include <condition_variable>
 #include <infer/trt_infer.hpp>
+#include <common/ilogger.hpp>
 #include "monopoly_allocator.hpp"
 
+/* 动态batch策略
+   worker在get_jobs_and_wait中等待，直到凑满max_batch_size，或者队列中最早的任务已经等待了max_queue_delay_us
+   max_batch_size：0表示使用worker传入的max_size，否则取两者较小值
+   max_queue_delay_us：0表示不等待，队列中有任务就立即返回（默认行为）
+   preferred_batch_sizes：超时提交时，优先凑成其中不超过当前任务数的最大值（例如引擎只针对1/4/8做过优化），为空则不限制
+*/
+struct BatchPolicy{
+    int max_batch_size     = 0;
+    int max_queue_delay_us = 0;
+    std::vector<int> preferred_batch_sizes;
+};
+
+// 每个batch的占用率统计
+struct BatchStatistics{
+    uint64_t num_batches        = 0;
+    uint64_t num_jobs           = 0;
+    uint64_t num_full_flush     = 0;      // 凑满batch后提交
+    uint64_t num_partial_flush  = 0;      // 未凑满即提交（等待超时，或者max_queue_delay_us为0）
+    int max_batch_size          = 0;
+    std::vector<uint64_t> batch_size_histogram;   // 下标为batch size
+
+    float average_batch_size() const{
+        return num_batches == 0 ? 0 : num_jobs / (float)num_batches;
+    }
+
+    // 平均每个batch的填充率，[0, 1]
+    float occupancy() const{
+        return max_batch_size == 0 ? 0 : average_batch_size() / max_batch_size;
+    }
+};
+
+/* 任务优先级，数值越小优先级越高，每个优先级对应一条独立的队列（lane）
+   多条lane之间按权重做加权公平调度（smooth weighted round robin），避免低优先级的大量回填任务拖慢高优先级任务，同时低优先级也不会被饿死
+*/
+enum class JobPriority : int{
+    High   = 0,
+    Normal = 1,
+    Low    = 2
+};
+
+// 任务在截止时间之前未能开始推理时被丢弃，对应的future在get时抛出该异常，以区别于preprocess失败返回的空结果
+class JobDeadlineExceeded : public std::runtime_error{
+public:
+    JobDeadlineExceeded() : std::runtime_error("Job deadline exceeded"){}
+};
+
 template<class Input, class Output, class StartParam=std::tuple<std::string, int>, class JobAdditional=int>
 class InferController{
 public:
@@ -20,8 +72,15 @@ public:
         JobAdditional additional;
         MonopolyAllocator<TRT::Tensor>::MonopolyDataPointer mono_tensor;
         std::shared_ptr<std::promise<Output>> pro;
+        std::chrono::steady_clock::time_point enqueue_time;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        int priority = static_cast<int>(JobPriority::Normal);
     };
 
+    InferController(){
+        set_lane_weights({8, 4, 1});
+    }
+
     virtual ~InferController(){
         stop();
     }
@@ -33,72 +92,182 @@ public:
         ////////////////////////////////////////// cleanup jobs
         {
             std::unique_lock<std::mutex> l(jobs_lock_);
-            while(!jobs_.empty()){
-                auto& item = jobs_.front();
-                if(item.pro)
-                    item.pro->set_value(Output());
-                jobs_.pop();
+            for(auto& lane : lanes_){
+                for(auto& item : lane.jobs){
+                    if(item.pro)
+                        item.pro->set_value(Output());
+                }
+                lane.jobs.clear();
             }
+            num_jobs_ = 0;
         };
 
-        if(worker_){
-            worker_->join();
-            worker_.reset();
+        for(auto& worker : workers_){
+            if(worker->joinable())
+                worker->join();
         }
+        workers_.clear();
     }
 
-    bool startup(const StartParam& param){
+    /* num_workers：worker线程数量，所有worker从同一个jobs_队列取任务
+       每个worker应当持有自己的执行上下文和stream（参考TRT::Infer::fork_context），以便多个batch在同一个引擎上重叠执行
+       任意一个worker启动失败，则全部停止并返回false
+    */
+    bool startup(const StartParam& param, int num_workers = 1){
         run_ = true;
 
-        std::promise<bool> pro;
+        if(num_workers < 1) num_workers = 1;
+        std::vector<std::promise<bool>> pros(num_workers);
         start_param_ = param;
-        worker_      = std::make_shared<std::thread>(&InferController::worker, this, std::ref(pro));
-        return pro.get_future().get();
+        for(int i = 0; i < num_workers; ++i){
+            workers_.push_back(std::make_shared<std::thread>(&InferController::worker_entry, this, i, std::ref(pros[i])));
+        }
+
+        bool ok = true;
+        for(auto& pro : pros)
+            ok = pro.get_future().get() && ok;
+
+        if(!ok) stop();
+        return ok;
+    }
+
+    int num_workers() const{
+        return static_cast<int>(workers_.size());
+    }
+
+    void set_batch_policy(const BatchPolicy& policy){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        batch_policy_ = policy;
+        std::sort(batch_policy_.preferred_batch_sizes.begin(), batch_policy_.preferred_batch_sizes.end());
+    }
+
+    BatchPolicy batch_policy(){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        return batch_policy_;
+    }
+
+    BatchStatistics batch_statistics(){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        return batch_statistics_;
+    }
+
+    void reset_batch_statistics(){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        batch_statistics_ = BatchStatistics();
+    }
+
+    /* 设置每条lane的调度权重，lane的数量等于weights.size()，下标即优先级
+       默认3条lane，权重8:4:1，即队列都积压时High/Normal/Low按该比例出队
+       只能在startup之前调用
+    */
+    void set_lane_weights(const std::vector<int>& weights){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        if(weights.empty() || num_jobs_ > 0){
+            INFOE("Set lane weights failed, weights is empty or jobs are pending");
+            return;
+        }
+
+        lanes_.resize(weights.size());
+        for(int i = 0; i < lanes_.size(); ++i){
+            lanes_[i].weight = std::max(1, weights[i]);
+            lanes_[i].current_weight = 0;
+        }
+    }
+
+    int num_lanes() const{
+        return static_cast<int>(lanes_.size());
+    }
+
+    // 因超过截止时间而被丢弃的任务数
+    uint64_t num_expired_jobs(){
+        std::unique_lock<std::mutex> l(jobs_lock_);
+        return num_expired_jobs_;
     }
 
     virtual std::shared_future<Output> commit(const Input& input){
+        return commit(input, static_cast<int>(JobPriority::Normal), std::chrono::steady_clock::time_point::max());
+    }
+
+    /* priority：优先级，取值[0, num_lanes)，超出范围时截断
+       deadline：绝对截止时间，到期仍未开始推理的任务会被丢弃，future抛出JobDeadlineExceeded
+    */
+    virtual std::shared_future<Output> commit(const Input& input, int priority, std::chrono::steady_clock::time_point deadline){
 
         Job job;
         job.pro = std::make_shared<std::promise<Output>>();
+        job.priority = clamp_priority(priority);
+        job.deadline = deadline;
+
+        // 已经过期的任务不做预处理，直接返回
+        if(std::chrono::steady_clock::now() >= deadline){
+            expire_job(job);
+            return job.pro->get_future();
+        }
+
         if(!preprocess(job, input)){
             job.pro->set_value(Output());
             return job.pro->get_future();
         }
         
+        std::shared_future<Output> result = job.pro->get_future();
         ///////////////////////////////////////////////////////////
         {
             std::unique_lock<std::mutex> l(jobs_lock_);
-            jobs_.push(job);
+            job.enqueue_time = std::chrono::steady_clock::now();
+            push_job_locked(job);
         };
         cond_.notify_one();
-        return job.pro->get_future();
+        return result;
     }
 
     virtual std::vector<std::shared_future<Output>> commits(const std::vector<Input>& inputs){
+        return commits(inputs, static_cast<int>(JobPriority::Normal), std::chrono::steady_clock::time_point::max());
+    }
+
+    virtual std::vector<std::shared_future<Output>> commits(const std::vector<Input>& inputs, int priority, std::chrono::steady_clock::time_point deadline){
 
         int batch_size = std::min((int)inputs.size(), this->tensor_allocator_->capacity());
         std::vector<Job> jobs(inputs.size());
         std::vector<std::shared_future<Output>> results(inputs.size());
+        std::vector<bool> ready(inputs.size(), false);
 
         int nepoch = (inputs.size() + batch_size - 1) / batch_size;
         for(int epoch = 0; epoch < nepoch; ++epoch){
             int begin = epoch * batch_size;
             int end   = std::min((int)inputs.size(), begin + batch_size);
 
+            int num_ready = 0;
             for(int i = begin; i < end; ++i){
                 Job& job = jobs[i];
                 job.pro = std::make_shared<std::promise<Output>>();
+                job.priority = clamp_priority(priority);
+                job.deadline = deadline;
+                results[i] = job.pro->get_future();
+
+                // 前面的批次可能已经等待了较长时间，每个批次预处理之前都检查一次
+                if(std::chrono::steady_clock::now() >= deadline){
+                    expire_job(job);
+                    continue;
+                }
+
                 if(!preprocess(job, inputs[i])){
                     job.pro->set_value(Output());
+                    continue;
                 }
-                results[i] = job.pro->get_future();
+                ready[i] = true;
+                num_ready++;
             }
 
+            if(num_ready == 0) continue;
+
             ///////////////////////////////////////////////////////////
             {
                 std::unique_lock<std::mutex> l(jobs_lock_);
+                auto now = std::chrono::steady_clock::now();
                 for(int i = begin; i < end; ++i){
-                    jobs_.emplace(std::move(jobs[i]));
+                    if(!ready[i]) continue;
+                    jobs[i].enqueue_time = now;
+                    push_job_locked(jobs[i]);
                 };
             }
             cond_.notify_one();
@@ -108,47 +277,176 @@ public:
 
 protected:
     virtual void worker(std::promise<bool>& result) = 0;
+
+    // 多worker时重写该函数，worker_id取值[0, num_workers)；默认忽略worker_id
+    virtual void worker(int worker_id, std::promise<bool>& result){
+        worker(result);
+    }
     virtual bool preprocess(Job& job, const Input& input) = 0;
     
     virtual bool get_jobs_and_wait(std::vector<Job>& fetch_jobs, int max_size){
 
         std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&](){
-            return !run_ || !jobs_.empty();
-        });
+        int limit = max_size;
+        if(batch_policy_.max_batch_size > 0)
+            limit = std::min(limit, batch_policy_.max_batch_size);
+
+        while(true){
+            cond_.wait(l, [&](){
+                return !run_ || num_jobs_ > 0;
+            });
+
+            if(!run_) return false;
+
+            // 过期的任务不再占用batch的位置
+            drop_expired_jobs_locked(std::chrono::steady_clock::now());
+            if(num_jobs_ == 0) continue;
+            if(batch_policy_.max_queue_delay_us <= 0) break;
+
+            // 等到凑满一个batch，或者最早的任务到期
+            auto deadline = oldest_enqueue_time_locked() + std::chrono::microseconds(batch_policy_.max_queue_delay_us);
+            cond_.wait_until(l, deadline, [&](){
+                return !run_ || num_jobs_ >= limit;
+            });
+
+            if(!run_) return false;
+
+            // 多worker时，任务可能已经被其他worker取走
+            drop_expired_jobs_locked(std::chrono::steady_clock::now());
+            if(num_jobs_ > 0) break;
+        }
+
+        int take = std::min(limit, num_jobs_);
+        bool full = take == limit;
+        if(!full){
+            auto& preferred = batch_policy_.preferred_batch_sizes;
+            auto it = std::upper_bound(preferred.begin(), preferred.end(), take);
+            if(it != preferred.begin() && *(it - 1) > 0)
+                take = *(it - 1);
+        }
 
-        if(!run_) return false;
-        
         fetch_jobs.clear();
-        for(int i = 0; i < max_size && !jobs_.empty(); ++i){
-            fetch_jobs.emplace_back(std::move(jobs_.front()));
-            jobs_.pop();
+        for(int i = 0; i < take; ++i){
+            fetch_jobs.emplace_back();
+            pop_job_locked(fetch_jobs.back());
         }
+
+        auto& stat = batch_statistics_;
+        if(stat.batch_size_histogram.size() <= take)
+            stat.batch_size_histogram.resize(take + 1, 0);
+        stat.batch_size_histogram[take]++;
+        stat.num_batches++;
+        stat.num_jobs += take;
+        stat.max_batch_size = std::max(stat.max_batch_size, limit);
+        if(full) stat.num_full_flush++;
+        else     stat.num_partial_flush++;
         return true;
     }
 
     virtual bool get_job_and_wait(Job& fetch_job){
 
         std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&](){
-            return !run_ || !jobs_.empty();
-        });
+        while(true){
+            cond_.wait(l, [&](){
+                return !run_ || num_jobs_ > 0;
+            });
+
+            if(!run_) return false;
 
-        if(!run_) return false;
+            drop_expired_jobs_locked(std::chrono::steady_clock::now());
+            if(num_jobs_ > 0) break;
+        }
         
-        fetch_job = std::move(jobs_.front());
-        jobs_.pop();
+        pop_job_locked(fetch_job);
         return true;
     }
 
+    // 任务过期：释放占用的tensor，future抛出JobDeadlineExceeded
+    virtual void expire_job(Job& job){
+        if(job.mono_tensor){
+            job.mono_tensor->release();
+            job.mono_tensor.reset();
+        }
+        job.pro->set_exception(std::make_exception_ptr(JobDeadlineExceeded()));
+    }
+
+private:
+    struct Lane{
+        std::deque<Job> jobs;
+        int weight = 1;
+        int current_weight = 0;
+    };
+
+    void worker_entry(int worker_id, std::promise<bool>& result){
+        worker(worker_id, result);
+    }
+
+    int clamp_priority(int priority) const{
+        return std::max(0, std::min(priority, static_cast<int>(lanes_.size()) - 1));
+    }
+
+    void push_job_locked(Job& job){
+        lanes_[job.priority].jobs.emplace_back(std::move(job));
+        num_jobs_++;
+    }
+
+    // smooth weighted round robin：每次出队时，非空lane的current_weight加上自身权重，选最大者出队并减去非空lane的权重之和
+    void pop_job_locked(Job& fetch_job){
+        Lane* selected = nullptr;
+        int total_weight = 0;
+        for(auto& lane : lanes_){
+            if(lane.jobs.empty()) continue;
+            lane.current_weight += lane.weight;
+            total_weight += lane.weight;
+            if(selected == nullptr || lane.current_weight > selected->current_weight)
+                selected = &lane;
+        }
+
+        selected->current_weight -= total_weight;
+        fetch_job = std::move(selected->jobs.front());
+        selected->jobs.pop_front();
+        num_jobs_--;
+    }
+
+    void drop_expired_jobs_locked(std::chrono::steady_clock::time_point now){
+        for(auto& lane : lanes_){
+            auto& jobs = lane.jobs;
+            auto end = std::remove_if(jobs.begin(), jobs.end(), [&](Job& job){
+                if(job.deadline > now) return false;
+                expire_job(job);
+                return true;
+            });
+
+            int num_expired = static_cast<int>(jobs.end() - end);
+            jobs.erase(end, jobs.end());
+            num_jobs_ -= num_expired;
+            num_expired_jobs_ += num_expired;
+        }
+    }
+
+    std::chrono::steady_clock::time_point oldest_enqueue_time_locked() const{
+        auto oldest = std::chrono::steady_clock::time_point::max();
+        for(auto& lane : lanes_){
+            if(!lane.jobs.empty())
+                oldest = std::min(oldest, lane.jobs.front().enqueue_time);
+        }
+        return oldest;
+    }
+
 protected:
     StartParam start_param_;
     std::atomic<bool> run_;
     std::mutex jobs_lock_;
-    std::queue<Job> jobs_;
-    std::shared_ptr<std::thread> worker_;
+    std::vector<std::shared_ptr<std::thread>> workers_;
     std::condition_variable cond_;
     std::shared_ptr<MonopolyAllocator<TRT::Tensor>> tensor_allocator_;
+    BatchPolicy batch_policy_;
+    BatchStatistics batch_statistics_;
+
+private:
+    std::vector<Lane> lanes_;
+    int num_jobs_ = 0;
+    uint64_t num_expired_jobs_ = 0;
 };
 
 #endif // INFER_CONTROLLER_HPP
\ No newline at end of file
@@ -0,0 +1,211 @@
+
+#include "memory_pool.hpp"
+#include "ilogger.hpp"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+namespace TRT{
+
+	const size_t MemoryPool::kMinBlockSize;
+	const size_t MemoryPool::kUnlimited;
+
+	const char* memory_kind_string(MemoryKind kind){
+		switch(kind){
+			case MemoryKind::Host: return "Host";
+			case MemoryKind::Device: return "Device";
+			default: return "Unknow";
+		}
+	}
+
+	class MallocMemoryBackend : public MemoryBackend{
+	public:
+		virtual void* allocate(MemoryKind kind, int device_id, size_t size) override{
+			return malloc(size);
+		}
+
+		virtual void deallocate(MemoryKind kind, int device_id, void* ptr) override{
+			free(ptr);
+		}
+
+		virtual void fill(MemoryKind kind, int device_id, void* ptr, int value, size_t size) override{
+			memset(ptr, value, size);
+		}
+
+		virtual const char* name() const override{
+			return "malloc";
+		}
+	};
+
+	shared_ptr<MemoryBackend> malloc_memory_backend(){
+		static shared_ptr<MemoryBackend> backend(new MallocMemoryBackend());
+		return backend;
+	}
+
+	MemoryPool::MemoryPool(shared_ptr<MemoryBackend> backend){
+		if(backend == nullptr)
+			INFOF("MemoryPool backend is nullptr");
+		backend_ = backend;
+	}
+
+	MemoryPool::~MemoryPool(){
+		empty_cache();
+	}
+
+	size_t MemoryPool::round_size(size_t size){
+		if(size <= kMinBlockSize)
+			return kMinBlockSize;
+
+		// size在(2^k, 2^(k+1)]之间时，按2^(k-2)对齐
+		int k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+		size_t step = (size_t)1 << (k - 2);
+		return (size + step - 1) / step * step;
+	}
+
+	MemoryPool::Arena& MemoryPool::arena_locked(MemoryKind kind, int device_id){
+		return arenas_[make_pair((int)kind, device_id)];
+	}
+
+	void* MemoryPool::allocate(MemoryKind kind, int device_id, size_t size, size_t* block_size){
+
+		size_t rounded = round_size(size);
+		if(block_size) *block_size = 0;
+
+		unique_lock<mutex> l(lock_);
+		auto& arena = arena_locked(kind, device_id);
+		auto& stat  = arena.statistics;
+		auto iter   = arena.free_blocks.find(rounded);
+		if(iter != arena.free_blocks.end() && !iter->second.empty()){
+			// 从最近释放的开始找事件已经完成的block。都没有完成时不在锁内等待GPU，按miss重新申请
+			auto& blocks = iter->second;
+			int index = (int)blocks.size() - 1;
+			while(index >= 0 && blocks[index].event != nullptr && !backend_->query_event(blocks[index].event))
+				--index;
+
+			if(index >= 0){
+				void* ptr = blocks[index].ptr;
+				if(blocks[index].event != nullptr)
+					backend_->destroy_event(blocks[index].event);
+				blocks.erase(blocks.begin() + index);
+				stat.hits++;
+				stat.bytes_cached -= rounded;
+				stat.bytes_in_use += rounded;
+				if(block_size) *block_size = rounded;
+				return ptr;
+			}
+			stat.busy++;
+		}
+		stat.misses++;
+
+		void* ptr = backend_->allocate(kind, device_id, rounded);
+		if(ptr == nullptr && stat.bytes_cached > 0){
+			size_t released = trim_locked(arena, kind, device_id, 0);
+			INFOW("%s memory allocation of %lld bytes on device %d failed, release %lld cached bytes and retry",
+				memory_kind_string(kind), (long long)rounded, device_id, (long long)released
+			);
+			ptr = backend_->allocate(kind, device_id, rounded);
+		}
+
+		if(ptr == nullptr){
+			INFOE("%s memory allocation of %lld bytes on device %d failed, backend = %s",
+				memory_kind_string(kind), (long long)rounded, device_id, backend_->name()
+			);
+			return nullptr;
+		}
+
+		stat.bytes_in_use += rounded;
+		stat.peak_bytes = std::max(stat.peak_bytes, stat.bytes_in_use + stat.bytes_cached);
+		if(block_size) *block_size = rounded;
+		return ptr;
+	}
+
+	void MemoryPool::deallocate(MemoryKind kind, int device_id, void* ptr, size_t block_size, void* stream){
+
+		if(ptr == nullptr) return;
+
+		unique_lock<mutex> l(lock_);
+		auto& arena = arena_locked(kind, device_id);
+		auto& stat  = arena.statistics;
+		stat.bytes_in_use -= block_size;
+
+		// 直接还给后端时由后端的释放函数同步（cudaFree），只有放回缓存的block需要事件
+		if(block_size > arena.cache_limit){
+			stat.trims++;
+			backend_->deallocate(kind, device_id, ptr);
+			return;
+		}
+
+		FreeBlock block;
+		block.ptr   = ptr;
+		block.event = backend_->record_event(device_id, stream);
+		arena.free_blocks[block_size].push_back(block);
+		stat.bytes_cached += block_size;
+		if(stat.bytes_cached > arena.cache_limit)
+			trim_locked(arena, kind, device_id, arena.cache_limit);
+	}
+
+	size_t MemoryPool::trim_locked(Arena& arena, MemoryKind kind, int device_id, size_t target_bytes){
+
+		// 从最大的size class开始释放，频繁使用的小block尽量保留
+		size_t released = 0;
+		auto& stat = arena.statistics;
+		auto iter  = arena.free_blocks.end();
+		while(stat.bytes_cached > target_bytes && iter != arena.free_blocks.begin()){
+			--iter;
+
+			auto& blocks = iter->second;
+			while(!blocks.empty() && stat.bytes_cached > target_bytes){
+				if(blocks.back().event != nullptr)
+					backend_->destroy_event(blocks.back().event);
+				backend_->deallocate(kind, device_id, blocks.back().ptr);
+				blocks.pop_back();
+				stat.bytes_cached -= iter->first;
+				stat.trims++;
+				released += iter->first;
+			}
+		}
+		return released;
+	}
+
+	size_t MemoryPool::trim(MemoryKind kind, int device_id, size_t target_bytes){
+		unique_lock<mutex> l(lock_);
+		return trim_locked(arena_locked(kind, device_id), kind, device_id, target_bytes);
+	}
+
+	void MemoryPool::empty_cache(){
+		unique_lock<mutex> l(lock_);
+		for(auto& item : arenas_)
+			trim_locked(item.second, (MemoryKind)item.first.first, item.first.second, 0);
+	}
+
+	void MemoryPool::set_cache_limit(MemoryKind kind, int device_id, size_t bytes){
+		unique_lock<mutex> l(lock_);
+		auto& arena = arena_locked(kind, device_id);
+		arena.cache_limit = bytes;
+		trim_locked(arena, kind, device_id, bytes);
+	}
+
+	size_t MemoryPool::cache_limit(MemoryKind kind, int device_id){
+		unique_lock<mutex> l(lock_);
+		return arena_locked(kind, device_id).cache_limit;
+	}
+
+	MemoryPoolStatistics MemoryPool::statistics(MemoryKind kind, int device_id){
+		unique_lock<mutex> l(lock_);
+		return arena_locked(kind, device_id).statistics;
+	}
+
+	void MemoryPool::reset_statistics(){
+		unique_lock<mutex> l(lock_);
+		for(auto& item : arenas_){
+			auto& stat = item.second.statistics;
+			stat.hits   = 0;
+			stat.misses = 0;
+			stat.trims  = 0;
+			stat.busy   = 0;
+			stat.peak_bytes = stat.bytes_in_use + stat.bytes_cached;
+		}
+	}
+};
@@ -0,0 +1,122 @@
+#ifndef MEMORY_POOL_HPP
+#define MEMORY_POOL_HPP
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+
+namespace TRT {
+
+    enum class MemoryKind : int{
+        Host   = 0,     // pinned host memory
+        Device = 1
+    };
+
+    const char* memory_kind_string(MemoryKind kind);
+
+    /* 真正申请/释放内存的后端，MemoryPool通过它和CUDA或者其他实现打交道
+       allocate失败时返回nullptr，不要在这里中断程序，MemoryPool会清理缓存后重试
+    */
+    class MemoryBackend{
+    public:
+        virtual ~MemoryBackend() = default;
+        virtual void* allocate(MemoryKind kind, int device_id, size_t size) = 0;
+        virtual void deallocate(MemoryKind kind, int device_id, void* ptr) = 0;
+
+        // 同步地把[ptr, ptr + size)的每个字节设置为value
+        virtual void fill(MemoryKind kind, int device_id, void* ptr, int value, size_t size) = 0;
+        virtual const char* name() const = 0;
+
+        /* 释放block时在stream当前的末尾记录事件，事件完成前stream上的kernel/拷贝可能还在使用这个block
+           stream为nullptr时是默认stream。没有异步执行的后端返回nullptr，block可以立即重用
+        */
+        virtual void* record_event(int device_id, void* stream){ return nullptr; }
+        virtual bool  query_event(void* event){ return true; }
+        virtual void  destroy_event(void* event){}
+    };
+
+    // 用malloc/free实现的后端，Host和Device都是普通内存，用于没有GPU的测试和评测
+    std::shared_ptr<MemoryBackend> malloc_memory_backend();
+
+    // cudaMallocHost/cudaMalloc实现的后端，定义在trt_tensor.cpp中
+    std::shared_ptr<MemoryBackend> cuda_memory_backend();
+
+    struct MemoryPoolStatistics{
+        size_t hits          = 0;   // 从缓存中拿到block的次数
+        size_t misses        = 0;   // 需要向后端申请的次数
+        size_t trims         = 0;   // 因超出上限或者申请失败而还给后端的block数
+        size_t bytes_in_use  = 0;
+        size_t bytes_cached  = 0;
+        size_t peak_bytes    = 0;   // bytes_in_use + bytes_cached的峰值
+        size_t busy          = 0;   // 缓存中有同样大小的block但释放事件都未完成的次数，同时计入misses
+    };
+
+    /* 按size class缓存的内存池，Host(pinned)和Device分开管理，每个device各自一份
+       1. 申请的大小向上取整到size class：每个2的幂区间分4档，浪费不超过25%，最小512字节
+       2. 释放的block放回对应size class的缓存，同样大小的下一次申请直接复用，不再调用后端
+       3. 每个(kind, device)可以设置缓存的上限，超出时从最大的block开始还给后端
+       4. 后端申请失败时，先把该(kind, device)的缓存全部还给后端，再重试一次
+       5. deallocate时在释放者的stream上记录事件，block只在事件完成后才会再分配出去：
+          同一size class中取事件已经完成的block，都未完成时不等待，按miss向后端申请新的block
+    */
+    class MemoryPool{
+    public:
+        static const size_t kMinBlockSize = 512;
+        static const size_t kUnlimited    = (size_t)-1;
+
+        explicit MemoryPool(std::shared_ptr<MemoryBackend> backend);
+        virtual ~MemoryPool();
+
+        // 返回的block大小写入block_size，deallocate时需要原样传回；失败返回nullptr
+        void* allocate(MemoryKind kind, int device_id, size_t size, size_t* block_size = nullptr);
+        // stream为最后使用这个block的stream，见MemoryBackend::record_event
+        void deallocate(MemoryKind kind, int device_id, void* ptr, size_t block_size, void* stream = nullptr);
+
+        // 缓存上限，默认kUnlimited，设置为0等价于不缓存
+        void set_cache_limit(MemoryKind kind, int device_id, size_t bytes);
+        size_t cache_limit(MemoryKind kind, int device_id);
+
+        // 把缓存降到target_bytes以下，返回还给后端的字节数
+        size_t trim(MemoryKind kind, int device_id, size_t target_bytes = 0);
+
+        // 所有缓存还给后端
+        void empty_cache();
+
+        MemoryPoolStatistics statistics(MemoryKind kind, int device_id);
+        void reset_statistics();
+
+        std::shared_ptr<MemoryBackend> backend() const{return backend_;}
+
+        static size_t round_size(size_t size);
+
+    private:
+        struct FreeBlock{
+            void* ptr;
+            void* event;    // 释放时记录的事件，nullptr表示可以立即重用
+        };
+
+        struct Arena{
+            std::map<size_t, std::vector<FreeBlock>> free_blocks;
+            MemoryPoolStatistics statistics;
+            size_t cache_limit = kUnlimited;
+        };
+
+        Arena& arena_locked(MemoryKind kind, int device_id);
+        size_t trim_locked(Arena& arena, MemoryKind kind, int device_id, size_t target_bytes);
+
+    private:
+        std::mutex lock_;
+        std::map<std::pair<int, int>, Arena> arenas_;
+        std::shared_ptr<MemoryBackend> backend_;
+    };
+
+    /* MixMemory默认使用的全局内存池，后端为cuda_memory_backend()
+       set_memory_pool只影响之后创建的MixMemory，已有的MixMemory持有各自的pool直到析构
+    */
+    std::shared_ptr<MemoryPool> memory_pool();
+    void set_memory_pool(std::shared_ptr<MemoryPool> pool);
+};
+
+#endif // MEMORY_POOL_HPP
@@ -23,6 +23,11 @@
  * 而引擎推理时，每次拿1个batch的数据进行推理
  * 当引擎推理速度慢而预处理速度快时，输入图像势必需要进行等候。否则缓存队列会越来越大
  * 而这里提到的几个点就是设计的主要目标
+ * 
+ * 实现方式：
+ * 空闲座位用无锁的侵入式链表（free-list）管理，query/release都是O(1)的CAS操作
+ * 链表头部带有版本号(tag)，避免ABA问题
+ * 没有空闲座位时，先自旋spin_count次，仍然没有则挂起在条件变量上，直到有人release或者超时
  **/
 
 #ifndef MONOPOLY_ALLOCATOR_HPP
@@ -32,6 +37,10 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
 
 template<class _ItemType>
 class MonopolyAllocator{
@@ -46,30 +55,40 @@ public:
         void release(){manager_->release_one(this);}
 
     private:
-        MonopolyData(MonopolyAllocator* pmanager){manager_ = pmanager;}
+        MonopolyData(MonopolyAllocator* pmanager, int index){manager_ = pmanager; index_ = index;}
 
     private:
         friend class MonopolyAllocator;
         MonopolyAllocator* manager_ = nullptr;
         std::shared_ptr<_ItemType> data_;
-        bool available_ = true;
+        std::atomic<bool> available_{true};
+        int index_ = 0;
     };
     typedef std::shared_ptr<MonopolyData> MonopolyDataPointer;
 
-    MonopolyAllocator(int size){
+    /* size：座位数量
+       spin_count：没有可用对象时，挂起前自旋重试的次数
+    */
+    MonopolyAllocator(int size, int spin_count = 64){
         capacity_ = size;
+        spin_count_ = spin_count;
         num_available_ = size;
         datas_.resize(size);
+        next_.reset(new std::atomic<uint32_t>[size]);
 
-        for(int i = 0; i < size; ++i)
-            datas_[i] = std::shared_ptr<MonopolyData>(new MonopolyData(this));
+        // 链表中保存的是index + 1，0表示链表尾
+        for(int i = 0; i < size; ++i){
+            datas_[i] = std::shared_ptr<MonopolyData>(new MonopolyData(this, i));
+            next_[i].store(i + 1 < size ? i + 2 : 0);
+        }
+        head_.store(size > 0 ? 1 : 0);
     }
 
     virtual ~MonopolyAllocator(){
         run_ = false;
-        cv_.notify_all();
-        
+
         std::unique_lock<std::mutex> l(lock_);
+        cv_.notify_all();
         cv_exit_.wait(l, [&](){
             return num_wait_thread_ == 0;
         });
@@ -81,31 +100,46 @@ public:
     */
     MonopolyDataPointer query(int timeout = 10000){
 
-        std::unique_lock<std::mutex> l(lock_);
         if(!run_) return nullptr;
-        
-        if(num_available_ == 0){
-            num_wait_thread_++;
 
-            auto state = cv_.wait_for(l, std::chrono::milliseconds(timeout), [&](){
-                return num_available_ > 0 || !run_;
-            });
+        int index = pop_free();
+        for(int i = 0; index == -1 && i < spin_count_ && run_; ++i){
+            std::this_thread::yield();
+            index = pop_free();
+        }
+
+        if(index == -1){
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+            std::unique_lock<std::mutex> l(lock_);
 
+            // 必须先登记等待者再检查链表，与release_one中先入链表再检查等待者配对，保证不会丢失唤醒
+            num_wait_thread_++;
+            while(run_){
+                index = pop_free();
+                if(index != -1) break;
+
+                if(cv_.wait_until(l, deadline) == std::cv_status::timeout){
+                    index = pop_free();
+                    break;
+                }
+            }
             num_wait_thread_--;
             cv_exit_.notify_one();
-
-            // timeout, no available, exit program
-            if(!state || num_available_ == 0 || !run_)
-                return nullptr;
         }
 
-        auto item = std::find_if(datas_.begin(), datas_.end(), [](MonopolyDataPointer& item){return item->available_;});
-        if(item == datas_.end())
+        // timeout, no available, exit program
+        if(index == -1)
             return nullptr;
-        
-        (*item)->available_ = false;
+
+        if(!run_){
+            push_free(index);
+            return nullptr;
+        }
+
+        auto& item = datas_[index];
+        item->available_.store(false);
         num_available_--;
-        return *item;
+        return item;
     }
 
     int num_available(){
@@ -118,23 +152,54 @@ public:
 
 private:
     void release_one(MonopolyData* prq){
-        std::unique_lock<std::mutex> l(lock_);
-        if(!prq->available_){
-            prq->available_ = true;
-            num_available_++;
+        if(prq->available_.exchange(true))
+            return;
+
+        num_available_++;
+        push_free(prq->index_);
+
+        if(num_wait_thread_ > 0){
+            std::unique_lock<std::mutex> l(lock_);
             cv_.notify_one();
         }
     }
 
+    // 弹出一个空闲座位，没有则返回-1
+    int pop_free(){
+        uint64_t old_head = head_.load();
+        while(true){
+            uint32_t top = static_cast<uint32_t>(old_head);
+            if(top == 0) return -1;
+
+            uint32_t next = next_[top - 1].load(std::memory_order_relaxed);
+            uint64_t new_head = (((old_head >> 32) + 1) << 32) | next;
+            if(head_.compare_exchange_weak(old_head, new_head))
+                return top - 1;
+        }
+    }
+
+    void push_free(int index){
+        uint64_t old_head = head_.load();
+        while(true){
+            next_[index].store(static_cast<uint32_t>(old_head), std::memory_order_relaxed);
+            uint64_t new_head = (((old_head >> 32) + 1) << 32) | static_cast<uint32_t>(index + 1);
+            if(head_.compare_exchange_weak(old_head, new_head))
+                return;
+        }
+    }
+
 private:
     std::mutex lock_;
     std::condition_variable cv_;
     std::condition_variable cv_exit_;
     std::vector<MonopolyDataPointer> datas_;
+    std::unique_ptr<std::atomic<uint32_t>[]> next_;
+    std::atomic<uint64_t> head_{0};       // 高32位为tag，低32位为index + 1
     int capacity_ = 0;
-    volatile int num_available_ = 0;
-    volatile int num_wait_thread_ = 0;
-    volatile bool run_ = true;
+    int spin_count_ = 0;
+    std::atomic<int> num_available_{0};
+    std::atomic<int> num_wait_thread_{0};
+    std::atomic<bool> run_{true};
 };
 
 #endif // MONOPOLY_ALLOCATOR_HPP
\ No newline at end of file
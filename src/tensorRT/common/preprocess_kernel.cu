@@ -3,31 +3,6 @@
 
 namespace CUDAKernel{
 
-	Norm Norm::mean_std(const float mean[3], const float std[3], float alpha, ChannelType channel_type){
-
-		Norm out;
-		out.type  = NormType::MeanStd;
-		out.alpha = alpha;
-		out.channel_type = channel_type;
-		memcpy(out.mean, mean, sizeof(out.mean));
-		memcpy(out.std,  std,  sizeof(out.std));
-		return out;
-	}
-
-	Norm Norm::alpha_beta(float alpha, float beta, ChannelType channel_type){
-
-		Norm out;
-		out.type = NormType::AlphaBeta;
-		out.alpha = alpha;
-		out.beta = beta;
-		out.channel_type = channel_type;
-		return out;
-	}
-
-	Norm Norm::None(){
-		return Norm();
-	}	
-
 	#define INTER_RESIZE_COEF_BITS 11
 	#define INTER_RESIZE_COEF_SCALE (1 << INTER_RESIZE_COEF_BITS)
 	#define CAST_BITS (INTER_RESIZE_COEF_BITS << 1)
@@ -433,9 +408,9 @@ namespace CUDAKernel{
         int offset_uv = (oy >> 1) * linesize + (ox & 0xFFFFFFFE);
         const uint8_t& u = uv[offset_uv + 0];
         const uint8_t& v = uv[offset_uv + 1];
-		dst_bgr[position * 3 + 0] = 1.164f * (yvalue - 16.0f) + 2.018f * (u - 128.0f);
-		dst_bgr[position * 3 + 1] = 1.164f * (yvalue - 16.0f) - 0.813f * (v - 128.0f) - 0.391f * (u - 128.0f);
-		dst_bgr[position * 3 + 2] = 1.164f * (yvalue - 16.0f) + 1.596f * (v - 128.0f);
+		dst_bgr[position * 3 + 0] = cast(1.164f * (yvalue - 16.0f) + 2.018f * (u - 128.0f));
+		dst_bgr[position * 3 + 1] = cast(1.164f * (yvalue - 16.0f) - 0.813f * (v - 128.0f) - 0.391f * (u - 128.0f));
+		dst_bgr[position * 3 + 2] = cast(1.164f * (yvalue - 16.0f) + 1.596f * (v - 128.0f));
     }
 
 
@@ -2,37 +2,10 @@
 #define PREPROCESS_KERNEL_CUH
 
 #include "cuda_tools.hpp"
+#include "preprocess_norm.hpp"
 
 namespace CUDAKernel{
 
-    enum class NormType : int{
-        None      = 0,
-        MeanStd   = 1,
-        AlphaBeta = 2
-    };
-
-    enum class ChannelType : int{
-        None          = 0,
-        Invert        = 1
-    };
-
-    struct Norm{
-        float mean[3];
-        float std[3];
-        float alpha, beta;
-        NormType type = NormType::None;
-        ChannelType channel_type = ChannelType::None;
-
-        // out = (x * alpha - mean) / std
-        static Norm mean_std(const float mean[3], const float std[3], float alpha = 1/255.0f, ChannelType channel_type=ChannelType::None);
-
-        // out = x * alpha + beta
-        static Norm alpha_beta(float alpha, float beta = 0, ChannelType channel_type=ChannelType::None);
-
-        // None
-        static Norm None();
-    };
-
     void resize_bilinear_and_normalize(
 		uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
 		const Norm& norm,
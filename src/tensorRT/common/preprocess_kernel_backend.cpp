@@ -0,0 +1,68 @@
+
+#include "preprocess_kernel.cuh"
+#include "preprocess_kernel_cpu.hpp"
+#include <atomic>
+
+namespace PreprocessKernel{
+
+	const KernelTable& cuda_kernels(){
+		static KernelTable table = [](){
+			KernelTable t;
+			t.resize_bilinear_and_normalize            = CUDAKernel::resize_bilinear_and_normalize;
+			t.warp_affine_bilinear_and_normalize_plane = CUDAKernel::warp_affine_bilinear_and_normalize_plane;
+			t.warp_affine_bilinear_and_normalize_focus = CUDAKernel::warp_affine_bilinear_and_normalize_focus;
+			t.warp_perspective                         = CUDAKernel::warp_perspective;
+			t.norm_feature                             = CUDAKernel::norm_feature;
+			t.convert_nv12_to_bgr_invoke               = CUDAKernel::convert_nv12_to_bgr_invoke;
+			return t;
+		}();
+		return table;
+	}
+
+	static bool has_cuda_device(){
+		static bool has_device = [](){
+			int count = 0;
+			return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+		}();
+		return has_device;
+	}
+
+	static std::atomic<int> g_backend(-1);
+
+	bool has_backend(Backend backend){
+		if(backend == Backend::CUDA) return has_cuda_device();
+		return backend == Backend::CPU;
+	}
+
+	bool set_backend(Backend backend){
+		if(!has_backend(backend)){
+			INFOE("Preprocess backend %s is not available", backend_string(backend));
+			return false;
+		}
+		g_backend = (int)backend;
+		return true;
+	}
+
+	Backend backend(){
+		int value = g_backend;
+		if(value == -1){
+			value = (int)(has_cuda_device() ? Backend::CUDA : Backend::CPU);
+			int expected = -1;
+			g_backend.compare_exchange_strong(expected, value);
+			value = g_backend;
+		}
+		return (Backend)value;
+	}
+
+	const char* backend_string(Backend backend){
+		switch(backend){
+			case Backend::CUDA: return "CUDA";
+			case Backend::CPU:  return "CPU";
+			default: return "Unknow";
+		}
+	}
+
+	const KernelTable& kernels(){
+		return backend() == Backend::CUDA ? cuda_kernels() : cpu_kernels();
+	}
+};
@@ -0,0 +1,742 @@
+
+#include "preprocess_kernel_cpu.hpp"
+#include "thread_pool.hpp"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_KERNEL_HAS_AVX2
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+namespace CPUKernel{
+
+	#define INTER_RESIZE_COEF_BITS 11
+	#define INTER_RESIZE_COEF_SCALE (1 << INTER_RESIZE_COEF_BITS)
+	#define CAST_BITS (INTER_RESIZE_COEF_BITS << 1)
+
+	template<typename _T>
+	static inline _T limit(_T value, _T low, _T high){
+		return value < low ? low : (value > high ? high : value);
+	}
+
+	// 一个轴上的采样位置和定点权重
+	struct AxisCoef{
+		int low, high;
+		int weight_low, weight_high;
+	};
+
+	// 每个输出通道的归一化参数，MeanStd: (x * alpha - mean) / std，AlphaBeta: x * alpha + beta
+	struct ChannelNorm{
+		float alpha, offset, std;
+	};
+
+	static bool cpu_support_avx2(){
+#ifdef CPU_KERNEL_HAS_AVX2
+		static bool support = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		return support;
+#else
+		return false;
+#endif
+	}
+
+	static std::atomic<bool> g_avx2_enabled(true);
+
+	bool avx2_enabled(){
+		return g_avx2_enabled && cpu_support_avx2();
+	}
+
+	void set_avx2_enabled(bool enabled){
+		g_avx2_enabled = enabled;
+	}
+
+	// 较老的GCC的__builtin_cpu_supports不认识f16c，直接读cpuid
+	static bool cpu_support_f16c(){
+#ifdef CPU_KERNEL_HAS_AVX2
+		static bool support = [](){
+			unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+			return __builtin_cpu_supports("avx") && __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C) != 0;
+		}();
+		return support;
+#else
+		return false;
+#endif
+	}
+
+	static bool cpu_support_avx512(){
+#ifdef CPU_KERNEL_HAS_AVX2
+		static bool support = __builtin_cpu_supports("avx512f");
+		return support;
+#else
+		return false;
+#endif
+	}
+
+	static std::atomic<bool> g_f16c_enabled(true);
+	static std::atomic<bool> g_avx512_enabled(true);
+
+	bool f16c_enabled(){
+		return g_f16c_enabled && cpu_support_f16c();
+	}
+
+	void set_f16c_enabled(bool enabled){
+		g_f16c_enabled = enabled;
+	}
+
+	bool avx512_enabled(){
+		return g_avx512_enabled && cpu_support_avx512();
+	}
+
+	void set_avx512_enabled(bool enabled){
+		g_avx512_enabled = enabled;
+	}
+
+	static std::mutex g_pool_lock;
+	static std::shared_ptr<ThreadPool> g_pool;
+	static int g_num_threads = 0;
+
+	void set_num_threads(int num_threads){
+		std::unique_lock<std::mutex> l(g_pool_lock);
+		g_num_threads = num_threads;
+		g_pool.reset();
+	}
+
+	int num_threads(){
+		std::unique_lock<std::mutex> l(g_pool_lock);
+		if(g_num_threads > 0) return g_num_threads;
+		return std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	// 调用者线程也参与计算，所以线程池只需要num_threads - 1个线程
+	static std::shared_ptr<ThreadPool> kernel_pool(){
+		std::unique_lock<std::mutex> l(g_pool_lock);
+		int threads = g_num_threads > 0 ? g_num_threads : std::max(1, (int)std::thread::hardware_concurrency());
+		if(threads <= 1) return nullptr;
+		if(g_pool == nullptr)
+			g_pool = std::make_shared<ThreadPool>(threads - 1);
+		return g_pool;
+	}
+
+	// 把[0, rows)切块并行执行func(row_begin, row_end)，总工作量较小时直接在调用者线程执行
+	template<class Func>
+	static void parallel_rows(int rows, size_t work_per_row, Func func){
+
+		const size_t min_parallel_work = 64 * 1024;
+		auto pool = rows > 1 && rows * work_per_row >= min_parallel_work ? kernel_pool() : nullptr;
+		if(pool == nullptr){
+			func(0, rows);
+			return;
+		}
+
+		int blocks = std::min(rows, (pool->size() + 1) * 4);
+		pool->parallel_for(0, blocks, [&](int block){
+			func((int)((int64_t)rows * block / blocks), (int)((int64_t)rows * (block + 1) / blocks));
+		});
+	}
+
+	void parallel_range(size_t size, size_t bytes_per_item, const std::function<void(size_t, size_t)>& func){
+
+		const size_t min_parallel_bytes = 1024 * 1024;
+		auto pool = size > 1 && size * bytes_per_item >= min_parallel_bytes ? kernel_pool() : nullptr;
+		if(pool == nullptr){
+			func(0, size);
+			return;
+		}
+
+		// 每块不小于min_parallel_bytes / 4，避免块太小时调度开销超过计算
+		size_t max_blocks = std::max<size_t>(1, size * bytes_per_item / (min_parallel_bytes / 4));
+		int blocks = (int)std::min<size_t>(std::min<size_t>(size, max_blocks), (pool->size() + 1) * 4);
+		pool->parallel_for(0, blocks, [&](int block){
+			func(size * block / blocks, size * (block + 1) / blocks);
+		});
+	}
+
+	// 与CUDA kernel相同的采样位置，nvcc会把(dx + 0.5f) * sx - 0.5f合并成fma，这里显式使用fmaf以保持逐位一致
+	static void compute_axis_coefs(int src_size, int dst_size, std::vector<AxisCoef>& coefs){
+
+		float scale = src_size / (float)dst_size;
+		coefs.resize(dst_size);
+		for(int d = 0; d < dst_size; ++d){
+			float s    = fmaf(d + 0.5f, scale, -0.5f);
+			int low    = floorf(s);
+			int high   = limit(low + 1, 0, src_size - 1);
+			low        = limit(low, 0, src_size - 1);
+
+			int weight = rintf((s - low) * INTER_RESIZE_COEF_SCALE);
+			coefs[d].low         = low;
+			coefs[d].high        = high;
+			coefs[d].weight_low  = INTER_RESIZE_COEF_SCALE - weight;
+			coefs[d].weight_high = weight;
+		}
+	}
+
+	// 水平插值一行源图像，同时完成通道交换，按输出通道写成3段planar的定点数据
+	static void horizontal_pass(const uint8_t* src_row, const AxisCoef* xcoefs, int dst_width, const int plane_of_channel[3], int* out){
+
+		int* out0 = out + plane_of_channel[0] * dst_width;
+		int* out1 = out + plane_of_channel[1] * dst_width;
+		int* out2 = out + plane_of_channel[2] * dst_width;
+		for(int dx = 0; dx < dst_width; ++dx){
+			const AxisCoef& xc = xcoefs[dx];
+			const uint8_t* p0  = src_row + xc.low * 3;
+			const uint8_t* p1  = src_row + xc.high * 3;
+			out0[dx] = xc.weight_low * p0[0] + xc.weight_high * p1[0];
+			out1[dx] = xc.weight_low * p0[1] + xc.weight_high * p1[1];
+			out2[dx] = xc.weight_low * p0[2] + xc.weight_high * p1[2];
+		}
+	}
+
+	static inline float normalize(float value, const ChannelNorm& norm, NormType type){
+		if(type == NormType::MeanStd)
+			return fmaf(value, norm.alpha, norm.offset) / norm.std;
+		else if(type == NormType::AlphaBeta)
+			return fmaf(value, norm.alpha, norm.offset);
+		return value;
+	}
+
+	// 垂直插值 + 定点转换 + 归一化，row0/row1为水平插值后的两行
+	static void vertical_pass_scalar(const int* row0, const int* row1, int weight0, int weight1, int n, const ChannelNorm& norm, NormType type, float* dst){
+
+		for(int i = 0; i < n; ++i){
+			int value = (weight0 * row0[i] + weight1 * row1[i] + (1 << (CAST_BITS - 1))) >> CAST_BITS;
+			dst[i] = normalize((float)value, norm, type);
+		}
+	}
+
+#ifdef CPU_KERNEL_HAS_AVX2
+	__attribute__((target("avx2,fma")))
+	static void vertical_pass_avx2(const int* row0, const int* row1, int weight0, int weight1, int n, const ChannelNorm& norm, NormType type, float* dst){
+
+		__m256i w0    = _mm256_set1_epi32(weight0);
+		__m256i w1    = _mm256_set1_epi32(weight1);
+		__m256i round = _mm256_set1_epi32(1 << (CAST_BITS - 1));
+		__m256 alpha  = _mm256_set1_ps(norm.alpha);
+		__m256 offset = _mm256_set1_ps(norm.offset);
+		__m256 std    = _mm256_set1_ps(norm.std);
+
+		int i = 0;
+		for(; i + 8 <= n; i += 8){
+			__m256i a = _mm256_loadu_si256((const __m256i*)(row0 + i));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(row1 + i));
+			__m256i v = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(a, w0), _mm256_mullo_epi32(b, w1)), round);
+			__m256 c  = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, CAST_BITS));
+
+			if(type == NormType::MeanStd)
+				c = _mm256_div_ps(_mm256_fmadd_ps(c, alpha, offset), std);
+			else if(type == NormType::AlphaBeta)
+				c = _mm256_fmadd_ps(c, alpha, offset);
+			_mm256_storeu_ps(dst + i, c);
+		}
+		vertical_pass_scalar(row0 + i, row1 + i, weight0, weight1, n - i, norm, type, dst + i);
+	}
+#endif
+
+	static void vertical_pass(const int* row0, const int* row1, int weight0, int weight1, int n, const ChannelNorm& norm, NormType type, float* dst, bool use_avx2){
+#ifdef CPU_KERNEL_HAS_AVX2
+		if(use_avx2){
+			vertical_pass_avx2(row0, row1, weight0, weight1, n, norm, type, dst);
+			return;
+		}
+#endif
+		vertical_pass_scalar(row0, row1, weight0, weight1, n, norm, type, dst);
+	}
+
+	static void normalize_plane_scalar(const float* src, int n, const ChannelNorm& norm, NormType type, float* dst){
+		for(int i = 0; i < n; ++i)
+			dst[i] = normalize(src[i], norm, type);
+	}
+
+#ifdef CPU_KERNEL_HAS_AVX2
+	__attribute__((target("avx2,fma")))
+	static void normalize_plane_avx2(const float* src, int n, const ChannelNorm& norm, NormType type, float* dst){
+
+		__m256 alpha  = _mm256_set1_ps(norm.alpha);
+		__m256 offset = _mm256_set1_ps(norm.offset);
+		__m256 std    = _mm256_set1_ps(norm.std);
+
+		int i = 0;
+		for(; i + 8 <= n; i += 8){
+			__m256 c = _mm256_loadu_ps(src + i);
+			if(type == NormType::MeanStd)
+				c = _mm256_div_ps(_mm256_fmadd_ps(c, alpha, offset), std);
+			else if(type == NormType::AlphaBeta)
+				c = _mm256_fmadd_ps(c, alpha, offset);
+			_mm256_storeu_ps(dst + i, c);
+		}
+		normalize_plane_scalar(src + i, n - i, norm, type, dst + i);
+	}
+#endif
+
+	static void normalize_plane(const float* src, int n, const ChannelNorm& norm, NormType type, float* dst, bool use_avx2){
+#ifdef CPU_KERNEL_HAS_AVX2
+		if(use_avx2){
+			normalize_plane_avx2(src, n, norm, type, dst);
+			return;
+		}
+#endif
+		normalize_plane_scalar(src, n, norm, type, dst);
+	}
+
+	static void make_channel_norms(const Norm& norm, ChannelNorm channel_norms[3]){
+		for(int c = 0; c < 3; ++c){
+			channel_norms[c].alpha  = norm.alpha;
+			channel_norms[c].offset = norm.type == NormType::MeanStd ? -norm.mean[c] : norm.beta;
+			channel_norms[c].std    = norm.type == NormType::MeanStd ? norm.std[c] : 1.0f;
+		}
+	}
+
+	// 与CUDA kernel相同的浮点双线性采样，越界的邻点取const_value，整体越界时三个通道都为const_value
+	static inline void sample_bilinear(
+		const uint8_t* src, int src_line_size, int src_width, int src_height,
+		float src_x, float src_y, uint8_t const_value_st, float& c0, float& c1, float& c2){
+
+		if(src_x <= -1 || src_x >= src_width || src_y <= -1 || src_y >= src_height){
+			c0 = const_value_st;
+			c1 = const_value_st;
+			c2 = const_value_st;
+			return;
+		}
+
+		int y_low  = floorf(src_y);
+		int x_low  = floorf(src_x);
+		int y_high = y_low + 1;
+		int x_high = x_low + 1;
+
+		uint8_t const_value[] = {const_value_st, const_value_st, const_value_st};
+		float ly    = src_y - y_low;
+		float lx    = src_x - x_low;
+		float hy    = 1 - ly;
+		float hx    = 1 - lx;
+		float w1    = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+		const uint8_t* v1 = const_value;
+		const uint8_t* v2 = const_value;
+		const uint8_t* v3 = const_value;
+		const uint8_t* v4 = const_value;
+		if(y_low >= 0){
+			if (x_low >= 0)
+				v1 = src + (size_t)y_low * src_line_size + x_low * 3;
+
+			if (x_high < src_width)
+				v2 = src + (size_t)y_low * src_line_size + x_high * 3;
+		}
+
+		if(y_high < src_height){
+			if (x_low >= 0)
+				v3 = src + (size_t)y_high * src_line_size + x_low * 3;
+
+			if (x_high < src_width)
+				v4 = src + (size_t)y_high * src_line_size + x_high * 3;
+		}
+
+		c0 = floorf(w1 * v1[0] + w2 * v2[0] + w3 * v3[0] + w4 * v4[0] + 0.5f);
+		c1 = floorf(w1 * v1[1] + w2 * v2[1] + w3 * v3[1] + w4 * v4[1] + 0.5f);
+		c2 = floorf(w1 * v1[2] + w2 * v2[2] + w3 * v3[2] + w4 * v4[2] + 0.5f);
+	}
+
+	/* warp类kernel的公共实现：map(dx, dy, src_x, src_y)给出输出像素在原图上的位置
+	   每行先采样到3个planar的行缓存（已做通道交换），再整行做SIMD归一化，最后由store写到输出
+	*/
+	template<class MapFunc, class StoreFunc>
+	static void warp_and_normalize(
+		const uint8_t* src, int src_line_size, int src_width, int src_height, int dst_width, int dst_height,
+		uint8_t const_value, const Norm& norm, MapFunc map, StoreFunc store){
+
+		ChannelNorm channel_norms[3];
+		make_channel_norms(norm, channel_norms);
+		bool invert   = norm.channel_type == ChannelType::Invert;
+		bool use_avx2 = avx2_enabled();
+
+		parallel_rows(dst_height, (size_t)dst_width * 3, [&](int dy_begin, int dy_end){
+			std::vector<float> sampled(dst_width * 3);
+			std::vector<float> normalized(dst_width * 3);
+			float* planes[] = {sampled.data(), sampled.data() + dst_width, sampled.data() + dst_width * 2};
+			if(invert) std::swap(planes[0], planes[2]);
+
+			for(int dy = dy_begin; dy < dy_end; ++dy){
+				for(int dx = 0; dx < dst_width; ++dx){
+					float src_x, src_y;
+					map(dx, dy, src_x, src_y);
+					sample_bilinear(src, src_line_size, src_width, src_height, src_x, src_y, const_value, planes[0][dx], planes[1][dx], planes[2][dx]);
+				}
+
+				for(int p = 0; p < 3; ++p)
+					normalize_plane(sampled.data() + p * dst_width, dst_width, channel_norms[p], norm.type, normalized.data() + p * dst_width, use_avx2);
+				store(dy, normalized.data());
+			}
+		});
+	}
+
+	void warp_affine_bilinear_and_normalize_plane(
+		uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+		float* matrix_2_3, uint8_t const_value, const Norm& norm,
+		cudaStream_t stream) {
+
+		float m_x1 = matrix_2_3[0];
+		float m_y1 = matrix_2_3[1];
+		float m_z1 = matrix_2_3[2];
+		float m_x2 = matrix_2_3[3];
+		float m_y2 = matrix_2_3[4];
+		float m_z2 = matrix_2_3[5];
+		size_t area = (size_t)dst_width * dst_height;
+
+		warp_and_normalize(src, src_line_size, src_width, src_height, dst_width, dst_height, const_value, norm,
+			[&](int dx, int dy, float& src_x, float& src_y){
+				src_x = m_x1 * dx + m_y1 * dy + m_z1;
+				src_y = m_x2 * dx + m_y2 * dy + m_z2;
+			},
+			[&](int dy, const float* row){
+				for(int p = 0; p < 3; ++p)
+					memcpy(dst + p * area + (size_t)dy * dst_width, row + p * dst_width, dst_width * sizeof(float));
+			}
+		);
+	}
+
+	void warp_affine_bilinear_and_normalize_focus(
+		uint8_t* src, int src_line_size, int src_width, int src_height,
+		float* dst  , int dst_width, int dst_height,
+		float* matrix_1_3, uint8_t const_value, const Norm& norm,
+		cudaStream_t stream){
+
+		float m_k  = matrix_1_3[0];
+		float m_b0 = matrix_1_3[1];
+		float m_b1 = matrix_1_3[2];
+		int after_focus_width  = dst_width / 2;
+		int after_focus_height = dst_height / 2;
+
+		warp_and_normalize(src, src_line_size, src_width, src_height, dst_width, dst_height, const_value, norm,
+			[&](int dx, int dy, float& src_x, float& src_y){
+				src_x = m_k * dx + m_b0;
+				src_y = m_k * dy + m_b1;
+			},
+			[&](int dy, const float* row){
+				// x[..., ::2, ::2], x[..., 1::2, ::2], x[..., ::2, 1::2], x[..., 1::2, 1::2]
+				int fdy = dy / 2;
+				if(fdy >= after_focus_height) return;
+
+				for(int dx = 0; dx < after_focus_width * 2; ++dx){
+					int fdx = dx / 2;
+					int fc  = ((dx % 2) << 1) | (dy % 2);
+					for(int p = 0; p < 3; ++p)
+						dst[((size_t)(fc * 3 + p) * after_focus_height + fdy) * after_focus_width + fdx] = row[p * dst_width + dx];
+				}
+			}
+		);
+	}
+
+	void warp_perspective(
+		uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+		float* matrix_3_3, uint8_t const_value, const Norm& norm, cudaStream_t stream
+	){
+		float m_x1 = matrix_3_3[0];
+		float m_y1 = matrix_3_3[1];
+		float m_z1 = matrix_3_3[2];
+		float m_x2 = matrix_3_3[3];
+		float m_y2 = matrix_3_3[4];
+		float m_z2 = matrix_3_3[5];
+		float m_x3 = matrix_3_3[6];
+		float m_y3 = matrix_3_3[7];
+		float m_z3 = matrix_3_3[8];
+		size_t area = (size_t)dst_width * dst_height;
+
+		warp_and_normalize(src, src_line_size, src_width, src_height, dst_width, dst_height, const_value, norm,
+			[&](int dx, int dy, float& src_x, float& src_y){
+				src_x = (m_x1 * dx + m_y1 * dy + m_z1) / (m_x3 * dx + m_y3 * dy + m_z3);
+				src_y = (m_x2 * dx + m_y2 * dy + m_z2) / (m_x3 * dx + m_y3 * dy + m_z3);
+			},
+			[&](int dy, const float* row){
+				for(int p = 0; p < 3; ++p)
+					memcpy(dst + p * area + (size_t)dy * dst_width, row + p * dst_width, dst_width * sizeof(float));
+			}
+		);
+	}
+
+	static float sum_square_scalar(const float* x, int n){
+		float sum = 0;
+		for(int i = 0; i < n; ++i)
+			sum += x[i] * x[i];
+		return sum;
+	}
+
+#ifdef CPU_KERNEL_HAS_AVX2
+	__attribute__((target("avx2,fma")))
+	static float sum_square_avx2(const float* x, int n){
+
+		__m256 acc = _mm256_setzero_ps();
+		int i = 0;
+		for(; i + 8 <= n; i += 8){
+			__m256 v = _mm256_loadu_ps(x + i);
+			acc = _mm256_fmadd_ps(v, v, acc);
+		}
+
+		float lanes[8];
+		_mm256_storeu_ps(lanes, acc);
+		float sum = 0;
+		for(int k = 0; k < 8; ++k) sum += lanes[k];
+		return sum + sum_square_scalar(x + i, n - i);
+	}
+#endif
+
+	static float sum_square(const float* x, int n, bool use_avx2){
+#ifdef CPU_KERNEL_HAS_AVX2
+		if(use_avx2)
+			return sum_square_avx2(x, n);
+#endif
+		return sum_square_scalar(x, n);
+	}
+
+	void norm_feature(
+		float* feature_array, int num_feature, int feature_length,
+		cudaStream_t stream
+	){
+		bool use_avx2 = avx2_enabled();
+		parallel_rows(num_feature, feature_length, [&](int begin, int end){
+			for(int i = begin; i < end; ++i){
+				float* feature = feature_array + (size_t)i * feature_length;
+				float l2_norm = sqrtf(sum_square(feature, feature_length, use_avx2));
+				for(int k = 0; k < feature_length; ++k)
+					feature[k] = feature[k] / l2_norm;
+			}
+		});
+	}
+
+	static inline uint8_t cast(float value){
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	void convert_nv12_to_bgr_invoke(
+		const uint8_t* y, const uint8_t* uv, int width, int height, int linesize, uint8_t* dst, cudaStream_t stream){
+
+		parallel_rows(height, (size_t)width * 3, [&](int oy_begin, int oy_end){
+			for(int oy = oy_begin; oy < oy_end; ++oy){
+				const uint8_t* yrow  = y + (size_t)oy * linesize;
+				const uint8_t* uvrow = uv + (size_t)(oy >> 1) * linesize;
+				uint8_t* dst_bgr     = dst + (size_t)oy * width * 3;
+				for(int ox = 0; ox < width; ++ox){
+					float yvalue = 1.164f * (yrow[ox] - 16.0f);
+					float u = uvrow[(ox & 0xFFFFFFFE) + 0] - 128.0f;
+					float v = uvrow[(ox & 0xFFFFFFFE) + 1] - 128.0f;
+					dst_bgr[ox * 3 + 0] = cast(yvalue + 2.018f * u);
+					dst_bgr[ox * 3 + 1] = cast(yvalue - 0.813f * v - 0.391f * u);
+					dst_bgr[ox * 3 + 2] = cast(yvalue + 1.596f * v);
+				}
+			}
+		});
+	}
+
+	uint16_t float_to_half(float value){
+
+		uint32_t x;
+		memcpy(&x, &value, sizeof(x));
+		uint32_t sign = (x >> 16) & 0x8000;
+		uint32_t abs  = x & 0x7FFFFFFF;
+
+		// inf/NaN，NaN置quiet位并保留尾数的高10位
+		if(abs >= 0x7F800000)
+			return sign | 0x7C00 | (abs > 0x7F800000 ? 0x0200 | ((abs >> 13) & 0x03FF) : 0);
+
+		// >= 65520时舍入为inf
+		if(abs >= 0x477FF000)
+			return sign | 0x7C00;
+
+		// < 2^-14，结果是非规格化数或0：h = mantissa * 2^(exponent - 126)
+		if(abs < 0x38800000){
+			int shift = 126 - (int)(abs >> 23);
+			if(shift > 24)
+				return sign;
+
+			uint32_t mantissa  = (abs & 0x007FFFFF) | 0x00800000;
+			uint32_t half      = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t midpoint  = 1u << (shift - 1);
+			if(remainder > midpoint || (remainder == midpoint && (half & 1)))
+				half++;
+			return sign | half;
+		}
+
+		// 规格化数：指数偏置从127换成15，尾数舍掉低13位，进位可以自然地进到指数
+		uint32_t half      = (abs - 0x38000000) >> 13;
+		uint32_t remainder = abs & 0x1FFF;
+		if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	float half_to_float(uint16_t value){
+
+		uint32_t sign     = (uint32_t)(value & 0x8000) << 16;
+		uint32_t exponent = (value >> 10) & 0x1F;
+		uint32_t mantissa = value & 0x03FF;
+		uint32_t x;
+		if(exponent == 0x1F){
+			x = sign | 0x7F800000 | (mantissa ? 0x00400000 | (mantissa << 13) : 0);
+		}else if(exponent == 0){
+			// 非规格化数 mantissa * 2^-24，在float中是精确的
+			float output = mantissa * (1.0f / 16777216.0f);
+			memcpy(&x, &output, sizeof(x));
+			x |= sign;
+		}else{
+			x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+
+		float output;
+		memcpy(&output, &x, sizeof(output));
+		return output;
+	}
+
+	static void float_to_half_scalar(const float* src, uint16_t* dst, size_t count){
+		for(size_t i = 0; i < count; ++i)
+			dst[i] = float_to_half(src[i]);
+	}
+
+	static void half_to_float_scalar(const uint16_t* src, float* dst, size_t count){
+		for(size_t i = 0; i < count; ++i)
+			dst[i] = half_to_float(src[i]);
+	}
+
+#ifdef CPU_KERNEL_HAS_AVX2
+	__attribute__((target("avx,f16c")))
+	static void float_to_half_f16c(const float* src, uint16_t* dst, size_t count){
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8){
+			__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128((__m128i*)(dst + i), h);
+		}
+		float_to_half_scalar(src + i, dst + i, count - i);
+	}
+
+	__attribute__((target("avx,f16c")))
+	static void half_to_float_f16c(const uint16_t* src, float* dst, size_t count){
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+		half_to_float_scalar(src + i, dst + i, count - i);
+	}
+
+	__attribute__((target("avx512f")))
+	static void float_to_half_avx512(const float* src, uint16_t* dst, size_t count){
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16){
+			__m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			_mm256_storeu_si256((__m256i*)(dst + i), h);
+		}
+		float_to_half_scalar(src + i, dst + i, count - i);
+	}
+
+	__attribute__((target("avx512f")))
+	static void half_to_float_avx512(const uint16_t* src, float* dst, size_t count){
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16)
+			_mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(src + i))));
+		half_to_float_scalar(src + i, dst + i, count - i);
+	}
+#endif
+
+	void convert_float_to_half(const float* src, uint16_t* dst, size_t count){
+
+		auto kernel = float_to_half_scalar;
+#ifdef CPU_KERNEL_HAS_AVX2
+		if(avx512_enabled() && f16c_enabled())
+			kernel = float_to_half_avx512;
+		else if(f16c_enabled())
+			kernel = float_to_half_f16c;
+#endif
+		parallel_range(count, sizeof(float) + sizeof(uint16_t), [&](size_t begin, size_t end){
+			kernel(src + begin, dst + begin, end - begin);
+		});
+	}
+
+	void convert_half_to_float(const uint16_t* src, float* dst, size_t count){
+
+		auto kernel = half_to_float_scalar;
+#ifdef CPU_KERNEL_HAS_AVX2
+		if(avx512_enabled() && f16c_enabled())
+			kernel = half_to_float_avx512;
+		else if(f16c_enabled())
+			kernel = half_to_float_f16c;
+#endif
+		parallel_range(count, sizeof(float) + sizeof(uint16_t), [&](size_t begin, size_t end){
+			kernel(src + begin, dst + begin, end - begin);
+		});
+	}
+
+	void resize_bilinear_and_normalize(
+		uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+		const Norm& norm,
+		cudaStream_t stream){
+
+		if(dst_width <= 0 || dst_height <= 0 || src_width <= 0 || src_height <= 0) return;
+
+		std::vector<AxisCoef> xcoefs, ycoefs;
+		compute_axis_coefs(src_width,  dst_width,  xcoefs);
+		compute_axis_coefs(src_height, dst_height, ycoefs);
+
+		int plane_of_channel[] = {0, 1, 2};
+		if(norm.channel_type == ChannelType::Invert){
+			plane_of_channel[0] = 2;
+			plane_of_channel[2] = 0;
+		}
+
+		ChannelNorm channel_norms[3];
+		make_channel_norms(norm, channel_norms);
+
+		bool use_avx2 = avx2_enabled();
+		size_t area   = (size_t)dst_width * dst_height;
+		parallel_rows(dst_height, (size_t)dst_width * 3, [&](int dy_begin, int dy_end){
+
+			// 相邻的输出行大多共用源图像行，缓存最近两行的水平插值结果
+			int row_size = dst_width * 3;
+			std::vector<int> cache(row_size * 2);
+			int cached_y[] = {-1, -1};
+			auto fetch_row = [&](int y, int slot){
+				horizontal_pass(src + (size_t)y * src_line_size, xcoefs.data(), dst_width, plane_of_channel, cache.data() + slot * row_size);
+				cached_y[slot] = y;
+			};
+
+			for(int dy = dy_begin; dy < dy_end; ++dy){
+				const AxisCoef& yc = ycoefs[dy];
+
+				int slot_low = cached_y[0] == yc.low ? 0 : (cached_y[1] == yc.low ? 1 : -1);
+				if(slot_low == -1){
+					slot_low = cached_y[0] == yc.high ? 1 : 0;
+					fetch_row(yc.low, slot_low);
+				}
+
+				int slot_high = cached_y[slot_low] == yc.high ? slot_low : 1 - slot_low;
+				if(cached_y[slot_high] != yc.high)
+					fetch_row(yc.high, slot_high);
+
+				const int* row_low  = cache.data() + slot_low * row_size;
+				const int* row_high = cache.data() + slot_high * row_size;
+				for(int p = 0; p < 3; ++p){
+					vertical_pass(
+						row_low + p * dst_width, row_high + p * dst_width, yc.weight_low, yc.weight_high, dst_width,
+						channel_norms[p], norm.type, dst + p * area + (size_t)dy * dst_width, use_avx2
+					);
+				}
+			}
+		});
+	}
+};
+
+namespace PreprocessKernel{
+
+	const KernelTable& cpu_kernels(){
+		static KernelTable table = [](){
+			KernelTable t;
+			t.resize_bilinear_and_normalize            = CPUKernel::resize_bilinear_and_normalize;
+			t.warp_affine_bilinear_and_normalize_plane = CPUKernel::warp_affine_bilinear_and_normalize_plane;
+			t.warp_affine_bilinear_and_normalize_focus = CPUKernel::warp_affine_bilinear_and_normalize_focus;
+			t.warp_perspective                         = CPUKernel::warp_perspective;
+			t.norm_feature                             = CPUKernel::norm_feature;
+			t.convert_nv12_to_bgr_invoke               = CPUKernel::convert_nv12_to_bgr_invoke;
+			return t;
+		}();
+		return table;
+	}
+};
@@ -0,0 +1,140 @@
+#ifndef PREPROCESS_KERNEL_CPU_HPP
+#define PREPROCESS_KERNEL_CPU_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "preprocess_norm.hpp"
+
+struct CUstream_st;
+typedef CUstream_st* cudaStream_t;
+
+/* CUDAKernel的CPU实现，函数签名、Norm/ChannelType的语义与CUDAKernel一致，stream参数被忽略
+   输入输出都是host内存；按输出行切块，在内部线程池上并行
+   x86上运行时检测AVX2/FMA，不支持时退回标量实现；除norm_feature的求和顺序外，两者结果逐位一致
+*/
+namespace CPUKernel{
+
+    using CUDAKernel::Norm;
+    using CUDAKernel::NormType;
+    using CUDAKernel::ChannelType;
+
+    // 单遍完成 resize(bilinear) + 通道交换 + 归一化 + HWC->CHW，插值与CUDAKernel::resize_bilinear_and_normalize相同（11位定点），结果逐位一致
+    void resize_bilinear_and_normalize(
+        uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+        const Norm& norm,
+        cudaStream_t stream = nullptr);
+
+    void warp_affine_bilinear_and_normalize_plane(
+        uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst  , int dst_width, int dst_height,
+        float* matrix_2_3, uint8_t const_value, const Norm& norm,
+        cudaStream_t stream = nullptr);
+
+    // matrix_1_3: [k, b0, b1]，src_x = k * dx + b0, src_y = k * dy + b1，输出为yolov5 focus的排列
+    void warp_affine_bilinear_and_normalize_focus(
+        uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst  , int dst_width, int dst_height,
+        float* matrix_1_3, uint8_t const_value, const Norm& norm,
+        cudaStream_t stream = nullptr);
+
+    void warp_perspective(
+        uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+        float* matrix_3_3, uint8_t const_value, const Norm& norm, cudaStream_t stream = nullptr
+    );
+
+    // 每个feature做L2归一化
+    void norm_feature(
+        float* feature_array, int num_feature, int feature_length,
+        cudaStream_t stream = nullptr
+    );
+
+    void convert_nv12_to_bgr_invoke(
+        const uint8_t* y, const uint8_t* uv, int width, int height,
+        int linesize, uint8_t* dst,
+        cudaStream_t stream = nullptr);
+
+    /* float32 <-> float16（IEEE binary16，按位存放在uint16_t中）
+       float->half为round-to-nearest-even，溢出为inf，NaN转为quiet NaN并保留高位payload，与F16C的vcvtps2ph、CUDA的__float2half_rn一致
+       half->float是精确的
+    */
+    uint16_t float_to_half(float value);
+    float half_to_float(uint16_t value);
+
+    /* 批量转换count个元素，src和dst不能重叠；大数组切块在内部线程池上并行
+       x86上运行时检测AVX-512F/F16C，不支持时退回标量实现，各路径结果逐位一致
+    */
+    void convert_float_to_half(const float* src, uint16_t* dst, size_t count);
+    void convert_half_to_float(const uint16_t* src, float* dst, size_t count);
+
+    // 把[0, size)切块在内部线程池上并行执行func(begin, end)，bytes_per_item为每项处理的字节数，总量较小时直接在调用者线程执行
+    void parallel_range(size_t size, size_t bytes_per_item, const std::function<void(size_t, size_t)>& func);
+
+    // 当前CPU是否走AVX2路径
+    bool avx2_enabled();
+
+    // 强制关闭/恢复AVX2路径，用于测试和对比评测；CPU不支持时设置为true无效
+    void set_avx2_enabled(bool enabled);
+
+    // 半精度转换是否走F16C/AVX-512路径，设置为false时退回标量实现，用于测试和对比评测；CPU不支持时设置为true无效
+    bool f16c_enabled();
+    void set_f16c_enabled(bool enabled);
+    bool avx512_enabled();
+    void set_avx512_enabled(bool enabled);
+
+    // 设置并行的线程数，0表示使用CPU核数，1表示在调用者线程上串行执行
+    void set_num_threads(int num_threads);
+    int  num_threads();
+};
+
+/* 运行时选择预处理的后端，kernels()返回的函数表与CUDAKernel的签名一致
+   CUDA后端的输入输出是device内存，CPU后端是host内存，由调用者保证
+   默认：有可用的GPU时为CUDA，否则为CPU
+*/
+namespace PreprocessKernel{
+
+    enum class Backend : int{
+        CUDA = 0,
+        CPU  = 1
+    };
+
+    struct KernelTable{
+        void (*resize_bilinear_and_normalize)(
+            uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+            const CUDAKernel::Norm& norm, cudaStream_t stream) = nullptr;
+
+        void (*warp_affine_bilinear_and_normalize_plane)(
+            uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+            float* matrix_2_3, uint8_t const_value, const CUDAKernel::Norm& norm, cudaStream_t stream) = nullptr;
+
+        void (*warp_affine_bilinear_and_normalize_focus)(
+            uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+            float* matrix_1_3, uint8_t const_value, const CUDAKernel::Norm& norm, cudaStream_t stream) = nullptr;
+
+        void (*warp_perspective)(
+            uint8_t* src, int src_line_size, int src_width, int src_height, float* dst, int dst_width, int dst_height,
+            float* matrix_3_3, uint8_t const_value, const CUDAKernel::Norm& norm, cudaStream_t stream) = nullptr;
+
+        void (*norm_feature)(float* feature_array, int num_feature, int feature_length, cudaStream_t stream) = nullptr;
+
+        void (*convert_nv12_to_bgr_invoke)(
+            const uint8_t* y, const uint8_t* uv, int width, int height, int linesize, uint8_t* dst, cudaStream_t stream) = nullptr;
+    };
+
+    // 固定后端的函数表，cuda_kernels定义在preprocess_kernel_backend.cpp中
+    const KernelTable& cpu_kernels();
+    const KernelTable& cuda_kernels();
+
+    // 当前编译/运行环境是否提供该后端
+    bool has_backend(Backend backend);
+
+    // 后端不可用时返回false，当前后端不变
+    bool set_backend(Backend backend);
+    Backend backend();
+    const char* backend_string(Backend backend);
+
+    // 当前后端的函数表
+    const KernelTable& kernels();
+};
+
+#endif // PREPROCESS_KERNEL_CPU_HPP
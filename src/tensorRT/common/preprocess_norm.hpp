@@ -0,0 +1,57 @@
+#ifndef PREPROCESS_NORM_HPP
+#define PREPROCESS_NORM_HPP
+
+#include <string.h>
+
+// 预处理的归一化参数，不依赖CUDA，CUDAKernel和CPUKernel共用
+namespace CUDAKernel{
+
+    enum class NormType : int{
+        None      = 0,
+        MeanStd   = 1,
+        AlphaBeta = 2
+    };
+
+    enum class ChannelType : int{
+        None          = 0,
+        Invert        = 1
+    };
+
+    struct Norm{
+        float mean[3];
+        float std[3];
+        float alpha, beta;
+        NormType type = NormType::None;
+        ChannelType channel_type = ChannelType::None;
+
+        // out = (x * alpha - mean) / std
+        static Norm mean_std(const float mean[3], const float std[3], float alpha = 1/255.0f, ChannelType channel_type=ChannelType::None){
+
+            Norm out;
+            out.type  = NormType::MeanStd;
+            out.alpha = alpha;
+            out.channel_type = channel_type;
+            memcpy(out.mean, mean, sizeof(out.mean));
+            memcpy(out.std,  std,  sizeof(out.std));
+            return out;
+        }
+
+        // out = x * alpha + beta
+        static Norm alpha_beta(float alpha, float beta = 0, ChannelType channel_type=ChannelType::None){
+
+            Norm out;
+            out.type = NormType::AlphaBeta;
+            out.alpha = alpha;
+            out.beta = beta;
+            out.channel_type = channel_type;
+            return out;
+        }
+
+        // None
+        static Norm None(){
+            return Norm();
+        }
+    };
+};
+
+#endif // PREPROCESS_NORM_HPP
@@ -0,0 +1,467 @@
+
+#include "tensor_archive.hpp"
+#include "ilogger.hpp"
+#include <unordered_map>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace TRT{
+
+	static const uint32_t kFileMagic   = TensorArchive::kMagic;	// "TRTA"
+	static const uint32_t kRecordMagic = 0x43455254;	// "TREC"
+	static const uint32_t kFooterMagic = 0x58444954;	// "TIDX"
+	static const uint32_t kMaxNameLength = 4096;
+	static const uint32_t kMaxDims = 32;
+
+	const uint32_t TensorArchive::kMagic;
+	const uint32_t TensorArchiveWriter::kVersion;
+	const uint32_t TensorArchiveWriter::kDefaultAlignment;
+
+	struct FileHeader{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t alignment;
+		uint32_t reserved;
+	};
+
+	struct RecordHeader{
+		uint32_t magic;
+		uint32_t name_length;
+		int32_t  dtype;
+		uint32_t ndims;
+		uint64_t payload_offset;
+		uint64_t payload_bytes;
+		uint32_t crc32;
+		uint32_t reserved;
+	};
+
+	struct Footer{
+		uint32_t magic;
+		uint32_t count;
+		uint64_t index_offset;
+	};
+
+	static_assert(sizeof(FileHeader) == 16 && sizeof(RecordHeader) == 40 && sizeof(Footer) == 16, "Unexpected archive header layout");
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// CRC32(IEEE 802.3，多项式0xEDB88320)，slicing-by-8，每次处理8个字节
+	static const uint32_t* crc32_tables(){
+		static uint32_t tables[8][256];
+		static bool initialized = [](){
+			for(uint32_t i = 0; i < 256; ++i){
+				uint32_t c = i;
+				for(int k = 0; k < 8; ++k)
+					c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+				tables[0][i] = c;
+			}
+			for(uint32_t i = 0; i < 256; ++i){
+				for(int t = 1; t < 8; ++t)
+					tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+			}
+			return true;
+		}();
+		(void)initialized;
+		return &tables[0][0];
+	}
+
+	uint32_t crc32(const void* data, size_t size, uint32_t crc){
+
+		const uint32_t* t = crc32_tables();
+		const uint8_t* p  = (const uint8_t*)data;
+		crc = ~crc;
+
+		while(size >= 8){
+			uint32_t lo, hi;
+			memcpy(&lo, p, 4);
+			memcpy(&hi, p + 4, 4);
+			lo ^= crc;
+			crc = t[7 * 256 + (lo & 0xFF)] ^ t[6 * 256 + ((lo >> 8) & 0xFF)] ^ t[5 * 256 + ((lo >> 16) & 0xFF)] ^ t[4 * 256 + (lo >> 24)] ^
+			      t[3 * 256 + (hi & 0xFF)] ^ t[2 * 256 + ((hi >> 8) & 0xFF)] ^ t[1 * 256 + ((hi >> 16) & 0xFF)] ^ t[0 * 256 + (hi >> 24)];
+			p    += 8;
+			size -= 8;
+		}
+
+		while(size--)
+			crc = t[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static bool valid_dtype(int32_t dtype){
+		return dtype >= (int)DataType::Float && dtype <= (int)DataType::UInt8;
+	}
+
+	static uint64_t align_up(uint64_t value, uint32_t alignment){
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	TensorArchiveWriter::~TensorArchiveWriter(){
+		close();
+	}
+
+	bool TensorArchiveWriter::fail(const char* message){
+		INFOE("Tensor archive %s: %s", path_.c_str(), message);
+		return false;
+	}
+
+	bool TensorArchiveWriter::open(const string& file, bool append, uint32_t alignment){
+
+		close();
+		path_ = file;
+		record_offsets_.clear();
+
+		if(alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > 4096)
+			return fail("alignment must be a power of 2 and <= 4096");
+
+		uint64_t end_offset = sizeof(FileHeader);
+		if(append && iLogger::exists(file)){
+			auto archive = TensorArchive::open(file);
+			if(archive == nullptr)
+				return fail("can not append to an invalid archive");
+
+			// 新的record接在最后一个有效的record之后，原来的Index和Footer会被覆盖
+			alignment_ = archive->alignment();
+			for(int i = 0; i < archive->size(); ++i){
+				auto& entry = archive->entry(i);
+				record_offsets_.push_back(entry.record_offset);
+				end_offset = std::max(end_offset, entry.offset + entry.bytes);
+			}
+			archive.reset();
+
+			file_ = fopen(file.c_str(), "r+b");
+			if(file_ == nullptr || fseeko(file_, end_offset, SEEK_SET) != 0){
+				close();
+				return fail("open for append failed");
+			}
+			return true;
+		}
+
+		file_ = fopen(file.c_str(), "wb");
+		if(file_ == nullptr)
+			return fail("open for write failed");
+
+		alignment_ = alignment;
+		FileHeader header{kFileMagic, kVersion, alignment_, 0};
+		if(fwrite(&header, 1, sizeof(header), file_) != sizeof(header)){
+			close();
+			return fail("write file header failed");
+		}
+		return true;
+	}
+
+	bool TensorArchiveWriter::write(const string& name, Tensor& tensor){
+		const void* data = tensor.bytes() > 0 ? tensor.cpu() : nullptr;
+		return write(name, tensor.type(), tensor.dims(), data);
+	}
+
+	bool TensorArchiveWriter::write(const string& name, DataType dtype, const vector<int>& dims, const void* data){
+		if(!begin(name, dtype, dims))
+			return false;
+
+		if(payload_expected_ > 0 && !append(data, payload_expected_))
+			return false;
+		return end();
+	}
+
+	bool TensorArchiveWriter::begin(const string& name, DataType dtype, const vector<int>& dims){
+
+		if(file_ == nullptr)   return fail("not opened");
+		if(in_record_)         return fail("begin called twice without end");
+		if(!valid_dtype((int)dtype)) return fail("unsupported dtype");
+		if(name.size() > kMaxNameLength || dims.size() > kMaxDims)
+			return fail("name or dims too long");
+
+		uint64_t numel = 1;
+		for(int d : dims){
+			if(d < 0) return fail("negative dimension");
+			numel *= d;
+		}
+
+		record_offset_    = ftello(file_);
+		payload_expected_ = numel * data_type_size(dtype);
+		payload_written_  = 0;
+		payload_crc_      = 0;
+
+		uint64_t meta_end = record_offset_ + sizeof(RecordHeader) + name.size() + dims.size() * sizeof(int32_t);
+		RecordHeader header{kRecordMagic, (uint32_t)name.size(), (int32_t)dtype, (uint32_t)dims.size(), align_up(meta_end, alignment_), payload_expected_, 0, 0};
+		vector<char> padding(header.payload_offset - meta_end, 0);
+
+		bool ok = fwrite(&header, 1, sizeof(header), file_) == sizeof(header) &&
+		          fwrite(name.data(), 1, name.size(), file_) == name.size() &&
+		          fwrite(dims.data(), sizeof(int32_t), dims.size(), file_) == dims.size() &&
+		          fwrite(padding.data(), 1, padding.size(), file_) == padding.size();
+		if(!ok)
+			return fail("write record header failed");
+
+		in_record_ = true;
+		return true;
+	}
+
+	bool TensorArchiveWriter::append(const void* data, size_t size){
+
+		if(!in_record_) return fail("append called without begin");
+		if(payload_written_ + size > payload_expected_)
+			return fail("payload larger than the declared shape");
+
+		if(size > 0 && fwrite(data, 1, size, file_) != size)
+			return fail("write payload failed");
+
+		payload_crc_ = crc32(data, size, payload_crc_);
+		payload_written_ += size;
+		return true;
+	}
+
+	bool TensorArchiveWriter::end(){
+
+		if(!in_record_) return fail("end called without begin");
+
+		if(payload_written_ != payload_expected_){
+			discard_record();
+			return fail("payload smaller than the declared shape, record discarded");
+		}
+		in_record_ = false;
+
+		// 回填crc32
+		uint64_t end_offset = ftello(file_);
+		bool ok = fseeko(file_, record_offset_ + offsetof(RecordHeader, crc32), SEEK_SET) == 0 &&
+		          fwrite(&payload_crc_, 1, sizeof(payload_crc_), file_) == sizeof(payload_crc_) &&
+		          fseeko(file_, end_offset, SEEK_SET) == 0;
+		if(!ok)
+			return fail("write crc32 failed");
+
+		record_offsets_.push_back(record_offset_);
+		return true;
+	}
+
+	void TensorArchiveWriter::discard_record(){
+
+		// 不完整的record从文件中截掉
+		in_record_ = false;
+		fflush(file_);
+		if(ftruncate(fileno(file_), record_offset_) != 0 || fseeko(file_, record_offset_, SEEK_SET) != 0)
+			INFOE("Truncate incomplete record of %s failed", path_.c_str());
+	}
+
+	bool TensorArchiveWriter::close(){
+
+		if(file_ == nullptr)
+			return false;
+
+		if(in_record_){
+			INFOW("Tensor archive %s closed while writing a record, the record is discarded", path_.c_str());
+			discard_record();
+		}
+
+		Footer footer{kFooterMagic, (uint32_t)record_offsets_.size(), (uint64_t)ftello(file_)};
+		bool ok = fwrite(record_offsets_.data(), sizeof(uint64_t), record_offsets_.size(), file_) == record_offsets_.size() &&
+		          fwrite(&footer, 1, sizeof(footer), file_) == sizeof(footer) &&
+		          fflush(file_) == 0;
+
+		// append模式下原来的文件可能更长
+		if(ok) ok = ftruncate(fileno(file_), ftello(file_)) == 0;
+		ok = fclose(file_) == 0 && ok;
+		file_ = nullptr;
+
+		if(!ok)
+			return fail("write index failed");
+		return true;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	// 引用映射内存的MixMemory，持有映射直到最后一个tensor释放
+	class MappedMemory : public MixMemory{
+	public:
+		MappedMemory(shared_ptr<void> mapping, void* cpu, size_t cpu_size)
+			:MixMemory(cpu, cpu_size, nullptr, 0), mapping_(mapping){}
+
+	private:
+		shared_ptr<void> mapping_;
+	};
+
+	TensorArchive::~TensorArchive(){
+	}
+
+	shared_ptr<TensorArchive> TensorArchive::open(const string& file, bool verify_crc){
+
+		int fd = ::open(file.c_str(), O_RDONLY);
+		if(fd == -1){
+			INFOE("Open %s failed.", file.c_str());
+			return nullptr;
+		}
+
+		struct stat file_stat;
+		if(fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(FileHeader)){
+			::close(fd);
+			INFOE("Invalid tensor archive %s, file too small", file.c_str());
+			return nullptr;
+		}
+
+		size_t size = file_stat.st_size;
+		void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if(ptr == MAP_FAILED){
+			INFOE("Mmap %s failed.", file.c_str());
+			return nullptr;
+		}
+
+		shared_ptr<TensorArchive> archive(new TensorArchive());
+		archive->path_    = file;
+		archive->mapping_ = shared_ptr<void>(ptr, [size](void* p){munmap(p, size);});
+		archive->base_    = (const uint8_t*)ptr;
+		archive->size_    = size;
+		if(!archive->parse())
+			return nullptr;
+
+		if(verify_crc){
+			for(int i = 0; i < archive->size(); ++i){
+				if(!archive->verify(i))
+					return nullptr;
+			}
+		}
+		return archive;
+	}
+
+	bool TensorArchive::parse_record(uint64_t offset, TensorArchiveEntry& entry, uint64_t& next_offset) const{
+
+		RecordHeader header;
+		if(offset + sizeof(header) > size_) return false;
+		memcpy(&header, base_ + offset, sizeof(header));
+
+		if(header.magic != kRecordMagic || header.name_length > kMaxNameLength || header.ndims > kMaxDims || !valid_dtype(header.dtype))
+			return false;
+
+		uint64_t meta_end = offset + sizeof(header) + header.name_length + header.ndims * sizeof(int32_t);
+		if(meta_end > size_ || header.payload_offset < meta_end || header.payload_offset > size_ || header.payload_bytes > size_ - header.payload_offset)
+			return false;
+
+		entry.name.assign((const char*)base_ + offset + sizeof(header), header.name_length);
+		entry.dims.resize(header.ndims);
+		memcpy(entry.dims.data(), base_ + offset + sizeof(header) + header.name_length, header.ndims * sizeof(int32_t));
+
+		uint64_t numel = 1;
+		for(int d : entry.dims){
+			if(d < 0) return false;
+			numel *= d;
+		}
+
+		entry.dtype  = (DataType)header.dtype;
+		entry.offset = header.payload_offset;
+		entry.bytes  = header.payload_bytes;
+		entry.crc32  = header.crc32;
+		entry.record_offset = offset;
+		if(numel * data_type_size(entry.dtype) != entry.bytes)
+			return false;
+
+		next_offset = header.payload_offset + header.payload_bytes;
+		return true;
+	}
+
+	bool TensorArchive::parse_index(uint64_t index_offset, uint32_t count){
+
+		if(index_offset > size_ || (size_ - index_offset) / sizeof(uint64_t) < count)
+			return false;
+
+		vector<uint64_t> offsets(count);
+		memcpy(offsets.data(), base_ + index_offset, count * sizeof(uint64_t));
+
+		entries_.resize(count);
+		uint64_t next_offset = 0;
+		for(uint32_t i = 0; i < count; ++i){
+			if(!parse_record(offsets[i], entries_[i], next_offset)){
+				entries_.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool TensorArchive::parse(){
+
+		FileHeader header;
+		memcpy(&header, base_, sizeof(header));
+		if(header.magic != kFileMagic){
+			INFOE("Invalid tensor archive %s, magic number mismatch", path_.c_str());
+			return false;
+		}
+
+		if(header.version == 0 || header.version > TensorArchiveWriter::kVersion){
+			INFOE("Unsupported tensor archive version %d of %s", header.version, path_.c_str());
+			return false;
+		}
+		version_   = header.version;
+		alignment_ = header.alignment;
+
+		// 优先用末尾的Index，没有正常close的文件逐个扫描record
+		Footer footer{0, 0, 0};
+		bool has_index = false;
+		if(size_ >= sizeof(FileHeader) + sizeof(Footer)){
+			memcpy(&footer, base_ + size_ - sizeof(footer), sizeof(footer));
+			if(footer.magic == kFooterMagic){
+				has_index = parse_index(footer.index_offset, footer.count);
+				if(!has_index)
+					INFOW("Broken index of tensor archive %s, scan records instead", path_.c_str());
+			}
+		}
+
+		if(!has_index){
+			uint64_t offset = sizeof(FileHeader);
+			TensorArchiveEntry entry;
+			while(parse_record(offset, entry, offset))
+				entries_.push_back(entry);
+
+			if(offset != size_ && footer.magic != kFooterMagic)
+				INFOW("Tensor archive %s is truncated or not closed, %d records loaded", path_.c_str(), (int)entries_.size());
+		}
+
+		for(int i = 0; i < (int)entries_.size(); ++i)
+			name_to_index_[entries_[i].name] = i;
+		return true;
+	}
+
+	int TensorArchive::find(const string& name) const{
+		auto iter = name_to_index_.find(name);
+		if(iter == name_to_index_.end())
+			return -1;
+		return iter->second;
+	}
+
+	const void* TensorArchive::data(int index) const{
+		return base_ + entries_[index].offset;
+	}
+
+	bool TensorArchive::verify(int index) const{
+		auto& entry = entries_[index];
+		auto crc = crc32(data(index), entry.bytes);
+		if(crc != entry.crc32){
+			INFOE("CRC32 mismatch of tensor %s in %s, expect %08X, got %08X", entry.name.c_str(), path_.c_str(), entry.crc32, crc);
+			return false;
+		}
+		return true;
+	}
+
+	shared_ptr<Tensor> TensorArchive::tensor(int index) const{
+
+		if(index < 0 || index >= size()){
+			INFOE("Tensor index %d out of range [0, %d) in %s", index, size(), path_.c_str());
+			return nullptr;
+		}
+
+		auto& entry  = entries_[index];
+		auto memory  = make_shared<MappedMemory>(mapping_, (void*)data(index), entry.bytes);
+		return make_shared<Tensor>(entry.dims, entry.dtype, memory);
+	}
+
+	shared_ptr<Tensor> TensorArchive::tensor(const string& name) const{
+		int index = find(name);
+		if(index == -1){
+			INFOE("Tensor %s not found in %s", name.c_str(), path_.c_str());
+			return nullptr;
+		}
+		return tensor(index);
+	}
+};
@@ -0,0 +1,149 @@
+#ifndef TENSOR_ARCHIVE_HPP
+#define TENSOR_ARCHIVE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <stdio.h>
+#include <stdint.h>
+#include "trt_tensor.hpp"
+
+/* 多tensor的归档文件，用于批量dump中间结果做回归对比
+   所有整数为小端，格式如下：
+
+   FileHeader   : magic(u32 0x41545254 "TRTA"), version(u32), alignment(u32), reserved(u32)
+   Record * N   : RecordHeader, name(name_length字节), dims(i32 * ndims), 填充0到alignment, payload(payload_bytes字节)
+   RecordHeader : magic(u32 0x43455254 "TREC"), name_length(u32), dtype(i32), ndims(u32),
+                  payload_offset(u64, 相对文件开头), payload_bytes(u64), crc32(u32, payload的CRC32/IEEE), reserved(u32)
+   Index        : record_offset(u64) * N
+   Footer       : magic(u32 0x58444954 "TIDX"), count(u32), index_offset(u64)
+
+   写入是流式的：每个tensor直接写到文件，payload写完后回填crc32；close时写Index和Footer
+   没有正常close的文件（没有Footer）仍然可以通过逐个扫描Record读取
+
+   # python读取
+   import numpy as np, struct
+
+   def load_archive(file):
+       data = np.memmap(file, np.uint8, "r")
+       magic, version, alignment, _ = struct.unpack_from("<4I", data, 0)
+       assert magic == 0x41545254, f"{file} not a tensor archive"
+       np_dtypes = {0: np.float32, 1: np.float16, 2: np.int32, 3: np.uint8}
+       tensors, offset = {}, 16
+       while offset + 40 <= len(data) and struct.unpack_from("<I", data, offset)[0] == 0x43455254:
+           _, name_length, dtype, ndims, payload_offset, payload_bytes, crc, _ = struct.unpack_from("<IIiIQQII", data, offset)
+           name = bytes(data[offset + 40 : offset + 40 + name_length]).decode()
+           dims = struct.unpack_from(f"<{ndims}i", data, offset + 40 + name_length)
+           tensors[name] = np.frombuffer(data, np_dtypes[dtype], int(np.prod(dims)), payload_offset).reshape(dims)
+           offset = payload_offset + payload_bytes
+       return tensors
+*/
+namespace TRT{
+
+    struct TensorArchiveEntry{
+        std::string name;
+        DataType dtype = DataType::Unknow;
+        std::vector<int> dims;
+        uint64_t offset = 0;        // payload相对文件开头的偏移
+        uint64_t bytes  = 0;
+        uint32_t crc32  = 0;
+        uint64_t record_offset = 0;
+    };
+
+    uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+    class TensorArchiveWriter{
+    public:
+        static const uint32_t kVersion          = 1;
+        static const uint32_t kDefaultAlignment = 64;
+
+        TensorArchiveWriter() = default;
+        TensorArchiveWriter(const TensorArchiveWriter&) = delete;
+        TensorArchiveWriter& operator = (const TensorArchiveWriter&) = delete;
+        virtual ~TensorArchiveWriter();
+
+        // append为true且文件已经是归档时，在末尾继续写入，alignment沿用原文件的值
+        bool open(const std::string& file, bool append = false, uint32_t alignment = kDefaultAlignment);
+        bool is_open() const{return file_ != nullptr;}
+
+        // 写入tensor的host数据，tensor在device上时会先拷贝到host
+        bool write(const std::string& name, Tensor& tensor);
+        bool write(const std::string& name, DataType dtype, const std::vector<int>& dims, const void* data);
+
+        /* 分块写入一个tensor：begin之后多次append，总字节数必须等于dims和dtype对应的大小，最后end
+           用于数据本身也是分块产生的情况，不需要先拼成一整块
+        */
+        bool begin(const std::string& name, DataType dtype, const std::vector<int>& dims);
+        bool append(const void* data, size_t size);
+        bool end();
+
+        bool close();
+
+        // 已经写入（包括append模式下原有）的tensor数
+        int size() const{return (int)record_offsets_.size();}
+
+    private:
+        bool fail(const char* message);
+        void discard_record();
+
+    private:
+        FILE* file_ = nullptr;
+        std::string path_;
+        uint32_t alignment_ = kDefaultAlignment;
+        std::vector<uint64_t> record_offsets_;
+
+        // 当前正在写入的record
+        bool in_record_ = false;
+        uint64_t record_offset_ = 0;
+        uint64_t payload_expected_ = 0;
+        uint64_t payload_written_  = 0;
+        uint32_t payload_crc_ = 0;
+    };
+
+    /* mmap方式读取归档，tensor()返回的Tensor直接引用映射的内存，不做拷贝
+       映射为MAP_PRIVATE，对返回的tensor的修改不会写回文件
+       Tensor（及其MixMemory）持有映射的引用，TensorArchive先析构也是安全的
+    */
+    class TensorArchive{
+    public:
+        static const uint32_t kMagic = 0x41545254;
+
+        virtual ~TensorArchive();
+
+        // verify_crc为true时打开时校验所有payload，否则只在verify时校验
+        static std::shared_ptr<TensorArchive> open(const std::string& file, bool verify_crc = false);
+
+        int size() const{return (int)entries_.size();}
+        uint32_t version() const{return version_;}
+        uint32_t alignment() const{return alignment_;}
+        const TensorArchiveEntry& entry(int index) const{return entries_[index];}
+
+        // 没有找到返回-1，重名时返回最后写入的
+        int find(const std::string& name) const;
+
+        const void* data(int index) const;
+        bool verify(int index) const;
+
+        std::shared_ptr<Tensor> tensor(int index) const;
+        std::shared_ptr<Tensor> tensor(const std::string& name) const;
+
+    private:
+        TensorArchive() = default;
+        bool parse();
+        bool parse_index(uint64_t index_offset, uint32_t count);
+        bool parse_record(uint64_t offset, TensorArchiveEntry& entry, uint64_t& next_offset) const;
+
+    private:
+        std::string path_;
+        std::shared_ptr<void> mapping_;
+        const uint8_t* base_ = nullptr;
+        size_t size_ = 0;
+        uint32_t version_ = 0;
+        uint32_t alignment_ = 0;
+        std::vector<TensorArchiveEntry> entries_;
+        std::unordered_map<std::string, int> name_to_index_;
+    };
+};
+
+#endif // TENSOR_ARCHIVE_HPP
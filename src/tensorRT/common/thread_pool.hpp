@@ -0,0 +1,140 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+/* 固定线程数的线程池，用于CPU侧的数据并行（例如一个batch内多张图片的预处理）
+   commit：提交单个任务，返回future
+   parallel_for：把[begin, end)按grain切块分发到线程池，调用者线程也参与计算，全部完成后返回
+   parallel_for中的切块由共享计数器领取，调用者只等待已经被领走的块，因此在线程池的线程中嵌套调用也不会死锁
+*/
+class ThreadPool{
+public:
+    // num_threads：0表示使用std::thread::hardware_concurrency()
+    explicit ThreadPool(int num_threads = 0){
+        if(num_threads <= 0)
+            num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+        run_ = true;
+        for(int i = 0; i < num_threads; ++i)
+            threads_.emplace_back(&ThreadPool::worker, this);
+    }
+
+    virtual ~ThreadPool(){
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            run_ = false;
+        }
+        cv_.notify_all();
+        for(auto& t : threads_){
+            if(t.joinable())
+                t.join();
+        }
+    }
+
+    int size() const{
+        return static_cast<int>(threads_.size());
+    }
+
+    template<class F>
+    std::future<typename std::result_of<F()>::type> commit(F&& func){
+        typedef typename std::result_of<F()>::type ReturnType;
+        auto task = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(func));
+        auto result = task->get_future();
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            tasks_.emplace([task](){ (*task)(); });
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+    // func(i)对[begin, end)中每个i调用一次，顺序不定
+    template<class F>
+    void parallel_for(int begin, int end, F func, int grain = 1){
+        if(end <= begin) return;
+        if(grain < 1) grain = 1;
+
+        int num_chunks = (end - begin + grain - 1) / grain;
+        if(num_chunks == 1){
+            for(int i = begin; i < end; ++i) func(i);
+            return;
+        }
+
+        struct State{
+            std::atomic<int> next_chunk{0};
+            std::atomic<int> done_chunk{0};
+            std::mutex lock;
+            std::condition_variable cv;
+        };
+        auto state = std::make_shared<State>();
+
+        // 返回false表示已经没有可领取的块
+        auto run_chunk = [=](){
+            int chunk = state->next_chunk++;
+            if(chunk >= num_chunks) return false;
+
+            int chunk_begin = begin + chunk * grain;
+            int chunk_end   = std::min(end, chunk_begin + grain);
+            for(int i = chunk_begin; i < chunk_end; ++i) func(i);
+
+            if(++state->done_chunk == num_chunks){
+                std::unique_lock<std::mutex> l(state->lock);
+                state->cv.notify_all();
+            }
+            return true;
+        };
+
+        int num_helpers = std::min(size(), num_chunks - 1);
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            for(int i = 0; i < num_helpers; ++i)
+                tasks_.emplace([run_chunk](){ while(run_chunk()); });
+        }
+        cv_.notify_all();
+
+        while(run_chunk());
+
+        std::unique_lock<std::mutex> l(state->lock);
+        state->cv.wait(l, [&](){
+            return state->done_chunk == num_chunks;
+        });
+    }
+
+private:
+    void worker(){
+        while(true){
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> l(lock_);
+                cv_.wait(l, [&](){
+                    return !run_ || !tasks_.empty();
+                });
+
+                if(!run_ && tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+private:
+    std::vector<std::thread> threads_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex lock_;
+    std::condition_variable cv_;
+    bool run_ = false;
+};
+
+#endif // THREAD_POOL_HPP
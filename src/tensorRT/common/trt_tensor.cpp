@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <cuda_runtime.h>
 #include "cuda_tools.hpp"
-#include <cuda_fp16.h>
+#include "preprocess_kernel_cpu.hpp"
+#include "tensor_archive.hpp"
+#include <limits>
 
 using namespace cv;
 using namespace std;
@@ -11,12 +13,13 @@ using namespace std;
 namespace TRT{
 
 	float float16_to_float(float16 value){
-		return __half2float(*reinterpret_cast<__half*>(&value));
+		return CPUKernel::half_to_float(value._);
 	}
 
 	float16 float_to_float16(float value){
-		auto val = __float2half(value);
-		return *reinterpret_cast<float16*>(&val);
+		float16 output;
+		output._ = CPUKernel::float_to_half(value);
+		return output;
 	}
 
 	int data_type_size(DataType dt){
@@ -42,11 +45,201 @@ namespace TRT{
 		return device_id;
 	}
 
-	MixMemory::MixMemory(int device_id){
+	class CUDAMemoryBackend : public MemoryBackend{
+	public:
+		virtual void* allocate(MemoryKind kind, int device_id, size_t size) override{
+			void* ptr = nullptr;
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			auto code = kind == MemoryKind::Host ? cudaMallocHost(&ptr, size) : cudaMalloc(&ptr, size);
+			if(code != cudaSuccess){
+				// 清掉这次的错误，避免后续的checkCudaRuntime误报
+				cudaGetLastError();
+				return nullptr;
+			}
+			return ptr;
+		}
+
+		virtual void deallocate(MemoryKind kind, int device_id, void* ptr) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			auto code = kind == MemoryKind::Host ? cudaFreeHost(ptr) : cudaFree(ptr);
+
+			// 进程退出时全局pool析构，此时cuda runtime可能已经卸载
+			if(code != cudaSuccess && code != cudaErrorCudartUnloading)
+				checkCudaRuntime(code);
+		}
+
+		virtual void fill(MemoryKind kind, int device_id, void* ptr, int value, size_t size) override{
+			if(kind == MemoryKind::Host){
+				memset(ptr, value, size);
+				return;
+			}
+
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			checkCudaRuntime(cudaMemset(ptr, value, size));
+		}
+
+		virtual const char* name() const override{
+			return "cuda";
+		}
+
+		virtual void* record_event(int device_id, void* stream) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			cudaEvent_t event = nullptr;
+			checkCudaRuntime(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+			checkCudaRuntime(cudaEventRecord(event, (cudaStream_t)stream));
+			return event;
+		}
+
+		virtual bool query_event(void* event) override{
+			cudaError_t code = cudaEventQuery((cudaEvent_t)event);
+			if(code == cudaErrorNotReady)
+				return false;
+
+			checkCudaRuntime(code);
+			return true;
+		}
+
+		virtual void destroy_event(void* event) override{
+			auto code = cudaEventDestroy((cudaEvent_t)event);
+
+			// 进程退出时全局pool析构，此时cuda runtime可能已经卸载
+			if(code != cudaSuccess && code != cudaErrorCudartUnloading)
+				checkCudaRuntime(code);
+		}
+	};
+
+	shared_ptr<MemoryBackend> cuda_memory_backend(){
+		static shared_ptr<MemoryBackend> backend(new CUDAMemoryBackend());
+		return backend;
+	}
+
+	static mutex global_memory_pool_lock_;
+	static shared_ptr<MemoryPool> global_memory_pool_;
+
+	shared_ptr<MemoryPool> memory_pool(){
+		unique_lock<mutex> l(global_memory_pool_lock_);
+		if(global_memory_pool_ == nullptr)
+			global_memory_pool_ = make_shared<MemoryPool>(cuda_memory_backend());
+		return global_memory_pool_;
+	}
+
+	void set_memory_pool(shared_ptr<MemoryPool> pool){
+		unique_lock<mutex> l(global_memory_pool_lock_);
+		global_memory_pool_ = pool;
+	}
+
+	class CUDATransferBackend : public TransferBackend{
+	public:
+		virtual void copy_async(MemoryKind dst_kind, void* dst, const void* src, size_t size, int device_id, CUStream stream) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			auto kind = dst_kind == MemoryKind::Host ? cudaMemcpyDeviceToHost : cudaMemcpyHostToDevice;
+			checkCudaRuntime(cudaMemcpyAsync(dst, src, size, kind, stream));
+		}
+
+		virtual void stream_synchronize(int device_id, CUStream stream) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			checkCudaRuntime(cudaStreamSynchronize(stream));
+		}
+
+		virtual TransferEvent create_event(int device_id) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			cudaEvent_t event = nullptr;
+			checkCudaRuntime(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+			return event;
+		}
+
+		virtual void destroy_event(TransferEvent event) override{
+			auto code = cudaEventDestroy((cudaEvent_t)event);
+
+			// 进程退出时才析构的事件，此时cuda runtime可能已经卸载
+			if(code != cudaSuccess && code != cudaErrorCudartUnloading)
+				checkCudaRuntime(code);
+		}
+
+		virtual void record_event(TransferEvent event, CUStream stream) override{
+			checkCudaRuntime(cudaEventRecord((cudaEvent_t)event, stream));
+		}
+
+		virtual void event_synchronize(TransferEvent event) override{
+			checkCudaRuntime(cudaEventSynchronize((cudaEvent_t)event));
+		}
+
+		virtual bool event_query(TransferEvent event) override{
+			cudaError_t code = cudaEventQuery((cudaEvent_t)event);
+			if(code == cudaErrorNotReady)
+				return false;
+
+			checkCudaRuntime(code);
+			return true;
+		}
+	};
+
+	shared_ptr<TransferBackend> cuda_transfer_backend(){
+		static shared_ptr<TransferBackend> backend(new CUDATransferBackend());
+		return backend;
+	}
+
+	static mutex global_transfer_backend_lock_;
+	static shared_ptr<TransferBackend> global_transfer_backend_;
+
+	shared_ptr<TransferBackend> transfer_backend(){
+		unique_lock<mutex> l(global_transfer_backend_lock_);
+		if(global_transfer_backend_ == nullptr)
+			global_transfer_backend_ = cuda_transfer_backend();
+		return global_transfer_backend_;
+	}
+
+	void set_transfer_backend(shared_ptr<TransferBackend> backend){
+		unique_lock<mutex> l(global_transfer_backend_lock_);
+		global_transfer_backend_ = backend;
+	}
+
+	// 创建时在stream当前的末尾记录，析构时由记录它的后端销毁
+	class TransferFence{
+	public:
+		TransferFence(shared_ptr<TransferBackend> backend, int device_id, CUStream stream) : backend_(backend){
+			event_ = backend_->create_event(device_id);
+			backend_->record_event(event_, stream);
+		}
+
+		~TransferFence(){
+			backend_->destroy_event(event_);
+		}
+
+		bool ready() const{ return backend_->event_query(event_); }
+		void wait() const{ backend_->event_synchronize(event_); }
+
+	private:
+		shared_ptr<TransferBackend> backend_;
+		TransferEvent event_ = nullptr;
+	};
+
+	bool TransferHandle::ready() const{
+		for(auto& fence : fences_){
+			if(!fence->ready())
+				return false;
+		}
+		return true;
+	}
+
+	void TransferHandle::wait() const{
+		for(auto& fence : fences_)
+			fence->wait();
+	}
+
+	void TransferHandle::add(const shared_ptr<TransferFence>& fence){
+		if(fence == nullptr || std::find(fences_.begin(), fences_.end(), fence) != fences_.end())
+			return;
+		fences_.push_back(fence);
+	}
+
+	MixMemory::MixMemory(int device_id, shared_ptr<MemoryPool> pool){
 		device_id_ = get_device(device_id);
+		pool_ = pool ? pool : memory_pool();
 	}
 
 	MixMemory::MixMemory(void* cpu, size_t cpu_size, void* gpu, size_t gpu_size){
+		pool_ = memory_pool();
 		reference_data(cpu, cpu_size, gpu, gpu_size);		
 	}
 
@@ -83,9 +276,9 @@ namespace TRT{
 			release_gpu();
 
 			gpu_size_ = size;
-			CUDATools::AutoDevice auto_device_exchange(device_id_);
-			checkCudaRuntime(cudaMalloc(&gpu_, size));
-			checkCudaRuntime(cudaMemset(gpu_, 0, size));
+			gpu_ = pool_->allocate(MemoryKind::Device, device_id_, size, &gpu_block_size_);
+			Assert(gpu_ != nullptr);
+			initialize(MemoryKind::Device, gpu_, size);
 		}
 		return gpu_;
 	}
@@ -96,34 +289,51 @@ namespace TRT{
 			release_cpu();
 
 			cpu_size_ = size;
-			CUDATools::AutoDevice auto_device_exchange(device_id_);
-			checkCudaRuntime(cudaMallocHost(&cpu_, size));
+			cpu_ = pool_->allocate(MemoryKind::Host, device_id_, size, &cpu_block_size_);
 			Assert(cpu_ != nullptr);
-			memset(cpu_, 0, size);
+			initialize(MemoryKind::Host, cpu_, size);
 		}
 		return cpu_;
 	}
 
+	void MixMemory::initialize(MemoryKind kind, void* ptr, size_t size){
+
+		if(init_ == MemoryInit::Zero){
+			pool_->backend()->fill(kind, device_id_, ptr, 0, size);
+		}
+#ifndef NDEBUG
+		else if(init_ == MemoryInit::PoisonInDebug){
+			pool_->backend()->fill(kind, device_id_, ptr, 0xFF, size);
+		}
+#endif
+	}
+
+	void MixMemory::swap_cpu(MixMemory& other){
+		Assert(pool_ == other.pool_ && device_id_ == other.device_id_);
+		std::swap(cpu_, other.cpu_);
+		std::swap(cpu_size_, other.cpu_size_);
+		std::swap(cpu_block_size_, other.cpu_block_size_);
+		std::swap(owner_cpu_, other.owner_cpu_);
+	}
+
 	void MixMemory::release_cpu() {
 		if (cpu_) {
-			if(owner_cpu_){
-				CUDATools::AutoDevice auto_device_exchange(device_id_);
-				checkCudaRuntime(cudaFreeHost(cpu_));
-			}
+			if(owner_cpu_)
+				pool_->deallocate(MemoryKind::Host, device_id_, cpu_, cpu_block_size_, stream_);
 			cpu_ = nullptr;
 		}
 		cpu_size_ = 0;
+		cpu_block_size_ = 0;
 	}
 
 	void MixMemory::release_gpu() {
 		if (gpu_) {
-			if(owner_gpu_){
-				CUDATools::AutoDevice auto_device_exchange(device_id_);
-				checkCudaRuntime(cudaFree(gpu_));
-			}
+			if(owner_gpu_)
+				pool_->deallocate(MemoryKind::Device, device_id_, gpu_, gpu_block_size_, stream_);
 			gpu_ = nullptr;
 		}
 		gpu_size_ = 0;
+		gpu_block_size_ = 0;
 	}
 
 	void MixMemory::release_all() {
@@ -140,6 +350,148 @@ namespace TRT{
 		}
 	}
 
+	const char* memory_init_string(MemoryInit init){
+		switch(init){
+			case MemoryInit::Zero: return "Zero";
+			case MemoryInit::Uninitialized: return "Uninitialized";
+			case MemoryInit::PoisonInDebug: return "PoisonInDebug";
+			default: return "Unknow";
+		}
+	}
+
+	// 转为整数时向0截断并饱和到_T的范围，NaN转为0
+	template<typename _T>
+	static inline _T saturate_cast(float value){
+		if(value != value) return 0;
+		if(value <= (float)std::numeric_limits<_T>::lowest()) return std::numeric_limits<_T>::lowest();
+		if(value >= (float)std::numeric_limits<_T>::max()) return std::numeric_limits<_T>::max();
+		return (_T)value;
+	}
+
+	static inline uint8_t saturate_uint8(int value){
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	template<typename _Src, typename _Dst, typename _Func>
+	static void convert_elements(const void* src, void* dst, size_t count, _Func func){
+		const _Src* s = (const _Src*)src;
+		_Dst* d = (_Dst*)dst;
+		CPUKernel::parallel_range(count, sizeof(_Src) + sizeof(_Dst), [&](size_t begin, size_t end){
+			for(size_t i = begin; i < end; ++i)
+				d[i] = func(s[i]);
+		});
+	}
+
+	// src和dst不重叠
+	static bool convert_range(const void* src, DataType src_type, void* dst, DataType dst_type, size_t count){
+
+		using CPUKernel::half_to_float;
+		using CPUKernel::float_to_half;
+
+		if(src_type == dst_type){
+			int element_size = data_type_size(src_type);
+			if(element_size <= 0)
+				return false;
+
+			memcpy(dst, src, count * element_size);
+			return true;
+		}
+
+		switch(src_type){
+		case DataType::Float:
+			switch(dst_type){
+			case DataType::Float16: CPUKernel::convert_float_to_half((const float*)src, (uint16_t*)dst, count); return true;
+			case DataType::Int32:   convert_elements<float, int>(src, dst, count, [](float v){return saturate_cast<int>(v);}); return true;
+			case DataType::UInt8:   convert_elements<float, uint8_t>(src, dst, count, [](float v){return saturate_cast<uint8_t>(v);}); return true;
+			default: return false;
+			}
+		case DataType::Float16:
+			switch(dst_type){
+			case DataType::Float:   CPUKernel::convert_half_to_float((const uint16_t*)src, (float*)dst, count); return true;
+			case DataType::Int32:   convert_elements<uint16_t, int>(src, dst, count, [](uint16_t v){return saturate_cast<int>(half_to_float(v));}); return true;
+			case DataType::UInt8:   convert_elements<uint16_t, uint8_t>(src, dst, count, [](uint16_t v){return saturate_cast<uint8_t>(half_to_float(v));}); return true;
+			default: return false;
+			}
+		case DataType::Int32:
+			switch(dst_type){
+			case DataType::Float:   convert_elements<int, float>(src, dst, count, [](int v){return (float)v;}); return true;
+			case DataType::Float16: convert_elements<int, uint16_t>(src, dst, count, [](int v){return float_to_half((float)v);}); return true;
+			case DataType::UInt8:   convert_elements<int, uint8_t>(src, dst, count, [](int v){return saturate_uint8(v);}); return true;
+			default: return false;
+			}
+		case DataType::UInt8:
+			switch(dst_type){
+			case DataType::Float:   convert_elements<uint8_t, float>(src, dst, count, [](uint8_t v){return (float)v;}); return true;
+			case DataType::Float16: convert_elements<uint8_t, uint16_t>(src, dst, count, [](uint8_t v){return float_to_half((float)v);}); return true;
+			case DataType::Int32:   convert_elements<uint8_t, int>(src, dst, count, [](uint8_t v){return (int)v;}); return true;
+			default: return false;
+			}
+		default: return false;
+		}
+	}
+
+	bool convert_data_type(const void* src, DataType src_type, void* dst, DataType dst_type, size_t count){
+
+		// 先用0个元素检查是否支持这两种类型，之后的转换不会失败
+		if(!convert_range(src, src_type, dst, dst_type, 0))
+			return false;
+
+		size_t src_size = data_type_size(src_type);
+		size_t dst_size = data_type_size(dst_type);
+		if(count == 0 || (src == dst && src_type == dst_type))
+			return true;
+
+		if(src != dst)
+			return convert_range(src, src_type, dst, dst_type, count);
+
+		// 原地转换，一小块元素经过中转缓冲区：先全部读出再写回
+		uint8_t* data = (uint8_t*)dst;
+		const size_t block = 4096;
+		auto stage = [&](size_t first, size_t n, std::vector<uint8_t>& staging){
+			staging.resize(n * dst_size);
+			convert_range(data + first * src_size, src_type, staging.data(), dst_type, n);
+			memcpy(data + first * dst_size, staging.data(), n * dst_size);
+		};
+
+		if(src_size == dst_size){
+			// 元素位置不变，块之间互不重叠，可以并行
+			size_t num_blocks = (count + block - 1) / block;
+			CPUKernel::parallel_range(num_blocks, block * (src_size + dst_size), [&](size_t begin, size_t end){
+				std::vector<uint8_t> staging;
+				for(size_t b = begin; b < end; ++b)
+					stage(b * block, std::min(block, count - b * block), staging);
+			});
+			return true;
+		}
+
+		std::vector<uint8_t> staging;
+		if(dst_size < src_size){
+			// 从前往后：[0, done)完成后，[done, done * src_size / dst_size)的输出只覆盖已经读完的输入，每轮内部可以并行
+			size_t done = std::min(count, block);
+			stage(0, done, staging);
+			while(done < count){
+				size_t end = std::min(count, done * src_size / dst_size);
+				convert_range(data + done * src_size, src_type, data + done * dst_size, dst_type, end - done);
+				done = end;
+			}
+			return true;
+		}
+
+		// 从后往前：[begin, count)完成后，[ceil(begin * src_size / dst_size), begin)的输出只覆盖已经读完的输入
+		size_t begin = count - std::min(count, block);
+		stage(begin, count - begin, staging);
+		while(begin > 0){
+			size_t first = (begin * src_size + dst_size - 1) / dst_size;
+			if(begin <= block || first >= begin){
+				stage(0, begin, staging);
+				break;
+			}
+			convert_range(data + first * src_size, src_type, data + first * dst_size, dst_type, begin - first);
+			begin = first;
+		}
+		return true;
+	}
+
 	const char* data_type_string(DataType dt){
 		switch(dt){
 			case DataType::Float: return "Float32";
@@ -231,14 +583,17 @@ namespace TRT{
 
 	void Tensor::setup_data(shared_ptr<MixMemory> data){
 		
+		wait_pending();
 		data_ = data;
 		if(data_ == nullptr){
 			data_ = make_shared<MixMemory>(device_id_);
 		}else{
 			device_id_ = data_->device_id();
 		}
+		data_->set_stream(stream_);
 
 		head_ = DataHead::Init;
+		batch_fill_values_.clear();
 		if(data_->cpu()){
 			head_ = DataHead::Host;
 		}
@@ -249,7 +604,9 @@ namespace TRT{
 	}
 
 	shared_ptr<Tensor> Tensor::clone() const{
+		// 拷贝在stream_上异步进行，新tensor要跟在同一个stream上，否则后续在默认stream上的操作会和拷贝竞争
 		auto new_tensor = make_shared<Tensor>(shape_, dtype_);
+		new_tensor->set_stream(stream_).set_workspace(workspace_);
 		if(head_ == DataHead::Init)
 			return new_tensor;
 		
@@ -280,6 +637,7 @@ namespace TRT{
 			return *this;
 		}
 		
+		mark_dirty_bytes(offset_location, copyed_bytes);
 		if(head_ == DataHead::Device){
 			int current_device_id = get_device(device_id);
 			int gpu_device_id = device();
@@ -317,11 +675,13 @@ namespace TRT{
 			return *this;
 		}
 
+		mark_dirty_bytes(offset_location, copyed_bytes);
 		if(head_ == DataHead::Device){
 			CUDATools::AutoDevice auto_device_exchange(this->device());
 			checkCudaRuntime(cudaMemcpyAsync((char*)data_->gpu() + offset_location, src, copyed_bytes, cudaMemcpyHostToDevice, stream_));
 		}else if(head_ == DataHead::Host){
 			//checkCudaRuntime(cudaMemcpyAsync((char*)data_->cpu() + offset_location, src, copyed_bytes, cudaMemcpyHostToHost, stream_));
+			wait_pending();
 			memcpy((char*)data_->cpu() + offset_location, src, copyed_bytes);
 		}else{
 			INFOE("Unsupport head type %d", head_);
@@ -330,6 +690,8 @@ namespace TRT{
 	}
 
 	Tensor& Tensor::release() {
+		// 内存还给pool之前，异步下载必须已经完成
+		wait_pending();
 		data_->release_all();
 		shape_.clear();
 		bytes_ = 0;
@@ -340,6 +702,7 @@ namespace TRT{
 		}
 		stream_owner_ = false;
 		stream_ = nullptr;
+		data_->set_stream(nullptr);
 		return *this;
 	}
 
@@ -408,6 +771,14 @@ namespace TRT{
 
 		this->adajust_memory_by_update_dims_or_type();
 		this->compute_shape_string();
+
+		// 重新申请内存或者槽位大小变化后，所有槽位的内容都未知
+		size_t slot_bytes = batch_slot_bytes();
+		if(head_ == DataHead::Init || slot_bytes != batch_slot_bytes_)
+			batch_fill_values_.clear();
+
+		batch_fill_values_.resize(shape_.empty() ? 0 : shape_[0], -1);
+		batch_slot_bytes_ = slot_bytes;
 		return *this;
 	}
 
@@ -427,86 +798,148 @@ namespace TRT{
 		return *this;
 	}
 
-	Tensor& Tensor::to_gpu(bool copy) {
+	bool Tensor::switch_head(DataHead head, bool copy) {
 
-		if (head_ == DataHead::Device)
-			return *this;
+		if (head_ == head)
+			return false;
 
-		head_ = DataHead::Device;
-		data_->gpu(bytes_);
+		// 另一侧没有数据，或者resize变大后另一侧的内存放不下当前的数据，都不能作为拷贝源
+		bool to_host    = head == DataHead::Host;
+		const void* src = to_host ? data_->gpu() : data_->cpu();
+		size_t src_size = to_host ? data_->gpu_size() : data_->cpu_size();
+		void* dst       = to_host ? data_->cpu(bytes_) : data_->gpu(bytes_);
+		head_ = head;
 
-		if (copy && data_->cpu() != nullptr) {
-			CUDATools::AutoDevice auto_device_exchange(this->device());
-			checkCudaRuntime(cudaMemcpyAsync(data_->gpu(), data_->cpu(), bytes_, cudaMemcpyHostToDevice, stream_));
+		if (!copy || src == nullptr || src_size < bytes_ || bytes_ == 0) {
+			mark_dirty();
+			return false;
 		}
+
+		transfer_backend()->copy_async(to_host ? MemoryKind::Host : MemoryKind::Device, dst, src, bytes_, device(), stream_);
+		return true;
+	}
+
+	void Tensor::wait_pending() {
+		if (pending_ == nullptr)
+			return;
+
+		pending_->wait();
+		pending_.reset();
+	}
+
+	Tensor& Tensor::to_gpu(bool copy) {
+		switch_head(DataHead::Device, copy);
 		return *this;
 	}
 	
 	Tensor& Tensor::to_cpu(bool copy) {
 
-		if (head_ == DataHead::Host)
+		if (head_ == DataHead::Host) {
+			wait_pending();
 			return *this;
+		}
 
-		head_ = DataHead::Host;
-		data_->cpu(bytes_);
-
-		if (copy && data_->gpu() != nullptr) {
-			CUDATools::AutoDevice auto_device_exchange(this->device());
-			checkCudaRuntime(cudaMemcpyAsync(data_->cpu(), data_->gpu(), bytes_, cudaMemcpyDeviceToHost, stream_));
-			checkCudaRuntime(cudaStreamSynchronize(stream_));
+		// 同步整个stream，之前未完成的下载也一并完成
+		if (switch_head(DataHead::Host, copy)) {
+			transfer_backend()->stream_synchronize(device(), stream_);
+			pending_.reset();
 		}
+		wait_pending();
 		return *this;
 	}
 
-	Tensor& Tensor::to_float() {
+	TransferHandle Tensor::to_cpu_async() {
 
-		if (type() == DataType::Float)
-			return *this;
+		TransferHandle handle;
+		if (switch_head(DataHead::Host, true))
+			pending_ = make_shared<TransferFence>(transfer_backend(), device(), stream_);
 
-		if (type() != DataType::Float16) {
-			INFOF("not implement function");
-			return *this;
-		}
+		handle.add(pending_);
+		return handle;
+	}
 
-		auto c = count();
-		float* convert_memory = (float*)malloc(c * data_type_size(DataType::Float));
-		float* dst = convert_memory;
-		float16* src = cpu<float16>();
+	TransferHandle Tensor::to_gpu_async() {
 
-		for (int i = 0; i < c; ++i)
-			*dst++ = float16_to_float(*src++);
+		TransferHandle handle;
+		if (switch_head(DataHead::Device, true))
+			handle.add(make_shared<TransferFence>(transfer_backend(), device(), stream_));
+		return handle;
+	}
 
-		this->dtype_ = DataType::Float;
-		adajust_memory_by_update_dims_or_type();
-		memcpy(cpu(), convert_memory, bytes_);
-		free(convert_memory);
-		return *this;
+	TransferHandle to_cpu_async(const std::vector<std::shared_ptr<Tensor>>& tensors) {
+
+		// 先提交所有的拷贝，事件记录在最后一个拷贝之后，同一个stream上的tensor共用一个事件
+		TransferHandle handle;
+		vector<Tensor*> submitted;
+		for (auto& tensor : tensors) {
+			if (tensor == nullptr)
+				continue;
+
+			if (tensor->switch_head(DataHead::Host, true))
+				submitted.push_back(tensor.get());
+			else
+				handle.add(tensor->pending_);
+		}
+
+		auto backend = transfer_backend();
+		map<pair<int, CUStream>, shared_ptr<TransferFence>> fences;
+		for (auto tensor : submitted) {
+			auto& fence = fences[make_pair(tensor->device(), tensor->get_stream())];
+			if (fence == nullptr)
+				fence = make_shared<TransferFence>(backend, tensor->device(), tensor->get_stream());
+
+			tensor->pending_ = fence;
+			handle.add(fence);
+		}
+		return handle;
 	}
 
-	Tensor& Tensor::to_half() {
+	Tensor& Tensor::convert_to(DataType dtype) {
 
-		if (type() == DataType::Float16)
+		if (type() == dtype)
 			return *this;
 
-		if (type() != DataType::Float) {
-			INFOF("not implement function");
+		int element_size = data_type_size(dtype);
+		if (element_size <= 0)
 			return *this;
-		}
-
-		auto c = count();
-		float16* convert_memory = (float16*)malloc(c * data_type_size(DataType::Float16));
-		float16* dst = convert_memory;
-		float* src = cpu<float>();
 
-		for (int i = 0; i < c; ++i) 
-			*dst++ = float_to_float16(*src++);
+		size_t c = count();
+		size_t needed = c * element_size;
+		void* src = cpu();
+		if (needed <= data_->cpu_size()) {
+			if (!convert_data_type(src, dtype_, src, dtype, c)) {
+				INFOE("Unsupport convert %s to %s", data_type_string(dtype_), data_type_string(dtype));
+				return *this;
+			}
+		}else{
+			// 双缓冲：从同一个pool申请新的host内存直接转换过去再交换，旧的内存随converted析构还给pool
+			MixMemory converted(data_->device_id(), data_->pool());
+			converted.set_init(MemoryInit::Uninitialized);
+			converted.set_stream(stream_);
+			if (!convert_data_type(src, dtype_, converted.cpu(needed), dtype, c)) {
+				INFOE("Unsupport convert %s to %s", data_type_string(dtype_), data_type_string(dtype));
+				return *this;
+			}
+			data_->swap_cpu(converted);
+		}
 
-		this->dtype_ = DataType::Float16;
+		this->dtype_ = dtype;
 		adajust_memory_by_update_dims_or_type();
-		memcpy(cpu(), convert_memory, bytes_);
-		free(convert_memory);
+
+		// 转换后的数据只在host上，不能在下次访问时被device上的旧数据覆盖
+		head_ = DataHead::Host;
+		batch_slot_bytes_ = batch_slot_bytes();
+		mark_dirty();
 		return *this;
 	}
+
+	Tensor& Tensor::to_float() {
+		return convert_to(DataType::Float);
+	}
+
+	Tensor& Tensor::to_half() {
+		return convert_to(DataType::Float16);
+	}
 	
 	template<typename _T>
 	static inline void memset_any_type(_T* ptr, size_t count, _T value){
@@ -516,6 +949,7 @@ namespace TRT{
 
 	Tensor& Tensor::set_to(float value) {
 		int c = count();
+		mark_dirty();
 		if (dtype_ == DataType::Float) {
 			memset_any_type(cpu<float>(), c, value);
 		}
@@ -558,10 +992,18 @@ namespace TRT{
 		Assert(image.channels() == 3 && !image.empty() && type() == DataType::Float);
 		Assert(ndims() == 4 && n < shape_[0]);
 		to_cpu(false);
+		mark_dirty(n, n + 1);
 
 		int width   = shape_[3];
 		int height  = shape_[2];
 
+		// uint8 BGR输入走单遍的CPU kernel：resize + BGR2RGB + (x - mean) / std + HWC->CHW，不产生中间图像
+		if(image.type() == CV_8UC3){
+			auto norm = CUDAKernel::Norm::mean_std(mean, std, 1.0f, CUDAKernel::ChannelType::Invert);
+			CPUKernel::resize_bilinear_and_normalize(image.data, image.step, image.cols, image.rows, cpu<float>(n), width, height, norm);
+			return *this;
+		}
+
 		cv::Mat inputframe = image;
 		if(inputframe.size() != cv::Size(width, height))
 			cv::resize(inputframe, inputframe, cv::Size(width, height));
@@ -584,12 +1026,80 @@ namespace TRT{
 		return *this;
 	}
 
+	size_t Tensor::batch_slot_bytes() const{
+		if(shape_.empty() || shape_[0] <= 0)
+			return 0;
+		return bytes_ / shape_[0];
+	}
+
+	bool Tensor::is_dirty(int ibatch) const{
+		if(ibatch < 0 || ibatch >= (int)batch_fill_values_.size())
+			return true;
+		return batch_fill_values_[ibatch] == -1;
+	}
+
+	Tensor& Tensor::mark_dirty(int ibatch_begin, int ibatch_end){
+		ibatch_begin = std::max(ibatch_begin, 0);
+		ibatch_end   = std::min(ibatch_end, (int)batch_fill_values_.size());
+		for(int i = ibatch_begin; i < ibatch_end; ++i)
+			batch_fill_values_[i] = -1;
+		return *this;
+	}
+
+	Tensor& Tensor::mark_dirty(){
+		return mark_dirty(0, (int)batch_fill_values_.size());
+	}
+
+	void Tensor::mark_dirty_bytes(size_t offset, size_t size){
+		if(batch_slot_bytes_ == 0 || size == 0) return;
+		mark_dirty(offset / batch_slot_bytes_, (offset + size - 1) / batch_slot_bytes_ + 1);
+	}
+
+	Tensor& Tensor::fill_batch(int ibatch_begin, int ibatch_end, unsigned char value){
+
+		if(shape_.empty() || ibatch_begin < 0 || ibatch_end > shape_[0] || ibatch_begin > ibatch_end){
+			INFOE("Invalid batch range [%d, %d) for tensor %s", ibatch_begin, ibatch_end, shape_string_);
+			return *this;
+		}
+
+		if(head_ == DataHead::Init)
+			to_cpu(false);
+
+		if(head_ == DataHead::Host)
+			wait_pending();
+
+		// 连续的需要填充的槽位合并成一次memset
+		size_t slot_bytes = batch_slot_bytes_;
+		int ibatch = ibatch_begin;
+		while(ibatch < ibatch_end){
+			if(batch_fill_values_[ibatch] == value){
+				++ibatch;
+				continue;
+			}
+
+			int run_begin = ibatch;
+			while(ibatch < ibatch_end && batch_fill_values_[ibatch] != value)
+				batch_fill_values_[ibatch++] = value;
+
+			size_t offset_location = run_begin * slot_bytes;
+			size_t fill_bytes      = (ibatch - run_begin) * slot_bytes;
+			if(head_ == DataHead::Device){
+				CUDATools::AutoDevice auto_device_exchange(this->device());
+				checkCudaRuntime(cudaMemsetAsync((char*)data_->gpu() + offset_location, value, fill_bytes, stream_));
+			}else{
+				memset((char*)data_->cpu() + offset_location, value, fill_bytes);
+			}
+		}
+		return *this;
+	}
+
 	Tensor& Tensor::set_mat(int n, const cv::Mat& _image) {
 
 		cv::Mat image = _image;
 		Assert(!image.empty() && CV_MAT_DEPTH(image.type()) == CV_32F && type() == DataType::Float);
 		Assert(shape_.size() == 4 && n < shape_[0] && image.channels() == shape_[1]);
 		to_cpu(false);
+		mark_dirty(n, n + 1);
 
 		int width  = shape_[3];
 		int height = shape_[2];
@@ -610,6 +1120,12 @@ namespace TRT{
 		return *this;
 	}
 
+	void Tensor::check_accessor(int ndims, size_t element_size, size_t* element_strides) const{
+		Assert(ndims == shape_.size() && element_size == this->element_size());
+		for(int i = 0; i < ndims; ++i)
+			element_strides[i] = strides_[i] / element_size;
+	}
+
 	bool Tensor::save_to_file(const std::string& file) const{
 
 		if(empty()) return false;
@@ -637,6 +1153,23 @@ namespace TRT{
 		unsigned int head[3] = {0};
 		fread(head, 1, sizeof(head), f);
 
+		// 归档文件读取第一个tensor
+		if(head[0] == TensorArchive::kMagic){
+			fclose(f);
+			auto archive = TensorArchive::open(file);
+			if(archive == nullptr || archive->size() == 0){
+				INFOE("Load %s failed, empty or invalid tensor archive", file.c_str());
+				return false;
+			}
+
+			auto& entry = archive->entry(0);
+			this->dtype_ = entry.dtype;
+			this->resize(entry.dims);
+			this->to_cpu(false);
+			memcpy(this->cpu(), archive->data(0), bytes_);
+			return true;
+		}
+
 		if(head[0] != 0xFCCFE2E2){
 			fclose(f);
 			INFOE("Invalid tensor file %s, magic number mismatch", file.c_str());
@@ -646,14 +1179,199 @@ namespace TRT{
 		int ndims = head[1];
 		auto dtype = (TRT::DataType)head[2];
 		vector<int> dims(ndims);
-		fread(dims.data(), 1, ndims * sizeof(dims[0]), f);
+		size_t dims_read = fread(dims.data(), 1, ndims * sizeof(dims[0]), f);
 		
 		this->dtype_ = dtype;
 		this->resize(dims);
 
-		fread(this->cpu(), 1, bytes_, f);
+		// 数据头直接切到host，不需要先从device拷贝旧数据
+		this->to_cpu(false);
+		size_t bytes_read = fread(this->cpu(), 1, bytes_, f);
 		fclose(f);
+
+		if(dims_read != ndims * sizeof(dims[0]) || bytes_read != bytes_){
+			INFOE("Invalid tensor file %s, file truncated", file.c_str());
+			return false;
+		}
 		return true;
 	}
 
+	TensorView::TensorView(shared_ptr<Tensor> parent){
+		if(parent == nullptr) return;
+
+		parent_  = parent;
+		dtype_   = parent->type();
+		shape_   = parent->dims();
+		strides_ = parent->strides();
+	}
+
+	int TensorView::numel() const{
+		int value = shape_.empty() ? 0 : 1;
+		for(int i = 0; i < shape_.size(); ++i)
+			value *= shape_[i];
+		return value;
+	}
+
+	bool TensorView::is_contiguous() const{
+		size_t expected = element_size();
+		for(int i = (int)shape_.size() - 1; i >= 0; --i){
+			// 大小为1的维度不会用到stride
+			if(shape_[i] != 1 && strides_[i] != expected)
+				return false;
+			expected *= shape_[i];
+		}
+		return true;
+	}
+
+	size_t TensorView::span_bytes() const{
+		if(numel() == 0) return 0;
+
+		size_t last = 0;
+		for(int i = 0; i < shape_.size(); ++i)
+			last += (shape_[i] - 1) * strides_[i];
+		return last + element_size();
+	}
+
+	void TensorView::check_valid() const{
+		Assert(parent_ != nullptr);
+		Assert(parent_->type() == dtype_ && byte_offset_ + span_bytes() <= parent_->bytes());
+	}
+
+	TensorView TensorView::slice(int axis, int begin, int end) const{
+
+		if(axis < 0 || axis >= (int)shape_.size() || begin < 0 || begin > end || end > shape_[axis]){
+			INFOE("Invalid slice [%d, %d) at axis %d of %s", begin, end, axis, empty() ? "empty view" : parent_->shape_string());
+			return TensorView();
+		}
+
+		TensorView view = *this;
+		view.byte_offset_ += begin * strides_[axis];
+		view.shape_[axis]  = end - begin;
+		return view;
+	}
+
+	TensorView TensorView::reshape(const std::vector<int>& dims) const{
+
+		if(empty()) return TensorView();
+		if(!is_contiguous()){
+			INFOE("Reshape a non-contiguous view of %s, clone it first", parent_->shape_string());
+			return TensorView();
+		}
+
+		vector<int> setup_dims = dims;
+		int infer_axis = -1;
+		int known = 1;
+		for(int i = 0; i < setup_dims.size(); ++i){
+			if(setup_dims[i] == -1 && infer_axis == -1){
+				infer_axis = i;
+				continue;
+			}
+
+			if(setup_dims[i] < 0){
+				INFOE("Invalid reshape dim %d at axis %d", setup_dims[i], i);
+				return TensorView();
+			}
+			known *= setup_dims[i];
+		}
+
+		int n = numel();
+		if(infer_axis != -1 && known > 0 && n % known == 0)
+			setup_dims[infer_axis] = n / known;
+
+		int reshaped = setup_dims.empty() ? 0 : 1;
+		for(int i = 0; i < setup_dims.size(); ++i)
+			reshaped *= setup_dims[i];
+
+		if(reshaped != n || (infer_axis != -1 && setup_dims[infer_axis] == -1)){
+			INFOE("Can not reshape %d elements of %s to %d dims", n, parent_->shape_string(), (int)setup_dims.size());
+			return TensorView();
+		}
+
+		TensorView view = *this;
+		view.shape_ = setup_dims;
+		view.strides_.resize(setup_dims.size());
+
+		size_t stride = element_size();
+		for(int i = (int)setup_dims.size() - 1; i >= 0; --i){
+			view.strides_[i] = stride;
+			stride *= setup_dims[i];
+		}
+		return view;
+	}
+
+	int TensorView::offset_array(size_t size, const int* index_array) const{
+
+		Assert(size <= shape_.size());
+		size_t value = 0;
+		for(int i = 0; i < size; ++i)
+			value += index_array[i] * strides_[i];
+		return value / element_size();
+	}
+
+	void* TensorView::cpu() const{
+		check_valid();
+		return (char*)parent_->cpu() + byte_offset_;
+	}
+
+	void* TensorView::gpu() const{
+		check_valid();
+		return (char*)parent_->gpu() + byte_offset_;
+	}
+
+	void TensorView::check_accessor(int ndims, size_t element_size, size_t* element_strides) const{
+		Assert(ndims == shape_.size() && element_size == this->element_size());
+		for(int i = 0; i < ndims; ++i)
+			element_strides[i] = strides_[i] / element_size;
+	}
+
+	const TensorView& TensorView::mark_dirty() const{
+		if(parent_ != nullptr)
+			parent_->mark_dirty_bytes(byte_offset_, span_bytes());
+		return *this;
+	}
+
+	shared_ptr<Tensor> TensorView::clone() const{
+
+		auto new_tensor = make_shared<Tensor>(shape_, dtype_);
+		if(empty())
+			return new_tensor;
+
+		// 同Tensor::clone，新tensor继承parent的stream和workspace
+		new_tensor->set_stream(parent_->get_stream()).set_workspace(parent_->get_workspace());
+		if(numel() == 0 || parent_->head() == DataHead::Init)
+			return new_tensor;
+
+		check_valid();
+		if(parent_->head() == DataHead::Device && is_contiguous()){
+			CUDATools::AutoDevice auto_device_exchange(parent_->device());
+			checkCudaRuntime(cudaMemcpyAsync(new_tensor->gpu(), gpu(), bytes(), cudaMemcpyDeviceToDevice, parent_->get_stream()));
+			return new_tensor;
+		}
+
+		// host上按最内层的连续段拷贝，[inner, ndims)维是连续的
+		int inner = shape_.size();
+		size_t run_bytes = element_size();
+		while(inner > 0 && (shape_[inner - 1] == 1 || strides_[inner - 1] == run_bytes)){
+			run_bytes *= shape_[inner - 1];
+			--inner;
+		}
+
+		size_t num_runs = 1;
+		for(int i = 0; i < inner; ++i)
+			num_runs *= shape_[i];
+
+		const char* src = (const char*)cpu();
+		char* dst = new_tensor->cpu<char>();
+		for(size_t irun = 0; irun < num_runs; ++irun){
+			size_t src_offset = 0;
+			size_t remain = irun;
+			for(int i = inner - 1; i >= 0; --i){
+				src_offset += (remain % shape_[i]) * strides_[i];
+				remain /= shape_[i];
+			}
+			memcpy(dst + irun * run_bytes, src + src_offset, run_bytes);
+		}
+		return new_tensor;
+	}
+
 }; // TRTTensor
\ No newline at end of file
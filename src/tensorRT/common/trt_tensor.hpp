@@ -7,6 +7,7 @@
 #include <vector>
 #include <map>
 #include <opencv2/opencv.hpp>
+#include "memory_pool.hpp"
 
 struct CUstream_st;
 typedef CUstream_st CUStreamRaw;
@@ -32,15 +33,72 @@ namespace TRT {
         UInt8 = 3
     };
 
+    enum class MemoryInit : int{
+        Zero          = 0,  // 新申请的内存清零，默认
+        Uninitialized = 1,  // 不初始化，用于申请后马上会被完整覆盖的内存，例如预处理的输入
+        PoisonInDebug = 2   // Debug编译时每个字节填充0xFF（float为NaN），用于发现读未初始化的内存；Release编译时同Uninitialized
+    };
+
     float float16_to_float(float16 value);
     float16 float_to_float16(float value);
     int data_type_size(DataType dt);
+
+    /* host内存上把count个元素从src_type转换为dst_type，大数组切块并行，不支持的类型返回false
+       float->half为round-to-nearest-even；转为整数时向0截断并饱和到目标类型的范围，NaN转为0
+       src和dst可以是同一地址（原地转换，按轮次推进，每轮只写已经读完的区域），其他形式的重叠不支持
+    */
+    bool convert_data_type(const void* src, DataType src_type, void* dst, DataType dst_type, size_t count);
     const char* data_head_string(DataHead dh);
     const char* data_type_string(DataType dt);
+    const char* memory_init_string(MemoryInit init);
+
+    typedef void* TransferEvent;
+
+    /* Tensor切换数据头时host和device之间的拷贝和同步，语义与CUDA一致：
+       copy_async在stream上排队，record_event在stream当前的末尾记录事件，之前排队的拷贝完成后事件完成
+       默认为cuda_transfer_backend()，单测可以用set_transfer_backend换成CPU上的实现
+    */
+    class TransferBackend {
+    public:
+        virtual ~TransferBackend() = default;
+
+        // dst_kind为目标内存的类型：Host为device->host，Device为host->device
+        virtual void copy_async(MemoryKind dst_kind, void* dst, const void* src, size_t size, int device_id, CUStream stream) = 0;
+        virtual void stream_synchronize(int device_id, CUStream stream) = 0;
+        virtual TransferEvent create_event(int device_id) = 0;
+        virtual void destroy_event(TransferEvent event) = 0;
+        virtual void record_event(TransferEvent event, CUStream stream) = 0;
+        virtual void event_synchronize(TransferEvent event) = 0;
+        virtual bool event_query(TransferEvent event) = 0;
+    };
+
+    std::shared_ptr<TransferBackend> cuda_transfer_backend();
+
+    // 只影响之后提交的拷贝，已经记录的事件仍由记录它的后端等待和销毁
+    std::shared_ptr<TransferBackend> transfer_backend();
+    void set_transfer_backend(std::shared_ptr<TransferBackend> backend);
+
+    // 一次记录的事件，定义在trt_tensor.cpp
+    class TransferFence;
+
+    /* 异步拷贝的完成句柄，包含这次提交涉及的每个stream上的一个事件
+       ready不阻塞；wait阻塞到全部完成。句柄析构时不等待，tensor之后访问host数据时也会先等待自己的下载
+    */
+    class TransferHandle {
+    public:
+        bool ready() const;
+        void wait() const;
+        inline bool empty() const { return fences_.empty(); }
+        void add(const std::shared_ptr<TransferFence>& fence);
+
+    private:
+        std::vector<std::shared_ptr<TransferFence>> fences_;
+    };
 
     class MixMemory {
     public:
-        MixMemory(int device_id = CURRENT_DEVICE_ID);
+        // pool为nullptr时使用全局的memory_pool()，申请和释放都经过pool缓存
+        MixMemory(int device_id = CURRENT_DEVICE_ID, std::shared_ptr<MemoryPool> pool = nullptr);
         MixMemory(void* cpu, size_t cpu_size, void* gpu, size_t gpu_size);
         virtual ~MixMemory();
         void* gpu(size_t size);
@@ -55,6 +113,11 @@ namespace TRT {
         inline size_t cpu_size() const{return cpu_size_;}
         inline size_t gpu_size() const{return gpu_size_;}
         inline int device_id() const{return device_id_;}
+        inline std::shared_ptr<MemoryPool> pool() const{return pool_;}
+
+        // 只影响之后新申请（扩容）的内存
+        inline MemoryInit init() const{return init_;}
+        inline void set_init(MemoryInit init){init_ = init;}
 
         inline void* gpu() const { return gpu_; }
 
@@ -63,17 +126,149 @@ namespace TRT {
 
         void reference_data(void* cpu, size_t cpu_size, void* gpu, size_t gpu_size);
 
+        // 交换两者的host内存（包括所有权），两者须来自同一个pool和设备，用于双缓冲
+        void swap_cpu(MixMemory& other);
+
+        /* 使用这块内存的stream，释放（包括扩容时释放旧的block）时pool在这个stream上记录事件，
+           stream上还没完成的kernel/拷贝结束之前block不会分配给别人。Tensor::set_stream会同步设置
+        */
+        inline CUStream stream() const { return stream_; }
+        inline void set_stream(CUStream stream) { stream_ = stream; }
+
+    private:
+        void initialize(MemoryKind kind, void* ptr, size_t size);
+
     private:
         void* cpu_ = nullptr;
         size_t cpu_size_ = 0;
+        size_t cpu_block_size_ = 0;
         bool owner_cpu_ = true;
         int device_id_ = 0;
 
         void* gpu_ = nullptr;
         size_t gpu_size_ = 0;
+        size_t gpu_block_size_ = 0;
         bool owner_gpu_ = true;
+
+        std::shared_ptr<MemoryPool> pool_;
+        MemoryInit init_ = MemoryInit::Zero;
+        CUStream stream_ = nullptr;
+    };
+
+    // 最后一维上连续的一行
+    template<typename DType>
+    class TensorRow {
+    public:
+        TensorRow(DType* data, int length) : data_(data), length_(length) {}
+
+        inline DType* begin() const { return data_; }
+        inline DType* end()   const { return data_ + length_; }
+        inline DType* data()  const { return data_; }
+        inline int    size()  const { return length_; }
+        inline DType& operator[](int i) const { return data_[i]; }
+
+    private:
+        DType* data_;
+        int length_;
+    };
+
+    // 沿倒数第二维逐行前进的迭代器，解引用得到TensorRow
+    template<typename DType>
+    class TensorRowIterator {
+    public:
+        TensorRowIterator(DType* data, size_t stride, int length) : data_(data), stride_(stride), length_(length) {}
+
+        inline TensorRow<DType> operator*() const { return TensorRow<DType>(data_, length_); }
+        inline TensorRowIterator& operator++() { data_ += stride_; return *this; }
+        inline bool operator==(const TensorRowIterator& other) const { return data_ == other.data_; }
+        inline bool operator!=(const TensorRowIterator& other) const { return data_ != other.data_; }
+
+    private:
+        DType* data_;
+        size_t stride_;
+        int length_;
     };
 
+    template<typename DType>
+    class TensorRowRange {
+    public:
+        TensorRowRange(DType* data, size_t stride, int num_rows, int length) : data_(data), stride_(stride), num_rows_(num_rows), length_(length) {}
+
+        inline TensorRowIterator<DType> begin() const { return TensorRowIterator<DType>(data_, stride_, length_); }
+        inline TensorRowIterator<DType> end()   const { return TensorRowIterator<DType>(data_ + num_rows_ * stride_, stride_, length_); }
+        inline int size() const { return num_rows_; }
+        inline TensorRow<DType> operator[](int i) const { return TensorRow<DType>(data_ + i * stride_, length_); }
+
+    private:
+        DType* data_;
+        size_t stride_;
+        int num_rows_;
+        int length_;
+    };
+
+    /* 固定维数的类型化访问器，由Tensor::accessor<DType, NDims>()创建，创建时取一次host指针和strides（单位元素）
+       下标在编译期展开成乘加，不检查数据头、不做越界检查，适合解析、预处理中的逐元素循环
+       只在创建它的tensor不resize、不切换到device上写入、不convert_to期间有效，之后需要重新创建
+    */
+    template<typename DType, int NDims>
+    class TensorAccessor {
+        static_assert(NDims > 0, "TensorAccessor needs at least one dimension");
+    public:
+        TensorAccessor(DType* data, const int* shape, const size_t* strides) : data_(data) {
+            for(int i = 0; i < NDims; ++i){
+                shape_[i]   = shape[i];
+                strides_[i] = strides[i];
+            }
+        }
+
+        inline DType* data() const { return data_; }
+        inline int size(int index) const { return shape_[index]; }
+        inline size_t stride(int index) const { return strides_[index]; }
+
+        template<typename ... _Args>
+        inline DType& operator()(_Args ... index) const {
+            static_assert(sizeof...(_Args) == NDims, "TensorAccessor needs exactly NDims indices");
+            return data_[offset<0>(index...)];
+        }
+
+        // 前面若干维的下标确定的子块的首地址，同Tensor::cpu<DType>(i, ...)
+        template<typename ... _Args>
+        inline DType* ptr(_Args ... index) const {
+            static_assert(sizeof...(_Args) <= NDims, "Too many indices");
+            return data_ + offset<0>(index...);
+        }
+
+        // 前NDims - 1维的下标确定的一行
+        template<typename ... _Args>
+        inline TensorRow<DType> row(_Args ... index) const {
+            static_assert(sizeof...(_Args) == NDims - 1, "TensorAccessor::row needs NDims - 1 indices");
+            return TensorRow<DType>(ptr(index...), shape_[NDims - 1]);
+        }
+
+        // 前NDims - 2维的下标确定的所有行，例如accessor<float, 3>().rows(ibatch)遍历第ibatch张图的每个框
+        template<typename ... _Args>
+        inline TensorRowRange<DType> rows(_Args ... index) const {
+            static_assert(NDims >= 2 && sizeof...(_Args) == NDims - 2, "TensorAccessor::rows needs NDims - 2 indices");
+            return TensorRowRange<DType>(ptr(index...), strides_[NDims >= 2 ? NDims - 2 : 0], shape_[NDims >= 2 ? NDims - 2 : 0], shape_[NDims - 1]);
+        }
+
+    private:
+        template<int Axis>
+        inline size_t offset() const { return 0; }
+
+        template<int Axis, typename ... _Args>
+        inline size_t offset(int index, _Args ... index_args) const {
+            return (size_t)index * strides_[Axis] + offset<Axis + 1>(index_args...);
+        }
+
+    private:
+        DType* data_;
+        int shape_[NDims];
+        size_t strides_[NDims];
+    };
+
+    class TensorView;
+
     class Tensor {
     public:
         Tensor(const Tensor& other) = delete;
@@ -132,6 +327,19 @@ namespace TRT {
         Tensor& to_gpu(bool copy=true);
         Tensor& to_cpu(bool copy=true);
 
+        /* 切换数据头并提交拷贝，不等待完成，需要拷贝时在stream上记录一个事件，通过返回的句柄查询或者等待
+           数据头立即变为Host/Device。下载未完成时，cpu()/to_cpu()等访问host数据的接口会先等待它完成
+           上传未完成前不能修改host数据。不需要拷贝时（数据头已经是目标或者另一侧没有数据）返回空的句柄
+           多个tensor一起下载用TRT::to_cpu_async(tensors)，每个stream只同步一次
+        */
+        TransferHandle to_cpu_async();
+        TransferHandle to_gpu_async();
+        inline bool transfer_pending() const { return pending_ != nullptr; }
+
+        /* 在host上把数据转换为dtype，shape不变，转换后数据头为Host
+           已有的host内存放得下时原地转换；放不下时从pool申请新的host内存直接转换过去再交换，不经过临时缓冲区和拷贝
+        */
+        Tensor& convert_to(DataType dtype);
         Tensor& to_half();
         Tensor& to_float();
         inline void* cpu() const { ((Tensor*)this)->to_cpu(); return data_->cpu(); }
@@ -153,6 +361,21 @@ namespace TRT {
 
         template<typename DType, typename ... _Args> 
         inline DType& at(int i, _Args&& ... args) { return *(cpu<DType>() + offset(i, args...)); }
+
+        // 固定维数的访问器，先同步到host并取一次指针，ndims或者元素大小不匹配时Assert，见TensorAccessor
+        template<typename DType, int NDims>
+        TensorAccessor<DType, NDims> accessor(){
+            size_t strides[NDims];
+            check_accessor(NDims, sizeof(DType), strides);
+            return TensorAccessor<DType, NDims>(cpu<DType>(), shape_.data(), strides);
+        }
+
+        template<typename DType, int NDims>
+        TensorAccessor<const DType, NDims> accessor() const{
+            size_t strides[NDims];
+            check_accessor(NDims, sizeof(DType), strides);
+            return TensorAccessor<const DType, NDims>(cpu<DType>(), shape_.data(), strides);
+        }
         
         std::shared_ptr<MixMemory> get_data()             const {return data_;}
         std::shared_ptr<MixMemory> get_workspace()        const {return workspace_;}
@@ -160,10 +383,23 @@ namespace TRT {
 
         bool is_stream_owner() const {return stream_owner_;}
         CUStream get_stream() const{return stream_;}
-        Tensor& set_stream(CUStream stream, bool owner=false){stream_ = stream; stream_owner_ = owner; return *this;}
+        Tensor& set_stream(CUStream stream, bool owner=false){stream_ = stream; stream_owner_ = owner; data_->set_stream(stream); return *this;}
 
         Tensor& set_mat     (int n, const cv::Mat& image);
         Tensor& set_norm_mat(int n, const cv::Mat& image, float mean[3], float std[3]);
+
+        Tensor& set_memory_init(MemoryInit init){data_->set_init(init); return *this;}
+        MemoryInit memory_init() const{return data_->init();}
+
+        /* 把第0维的[ibatch_begin, ibatch_end)个槽位的每个字节填充为value，在当前数据头(host/device)上执行
+           tensor记录每个槽位最近一次填充的值，已经等于value且之后没有被写过的槽位会跳过
+           用于padding的batch只清理未使用的槽位：fill_batch(num_valid, tensor.batch())
+           set_mat、set_norm_mat、copy_from_cpu/gpu、set_to会自动标记写入的槽位；通过cpu()/gpu()指针直接写入时需要调用mark_dirty
+        */
+        Tensor& fill_batch(int ibatch_begin, int ibatch_end, unsigned char value = 0);
+        Tensor& mark_dirty(int ibatch_begin, int ibatch_end);
+        Tensor& mark_dirty();
+        bool is_dirty(int ibatch) const;
         cv::Mat at_mat(int n = 0, int c = 0) { return cv::Mat(height(), width(), CV_32F, cpu<float>(n, c)); }
 
         Tensor& synchronize();
@@ -194,19 +430,35 @@ namespace TRT {
                 np_dtype = np.float32
             elif dtype == 1:
                 np_dtype = np.float16
+            elif dtype == 2:
+                np_dtype = np.int32
+            elif dtype == 3:
+                np_dtype = np.uint8
             else:
                 assert False, f"Unsupport dtype = {dtype}, can not convert to numpy dtype"
                 
             return np.frombuffer(binary_data, np_dtype, offset=(ndims + 3) * 4).reshape(*dims)
 
          **/
+        // 多个tensor的归档、mmap读取见tensor_archive.hpp，load_from_file也可以读取归档中的第一个tensor
         bool save_to_file(const std::string& file) const;
         bool load_from_file(const std::string& file);
 
     private:
+        friend class TensorView;
+        friend TransferHandle to_cpu_async(const std::vector<std::shared_ptr<Tensor>>& tensors);
+
+        /* 数据头状态机：切换到head，copy为true且另一侧有完整的数据时在stream上提交拷贝，返回是否提交了拷贝
+           不等待拷贝完成，由调用者同步stream或者记录事件
+        */
+        bool switch_head(DataHead head, bool copy);
+        void wait_pending();
         Tensor& compute_shape_string();
         Tensor& adajust_memory_by_update_dims_or_type();
         void setup_data(std::shared_ptr<MixMemory> data);
+        void mark_dirty_bytes(size_t offset, size_t size);
+        size_t batch_slot_bytes() const;
+        void check_accessor(int ndims, size_t element_size, size_t* element_strides) const;
 
     private:
         std::vector<int> shape_;
@@ -221,6 +473,109 @@ namespace TRT {
         char descriptor_string_[100];
         std::shared_ptr<MixMemory> data_;
         std::shared_ptr<MixMemory> workspace_;
+
+        // 未完成的下载，访问host数据前需要等待
+        std::shared_ptr<TransferFence> pending_;
+
+        // 每个batch槽位最近一次fill_batch的值，-1表示内容未知
+        std::vector<int> batch_fill_values_;
+        size_t batch_slot_bytes_ = 0;
+    };
+
+    /* 把一组tensor异步下载到host：先在各自的stream上提交所有拷贝，再在每个用到的stream上记录一个事件
+       对返回的句柄wait一次，代替逐个to_cpu时每个tensor都同步一次stream，例如parser读取多个输出之前
+    */
+    TransferHandle to_cpu_async(const std::vector<std::shared_ptr<Tensor>>& tensors);
+
+    /* Tensor的非拥有视图：共享parent的MixMemory，只记录相对parent数据的字节偏移、自己的shape和strides（单位字节，同Tensor::strides）
+       生命周期：视图持有parent的shared_ptr，parent和它的内存至少活到最后一个引用它的视图析构，把视图交给下游不需要额外保留parent
+       数据头由parent管理，cpu()/gpu()先让parent同步到对应设备再加上偏移，通过视图写入后需要调用mark_dirty
+       parent之后resize变小、改变类型或者release会使视图失效，cpu()/gpu()时Assert检查；parent扩容后原来取得的指针也失效，需要重新获取
+       slice和reshape都不拷贝数据，reshape要求视图是连续的；需要独立的数据时用clone
+    */
+    class TensorView {
+    public:
+        TensorView() = default;
+
+        // 整个tensor的视图
+        explicit TensorView(std::shared_ptr<Tensor> parent);
+
+        // 第axis维取[begin, end)，其他维不变，越界时返回空视图
+        TensorView slice(int axis, int begin, int end) const;
+
+        // 第0维的第ibatch个槽位，保留第0维（大小为1），等价于slice(0, ibatch, ibatch + 1)
+        TensorView batch_slot(int ibatch) const { return slice(0, ibatch, ibatch + 1); }
+
+        // numel不变时改变shape，最多一个维度为-1（由其他维度推算），不连续的视图或numel不同时返回空视图
+        TensorView reshape(const std::vector<int>& dims) const;
+
+        template<typename ... _Args>
+        TensorView reshape(int dim_size, _Args ... dim_size_args) const{
+            return reshape(std::vector<int>{dim_size, dim_size_args...});
+        }
+
+        inline bool empty() const { return parent_ == nullptr; }
+        inline const std::shared_ptr<Tensor>& parent() const { return parent_; }
+        inline size_t byte_offset() const { return byte_offset_; }
+        inline int ndims() const { return shape_.size(); }
+        inline int size(int index)  const { return shape_[index]; }
+        inline int shape(int index) const { return shape_[index]; }
+        inline const std::vector<int>& dims() const { return shape_; }
+        inline const std::vector<size_t>& strides() const { return strides_; }
+        inline DataType type() const { return dtype_; }
+        inline int element_size() const { return data_type_size(dtype_); }
+        inline size_t bytes() const { return (size_t)numel() * element_size(); }
+        int numel() const;
+        bool is_contiguous() const;
+
+        // 相对cpu<DType>()/gpu<DType>()的元素偏移，按strides计算，不连续的视图也适用
+        template<typename ... _Args>
+        int offset(int index, _Args ... index_args) const{
+            const int index_array[] = {index, index_args...};
+            return offset_array(sizeof...(index_args) + 1, index_array);
+        }
+        int offset_array(size_t size, const int* index_array) const;
+
+        void* cpu() const;
+        void* gpu() const;
+
+        template<typename DType> inline DType* cpu() const { return (DType*)cpu(); }
+        template<typename DType> inline DType* gpu() const { return (DType*)gpu(); }
+
+        template<typename DType, typename ... _Args>
+        inline DType* cpu(int i, _Args&& ... args) const { return cpu<DType>() + offset(i, args...); }
+
+        template<typename DType, typename ... _Args>
+        inline DType* gpu(int i, _Args&& ... args) const { return gpu<DType>() + offset(i, args...); }
+
+        template<typename DType, typename ... _Args>
+        inline DType& at(int i, _Args&& ... args) const { return *(cpu<DType>() + offset(i, args...)); }
+
+        template<typename DType, int NDims>
+        TensorAccessor<DType, NDims> accessor() const{
+            size_t strides[NDims];
+            check_accessor(NDims, sizeof(DType), strides);
+            return TensorAccessor<DType, NDims>(cpu<DType>(), shape_.data(), strides);
+        }
+
+        // 把视图覆盖的parent槽位标记为已写入，见Tensor::fill_batch
+        const TensorView& mark_dirty() const;
+
+        // 拷贝为一个连续的、拥有自己内存的tensor
+        std::shared_ptr<Tensor> clone() const;
+
+    private:
+        // 视图覆盖的字节范围[byte_offset_, byte_offset_ + span_bytes())
+        size_t span_bytes() const;
+        void check_valid() const;
+        void check_accessor(int ndims, size_t element_size, size_t* element_strides) const;
+
+    private:
+        std::shared_ptr<Tensor> parent_;
+        size_t byte_offset_ = 0;
+        DataType dtype_ = DataType::Float;
+        std::vector<int> shape_;
+        std::vector<size_t> strides_;
     };
 };
 
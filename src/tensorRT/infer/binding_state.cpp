@@ -0,0 +1,71 @@
+
+#include "binding_state.hpp"
+#include "graph_cache.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace TRT {
+
+	void BindingState::reset(int num_profiles, int num_bindings_per_profile){
+		input_shapes_.clear();
+		output_shapes_.clear();
+		graph_key_.clear();
+		num_bindings_per_profile_ = num_bindings_per_profile;
+		bindings_.assign(num_profiles * num_bindings_per_profile, nullptr);
+		active_profile_ = 0;
+	}
+
+	void BindingState::switch_profile(int profile){
+		if(profile == active_profile_)
+			return;
+
+		std::fill(bindings_.begin(), bindings_.end(), nullptr);
+		active_profile_ = profile;
+		graph_key_.clear();
+		statistics_.num_profile_switches++;
+	}
+
+	void BindingState::bind(const vector<vector<int>>& input_shapes, const vector<vector<int>>& output_shapes){
+		input_shapes_  = input_shapes;
+		output_shapes_ = output_shapes;
+		graph_key_.clear();
+		statistics_.num_dims_updates++;
+	}
+
+	void BindingState::unbind(){
+		input_shapes_.clear();
+		graph_key_.clear();
+	}
+
+	void BindingState::output_resized(){
+		graph_key_.clear();
+		statistics_.num_output_resizes++;
+	}
+
+	bool BindingState::update_pointers(const vector<void*>& ptrs){
+
+		bool changed = false;
+		for(int i = 0; i < ptrs.size(); ++i){
+			void*& ptr = bindings_[binding_index(i)];
+			if(ptr != ptrs[i]){
+				ptr = ptrs[i];
+				changed = true;
+			}
+		}
+
+		if(changed)
+			statistics_.num_pointer_updates++;
+		return changed;
+	}
+
+	const vector<int>& BindingState::graph_key(const vector<vector<int>>& binding_shapes){
+
+		if(graph_key_.empty()){
+			graph_key_ = GraphCache::make_key(binding_shapes);
+			graph_key_.push_back(active_profile_);
+		}
+		return graph_key_;
+	}
+
+};	// TRT
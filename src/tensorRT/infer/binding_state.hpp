@@ -0,0 +1,72 @@
+#ifndef BINDING_STATE_HPP
+#define BINDING_STATE_HPP
+
+#include <vector>
+#include <stdint.h>
+
+namespace TRT {
+
+	// forward中更新TensorRT绑定状态的次数，输入形状、输出形状、tensor地址与上一次相同时都会跳过
+	struct BindingStatistics {
+		uint64_t num_forwards         = 0;
+		uint64_t num_dims_updates     = 0;   // 输入形状变化，对输入调用setBindingDimensions
+		uint64_t num_output_resizes   = 0;   // 输出形状与TensorRT推导的不一致，resize输出
+		uint64_t num_pointer_updates  = 0;   // 至少一个binding的gpu地址变化（set_input/set_output、重新申请内存）
+		uint64_t num_profile_switches = 0;   // 输入形状对应的最佳优化配置变化，切换IExecutionContext的配置
+	};
+
+	/* InferImpl中与TensorRT无关的绑定记录：已设置的输入输出形状、当前优化配置、binding地址、CUDA Graph的key
+	   forward和forward_async共用一份，任何一方改变了绑定形状或配置，graph key都会失效，下次graph_key()时重建
+	   TensorRT的调用（setOptimizationProfileAsync、setBindingDimensions）由InferImpl完成，成功后再记录到这里
+	*/
+	class BindingState {
+	public:
+		// 重新建立输入输出的映射后调用，binding按配置分组，第k个配置的binding下标为k * num_bindings_per_profile + i
+		void reset(int num_profiles, int num_bindings_per_profile);
+
+		// 输入形状与已设置的不同，需要重新setBindingDimensions
+		bool need_bind(const std::vector<std::vector<int>>& input_shapes) const{return input_shapes != input_shapes_;}
+
+		// 切换到另一个优化配置，原配置的binding地址不会再被读取，全部清空
+		void switch_profile(int profile);
+
+		// setBindingDimensions成功后记录输入形状和TensorRT推导的输出形状
+		void bind(const std::vector<std::vector<int>>& input_shapes, const std::vector<std::vector<int>>& output_shapes);
+
+		// setBindingDimensions失败，下次一定重新设置
+		void unbind();
+
+		// forward中的输出tensor按output_shapes() resize了
+		void output_resized();
+
+		// 用当前配置的binding地址更新，ptrs[i]对应配置内第i个binding，返回是否有地址变化
+		bool update_pointers(const std::vector<void*>& ptrs);
+
+		// set_input/set_output替换了tensor
+		void invalidate_graph_key(){graph_key_.clear();}
+
+		// 由所有binding的形状和当前优化配置组成，只在失效后重建
+		const std::vector<int>& graph_key(const std::vector<std::vector<int>>& binding_shapes);
+
+		void count_forward(){statistics_.num_forwards++;}
+
+		int  active_profile() const{return active_profile_;}
+		int  binding_index(int ordered_index) const{return active_profile_ * num_bindings_per_profile_ + ordered_index;}
+		const std::vector<std::vector<int>>& input_shapes()  const{return input_shapes_;}
+		const std::vector<std::vector<int>>& output_shapes() const{return output_shapes_;}
+		std::vector<void*>& bindings(){return bindings_;}
+		const BindingStatistics& statistics() const{return statistics_;}
+
+	private:
+		std::vector<std::vector<int>> input_shapes_;    // 已经通过setBindingDimensions设置的输入形状
+		std::vector<std::vector<int>> output_shapes_;   // 对应的由TensorRT推导的输出形状
+		std::vector<void*> bindings_;                   // 所有配置的binding，只有active_profile_的一组被使用
+		std::vector<int> graph_key_;                    // 为空表示失效
+		int num_bindings_per_profile_ = 0;
+		int active_profile_ = 0;                        // 新建的IExecutionContext默认使用配置0
+		BindingStatistics statistics_;
+	};
+
+};	// TRT
+
+#endif // BINDING_STATE_HPP
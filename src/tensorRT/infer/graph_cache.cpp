@@ -0,0 +1,171 @@
+
+#include "graph_cache.hpp"
+#include <cuda_runtime.h>
+#include <math.h>
+#include <common/cuda_tools.hpp>
+#include <common/ilogger.hpp>
+
+using namespace std;
+
+namespace TRT {
+
+	class CUDAGraphBackend : public GraphBackend {
+	public:
+		virtual GraphExec capture(void* stream, const function<bool()>& enqueue) override{
+
+			cudaStream_t cuda_stream = (cudaStream_t)stream;
+			if(!checkCudaRuntime(cudaStreamBeginCapture(cuda_stream, cudaStreamCaptureModeThreadLocal)))
+				return nullptr;
+
+			bool ok = enqueue();
+			cudaGraph_t graph = nullptr;
+
+			// 无论enqueue是否成功都要结束捕获，否则stream一直处于捕获状态
+			if(!checkCudaRuntime(cudaStreamEndCapture(cuda_stream, &graph)) || !ok || graph == nullptr){
+				if(graph) cudaGraphDestroy(graph);
+				return nullptr;
+			}
+
+			cudaGraphExec_t exec = nullptr;
+			ok = checkCudaRuntime(cudaGraphInstantiate(&exec, graph, nullptr, nullptr, 0));
+			checkCudaRuntime(cudaGraphDestroy(graph));
+			return ok ? exec : nullptr;
+		}
+
+		virtual bool launch(GraphExec graph, void* stream) override{
+			return checkCudaRuntime(cudaGraphLaunch((cudaGraphExec_t)graph, (cudaStream_t)stream));
+		}
+
+		virtual void destroy(GraphExec graph) override{
+			if(graph) checkCudaRuntime(cudaGraphExecDestroy((cudaGraphExec_t)graph));
+		}
+	};
+
+	shared_ptr<GraphBackend> cuda_graph_backend(){
+		return make_shared<CUDAGraphBackend>();
+	}
+
+	void LatencyHistogram::add(double us){
+
+		int index = 0;
+		if(us >= 1)
+			index = (int)log2(us);
+
+		if(buckets.size() <= index)
+			buckets.resize(index + 1, 0);
+
+		buckets[index]++;
+		count++;
+		total_us += us;
+	}
+
+	double LatencyHistogram::percentile(float p) const{
+
+		if(count == 0)
+			return 0;
+
+		uint64_t target = (uint64_t)ceil(count * p);
+		uint64_t accumulate = 0;
+		for(int i = 0; i < buckets.size(); ++i){
+			accumulate += buckets[i];
+			if(accumulate >= target)
+				return (double)(1ull << (i + 1));
+		}
+		return (double)(1ull << buckets.size());
+	}
+
+	GraphCache::GraphCache(shared_ptr<GraphBackend> backend, int max_graphs){
+		Assert(backend != nullptr && max_graphs > 0);
+		backend_    = backend;
+		max_graphs_ = max_graphs;
+	}
+
+	GraphCache::~GraphCache(){
+		clear();
+	}
+
+	vector<int> GraphCache::make_key(const vector<vector<int>>& binding_shapes){
+
+		vector<int> key;
+		for(auto& shape : binding_shapes){
+			key.push_back(shape.size());
+			key.insert(key.end(), shape.begin(), shape.end());
+		}
+		return key;
+	}
+
+	list<GraphCache::Entry>::iterator GraphCache::find(const vector<int>& key){
+		for(auto iter = entries_.begin(); iter != entries_.end(); ++iter){
+			if(iter->key == key)
+				return iter;
+		}
+		return entries_.end();
+	}
+
+	bool GraphCache::contains(const vector<int>& key) const{
+		for(auto& entry : entries_){
+			if(entry.key == key)
+				return true;
+		}
+		return false;
+	}
+
+	bool GraphCache::run(const vector<int>& key, const vector<void*>& bindings, void* stream, const function<bool()>& enqueue){
+
+		auto begin = iLogger::timestamp_now_float();
+		auto iter  = find(key);
+		if(iter != entries_.end()){
+			if(iter->bindings == bindings){
+				entries_.splice(entries_.begin(), entries_, iter);
+
+				// 捕获失败过的key直接enqueue，不再重复尝试
+				if(iter->graph == nullptr)
+					return enqueue();
+
+				bool ok = backend_->launch(iter->graph, stream);
+				statistics_.num_replays++;
+				statistics_.replay_latency.add((iLogger::timestamp_now_float() - begin) * 1000);
+				return ok;
+			}
+
+			// graph中记录的是旧的binding地址，不能再重放
+			backend_->destroy(iter->graph);
+			entries_.erase(iter);
+			statistics_.num_invalidations++;
+		}
+
+		// 第一次执行正常enqueue，TensorRT会在这里完成形状相关的准备，之后再捕获
+		if(!enqueue())
+			return false;
+
+		GraphExec graph = backend_->capture(stream, enqueue);
+		if(graph == nullptr){
+			INFOW("Capture cuda graph failed, fallback to enqueue.");
+			statistics_.num_failures++;
+		}
+
+		if(entries_.size() >= max_graphs_){
+			backend_->destroy(entries_.back().graph);
+			entries_.pop_back();
+			statistics_.num_evictions++;
+		}
+
+		Entry entry;
+		entry.key      = key;
+		entry.bindings = bindings;
+		entry.graph    = graph;
+		entries_.push_front(entry);
+		if(graph){
+			statistics_.num_captures++;
+			statistics_.capture_latency.add((iLogger::timestamp_now_float() - begin) * 1000);
+		}
+		return true;
+	}
+
+	void GraphCache::clear(){
+		for(auto& entry : entries_)
+			backend_->destroy(entry.graph);
+		entries_.clear();
+	}
+
+};	// TRT
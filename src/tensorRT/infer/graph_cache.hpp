@@ -0,0 +1,93 @@
+#ifndef GRAPH_CACHE_HPP
+#define GRAPH_CACHE_HPP
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <functional>
+#include <stdint.h>
+
+namespace TRT {
+
+	typedef void* GraphExec;
+
+	// 捕获、重放CUDA Graph的抽象，InferImpl使用cuda_graph_backend()，单测可以换成CPU上的实现
+	class GraphBackend {
+	public:
+		virtual ~GraphBackend() = default;
+
+		// 在stream上捕获enqueue提交的任务并实例化，只记录不执行，失败返回nullptr
+		virtual GraphExec capture(void* stream, const std::function<bool()>& enqueue) = 0;
+		virtual bool launch(GraphExec graph, void* stream) = 0;
+		virtual void destroy(GraphExec graph) = 0;    // graph可能为nullptr
+	};
+
+	std::shared_ptr<GraphBackend> cuda_graph_backend();
+
+	/* 延迟直方图，下标i统计[2^i, 2^(i+1))微秒，下标0包括小于1微秒
+	   记录的是host侧提交的耗时，capture包括第一次正常enqueue + 捕获 + 实例化，replay为一次graph launch
+	*/
+	struct LatencyHistogram{
+		std::vector<uint64_t> buckets;
+		uint64_t count   = 0;
+		double   total_us = 0;
+
+		void add(double us);
+		double mean() const{return count == 0 ? 0 : total_us / count;}
+
+		// 返回百分位所在桶的上界，单位微秒
+		double percentile(float p) const;
+	};
+
+	struct GraphStatistics{
+		uint64_t num_captures      = 0;
+		uint64_t num_replays       = 0;
+		uint64_t num_invalidations = 0;   // 同一个key的绑定指针变化，旧graph被丢弃
+		uint64_t num_evictions     = 0;   // 超过max_graphs时丢弃最久未使用的graph
+		uint64_t num_failures      = 0;   // 捕获失败，该key之后一直使用普通enqueue
+		LatencyHistogram capture_latency;
+		LatencyHistogram replay_latency;
+	};
+
+	/* 按key缓存CUDA Graph，key由所有binding的形状组成（make_key），其中已经包含batch size
+	   graph中固化了binding的地址，因此同一个key的绑定指针发生变化时需要重新捕获
+	   最多缓存max_graphs个，超过后按LRU淘汰；非线程安全，每个Infer一个
+	*/
+	class GraphCache {
+	public:
+		GraphCache(std::shared_ptr<GraphBackend> backend, int max_graphs = 8);
+		virtual ~GraphCache();
+
+		static std::vector<int> make_key(const std::vector<std::vector<int>>& binding_shapes);
+
+		/* 命中且绑定指针相同时重放graph，否则先正常执行一次enqueue再捕获，下次调用开始重放
+		   return：本次提交是否成功
+		*/
+		bool run(const std::vector<int>& key, const std::vector<void*>& bindings, void* stream, const std::function<bool()>& enqueue);
+
+		bool contains(const std::vector<int>& key) const;
+		int  size() const{return static_cast<int>(entries_.size());}
+		void clear();
+
+		const GraphStatistics& statistics() const{return statistics_;}
+		void reset_statistics(){statistics_ = GraphStatistics();}
+
+	private:
+		struct Entry{
+			std::vector<int> key;
+			std::vector<void*> bindings;
+			GraphExec graph = nullptr;
+		};
+
+		std::list<Entry>::iterator find(const std::vector<int>& key);
+
+	private:
+		std::shared_ptr<GraphBackend> backend_;
+		int max_graphs_ = 0;
+		std::list<Entry> entries_;     // 前面的是最近使用的
+		GraphStatistics statistics_;
+	};
+
+};	// TRT
+
+#endif // GRAPH_CACHE_HPP
@@ -0,0 +1,55 @@
+
+#include "optimization_profile.hpp"
+#include <math.h>
+
+using namespace std;
+
+namespace TRT {
+
+	static double volume(const vector<int>& shape){
+		double output = 1;
+		for(int v : shape)
+			output *= v;
+		return output;
+	}
+
+	bool ProfileShapes::contains(const vector<vector<int>>& shapes) const{
+
+		if(shapes.size() != min.size() || shapes.size() != max.size())
+			return false;
+
+		for(int i = 0; i < shapes.size(); ++i){
+			auto& shape = shapes[i];
+			if(shape.size() != min[i].size() || shape.size() != max[i].size())
+				return false;
+
+			for(int j = 0; j < shape.size(); ++j){
+				if(shape[j] < min[i][j] || shape[j] > max[i][j])
+					return false;
+			}
+		}
+		return true;
+	}
+
+	int select_optimization_profile(const vector<ProfileShapes>& profiles, const vector<vector<int>>& shapes){
+
+		int best = -1;
+		double best_distance = 0;
+		for(int i = 0; i < profiles.size(); ++i){
+			auto& profile = profiles[i];
+			if(!profile.contains(shapes) || profile.opt.size() != shapes.size())
+				continue;
+
+			double distance = 0;
+			for(int j = 0; j < shapes.size(); ++j)
+				distance += fabs(volume(profile.opt[j]) - volume(shapes[j]));
+
+			if(best == -1 || distance < best_distance){
+				best = i;
+				best_distance = distance;
+			}
+		}
+		return best;
+	}
+
+};	// TRT
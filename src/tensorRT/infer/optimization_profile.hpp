@@ -0,0 +1,23 @@
+#ifndef OPTIMIZATION_PROFILE_HPP
+#define OPTIMIZATION_PROFILE_HPP
+
+#include <vector>
+
+namespace TRT {
+
+	// engine中一个优化配置的输入形状范围，下标与Infer的输入顺序一致，形状包括batch维
+	struct ProfileShapes {
+		std::vector<std::vector<int>> min, opt, max;
+
+		bool contains(const std::vector<std::vector<int>>& shapes) const;
+	};
+
+	/* 为实际的输入形状选择优化配置
+	   在所有能容纳shapes的配置中选择opt与实际形状最接近的一个（各输入元素个数之差的和最小），相同时选下标小的
+	   TensorRT按opt选择tactic，实际形状越接近opt越快；没有能容纳的配置时返回-1
+	*/
+	int select_optimization_profile(const std::vector<ProfileShapes>& profiles, const std::vector<std::vector<int>>& shapes);
+
+};	// TRT
+
+#endif // OPTIMIZATION_PROFILE_HPP
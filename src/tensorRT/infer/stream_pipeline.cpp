@@ -0,0 +1,138 @@
+
+#include "stream_pipeline.hpp"
+#include <cuda_runtime.h>
+#include <common/cuda_tools.hpp>
+#include <common/ilogger.hpp>
+
+using namespace std;
+
+namespace TRT {
+
+	class CUDAStreamBackend : public StreamBackend {
+	public:
+		virtual StageStream create_stream() override{
+			cudaStream_t stream = nullptr;
+			checkCudaRuntime(cudaStreamCreate(&stream));
+			return stream;
+		}
+
+		virtual void destroy_stream(StageStream stream) override{
+			if(stream) checkCudaRuntime(cudaStreamDestroy((cudaStream_t)stream));
+		}
+
+		virtual StageEvent create_event() override{
+			cudaEvent_t event = nullptr;
+			checkCudaRuntime(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+			return event;
+		}
+
+		virtual void destroy_event(StageEvent event) override{
+			if(event) checkCudaRuntime(cudaEventDestroy((cudaEvent_t)event));
+		}
+
+		virtual void record_event(StageEvent event, StageStream stream) override{
+			checkCudaRuntime(cudaEventRecord((cudaEvent_t)event, (cudaStream_t)stream));
+		}
+
+		virtual void stream_wait_event(StageStream stream, StageEvent event) override{
+			checkCudaRuntime(cudaStreamWaitEvent((cudaStream_t)stream, (cudaEvent_t)event, 0));
+		}
+
+		virtual void event_synchronize(StageEvent event) override{
+			checkCudaRuntime(cudaEventSynchronize((cudaEvent_t)event));
+		}
+
+		virtual bool event_query(StageEvent event) override{
+			cudaError_t code = cudaEventQuery((cudaEvent_t)event);
+			if(code == cudaErrorNotReady)
+				return false;
+
+			checkCudaRuntime(code);
+			return true;
+		}
+	};
+
+	shared_ptr<StreamBackend> cuda_stream_backend(){
+		return make_shared<CUDAStreamBackend>();
+	}
+
+	StagePipeline::StagePipeline(shared_ptr<StreamBackend> backend, int num_slots){
+
+		Assert(backend != nullptr && num_slots > 0);
+		backend_   = backend;
+		num_slots_ = num_slots;
+		for(int i = 0; i < NUM_STAGE; ++i)
+			streams_[i] = backend_->create_stream();
+
+		events_.resize(num_slots_ * NUM_STAGE);
+		for(auto& e : events_)
+			e = backend_->create_event();
+	}
+
+	StagePipeline::~StagePipeline(){
+		synchronize();
+		for(auto& e : events_)
+			backend_->destroy_event(e);
+
+		for(int i = 0; i < NUM_STAGE; ++i)
+			backend_->destroy_stream(streams_[i]);
+	}
+
+	long long StagePipeline::submit(const StageFunction& upload, const StageFunction& compute, const StageFunction& download){
+
+		long long sequence = num_submitted_;
+		int islot          = slot(sequence);
+		bool reuse         = sequence >= num_slots_;
+		StageStream upload_stream   = stream(Stage::Upload);
+		StageStream compute_stream  = stream(Stage::Compute);
+		StageStream download_stream = stream(Stage::Download);
+
+		// 先增加计数，使上一轮的结果在被覆盖之前就标记为过期
+		num_submitted_ = sequence + 1;
+
+		// 等待事件时使用的是上一轮的记录，必须在本轮重新记录之前提交等待
+		if(reuse) backend_->stream_wait_event(upload_stream, event(islot, Stage::Compute));
+		if(upload) upload(islot, upload_stream);
+		backend_->record_event(event(islot, Stage::Upload), upload_stream);
+
+		backend_->stream_wait_event(compute_stream, event(islot, Stage::Upload));
+		if(reuse) backend_->stream_wait_event(compute_stream, event(islot, Stage::Download));
+		if(compute) compute(islot, compute_stream);
+		backend_->record_event(event(islot, Stage::Compute), compute_stream);
+
+		backend_->stream_wait_event(download_stream, event(islot, Stage::Compute));
+		if(download) download(islot, download_stream);
+		backend_->record_event(event(islot, Stage::Download), download_stream);
+		return sequence;
+	}
+
+	bool StagePipeline::expired(long long sequence) const{
+		return sequence + num_slots_ < num_submitted_;
+	}
+
+	bool StagePipeline::wait_stage(long long sequence, Stage stage){
+
+		if(sequence < 0 || sequence >= num_submitted_ || expired(sequence))
+			return false;
+
+		backend_->event_synchronize(event(slot(sequence), stage));
+
+		// 等待期间槽位被复用时，等到的是新一轮的事件，结果已经不属于sequence
+		return !expired(sequence);
+	}
+
+	bool StagePipeline::query(long long sequence, Stage stage){
+
+		if(sequence < 0 || sequence >= num_submitted_ || expired(sequence))
+			return false;
+		return backend_->event_query(event(slot(sequence), stage)) && !expired(sequence);
+	}
+
+	void StagePipeline::synchronize(){
+
+		long long count = min<long long>(num_submitted_, num_slots_);
+		for(long long i = 0; i < count; ++i)
+			backend_->event_synchronize(event((int)i, Stage::Download));
+	}
+
+};	// TRT
@@ -0,0 +1,90 @@
+#ifndef STREAM_PIPELINE_HPP
+#define STREAM_PIPELINE_HPP
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
+
+namespace TRT {
+
+	typedef void* StageStream;
+	typedef void* StageEvent;
+
+	/* 流和事件的抽象，语义与CUDA一致：
+	   record_event在stream当前的末尾记录事件；stream_wait_event使stream之后的任务等待事件最近一次的记录完成
+	   InferImpl使用cuda_stream_backend()，单测可以换成CPU上的实现
+	*/
+	class StreamBackend {
+	public:
+		virtual ~StreamBackend() = default;
+		virtual StageStream create_stream() = 0;
+		virtual void destroy_stream(StageStream stream) = 0;
+		virtual StageEvent create_event() = 0;
+		virtual void destroy_event(StageEvent event) = 0;
+		virtual void record_event(StageEvent event, StageStream stream) = 0;
+		virtual void stream_wait_event(StageStream stream, StageEvent event) = 0;
+		virtual void event_synchronize(StageEvent event) = 0;
+		virtual bool event_query(StageEvent event) = 0;
+	};
+
+	std::shared_ptr<StreamBackend> cuda_stream_backend();
+
+	enum class Stage : int {
+		Upload   = 0,
+		Compute  = 1,
+		Download = 2
+	};
+
+	const int NUM_STAGE = 3;
+
+	/* 上传、计算、下载三个阶段各自一个stream，轮流使用num_slots组缓冲区
+	   第k次提交使用槽位k % num_slots，stream之间通过每个槽位每个阶段的事件建立依赖：
+	     upload[k]   等待 compute[k - num_slots]   （输入缓冲区被上一轮读完）
+	     compute[k]  等待 upload[k]、download[k - num_slots]（输出缓冲区被上一轮下载完）
+	     download[k] 等待 compute[k]
+	   因此num_slots = 3时，k + 1上传的同时k在计算、k - 1在下载
+	   第k次的结果在第k + num_slots次提交之后会被覆盖，此时expired(k)为true
+	   submit只能在一个线程中调用，query/wait_stage可以在其他线程调用
+	*/
+	class StagePipeline {
+	public:
+		// 参数分别为槽位号和该阶段的stream，函数中只在stream上异步提交任务
+		typedef std::function<void(int slot, StageStream stream)> StageFunction;
+
+		StagePipeline(std::shared_ptr<StreamBackend> backend, int num_slots = 3);
+		virtual ~StagePipeline();
+
+		// 返回这次提交的序号，从0开始
+		long long submit(const StageFunction& upload, const StageFunction& compute, const StageFunction& download);
+
+		inline int num_slots() const{return num_slots_;}
+		inline int slot(long long sequence) const{return (int)(sequence % num_slots_);}
+		inline int next_slot() const{return slot(num_submitted_);}
+		inline long long num_submitted() const{return num_submitted_;}
+		inline StageStream stream(Stage stage) const{return streams_[(int)stage];}
+		inline std::shared_ptr<StreamBackend> backend() const{return backend_;}
+
+		bool expired(long long sequence) const;
+
+		// 等待sequence的某个阶段完成，sequence已经过期时返回false
+		bool wait_stage(long long sequence, Stage stage = Stage::Download);
+		bool query(long long sequence, Stage stage = Stage::Download);
+
+		// 等待所有已提交的任务完成
+		void synchronize();
+
+	private:
+		StageEvent event(int slot, Stage stage) const{return events_[slot * NUM_STAGE + (int)stage];}
+
+	private:
+		std::shared_ptr<StreamBackend> backend_;
+		int num_slots_ = 0;
+		std::atomic<long long> num_submitted_{0};
+		StageStream streams_[NUM_STAGE];
+		std::vector<StageEvent> events_;
+	};
+
+};	// TRT
+
+#endif // STREAM_PIPELINE_HPP
@@ -1,6 +1,8 @@
 
 
 #include "trt_infer.hpp"
+#include "stream_pipeline.hpp"
+#include "optimization_profile.hpp"
 #include <cuda_runtime.h>
 #include <algorithm>
 #include <NvInfer.h>
@@ -43,6 +45,27 @@ namespace TRT {
 		if (ptr) ptr->destroy();
 	}
 
+	static string join_dims(const vector<int>& dims){
+		string output;
+		for(int i = 0; i < dims.size(); ++i)
+			output += iLogger::format(i == 0 ? "%d" : " x %d", dims[i]);
+		return output;
+	}
+
+	static vector<int> convert_to_vector(const nvinfer1::Dims& dims){
+		if(dims.nbDims < 0)
+			return vector<int>();
+		return vector<int>(dims.d, dims.d + dims.nbDims);
+	}
+
+	static nvinfer1::Dims convert_to_trt_dims(const vector<int>& dims){
+		nvinfer1::Dims output;
+		output.nbDims = dims.size();
+		for(int i = 0; i < dims.size(); ++i)
+			output.d[i] = dims[i];
+		return output;
+	}
+
 	class EngineContext {
 	public:
 		virtual ~EngineContext() { destroy(); }
@@ -79,6 +102,24 @@ namespace TRT {
 			return context_ != nullptr;
 		}
 
+		// 共享other的runtime和engine，创建新的执行上下文和stream
+		bool build_context(const EngineContext& other) {
+			destroy();
+
+			if(other.engine_ == nullptr)
+				return false;
+
+			owner_stream_ = true;
+			checkCudaRuntime(cudaStreamCreate(&stream_));
+			if(stream_ == nullptr)
+				return false;
+
+			runtime_ = other.runtime_;
+			engine_  = other.engine_;
+			context_ = shared_ptr<IExecutionContext>(engine_->createExecutionContext(), destroy_nvidia_pointer<IExecutionContext>);
+			return context_ != nullptr;
+		}
+
 	private:
 		void destroy() {
 			context_.reset();
@@ -99,15 +140,55 @@ namespace TRT {
 		shared_ptr<IRuntime> runtime_ = nullptr;
 	};
 
+	class ForwardHandleImpl : public ForwardHandle {
+	public:
+		ForwardHandleImpl(shared_ptr<StagePipeline> pipeline, long long sequence, const vector<shared_ptr<Tensor>>& outputs)
+			:pipeline_(pipeline), sequence_(sequence), outputs_(outputs){}
+
+		virtual long long sequence() const override{return sequence_;}
+		virtual bool expired() const override{return pipeline_->expired(sequence_);}
+		virtual bool ready() override{return pipeline_->query(sequence_, Stage::Download);}
+		virtual int  num_output() const override{return static_cast<int>(outputs_.size());}
+
+		virtual bool wait() override{
+			if(!pipeline_->wait_stage(sequence_, Stage::Download)){
+				INFOW("ForwardHandle %lld wait failed, the buffers have been reused by a later forward_async.", sequence_);
+				return false;
+			}
+			return true;
+		}
+
+		virtual shared_ptr<Tensor> output(int index) const override{
+			if(index < 0 || index >= outputs_.size()){
+				INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+			}
+			return outputs_[index];
+		}
+
+	private:
+		shared_ptr<StagePipeline> pipeline_;
+		long long sequence_ = 0;
+		vector<shared_ptr<Tensor>> outputs_;
+	};
+
 	class InferImpl : public Infer {
 
 	public:
 		virtual ~InferImpl();
 		virtual bool load(const std::string& file);
 		virtual bool load_from_memory(const void* pdata, size_t size);
+		virtual bool load_from_context(const EngineContext& other, int device);
 		virtual void destroy();
 		virtual void forward(bool sync) override;
+		virtual std::shared_ptr<ForwardHandle> forward_async() override;
+		virtual void set_graph_mode(bool enable, int max_graphs) override;
+		virtual bool graph_mode() const override;
+		virtual GraphStatistics graph_statistics() const override;
+		virtual BindingStatistics binding_statistics() const override;
 		virtual int get_max_batch_size() const override;
+		virtual int get_min_batch_size() const override;
+		virtual int get_num_optimization_profiles() const override;
+		virtual int get_optimization_profile() const override;
 		virtual CUStream get_stream() const override;
 		virtual void set_stream(CUStream stream) override;
 		virtual void synchronize() override;
@@ -123,6 +204,7 @@ namespace TRT {
 		virtual void set_input (int index, std::shared_ptr<Tensor> tensor) override;
 		virtual void set_output(int index, std::shared_ptr<Tensor> tensor) override;
 		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() override;
+		virtual std::shared_ptr<Infer> fork_context() override;
 
 		virtual void print() const override;
 
@@ -132,6 +214,9 @@ namespace TRT {
 
 	private:
 		void build_engine_input_and_outputs_mapper();
+		bool prepare_async_buffers();
+		bool update_binding_dimensions(cudaStream_t stream);
+		int  binding_index(int ordered_index) const{return binding_state_.binding_index(ordered_index);}
 
 	private:
 		std::vector<std::shared_ptr<Tensor>> inputs_;
@@ -143,10 +228,25 @@ namespace TRT {
 		std::vector<std::shared_ptr<Tensor>> orderdBlobs_;
 		std::map<std::string, int> blobsNameMapper_;
 		std::shared_ptr<EngineContext> context_;
-		std::vector<void*> bindingsPtr_;
 		std::shared_ptr<MixMemory> workspace_;
 		int device_ = 0;
 		int max_batch_size_ = 0;
+
+		// forward_async使用，async_blobs_[slot]与orderdBlobs_一一对应
+		std::shared_ptr<StagePipeline> pipeline_;
+		std::vector<std::vector<std::shared_ptr<Tensor>>> async_blobs_;
+
+		// 为nullptr时不使用CUDA Graph
+		std::shared_ptr<GraphCache> graph_cache_;
+
+		/* 多个优化配置时，engine的binding按配置分组，第k个配置的binding下标为k * num_bindings_per_profile_ + i
+		   orderdBlobs_只对应一组，binding_state_中的地址包括所有组，只有当前配置的一组被使用
+		*/
+		std::vector<ProfileShapes> profiles_;
+		int num_bindings_per_profile_ = 0;
+
+		// 上一次forward/forward_async的绑定状态，只在变化时更新TensorRT
+		BindingState binding_state_;
 	};
 
 	////////////////////////////////////////////////////////////////////////////////////
@@ -159,6 +259,9 @@ namespace TRT {
 		int old_device = 0;
 		checkCudaRuntime(cudaGetDevice(&old_device));
 		checkCudaRuntime(cudaSetDevice(device_));
+		this->pipeline_.reset();
+		this->async_blobs_.clear();
+		this->graph_cache_.reset();
 		this->context_.reset();
 		this->blobsNameMapper_.clear();
 		this->outputs_.clear();
@@ -177,6 +280,14 @@ namespace TRT {
 		INFO("Infer %p detail", this);
 		INFO("\tBase device: %s", CUDATools::device_description().c_str());
 		INFO("\tMax Batch Size: %d", this->get_max_batch_size());
+		INFO("\tOptimization Profiles: %d", profiles_.size());
+		for(int k = 0; k < profiles_.size(); ++k){
+			auto& profile = profiles_[k];
+			for(int i = 0; i < profile.min.size(); ++i){
+				INFO("\t\t%d.%s : min {%s}, opt {%s}, max {%s}", k, inputs_name_[i].c_str(),
+					join_dims(profile.min[i]).c_str(), join_dims(profile.opt[i]).c_str(), join_dims(profile.max[i]).c_str());
+			}
+		}
 		INFO("\tInputs: %d", inputs_.size());
 		for(int i = 0; i < inputs_.size(); ++i){
 			auto& tensor = inputs_[i];
@@ -218,6 +329,34 @@ namespace TRT {
 		return true;
 	}
 
+	bool InferImpl::load_from_context(const EngineContext& other, int device) {
+
+		CUDATools::AutoDevice auto_device_exchange(device);
+		context_.reset(new EngineContext());
+		if (!context_->build_context(other)) {
+			context_.reset();
+			return false;
+		}
+
+		workspace_.reset(new MixMemory());
+		device_ = device;
+		build_engine_input_and_outputs_mapper();
+		return true;
+	}
+
+	std::shared_ptr<Infer> InferImpl::fork_context() {
+
+		if (context_ == nullptr) {
+			INFOE("Infer fork_context, engine is not loaded.");
+			return nullptr;
+		}
+
+		std::shared_ptr<InferImpl> Infer(new InferImpl());
+		if (!Infer->load_from_context(*context_, device_))
+			Infer.reset();
+		return Infer;
+	}
+
 	bool InferImpl::load(const std::string& file) {
 
 		auto data = iLogger::load_file(file);
@@ -258,6 +397,7 @@ namespace TRT {
 		
 		EngineContext* context = (EngineContext*)this->context_.get();
 		int nbBindings = context->engine_->getNbBindings();
+		int nbProfiles = std::max(1, context->engine_->getNbOptimizationProfiles());
 		// int max_batchsize = context->engine_->getMaxBatchSize();
 
 		inputs_.clear();
@@ -265,24 +405,69 @@ namespace TRT {
 		outputs_.clear();
 		outputs_name_.clear();
 		orderdBlobs_.clear();
-		bindingsPtr_.clear();
 		blobsNameMapper_.clear();
-		for (int i = 0; i < nbBindings; ++i) {
+		inputs_map_to_ordered_index_.clear();
+		outputs_map_to_ordered_index_.clear();
+		num_bindings_per_profile_ = nbBindings / nbProfiles;
+		binding_state_.reset(nbProfiles, num_bindings_per_profile_);
+
+		// 每个配置中输入的范围，getProfileDimensions无效时（没有动态维度的engine）使用binding的维度
+		profiles_.assign(nbProfiles, ProfileShapes());
+		for (int i = 0; i < num_bindings_per_profile_; ++i) {
+			if (!context->engine_->bindingIsInput(i)) continue;
+
+			auto dims = convert_to_vector(context->engine_->getBindingDimensions(i));
+			for (int k = 0; k < nbProfiles; ++k) {
+				int index = k * num_bindings_per_profile_ + i;
+				auto min = convert_to_vector(context->engine_->getProfileDimensions(index, k, OptProfileSelector::kMIN));
+				auto opt = convert_to_vector(context->engine_->getProfileDimensions(index, k, OptProfileSelector::kOPT));
+				auto max = convert_to_vector(context->engine_->getProfileDimensions(index, k, OptProfileSelector::kMAX));
+				if (min.size() != dims.size() || opt.size() != dims.size() || max.size() != dims.size())
+					min = opt = max = dims;
+
+				profiles_[k].min.push_back(min);
+				profiles_[k].opt.push_back(opt);
+				profiles_[k].max.push_back(max);
+			}
+		}
+
+		// 输入tensor默认按最大batch的配置的max形状创建
+		int default_profile = 0;
+		for (int k = 1; k < nbProfiles; ++k) {
+			if (!profiles_[k].max.empty() && profiles_[k].max[0][0] > profiles_[default_profile].max[0][0])
+				default_profile = k;
+		}
+
+		if (!profiles_[default_profile].max.empty())
+			max_batch_size_ = profiles_[default_profile].max[0][0];
+
+		int input_index = 0;
+		for (int i = 0; i < num_bindings_per_profile_; ++i) {
 
 			auto dims = context->engine_->getBindingDimensions(i);
 			auto type = context->engine_->getBindingDataType(i);
 			const char* bindingName = context->engine_->getBindingName(i);
-			if (dims.d[0] == -1) {
-				FMT_INFOW("When tensorRT_Pro using in TensorRT(8.1 < version < 8.4), get_max_batch_size() MAY be wrong!!! Recommend you to update your TensorRT >= 8.4!");
-				max_batch_size_ = context->engine_->getMaxBatchSize();
-				dims.d[0] = max_batch_size_;
-			} else if (max_batch_size_ == 0) {
-				max_batch_size_ = dims.d[0];
+			bool isInput = context->engine_->bindingIsInput(i);
+
+			if (isInput) {
+				dims = convert_to_trt_dims(profiles_[default_profile].max[input_index++]);
+			} else {
+				// 输出的动态维度在forward设置输入形状后由TensorRT推导，这里先占位
+				if (dims.d[0] == -1)
+					dims.d[0] = max_batch_size_;
+
+				for (int j = 1; j < dims.nbDims; ++j) {
+					if (dims.d[j] == -1) dims.d[j] = 1;
+				}
 			}
+
+			if (max_batch_size_ == 0)
+				max_batch_size_ = dims.d[0];
+
 			auto newTensor = make_shared<Tensor>(dims.nbDims, dims.d, convert_trt_datatype(type));
 			newTensor->set_stream(this->context_->stream_);
 			newTensor->set_workspace(this->workspace_);
-			if (context->engine_->bindingIsInput(i)) {
+			if (isInput) {
 				//if is input
 				inputs_.push_back(newTensor);
 				inputs_name_.push_back(bindingName);
@@ -297,7 +482,6 @@ namespace TRT {
 			blobsNameMapper_[bindingName] = i;
 			orderdBlobs_.push_back(newTensor);
 		}
-		bindingsPtr_.resize(orderdBlobs_.size());
 	}
 
 	void InferImpl::set_stream(CUStream stream){
@@ -329,28 +513,47 @@ namespace TRT {
 
 	void InferImpl::forward(bool sync) {
 
+		// 与forward_async共用IExecutionContext，先等待异步任务结束
+		if(pipeline_)
+			pipeline_->synchronize();
+
 		EngineContext* context = (EngineContext*)context_.get();
-		int inputBatchSize = inputs_[0]->size(0);
-		for(int i = 0; i < context->engine_->getNbBindings(); ++i){
-			auto dims = context->engine_->getBindingDimensions(i);
-			auto type = context->engine_->getBindingDataType(i);
-			dims.d[0] = inputBatchSize;
-			if(context->engine_->bindingIsInput(i)){
-				context->context_->setBindingDimensions(i, dims);
-			}
+		binding_state_.count_forward();
+
+		if (!update_binding_dimensions(context->stream_)) {
+			INFOF("Infer forward, update binding dimensions failed.");
+			return;
 		}
 
+		auto& output_shapes = binding_state_.output_shapes();
 		for (int i = 0; i < outputs_.size(); ++i) {
-			outputs_[i]->resize_single_dim(0, inputBatchSize);
+			if (outputs_[i]->dims() != output_shapes[i]) {
+				outputs_[i]->resize(output_shapes[i]);
+				binding_state_.output_resized();
+			}
 			outputs_[i]->to_gpu(false);
 		}
 
+		// gpu()会把host上的输入上传，每次都需要调用，只统计地址的变化
+		vector<void*> ptrs(orderdBlobs_.size());
 		for (int i = 0; i < orderdBlobs_.size(); ++i)
-			bindingsPtr_[i] = orderdBlobs_[i]->gpu();
+			ptrs[i] = orderdBlobs_[i]->gpu();
+		binding_state_.update_pointers(ptrs);
 
-		void** bindingsptr = bindingsPtr_.data();
+		auto& bindings = binding_state_.bindings();
+		void** bindingsptr = bindings.data();
 		//bool execute_result = context->context_->enqueue(inputBatchSize, bindingsptr, context->stream_, nullptr);
-		bool execute_result = context->context_->enqueueV2(bindingsptr, context->stream_, nullptr);
+		auto enqueue = [&](){return context->context_->enqueueV2(bindingsptr, context->stream_, nullptr);};
+		bool execute_result = false;
+		if(graph_cache_){
+			std::vector<std::vector<int>> shapes(orderdBlobs_.size());
+			for (int i = 0; i < orderdBlobs_.size(); ++i)
+				shapes[i] = orderdBlobs_[i]->dims();
+			execute_result = graph_cache_->run(binding_state_.graph_key(shapes), bindings, context->stream_, enqueue);
+		}else{
+			execute_result = enqueue();
+		}
+
 		if(!execute_result){
 			auto code = cudaGetLastError();
 			INFOF("execute fail, code %d[%s], message %s", code, cudaGetErrorName(code), cudaGetErrorString(code));
@@ -361,6 +564,203 @@ namespace TRT {
 		}
 	}
 
+	bool InferImpl::update_binding_dimensions(cudaStream_t stream) {
+
+		vector<vector<int>> shapes(inputs_.size());
+		for(int i = 0; i < inputs_.size(); ++i)
+			shapes[i] = inputs_[i]->dims();
+
+		if(!binding_state_.need_bind(shapes))
+			return true;
+
+		int profile = select_optimization_profile(profiles_, shapes);
+		if(profile == -1){
+			INFOE("No optimization profile can hold the input shape %s", inputs_.empty() ? "" : inputs_[0]->shape_string());
+			return false;
+		}
+
+		EngineContext* context = (EngineContext*)context_.get();
+		if(profile != binding_state_.active_profile()){
+			if(!context->context_->setOptimizationProfileAsync(profile, stream)){
+				INFOE("Set optimization profile %d failed.", profile);
+				return false;
+			}
+
+			// 原配置的binding不会再被读取，清空后下次forward重新填写当前配置的地址
+			binding_state_.switch_profile(profile);
+		}
+
+		for(int i = 0; i < inputs_.size(); ++i){
+			if(!context->context_->setBindingDimensions(binding_index(inputs_map_to_ordered_index_[i]), convert_to_trt_dims(shapes[i]))){
+				INFOE("Set binding dimensions of input[%d] %s [%s] failed.", i, inputs_name_[i].c_str(), inputs_[i]->shape_string());
+				binding_state_.unbind();
+				return false;
+			}
+		}
+
+		vector<vector<int>> output_shapes(outputs_.size());
+		for(int i = 0; i < outputs_.size(); ++i){
+			output_shapes[i] = convert_to_vector(context->context_->getBindingDimensions(binding_index(outputs_map_to_ordered_index_[i])));
+
+			// 推导失败时保持旧的行为，只修改batch维
+			bool valid = !output_shapes[i].empty();
+			for(int v : output_shapes[i])
+				valid = valid && v >= 0;
+
+			if(!valid){
+				output_shapes[i] = outputs_[i]->dims();
+				output_shapes[i][0] = shapes[0][0];
+			}
+		}
+
+		// 形状或配置变化后graph key失效，forward和forward_async哪一方先调用都一样
+		binding_state_.bind(shapes, output_shapes);
+		return true;
+	}
+
+	int InferImpl::get_num_optimization_profiles() const {
+		return static_cast<int>(profiles_.size());
+	}
+
+	int InferImpl::get_optimization_profile() const {
+		return binding_state_.active_profile();
+	}
+
+	BindingStatistics InferImpl::binding_statistics() const {
+		return binding_state_.statistics();
+	}
+
+	void InferImpl::set_graph_mode(bool enable, int max_graphs) {
+
+		if(!enable){
+			graph_cache_.reset();
+			return;
+		}
+
+		if(graph_cache_ == nullptr)
+			graph_cache_ = make_shared<GraphCache>(cuda_graph_backend(), max_graphs);
+	}
+
+	bool InferImpl::graph_mode() const {
+		return graph_cache_ != nullptr;
+	}
+
+	GraphStatistics InferImpl::graph_statistics() const {
+		if(graph_cache_ == nullptr)
+			return GraphStatistics();
+		return graph_cache_->statistics();
+	}
+
+	bool InferImpl::prepare_async_buffers() {
+
+		if(pipeline_)
+			return true;
+
+		if(context_ == nullptr){
+			INFOE("Infer forward_async, engine is not loaded.");
+			return false;
+		}
+
+		pipeline_ = make_shared<StagePipeline>(cuda_stream_backend(), 3);
+		async_blobs_.resize(pipeline_->num_slots());
+		for(auto& blobs : async_blobs_){
+			blobs.resize(orderdBlobs_.size());
+			for(int i = 0; i < orderdBlobs_.size(); ++i){
+				// 按最大batch申请，之后batch变化时不会重新申请正在被异步任务使用的内存
+				auto newTensor = make_shared<Tensor>(orderdBlobs_[i]->dims(), orderdBlobs_[i]->type());
+				newTensor->set_memory_init(MemoryInit::Uninitialized);
+				newTensor->set_workspace(this->workspace_);
+				newTensor->resize_single_dim(0, max_batch_size_);
+				newTensor->to_gpu(false);
+				blobs[i] = newTensor;
+			}
+
+			for(int index : outputs_map_to_ordered_index_)
+				blobs[index]->to_cpu(false);
+		}
+		return true;
+	}
+
+	std::shared_ptr<ForwardHandle> InferImpl::forward_async() {
+
+		if(!prepare_async_buffers())
+			return nullptr;
+
+		EngineContext* context = (EngineContext*)context_.get();
+		auto& blobs = async_blobs_[pipeline_->next_slot()];
+
+		if(!update_binding_dimensions((cudaStream_t)pipeline_->stream(Stage::Compute)))
+			return nullptr;
+
+		for(int i = 0; i < inputs_.size(); ++i)
+			blobs[inputs_map_to_ordered_index_[i]]->resize(inputs_[i]->dims());
+
+		for(int i = 0; i < outputs_.size(); ++i)
+			blobs[outputs_map_to_ordered_index_[i]]->resize(binding_state_.output_shapes()[i]);
+
+		// 缓冲区按默认形状申请，输入或输出更大时（例如选择了空间尺寸更大的优化配置），等待所有异步任务结束后重新申请
+		bool grow = false;
+		for(auto& blob : blobs)
+			grow = grow || blob->bytes() > blob->get_data()->gpu_size();
+
+		if(grow)
+			pipeline_->synchronize();
+
+		for(int i = 0; i < inputs_.size(); ++i){
+			auto& src = inputs_[i];
+			blobs[inputs_map_to_ordered_index_[i]]->to_gpu(false);
+
+			// device上的输入可能还在自己的stream上写入
+			if(src->head() == DataHead::Device)
+				src->synchronize();
+		}
+
+		vector<shared_ptr<Tensor>> outputs(outputs_.size());
+		for(int i = 0; i < outputs_.size(); ++i){
+			auto& dst = blobs[outputs_map_to_ordered_index_[i]];
+			dst->to_gpu(false);
+			dst->to_cpu(false);
+			outputs[i] = dst;
+		}
+
+		auto upload = [&](int slot, StageStream stream){
+			for(int i = 0; i < inputs_.size(); ++i){
+				auto& src = inputs_[i];
+				auto& dst = blobs[inputs_map_to_ordered_index_[i]];
+				if(src->head() == DataHead::Device){
+					checkCudaRuntime(cudaMemcpyAsync(dst->get_data()->gpu(), src->get_data()->gpu(), src->bytes(), cudaMemcpyDeviceToDevice, (cudaStream_t)stream));
+				}else{
+					checkCudaRuntime(cudaMemcpyAsync(dst->get_data()->gpu(), src->cpu(), src->bytes(), cudaMemcpyHostToDevice, (cudaStream_t)stream));
+				}
+			}
+		};
+
+		auto compute = [&](int slot, StageStream stream){
+			vector<void*> bindings(binding_state_.bindings().size(), nullptr);
+			for(int i = 0; i < blobs.size(); ++i)
+				bindings[binding_index(i)] = blobs[i]->get_data()->gpu();
+
+			bool execute_result = context->context_->enqueueV2(bindings.data(), (cudaStream_t)stream, nullptr);
+			if(!execute_result){
+				auto code = cudaGetLastError();
+				INFOF("execute fail, code %d[%s], message %s", code, cudaGetErrorName(code), cudaGetErrorString(code));
+			}
+		};
+
+		auto download = [&](int slot, StageStream stream){
+			for(auto& output : outputs){
+				auto data = output->get_data();
+				checkCudaRuntime(cudaMemcpyAsync(data->cpu(), data->gpu(), output->bytes(), cudaMemcpyDeviceToHost, (cudaStream_t)stream));
+			}
+		};
+
+		long long sequence = pipeline_->submit(upload, compute, download);
+
+		// 输入上传完之后调用者就可以改写input(i)
+		pipeline_->wait_stage(sequence, Stage::Upload);
+		return make_shared<ForwardHandleImpl>(pipeline_, sequence, outputs);
+	}
+
 	std::shared_ptr<MixMemory> InferImpl::get_workspace() {
 		return workspace_;
 	}
@@ -382,6 +782,7 @@ namespace TRT {
 		this->inputs_[index] = tensor;
 		int order_index = inputs_map_to_ordered_index_[index];
 		this->orderdBlobs_[order_index] = tensor;
+		this->binding_state_.invalidate_graph_key();
 	}
 
 	void InferImpl::set_output(int index, std::shared_ptr<Tensor> tensor){
@@ -393,6 +794,7 @@ namespace TRT {
 		this->outputs_[index] = tensor;
 		int order_index = outputs_map_to_ordered_index_[index];
 		this->orderdBlobs_[order_index] = tensor;
+		this->binding_state_.invalidate_graph_key();
 	}
 
 	std::shared_ptr<Tensor> InferImpl::input(int index) const {
@@ -428,6 +830,16 @@ namespace TRT {
 		return max_batch_size_;
 	}
 
+	int InferImpl::get_min_batch_size() const {
+		Assert(this->context_ != nullptr && max_batch_size_ != 0);
+		int min_batch_size = max_batch_size_;
+		for(auto& profile : profiles_){
+			if(!profile.min.empty() && !profile.min[0].empty())
+				min_batch_size = std::min(min_batch_size, profile.min[0][0]);
+		}
+		return std::max(min_batch_size, 1);
+	}
+
 	std::shared_ptr<Tensor> InferImpl::tensor(const std::string& name) {
 
 		auto node = this->blobsNameMapper_.find(name);
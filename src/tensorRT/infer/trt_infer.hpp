@@ -8,13 +8,54 @@
 #include <vector>
 #include <map>
 #include <common/trt_tensor.hpp>
+#include "graph_cache.hpp"
+#include "binding_state.hpp"
 
 namespace TRT {
 
+	/* forward_async返回的完成句柄
+	   输出在句柄自己的缓冲区中，wait成功后通过output(i)在host上读取，不影响Infer::output(i)
+	   同一个Infer之后再提交3次forward_async时，这组缓冲区会被复用，句柄过期，wait返回false
+	*/
+	class ForwardHandle {
+	public:
+		virtual ~ForwardHandle() = default;
+		virtual long long sequence() const = 0;
+		virtual bool expired() const = 0;
+		virtual bool ready() = 0;
+		virtual bool wait() = 0;
+		virtual int  num_output() const = 0;
+		virtual std::shared_ptr<Tensor> output(int index = 0) const = 0;
+	};
+
 	class Infer {
 	public:
 		virtual void     forward(bool sync = true) = 0;
+
+		/* 异步推理，上传、计算、下载分别在三个stream上执行，轮流使用三组输入输出缓冲区
+		   使第k + 1次的上传、第k次的计算与第k - 1次的下载重叠
+		   input(i)在host或device上准备好后调用，返回时输入已经上传完毕，可以立即准备下一批
+		   forward会先等待所有未完成的异步推理；失败时返回nullptr
+		*/
+		virtual std::shared_ptr<ForwardHandle> forward_async() = 0;
+
+		/* CUDA Graph模式，默认关闭。每种binding形状第一次forward时捕获enqueue，之后重放graph，省去逐个kernel launch的开销
+		   set_input/set_output替换了tensor或者tensor重新申请了内存时，binding地址变化，对应的graph会重新捕获
+		   关闭时释放所有graph，统计在重新开启时清零
+		*/
+		virtual void set_graph_mode(bool enable, int max_graphs = 8) = 0;
+		virtual bool graph_mode() const = 0;
+		virtual GraphStatistics graph_statistics() const = 0;
+		virtual BindingStatistics binding_statistics() const = 0;
 		virtual int      get_max_batch_size() const = 0;
+		// 所有优化配置中最小的batch，没有动态batch的engine等于get_max_batch_size()，更少的输入需要padding到这个batch
+		virtual int      get_min_batch_size() const = 0;
+
+		/* engine中的优化配置个数（compile时的profiles），以及当前使用的配置
+		   每次forward按输入形状选择能容纳它且opt最接近的配置，见optimization_profile.hpp
+		*/
+		virtual int      get_num_optimization_profiles() const = 0;
+		virtual int      get_optimization_profile() const = 0;
 		virtual void     set_stream(CUStream stream) = 0;
 		virtual CUStream get_stream() const = 0;
 		virtual void     synchronize() = 0;
@@ -34,6 +75,10 @@ namespace TRT {
 		virtual void set_input (int index, std::shared_ptr<Tensor> tensor) = 0;
 		virtual void set_output(int index, std::shared_ptr<Tensor> tensor) = 0;
 		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() = 0;
+
+		// 与当前Infer共享同一个engine，但拥有独立的IExecutionContext、stream和输入输出tensor
+		// 用于多个线程在同一个引擎上并发推理，避免重复反序列化engine
+		virtual std::shared_ptr<Infer> fork_context() = 0;
 	};
 
 	struct DeviceMemorySummary {
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "MappedFile.hpp"
 #include "onnx2trt.hpp"
 #include "onnx2trt_utils.hpp"
 #include "onnxErrorRecorder.hpp"
@@ -85,6 +86,7 @@ class ImporterContext final : public IImporterContext
     std::unordered_set<std::string> mUnsupportedShapeTensors; // Container to hold output tensor names of layers that produce shape tensor outputs but do not natively support them.
     StringMap<std::string> mLoopTensors; // Container to map subgraph tensors to their original outer graph names.
     std::string mOnnxFileLocation; // Keep track of the directory of the parsed ONNX file
+    StringMap<std::unique_ptr<MappedFile>> mExternalFiles; // External data files, mapped on first use and kept alive for the weights that point into them.
     std::unique_ptr<ErrorRecorderWrapper> mErrorWrapper; // error recorder to control TRT errors
 
 public:
@@ -136,6 +138,20 @@ public:
     {
         return mOnnxFileLocation;
     }
+    MappedFile const* mapExternalFile(std::string const& path) override
+    {
+        auto it = mExternalFiles.find(path);
+        if (it != mExternalFiles.end())
+        {
+            return it->second.get();
+        }
+        std::unique_ptr<MappedFile> file(new MappedFile(path));
+        if (!file->isOpen())
+        {
+            return nullptr;
+        }
+        return (mExternalFiles[path] = std::move(file)).get();
+    }
     // This actually handles weights as well, but is named this way to be consistent with the tensors()
     void registerTensor(TensorOrWeights tensor, const std::string& basename) override
     {
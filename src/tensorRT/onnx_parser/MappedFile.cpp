@@ -0,0 +1,198 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "MappedFile.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace onnx2trt
+{
+
+MappedFile::MappedFile(std::string const& path)
+    : mPath(path)
+{
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        mSize = static_cast<size_t>(st.st_size);
+        if (mSize == 0)
+        {
+            mOpen = true;
+        }
+        else
+        {
+            void* mapped = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                // Models are parsed front to back, let the kernel read ahead aggressively.
+                ::madvise(mapped, mSize, MADV_SEQUENTIAL);
+                mMapped = mapped;
+                mData = static_cast<uint8_t const*>(mapped);
+                mOpen = true;
+            }
+        }
+    }
+    ::close(fd);
+    if (mOpen)
+    {
+        return;
+    }
+#endif
+
+    // Fallback for platforms or files that cannot be mapped.
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream)
+    {
+        return;
+    }
+    mBuffer.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0, std::ios::beg);
+    if (!stream.read(reinterpret_cast<char*>(mBuffer.data()), mBuffer.size()))
+    {
+        mBuffer.clear();
+        return;
+    }
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+    mOpen = true;
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (mMapped)
+    {
+        ::munmap(mMapped, mSize);
+    }
+#endif
+}
+
+void MappedFile::release(size_t offset, size_t size) const
+{
+#ifndef _WIN32
+    if (!mMapped || offset >= mSize)
+    {
+        return;
+    }
+    size = std::min(size, mSize - offset);
+
+    size_t const pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t const begin = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t const end = offset + size == mSize ? mSize : (offset + size) / pageSize * pageSize;
+    if (end > begin)
+    {
+        ::madvise(static_cast<uint8_t*>(mMapped) + begin, end - begin, MADV_DONTNEED);
+    }
+#endif
+}
+
+MappedInputStream::MappedInputStream(MappedFile const& file, int blockSize)
+    : mFile(file)
+    , mBlockSize(static_cast<size_t>(std::max(blockSize, 1)))
+{
+}
+
+MappedInputStream::~MappedInputStream()
+{
+    mFile.release(mReleased, mFile.size() - mReleased);
+}
+
+bool MappedInputStream::Next(void const** data, int* size)
+{
+    // Protobuf gives up the previous block when it asks for the next one, nothing before mPosition is referenced.
+    if (mPosition - mReleased >= mBlockSize)
+    {
+        mFile.release(mReleased, mPosition - mReleased);
+        mReleased = mPosition;
+    }
+
+    if (mPosition >= mFile.size())
+    {
+        return false;
+    }
+    size_t const blockSize = std::min(mBlockSize, mFile.size() - mPosition);
+    *data = mFile.data() + mPosition;
+    *size = static_cast<int>(blockSize);
+    mPosition += blockSize;
+    return true;
+}
+
+void MappedInputStream::BackUp(int count)
+{
+    mPosition -= std::min(static_cast<size_t>(std::max(count, 0)), mPosition - mReleased);
+}
+
+bool MappedInputStream::Skip(int count)
+{
+    size_t const remaining = mFile.size() - mPosition;
+    if (count < 0 || static_cast<size_t>(count) > remaining)
+    {
+        mPosition = mFile.size();
+        return false;
+    }
+    mPosition += static_cast<size_t>(count);
+    return true;
+}
+
+google::protobuf::int64 MappedInputStream::ByteCount() const
+{
+    return static_cast<google::protobuf::int64>(mPosition);
+}
+
+bool parseFromMappedFile(MappedFile const& file, google::protobuf::Message* message, bool* isText)
+{
+    // Protobuf cannot address more than 2GB in one message.
+    if (!file.isOpen() || file.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+        return false;
+    }
+
+    {
+        MappedInputStream rawInput(file);
+        google::protobuf::io::CodedInputStream codedInput(&rawInput);
+        // Note: This WARs the very low default size limit (64MB)
+        codedInput.SetTotalBytesLimit(std::numeric_limits<int>::max());
+        if (message->ParseFromCodedStream(&codedInput))
+        {
+            if (isText)
+            {
+                *isText = false;
+            }
+            return true;
+        }
+    }
+
+    message->Clear();
+    MappedInputStream rawInput(file);
+    if (google::protobuf::TextFormat::Parse(&rawInput, message))
+    {
+        if (isText)
+        {
+            *isText = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace onnx2trt
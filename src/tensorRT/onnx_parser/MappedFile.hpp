@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! Read-only view of a whole file, backed by mmap where available and by a heap copy otherwise.
+//! Large ONNX models and their external data files are read through this so that the bytes are
+//! never copied into an intermediate buffer.
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool isOpen() const
+    {
+        return mOpen;
+    }
+    bool isMapped() const
+    {
+        return mMapped != nullptr;
+    }
+    uint8_t const* data() const
+    {
+        return mData;
+    }
+    size_t size() const
+    {
+        return mSize;
+    }
+    std::string const& path() const
+    {
+        return mPath;
+    }
+
+    //! Drops the resident pages in [offset, offset + size) once they have been consumed. The range is rounded
+    //! inwards to whole pages and touching it again faults the data back in from the file.
+    void release(size_t offset, size_t size) const;
+
+private:
+    std::string mPath;
+    bool mOpen{false};
+    void* mMapped{nullptr};
+    std::vector<uint8_t> mBuffer;
+    uint8_t const* mData{nullptr};
+    size_t mSize{0};
+};
+
+//! Protobuf input stream over a MappedFile. Blocks handed to protobuf are released behind the parser,
+//! so deserializing a model does not keep the whole file resident next to the parsed message.
+class MappedInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+    static constexpr int kDefaultBlockSize = 16 << 20;
+
+    explicit MappedInputStream(MappedFile const& file, int blockSize = kDefaultBlockSize);
+    ~MappedInputStream() override;
+
+    bool Next(void const** data, int* size) override;
+    void BackUp(int count) override;
+    bool Skip(int count) override;
+    google::protobuf::int64 ByteCount() const override;
+
+private:
+    MappedFile const& mFile;
+    size_t mBlockSize;
+    size_t mPosition{0};
+    size_t mReleased{0};
+};
+
+//! Deserializes a message from a mapped file in a single pass, trying the binary encoding first and the
+//! text encoding second. isText, if given, reports which encoding was found.
+bool parseFromMappedFile(MappedFile const& file, google::protobuf::Message* message, bool* isText = nullptr);
+
+} // namespace onnx2trt
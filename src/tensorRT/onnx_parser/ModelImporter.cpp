@@ -3,6 +3,7 @@
  */
 
 #include "ModelImporter.hpp"
+#include "MappedFile.hpp"
 #include "OnnxAttrs.hpp"
 #include "onnx2trt_utils.hpp"
 #include "onnx_utils.hpp"
@@ -481,14 +482,7 @@ bool ModelImporter::parseWithWeightDescriptors(void const* serialized_onnx_model
         _errors.push_back(status);
         return false;
     }
-    status = this->importModel(model);
-    if (status.is_error())
-    {
-        status.setNode(_current_node);
-        _errors.push_back(status);
-        return false;
-    }
-    return true;
+    return importOwnedModel(model);
 }
 
 bool ModelImporter::parse(void const* serialized_onnx_model, size_t serialized_onnx_model_size, const char* model_path)
@@ -686,25 +680,10 @@ Status ModelImporter::importModel(
     return Status::success();
 }
 
-bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
+// Prints the metadata of a model that has been deserialized, below the line identifying its source.
+static void printModelSummary(IImporterContext* ctx, ::onnx::ModelProto const& onnx_model)
 {
-    GOOGLE_PROTOBUF_VERIFY_VERSION;
-    ::onnx::ModelProto onnx_model;
-    auto* ctx = &_importer_ctx;
-
-    const bool is_binary = ParseFromFile_WAR(&onnx_model, onnxModelFile);
-    if (!is_binary && !ParseFromTextFile(&onnx_model, onnxModelFile))
-    {
-        LOG_ERROR("Failed to parse ONNX model from file: " << onnxModelFile);
-        return false;
-    }
-
-    // Keep track of the absolute path to the ONNX file.
-    _importer_ctx.setOnnxFileLocation(onnxModelFile);
-
     const int64_t opset_version = (onnx_model.opset_import().size() ? onnx_model.opset_import(0).version() : 0);
-    LOG_INFO("----------------------------------------------------------------");
-    LOG_INFO("Input filename:   " << onnxModelFile);
     LOG_INFO("ONNX IR version:  " << onnx_ir_version_string(onnx_model.ir_version()));
     LOG_INFO("Opset version:    " << opset_version);
     LOG_INFO("Producer name:    " << onnx_model.producer_name());
@@ -713,45 +692,86 @@ bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
     LOG_INFO("Model version:    " << onnx_model.model_version());
     LOG_INFO("Doc string:       " << onnx_model.doc_string());
     LOG_INFO("----------------------------------------------------------------");
+}
+
+void ModelImporter::printErrors(::onnx::ModelProto const& onnx_model)
+{
+    auto* ctx = &_importer_ctx;
+    const int32_t nerror = getNbErrors();
+    for (int32_t i = 0; i < nerror; ++i)
+    {
+        nvonnxparser::IParserError const* error = getError(i);
+        if (error->node() != -1 && error->node() < onnx_model.graph().node_size())
+        {
+            ::onnx::NodeProto const& node = onnx_model.graph().node(error->node());
+            LOG_ERROR("While parsing node number " << error->node() << " [" << node.op_type() << " -> \"" << node.output(0) << "\"" << "]:");
+            LOG_ERROR("--- Begin node ---");
+            LOG_ERROR(pretty_print_onnx_to_string(node));
+            LOG_ERROR("--- End node ---");
+        }
+        LOG_ERROR("ERROR: " << error->file() << ":" << error->line() << " In function " << error->func() << ":\n"
+             << "[" << static_cast<int>(error->code()) << "] " << error->desc());
+    }
+}
+
+bool ModelImporter::importOwnedModel(::onnx::ModelProto const& model)
+{
+    Status status = this->importModel(model);
+    if (status.is_error())
+    {
+        status.setNode(_current_node);
+        _errors.push_back(status);
+        return false;
+    }
+    return true;
+}
+
+bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    auto* ctx = &_importer_ctx;
+    _current_node = -1;
 
-    { //...Read input file, parse it
-        std::ifstream onnx_file(onnxModelFile, std::ios::binary | std::ios::ate);
-        const std::streamsize file_size = onnx_file.tellg();
-        onnx_file.seekg(0, std::ios::beg);
-        std::vector<char> onnx_buf(file_size);
-        if (!onnx_file.read(onnx_buf.data(), onnx_buf.size()))
+    // The model is deserialized once, straight from a mapping of the file, into the copy that owns the weights.
+    // The same message serves the summary, the import and the diagnostics.
+    _onnx_models.emplace_back();
+    ::onnx::ModelProto& onnx_model = _onnx_models.back();
+    {
+        MappedFile onnx_file(onnxModelFile);
+        if (!onnx_file.isOpen())
         {
             LOG_ERROR("Failed to read from file: " << onnxModelFile);
+            _onnx_models.pop_back();
             return false;
         }
-        if (!parse(onnx_buf.data(), onnx_buf.size()))
+        if (!parseFromMappedFile(onnx_file, &onnx_model))
         {
-            const int32_t nerror = getNbErrors();
-            for (int32_t i = 0; i < nerror; ++i)
-            {
-                nvonnxparser::IParserError const* error = getError(i);
-                if (error->node() != -1)
-                {
-                    ::onnx::NodeProto const& node = onnx_model.graph().node(error->node());
-                    LOG_ERROR("While parsing node number " << error->node() << " [" << node.op_type() << " -> \"" << node.output(0) << "\"" << "]:");
-                    LOG_ERROR("--- Begin node ---");
-                    LOG_ERROR(pretty_print_onnx_to_string(node));
-                    LOG_ERROR("--- End node ---");
-                }
-                LOG_ERROR("ERROR: " << error->file() << ":" << error->line() << " In function " << error->func() << ":\n"
-                     << "[" << static_cast<int>(error->code()) << "] " << error->desc());
-            }
+            LOG_ERROR("Failed to parse ONNX model from file: " << onnxModelFile);
+            _onnx_models.pop_back();
             return false;
         }
-    } //...End Reading input file, parsing it
+    }
+
+    // Keep track of the absolute path to the ONNX file.
+    _importer_ctx.setOnnxFileLocation(onnxModelFile);
+
+    LOG_INFO("----------------------------------------------------------------");
+    LOG_INFO("Input filename:   " << onnxModelFile);
+    printModelSummary(ctx, onnx_model);
+
+    if (!importOwnedModel(onnx_model))
+    {
+        printErrors(onnx_model);
+        return false;
+    }
     return true;
 }
 
 bool ModelImporter::parseFromData(const void* onnx_data, size_t size, int verbosity)
 {
     GOOGLE_PROTOBUF_VERIFY_VERSION;
-    ::onnx::ModelProto onnx_model;
     auto* ctx = &_importer_ctx;
+    _current_node = -1;
 
     if (onnx_data == nullptr || size < 1)
     {
@@ -759,40 +779,26 @@ bool ModelImporter::parseFromData(const void* onnx_data, size_t size, int verbos
         return false;
     }
 
-    // Keep track of the absolute path to the ONNX file.
-    const int64_t opset_version = (onnx_model.opset_import().size() ? onnx_model.opset_import(0).version() : 0);
-    LOG_INFO("----------------------------------------------------------------");
-    LOG_INFO("Input data size:   " << size);
-    LOG_INFO("ONNX IR version:  " << onnx_ir_version_string(onnx_model.ir_version()));
-    LOG_INFO("Opset version:    " << opset_version);
-    LOG_INFO("Producer name:    " << onnx_model.producer_name());
-    LOG_INFO("Producer version: " << onnx_model.producer_version());
-    LOG_INFO("Domain:           " << onnx_model.domain());
-    LOG_INFO("Model version:    " << onnx_model.model_version());
-    LOG_INFO("Doc string:       " << onnx_model.doc_string());
+    _onnx_models.emplace_back();
+    ::onnx::ModelProto& onnx_model = _onnx_models.back();
+    Status status = deserialize_onnx_model(onnx_data, size, false, &onnx_model);
+    if (status.is_error())
+    {
+        _errors.push_back(status);
+        _onnx_models.pop_back();
+        LOG_ERROR("Failed to parse ONNX model from data, size = " << size);
+        return false;
+    }
+
     LOG_INFO("----------------------------------------------------------------");
+    LOG_INFO("Input data size:  " << size);
+    printModelSummary(ctx, onnx_model);
 
-    { //...Read input file, parse it
-        if (!parse(onnx_data, size))
-        {
-            const int32_t nerror = getNbErrors();
-            for (int32_t i = 0; i < nerror; ++i)
-            {
-                nvonnxparser::IParserError const* error = getError(i);
-                if (error->node() != -1)
-                {
-                    ::onnx::NodeProto const& node = onnx_model.graph().node(error->node());
-                    LOG_ERROR("While parsing node number " << error->node() << " [" << node.op_type() << " -> \"" << node.output(0) << "\"" << "]:");
-                    LOG_ERROR("--- Begin node ---");
-                    LOG_ERROR(pretty_print_onnx_to_string(node));
-                    LOG_ERROR("--- End node ---");
-                }
-                LOG_ERROR("ERROR: " << error->file() << ":" << error->line() << " In function " << error->func() << ":\n"
-                     << "[" << static_cast<int>(error->code()) << "] " << error->desc());
-            }
-            return false;
-        }
-    } //...End Reading input file, parsing it
+    if (!importOwnedModel(onnx_model))
+    {
+        printErrors(onnx_model);
+        return false;
+    }
     return true;
 }
 
@@ -28,6 +28,10 @@ private:
     std::vector<Status> _errors;
     std::vector<nvinfer1::Dims> _input_dims;
 
+    // Imports a model held in _onnx_models, recording the failing node on error.
+    bool importOwnedModel(::onnx::ModelProto const& model);
+    void printErrors(::onnx::ModelProto const& model);
+
 public:
     ModelImporter(nvinfer1::INetworkDefinition* network, nvinfer1::ILogger* logger, const std::vector<nvinfer1::Dims>& input_dims)
         : _op_importers(getBuiltinOpImporterMap())
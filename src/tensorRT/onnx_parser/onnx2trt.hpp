@@ -21,6 +21,7 @@ namespace onnx2trt
 {
 
 class IImporterContext;
+class MappedFile;
 
 // TODO: Find ABI-safe alternative approach for this:
 //         Can't use std::vector
@@ -47,6 +48,7 @@ public:
     virtual StringMap<std::string>& loopTensors() = 0;
     virtual void setOnnxFileLocation(std::string location) = 0;
     virtual std::string getOnnxFileLocation() = 0;
+    virtual MappedFile const* mapExternalFile(std::string const& path) = 0;
     virtual void registerTensor(TensorOrWeights tensor, const std::string& basename) = 0;
     virtual void registerLayer(nvinfer1::ILayer* layer, const std::string& basename) = 0;
     virtual ShapedWeights createTempWeights(ShapedWeights::DataType type, nvinfer1::Dims shape, uint8_t value = 0) = 0;
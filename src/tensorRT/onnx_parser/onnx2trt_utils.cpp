@@ -3,6 +3,7 @@
  */
 
 #include "onnx2trt_utils.hpp"
+#include "MappedFile.hpp"
 #include "OnnxAttrs.hpp"
 #include <set>
 
@@ -655,24 +656,41 @@ bool convertOnnxWeights(
             }
         }
 
-        // Buffer to hold the data read from the file
-        std::vector<char> dataBuf;
-        // Will update dataBuf and nbytes by reference.
-        if (!parseExternalWeights(ctx, location, ctx->getOnnxFileLocation(), offset, length, dataBuf, nbytes))
+        // Pointer into the mapped external file
+        uint8_t const* mappedPtr{nullptr};
+        // Will update mappedPtr and nbytes by reference.
+        if (!parseExternalWeights(ctx, location, ctx->getOnnxFileLocation(), offset, length, mappedPtr, nbytes))
         {
             return false;
         }
         shape.nbDims = onnxTensor.dims().size();
         std::copy(onnxTensor.dims().begin(), onnxTensor.dims().end(), shape.d);
 
-        // For weights parsed from external files, createTempWeights is necessary to keep them in scope
+        // Weights used in place are read straight from the mapping, so the range must cover the whole tensor.
+        const int dtypeSize = getDtypeSize(onnxDtype);
+        if (dtypeSize <= 0 || static_cast<int64_t>(nbytes) != volume(shape) * dtypeSize)
+        {
+            LOG_ERROR("External weights of " << onnxTensor.name() << " have " << nbytes
+                                             << " bytes, which does not match the shape and type of the tensor");
+            return false;
+        }
+
+        // The proxy conversions below read whole elements, so misaligned data is staged in an aligned buffer first.
+        std::vector<uint8_t> alignedBuf;
+        const bool aligned = reinterpret_cast<uintptr_t>(mappedPtr) % dtypeSize == 0;
+        if (!aligned)
+        {
+            alignedBuf.assign(mappedPtr, mappedPtr + nbytes);
+        }
+        const void* dataBuf = aligned ? static_cast<const void*>(mappedPtr) : alignedBuf.data();
+
+        // Converted weights are created with createTempWeights to keep them in scope
         ShapedWeights externalWeights;
 
         // Cast non-native TRT types to their corresponding proxy types
         if (onnxDtype == ::onnx::TensorProto::INT64)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertINT64(reinterpret_cast<const int64_t*>(dataPtr), shape, ctx);
+            dataPtr = convertINT64(reinterpret_cast<const int64_t*>(dataBuf), shape, ctx);
             nbytes = nbytes / (sizeof(int64_t) / sizeof(int32_t));
             onnxDtype = ::onnx::TensorProto::INT32;
             externalWeights = ctx->createTempWeights(onnxDtype, shape);
@@ -680,8 +698,7 @@ bool convertOnnxWeights(
         }
         else if (onnxDtype == ::onnx::TensorProto::UINT8)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertUINT8(reinterpret_cast<const uint8_t*>(dataPtr), shape, ctx);
+            dataPtr = convertUINT8(reinterpret_cast<const uint8_t*>(dataBuf), shape, ctx);
             nbytes = nbytes * (sizeof(int32_t) / sizeof(uint8_t));
             onnxDtype = ::onnx::TensorProto::INT32;
             externalWeights = ctx->createTempWeights(onnxDtype, shape);
@@ -689,18 +706,21 @@ bool convertOnnxWeights(
         }
         else if (onnxDtype == ::onnx::TensorProto::DOUBLE)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertDouble(reinterpret_cast<const double*>(dataPtr), shape, ctx);
+            dataPtr = convertDouble(reinterpret_cast<const double*>(dataBuf), shape, ctx);
             nbytes = nbytes / (sizeof(double) / sizeof(float));
             onnxDtype = ::onnx::TensorProto::FLOAT;
             externalWeights = ctx->createTempWeights(onnxDtype, shape);
             std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
-        // Copy weight values directly to externalWeights
+        // Native types are used in place, without copying them out of the mapping
+        else if (aligned)
+        {
+            externalWeights = ShapedWeights(onnxDtype, const_cast<uint8_t*>(mappedPtr), shape);
+        }
         else
         {
             externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataBuf.data(), nbytes);
+            std::memcpy(externalWeights.values, dataBuf, nbytes);
         }
 
         *weights = externalWeights;
@@ -1589,7 +1609,7 @@ nvinfer1::Dims insertDimension(const nvinfer1::Dims& dims, const int axis, const
 }
 
 bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string path, int64_t offset, int64_t length,
-    std::vector<char>& weightsBuf, size_t& size)
+    uint8_t const*& weightsPtr, size_t& size)
 {
     // The weight paths in the ONNX model are relative paths to the main ONNX file.
 #ifdef _MSC_VER
@@ -1605,23 +1625,22 @@ bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string p
     {
         path = file;
     }
-    std::ifstream relPathFile(path, std::ios::binary | std::ios::ate);
-    if (!relPathFile)
+    MappedFile const* mappedFile = ctx->mapExternalFile(path);
+    if (!mappedFile)
     {
         LOG_ERROR("Failed to open file: " << path);
         return false;
     }
-    std::streamsize fileSize = relPathFile.tellg();
-    relPathFile.seekg(offset, std::ios::beg);
-    int64_t weightsBufSize = length == 0 ? fileSize : length;
-    weightsBuf.resize(weightsBufSize);
-    LOG_VERBOSE("Reading weights from external file: " << path);
-    if (!relPathFile.read(weightsBuf.data(), weightsBuf.size()))
+    const int64_t fileSize = static_cast<int64_t>(mappedFile->size());
+    if (offset < 0 || length < 0 || offset > fileSize || length > fileSize - offset)
     {
-        LOG_ERROR("Failed to read weights from external file: " << path);
+        LOG_ERROR("Weights [offset = " << offset << ", length = " << length << "] are out of range of external file: "
+                                       << path << " (" << fileSize << " bytes)");
         return false;
     }
-    size = weightsBuf.size();
+    LOG_VERBOSE("Reading weights from external file: " << path);
+    weightsPtr = mappedFile->data() + offset;
+    size = static_cast<size_t>(length == 0 ? fileSize - offset : length);
     return true;
 }
 
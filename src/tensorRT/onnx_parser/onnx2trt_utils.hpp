@@ -277,9 +277,10 @@ NodeImportResult lstmLegacyImporter(
 // Helper function to create and fill a Dims object with defined values
 nvinfer1::Dims makeDims(int nbDims, int val);
 
-// Helper function to read weights from an external file
+// Helper function to locate weights in an external file. The file is mapped once per parser and weightsPtr points
+// into the mapping, which stays valid for the lifetime of the importer context.
 bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string path, int64_t offset, int64_t length,
-    std::vector<char>& weightsBuf, size_t& size);
+    uint8_t const*& weightsPtr, size_t& size);
 
 // Helper function to map various ONNX pooling ops into TensorRT.
 NodeImportResult poolingHelper(IImporterContext* ctx, ::onnx::NodeProto const& node,
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <infer/binding_state.hpp>
+#include <infer/graph_cache.hpp>
+#include <vector>
+
+using namespace TRT;
+
+typedef std::vector<std::vector<int>> Shapes;
+
+// 两个优化配置，每个配置一个输入一个输出
+TEST(BindingStateCase, Statistics) {
+    BindingState state;
+    state.reset(2, 2);
+    ASSERT_EQ(state.bindings().size(), 4u);
+
+    Shapes input = {{2, 3}}, output = {{2, 5}};
+    ASSERT_TRUE(state.need_bind(input));
+    state.bind(input, output);
+    ASSERT_FALSE(state.need_bind(input));
+    ASSERT_TRUE(state.need_bind({{4, 3}}));
+    ASSERT_EQ(state.output_shapes(), output);
+
+    // 地址不变时不计数
+    int a = 0, b = 0, c = 0;
+    ASSERT_TRUE(state.update_pointers({&a, &b}));
+    ASSERT_FALSE(state.update_pointers({&a, &b}));
+    ASSERT_TRUE(state.update_pointers({&a, &c}));
+    ASSERT_EQ(state.bindings()[1], &c);
+
+    // 切换配置后清空所有地址，写入第二组
+    state.switch_profile(1);
+    state.switch_profile(1);
+    ASSERT_EQ(state.active_profile(), 1);
+    ASSERT_EQ(state.binding_index(1), 3);
+    ASSERT_EQ(state.bindings()[1], nullptr);
+    ASSERT_TRUE(state.update_pointers({&a, &c}));
+    ASSERT_EQ(state.bindings()[2], &a);
+    ASSERT_EQ(state.bindings()[3], &c);
+
+    state.output_resized();
+    state.count_forward();
+
+    // setBindingDimensions失败后同样的形状也要重新设置
+    state.unbind();
+    ASSERT_TRUE(state.need_bind(input));
+
+    auto& stat = state.statistics();
+    ASSERT_EQ(stat.num_forwards, 1u);
+    ASSERT_EQ(stat.num_dims_updates, 1u);
+    ASSERT_EQ(stat.num_output_resizes, 1u);
+    ASSERT_EQ(stat.num_pointer_updates, 3u);
+    ASSERT_EQ(stat.num_profile_switches, 1u);
+
+    // reset保留统计，回到配置0
+    state.reset(2, 2);
+    ASSERT_EQ(state.active_profile(), 0);
+    ASSERT_TRUE(state.need_bind(input));
+    ASSERT_EQ(state.statistics().num_pointer_updates, 3u);
+}
+
+// 模拟InferImpl：forward和forward_async都通过prepare设置形状，只有forward读取graph key
+static void prepare(BindingState& state, const Shapes& input, int profile = 0) {
+    if (!state.need_bind(input)) return;
+    state.switch_profile(profile);
+    state.bind(input, input);
+}
+
+static std::vector<int> expect_key(const Shapes& input, int profile = 0) {
+    Shapes shapes = input;
+    shapes.insert(shapes.end(), input.begin(), input.end());
+    auto key = GraphCache::make_key(shapes);
+    key.push_back(profile);
+    return key;
+}
+
+static const std::vector<int>& forward(BindingState& state, const Shapes& input, int profile = 0) {
+    prepare(state, input, profile);
+    Shapes shapes = state.input_shapes();
+    shapes.insert(shapes.end(), state.output_shapes().begin(), state.output_shapes().end());
+    return state.graph_key(shapes);
+}
+
+TEST(BindingStateCase, GraphKeyAcrossForwardAsync) {
+    BindingState state;
+    state.reset(2, 2);
+    Shapes small = {{2, 3}}, large = {{8, 3}};
+
+    ASSERT_EQ(forward(state, small), expect_key(small));
+    ASSERT_EQ(forward(state, small), expect_key(small));
+
+    // forward_async先设置了新形状，之后forward看到的形状没有变化，但key必须重建
+    prepare(state, large);
+    ASSERT_FALSE(state.need_bind(large));
+    ASSERT_EQ(forward(state, large), expect_key(large));
+
+    // forward_async切换了配置，形状相同的key也不同
+    prepare(state, small, 1);
+    ASSERT_EQ(forward(state, small, 1), expect_key(small, 1));
+    prepare(state, large, 0);
+    ASSERT_EQ(forward(state, large), expect_key(large, 0));
+
+    // set_input/set_output替换tensor后重建
+    state.invalidate_graph_key();
+    ASSERT_EQ(forward(state, large), expect_key(large, 0));
+    ASSERT_EQ(state.statistics().num_dims_updates, 4u);
+    ASSERT_EQ(state.statistics().num_profile_switches, 2u);
+}
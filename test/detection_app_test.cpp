@@ -39,7 +39,7 @@ TEST_F(DetAppCase, SinglePictureCPUPreProcessing) {
     ASSERT_NE(engine, nullptr);
     auto height = engine->immutable_infer()->input(0)->height();
     auto width = engine->immutable_infer()->input(0)->width();
-    auto f = preprocessing::resize_keep_aspect_ratio(image_OK, cv::Size{height, width}, image_OK);
+    auto f = PreProcessing::resize_keep_aspect_ratio(image_OK, cv::Size{height, width}, image_OK);
     FMT_INFO("%f %f", f.width, f.height);
     FMT_INFO("%d %d", image_OK.size().width, image_OK.size().height);
     auto result = engine->run(image_OK, mean, std); // 当然这里会再次resize到模型指定大小的
@@ -0,0 +1,61 @@
+#ifndef DETECTION_OUTPUTS_HPP
+#define DETECTION_OUTPUTS_HPP
+
+#include <detection.h>
+#include <string.h>
+#include <vector>
+
+// 检测parser单测共用的插件输出，数据都在host上
+
+inline std::shared_ptr<TRT::Tensor> make_host_tensor(const std::vector<int>& dims, TRT::DataType dtype) {
+    auto tensor = std::make_shared<TRT::Tensor>(dims, dtype);
+    tensor->to_cpu(false);
+    memset(tensor->cpu(), 0, tensor->bytes());
+    return tensor;
+}
+
+// 第ibatch张图的有效框数
+inline int some_boxes(int ibatch) { return (ibatch * 37) % (Detection::MAX_IMAGE_BBOX + 1); }
+inline int full_boxes(int ibatch) { return Detection::MAX_IMAGE_BBOX; }
+
+// mmdeploy插件的输出：dets{batch, 100, 5}，labels{batch, 100}，第i张图前num_boxes(i)个框有效
+inline std::vector<std::shared_ptr<TRT::Tensor>> make_mmdeploy_output(int batch_size, int (*num_boxes)(int) = full_boxes) {
+    using Detection::MAX_IMAGE_BBOX;
+    auto dets   = make_host_tensor({batch_size, MAX_IMAGE_BBOX, 5}, TRT::DataType::Float);
+    auto labels = make_host_tensor({batch_size, MAX_IMAGE_BBOX}, TRT::DataType::Int32);
+    for (int i = 0; i < batch_size; ++i) {
+        for (int j = 0; j < MAX_IMAGE_BBOX; ++j) {
+            bool valid = j < num_boxes(i);
+            dets->at<float>(i, j, 0) = i * 10.0f + j;
+            dets->at<float>(i, j, 1) = j * 2.0f;
+            dets->at<float>(i, j, 2) = i * 10.0f + j + 50;
+            dets->at<float>(i, j, 3) = j * 2.0f + 30;
+            dets->at<float>(i, j, 4) = valid ? 1.0f - j * 0.005f : 0.0f;
+            labels->at<int>(i, j) = valid ? (i + j) % 7 : -1;
+        }
+    }
+    return {dets, labels};
+}
+
+// amirstan插件的输出：num_detections{batch, 1}，boxes{batch, 100, 4}，scores{batch, 100}，classes{batch, 100}
+inline std::vector<std::shared_ptr<TRT::Tensor>> make_amirstan_output(int batch_size, int (*num_boxes)(int) = full_boxes) {
+    using Detection::MAX_IMAGE_BBOX;
+    auto nums    = make_host_tensor({batch_size, 1}, TRT::DataType::Int32);
+    auto boxes   = make_host_tensor({batch_size, MAX_IMAGE_BBOX, 4}, TRT::DataType::Float);
+    auto scores  = make_host_tensor({batch_size, MAX_IMAGE_BBOX}, TRT::DataType::Float);
+    auto classes = make_host_tensor({batch_size, MAX_IMAGE_BBOX}, TRT::DataType::Float);
+    for (int i = 0; i < batch_size; ++i) {
+        nums->at<int>(i, 0) = num_boxes(i);
+        for (int j = 0; j < MAX_IMAGE_BBOX; ++j) {
+            boxes->at<float>(i, j, 0) = i * 10.0f + j;
+            boxes->at<float>(i, j, 1) = j * 2.0f;
+            boxes->at<float>(i, j, 2) = i * 10.0f + j + 50;
+            boxes->at<float>(i, j, 3) = j * 2.0f + 30;
+            scores->at<float>(i, j)  = 1.0f - j * 0.005f;
+            classes->at<float>(i, j) = (float)((i + j) % 7);
+        }
+    }
+    return {nums, boxes, scores, classes};
+}
+
+#endif // DETECTION_OUTPUTS_HPP
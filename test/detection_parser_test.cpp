@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <detection.h>
+#include <ilogger.hpp>
+#include "detection_outputs.hpp"
+#include <vector>
+
+using namespace Detection;
+
+static void expect_bbox_eq(const BBox& a, const BBox& b) {
+    ASSERT_EQ(a.left, b.left);
+    ASSERT_EQ(a.top, b.top);
+    ASSERT_EQ(a.right, b.right);
+    ASSERT_EQ(a.bottom, b.bottom);
+    ASSERT_EQ(a.confidence, b.confidence);
+    ASSERT_EQ(a.label, b.label);
+    ASSERT_EQ(a.area, b.area);
+}
+
+TEST(DetectionParserCase, MMDeployArenaMatchesBuffer) {
+    const int batch_size = 5;
+    auto output = make_mmdeploy_output(batch_size, some_boxes);
+
+    // 原来经过buffer tensor的解析
+    std::vector<std::shared_ptr<DetResult>> expect;
+    mmdeploy_det_plg_parser->App::OutputParser<DetResult>::parse(output, expect);
+
+    std::vector<std::shared_ptr<DetResult>> result;
+    ASSERT_EQ(mmdeploy_det_plg_parser->parse(output, result), 0);
+    ASSERT_EQ(result.size(), expect.size());
+    for (int i = 0; i < batch_size; ++i) {
+        ASSERT_TRUE(result[i]->is_view());
+        ASSERT_EQ(result[i]->size(), some_boxes(i));
+        ASSERT_EQ(result[i]->defect_num(), expect[i]->defect_num());
+        for (int j = 0; j < result[i]->size(); ++j) {
+            expect_bbox_eq(result[i]->bbox(j), expect[i]->bbox(j));
+        }
+        ASSERT_EQ(result[i]->format(), expect[i]->format());
+    }
+}
+
+TEST(DetectionParserCase, AmirstanArena) {
+    const int batch_size = 5;
+    auto output = make_amirstan_output(batch_size, some_boxes);
+
+    DetectionArena arena;
+    ASSERT_EQ(amirstan_det_plg_parser->parse(output, arena), batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+        auto view = arena.view(i);
+        ASSERT_EQ(view.size(), some_boxes(i));
+        for (int j = 0; j < view.size(); ++j) {
+            expect_bbox_eq(view[j], BBox(i * 10.0f + j, j * 2.0f, i * 10.0f + j + 50, j * 2.0f + 30,
+                                         1.0f - j * 0.005f, (float)((i + j) % 7)));
+        }
+    }
+
+    // num_detections越界时截断到capacity
+    output[0]->at<int>(0, 0) = MAX_IMAGE_BBOX + 10;
+    output[0]->at<int>(1, 0) = -3;
+    ASSERT_EQ(amirstan_det_plg_parser->parse(output, arena), batch_size);
+    ASSERT_EQ(arena.count(0), MAX_IMAGE_BBOX);
+    ASSERT_EQ(arena.count(1), 0);
+}
+
+TEST(DetectionParserCase, ArenaReuse) {
+    DetectionArena arena;
+    auto large = make_mmdeploy_output(8, full_boxes);
+    auto small = make_mmdeploy_output(2, some_boxes);
+
+    ASSERT_EQ(mmdeploy_det_plg_parser->parse(large, arena), 8);
+    const float* storage = arena.field(DetectionArena::Left, 0);
+
+    // batch变小时复用已有内存
+    ASSERT_EQ(mmdeploy_det_plg_parser->parse(small, arena), 2);
+    ASSERT_EQ(arena.field(DetectionArena::Left, 0), storage);
+    ASSERT_EQ(arena.count(0), some_boxes(0));
+    ASSERT_EQ(arena.count(1), some_boxes(1));
+}
+
+TEST(DetectionParserCase, DetResultView) {
+    auto output = make_mmdeploy_output(2, full_boxes);
+    std::vector<std::shared_ptr<DetResult>> result;
+    ASSERT_EQ(mmdeploy_det_plg_parser->parse(output, result), 0);
+
+    // 两个result共享同一个arena，修改其中一个不影响另一个
+    auto& bboxes = result[0]->mutable_defects();
+    ASSERT_FALSE(result[0]->is_view());
+    ASSERT_EQ(bboxes.size(), (size_t)MAX_IMAGE_BBOX);
+    bboxes.resize(3);
+    ASSERT_EQ(result[0]->defect_num(), 3u);
+
+    ASSERT_TRUE(result[1]->is_view());
+    ASSERT_EQ(result[1]->immutable_defects().size(), (size_t)MAX_IMAGE_BBOX);
+    expect_bbox_eq(result[1]->immutable_defects()[1], result[1]->bbox(1));
+
+    // 默认构造的DetResult没有目标
+    DetResult empty;
+    ASSERT_TRUE(empty.ok());
+    ASSERT_FALSE(empty.is_view());
+}
+
+// 每帧batch=16、每张图100个框，比较buffer tensor方式、每次新建arena和复用arena的解析耗时
+TEST(DetectionParserBenchMark, ParseLatency) {
+    const int batch_size = 16;
+    const int loops = 500;
+    struct Case {
+        const char* name;
+        std::shared_ptr<DetectionParser> parser;
+        std::vector<std::shared_ptr<TRT::Tensor>> output;
+    };
+    std::vector<Case> cases{
+        {"mmdeploy", mmdeploy_det_plg_parser, make_mmdeploy_output(batch_size, full_boxes)},
+        {"amirstan", amirstan_det_plg_parser, make_amirstan_output(batch_size, full_boxes)}
+    };
+
+    for (auto& c : cases) {
+        float sum = 0;
+        auto begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            std::vector<std::shared_ptr<DetResult>> result;
+            c.parser->App::OutputParser<DetResult>::parse(c.output, result);
+            sum += result.back()->bbox(0).left;
+        }
+        float buffer_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            std::vector<std::shared_ptr<DetResult>> result;
+            c.parser->parse(c.output, result);
+            sum += result.back()->bbox(0).left;
+        }
+        float view_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        DetectionArena arena;
+        begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            c.parser->parse(c.output, arena);
+            sum += arena.view(batch_size - 1)[0].left;
+        }
+        float arena_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        FMT_INFO("%s batch %d x %d boxes, buffer: %.3f ms, DetResult view: %.3f ms, reused arena: %.3f ms, sum = %f",
+                 c.name, batch_size, MAX_IMAGE_BBOX, buffer_cost, view_cost, arena_cost, sum);
+    }
+}
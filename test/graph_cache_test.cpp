@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <infer/graph_cache.hpp>
+#include <ilogger.hpp>
+#include <vector>
+
+using namespace TRT;
+
+// 捕获时记下当时enqueue的次数作为graph，launch时记录被重放的graph
+class FakeGraphBackend : public GraphBackend {
+public:
+    int num_alive = 0;
+    bool fail_capture = false;
+    std::vector<int> launched;
+
+    virtual GraphExec capture(void* stream, const std::function<bool()>& enqueue) override {
+        if (!enqueue() || fail_capture) return nullptr;
+        num_alive++;
+        return new int(++num_graphs_);
+    }
+
+    virtual bool launch(GraphExec graph, void* stream) override {
+        launched.push_back(*(int*)graph);
+        return true;
+    }
+
+    virtual void destroy(GraphExec graph) override {
+        if (graph == nullptr) return;
+        num_alive--;
+        delete (int*)graph;
+    }
+
+private:
+    int num_graphs_ = 0;
+};
+
+static std::vector<int> make_key(int batch) { return GraphCache::make_key({{batch, 3, 640, 640}, {batch, 25200, 85}}); }
+
+TEST(GraphCacheCase, MakeKey) {
+    ASSERT_EQ(make_key(1), make_key(1));
+    ASSERT_NE(make_key(1), make_key(8));
+
+    // 维度个数也是key的一部分，{2, 3} + {4}与{2} + {3, 4}不同
+    ASSERT_NE(GraphCache::make_key({{2, 3}, {4}}), GraphCache::make_key({{2}, {3, 4}}));
+}
+
+TEST(GraphCacheCase, CaptureThenReplay) {
+    auto backend = std::make_shared<FakeGraphBackend>();
+    int num_enqueue = 0;
+    auto enqueue = [&]() { num_enqueue++; return true; };
+    std::vector<void*> bindings{(void*)0x1000, (void*)0x2000};
+
+    {
+        GraphCache cache(backend, 4);
+        ASSERT_TRUE(cache.run(make_key(1), bindings, nullptr, enqueue));
+
+        // 第一次：正常enqueue一次 + 捕获时记录一次
+        ASSERT_EQ(num_enqueue, 2);
+        ASSERT_TRUE(cache.contains(make_key(1)));
+        ASSERT_TRUE(backend->launched.empty());
+
+        for (int i = 0; i < 5; ++i) ASSERT_TRUE(cache.run(make_key(1), bindings, nullptr, enqueue));
+        ASSERT_EQ(num_enqueue, 2);
+        ASSERT_EQ(backend->launched, std::vector<int>(5, 1));
+
+        auto& stat = cache.statistics();
+        ASSERT_EQ(stat.num_captures, 1u);
+        ASSERT_EQ(stat.num_replays, 5u);
+        ASSERT_EQ(stat.capture_latency.count, 1u);
+        ASSERT_EQ(stat.replay_latency.count, 5u);
+        ASSERT_EQ(backend->num_alive, 1);
+    }
+    ASSERT_EQ(backend->num_alive, 0);
+}
+
+TEST(GraphCacheCase, Invalidation) {
+    auto backend = std::make_shared<FakeGraphBackend>();
+    auto enqueue = []() { return true; };
+    GraphCache cache(backend, 2);
+    std::vector<void*> bindings{(void*)0x1000, (void*)0x2000};
+
+    cache.run(make_key(1), bindings, nullptr, enqueue);
+    cache.run(make_key(8), bindings, nullptr, enqueue);
+    ASSERT_EQ(cache.size(), 2);
+
+    // batch切换回来时直接命中之前的graph
+    cache.run(make_key(1), bindings, nullptr, enqueue);
+    ASSERT_EQ(backend->launched, std::vector<int>{1});
+
+    // 绑定地址变化，重新捕获
+    std::vector<void*> moved{(void*)0x1000, (void*)0x3000};
+    cache.run(make_key(1), moved, nullptr, enqueue);
+    cache.run(make_key(1), moved, nullptr, enqueue);
+    ASSERT_EQ(backend->launched, (std::vector<int>{1, 3}));
+    ASSERT_EQ(cache.statistics().num_invalidations, 1u);
+
+    // 超过容量淘汰最久未使用的batch 8
+    cache.run(make_key(4), bindings, nullptr, enqueue);
+    ASSERT_FALSE(cache.contains(make_key(8)));
+    ASSERT_TRUE(cache.contains(make_key(1)));
+    ASSERT_EQ(cache.statistics().num_evictions, 1u);
+    ASSERT_EQ(backend->num_alive, 2);
+
+    cache.clear();
+    ASSERT_EQ(cache.size(), 0);
+    ASSERT_EQ(backend->num_alive, 0);
+}
+
+TEST(GraphCacheCase, CaptureFailure) {
+    auto backend = std::make_shared<FakeGraphBackend>();
+    backend->fail_capture = true;
+    int num_enqueue = 0;
+    auto enqueue = [&]() { num_enqueue++; return true; };
+    GraphCache cache(backend, 2);
+    std::vector<void*> bindings{(void*)0x1000};
+
+    ASSERT_TRUE(cache.run(make_key(1), bindings, nullptr, enqueue));
+    ASSERT_EQ(num_enqueue, 2);
+
+    // 不再尝试捕获，每次普通enqueue
+    ASSERT_TRUE(cache.run(make_key(1), bindings, nullptr, enqueue));
+    ASSERT_EQ(num_enqueue, 3);
+    ASSERT_EQ(cache.statistics().num_failures, 1u);
+    ASSERT_EQ(cache.statistics().num_captures, 0u);
+    ASSERT_TRUE(backend->launched.empty());
+
+    // enqueue失败时返回false，不缓存
+    ASSERT_FALSE(cache.run(make_key(2), bindings, nullptr, []() { return false; }));
+    ASSERT_FALSE(cache.contains(make_key(2)));
+}
+
+TEST(GraphCacheCase, LatencyHistogram) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.5f), 0);
+
+    for (int i = 0; i < 90; ++i) histogram.add(0.5);    // 桶0
+    for (int i = 0; i < 10; ++i) histogram.add(100);    // [64, 128)
+    ASSERT_EQ(histogram.count, 100u);
+    ASSERT_NEAR(histogram.mean(), (90 * 0.5 + 10 * 100) / 100.0, 1e-6);
+    ASSERT_EQ(histogram.buckets[0], 90u);
+    ASSERT_EQ(histogram.buckets[6], 10u);
+    ASSERT_EQ(histogram.percentile(0.5f), 2);
+    ASSERT_EQ(histogram.percentile(0.99f), 128);
+}
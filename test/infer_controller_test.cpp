@@ -0,0 +1,321 @@
+#include <gtest/gtest.h>
+
+#include <infer_controller.hpp>
+#include <ilogger.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// CPU mock后端：用sleep模拟引擎推理一个batch的耗时，不需要GPU即可测试/评测InferController的调度逻辑
+// start param: (每个batch的固定耗时us, max batch size, batch中每个样本的额外耗时us)
+typedef InferController<int, int, std::tuple<int, int, int>> MockControllerImpl;
+
+class MockInferController : public MockControllerImpl {
+public:
+    virtual ~MockInferController() {
+        stop();
+    }
+
+    bool startup(int batch_latency_us, int max_batch_size, int num_workers = 1, int item_latency_us = 0) {
+        tensor_allocator_ = std::make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2 * num_workers);
+        return MockControllerImpl::startup(std::make_tuple(batch_latency_us, max_batch_size, item_latency_us), num_workers);
+    }
+
+    std::atomic<int> num_batches{0};
+    std::atomic<int> max_concurrency{0};
+    std::atomic<int64_t> total_latency_us{0};    // 所有任务从入队到完成的耗时之和
+    std::atomic<int> num_preprocess{0};
+
+    // 按完成顺序记录(input, 入队到完成的耗时us)
+    std::mutex completed_lock;
+    std::vector<std::pair<int, int64_t>> completed;
+
+protected:
+    virtual void worker(std::promise<bool>& result) override {
+        worker(0, result);
+    }
+
+    virtual void worker(int worker_id, std::promise<bool>& result) override {
+        int batch_latency_us = std::get<0>(start_param_);
+        int max_batch_size   = std::get<1>(start_param_);
+        int item_latency_us  = std::get<2>(start_param_);
+        result.set_value(true);
+
+        std::vector<Job> fetch_jobs;
+        while (get_jobs_and_wait(fetch_jobs, max_batch_size)) {
+            int running = ++concurrency_;
+            int old_max = max_concurrency;
+            while (running > old_max && !max_concurrency.compare_exchange_weak(old_max, running));
+
+            std::this_thread::sleep_for(std::chrono::microseconds(batch_latency_us + item_latency_us * (int)fetch_jobs.size()));
+            --concurrency_;
+
+            auto now = std::chrono::steady_clock::now();
+            for (auto& job : fetch_jobs) {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - job.enqueue_time).count();
+                total_latency_us += latency;
+                {
+                    std::unique_lock<std::mutex> l(completed_lock);
+                    completed.emplace_back(job.input, latency);
+                }
+                job.pro->set_value(job.input * 2);
+            }
+            num_batches++;
+            fetch_jobs.clear();
+        }
+    }
+
+    virtual bool preprocess(Job& job, const int& input) override {
+        num_preprocess++;
+        job.input = input;
+        return true;
+    }
+
+private:
+    std::atomic<int> concurrency_{0};
+};
+
+TEST(InferControllerCase, ResultsResolve) {
+    MockInferController controller;
+    ASSERT_TRUE(controller.startup(100, 4));
+    ASSERT_EQ(controller.num_workers(), 1);
+
+    std::vector<int> inputs(64);
+    for (int i = 0; i < inputs.size(); ++i) inputs[i] = i;
+
+    auto results = controller.commits(inputs);
+    auto single  = controller.commit(1000);
+    for (int i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i].get(), i * 2);
+    }
+    ASSERT_EQ(single.get(), 2000);
+}
+
+TEST(InferControllerCase, MultiWorkerOverlap) {
+    MockInferController controller;
+    ASSERT_TRUE(controller.startup(20000, 1, 4));
+    ASSERT_EQ(controller.num_workers(), 4);
+
+    std::vector<std::shared_future<int>> results;
+    for (int i = 0; i < 8; ++i) {
+        results.push_back(controller.commit(i));
+    }
+    for (int i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i].get(), i * 2);
+    }
+    ASSERT_GT(controller.max_concurrency, 1);
+}
+
+TEST(InferControllerCase, StopResolvesPendingJobs) {
+    MockInferController controller;
+    ASSERT_TRUE(controller.startup(50000, 1));
+
+    std::vector<std::shared_future<int>> results;
+    for (int i = 0; i < 8; ++i) {
+        results.push_back(controller.commit(i + 1));
+    }
+    controller.stop();
+    for (auto& result : results) {
+        ASSERT_EQ(result.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    }
+}
+
+TEST(InferControllerCase, BatchFillsBeforeDeadline) {
+    MockInferController controller;
+    BatchPolicy policy;
+    policy.max_queue_delay_us = 500000;
+    controller.set_batch_policy(policy);
+    ASSERT_TRUE(controller.startup(100, 4));
+
+    std::vector<int> inputs{1, 2, 3, 4};
+    auto results = controller.commits(inputs);
+    for (auto& result : results) result.get();
+
+    auto stat = controller.batch_statistics();
+    ASSERT_EQ(stat.num_batches, 1);
+    ASSERT_EQ(stat.num_full_flush, 1);
+    ASSERT_EQ(stat.batch_size_histogram[4], 1);
+    ASSERT_FLOAT_EQ(stat.occupancy(), 1.0f);
+}
+
+TEST(InferControllerCase, DeadlineFlush) {
+    MockInferController controller;
+    BatchPolicy policy;
+    policy.max_queue_delay_us = 20000;
+    controller.set_batch_policy(policy);
+    ASSERT_TRUE(controller.startup(100, 8));
+
+    auto begin = iLogger::timestamp_now_float();
+    ASSERT_EQ(controller.commit(21).get(), 42);
+    auto cost = iLogger::timestamp_now_float() - begin;
+    ASSERT_GE(cost, 19);
+
+    auto stat = controller.batch_statistics();
+    ASSERT_EQ(stat.num_batches, 1);
+    ASSERT_EQ(stat.num_partial_flush, 1);
+    ASSERT_EQ(stat.batch_size_histogram[1], 1);
+}
+
+TEST(InferControllerCase, PreferredBatchSizes) {
+    MockInferController controller;
+    BatchPolicy policy;
+    policy.max_queue_delay_us = 10000;
+    policy.preferred_batch_sizes = {4, 1, 2};
+    controller.set_batch_policy(policy);
+    ASSERT_TRUE(controller.startup(100, 8));
+
+    std::vector<int> inputs{1, 2, 3};
+    auto results = controller.commits(inputs);
+    for (auto& result : results) result.get();
+
+    // 3个任务超时提交时，拆成2 + 1
+    auto stat = controller.batch_statistics();
+    ASSERT_EQ(stat.num_batches, 2);
+    ASSERT_EQ(stat.batch_size_histogram[2], 1);
+    ASSERT_EQ(stat.batch_size_histogram[1], 1);
+}
+
+TEST(InferControllerCase, PriorityLanes) {
+    MockInferController controller;
+    ASSERT_TRUE(controller.startup(5000, 1));
+    ASSERT_EQ(controller.num_lanes(), 3);
+
+    // 第一个任务占住worker，之后的任务全部积压在队列里
+    auto never = std::chrono::steady_clock::time_point::max();
+    auto blocker = controller.commit(0);
+    iLogger::sleep(2);
+
+    std::vector<std::shared_future<int>> results;
+    for (int i = 0; i < 8; ++i) results.push_back(controller.commit(100 + i, (int)JobPriority::Low, never));
+    for (int i = 0; i < 8; ++i) results.push_back(controller.commit(200 + i, (int)JobPriority::High, never));
+    for (auto& result : results) result.get();
+    blocker.get();
+
+    // 权重8:1，High先出队8个，期间Low出队1个；Low按FIFO顺序出队，且不会被饿死
+    std::vector<int> order;
+    for (auto& item : controller.completed) order.push_back(item.first);
+    ASSERT_EQ(order.size(), 17);
+    ASSERT_EQ(order[0], 0);
+    int num_high_before_low = 0;
+    while (order[1 + num_high_before_low] >= 200) num_high_before_low++;
+    ASSERT_GE(num_high_before_low, 4);
+
+    std::vector<int> low_order;
+    for (int input : order) if (input >= 100 && input < 200) low_order.push_back(input);
+    ASSERT_TRUE(std::is_sorted(low_order.begin(), low_order.end()));
+}
+
+TEST(InferControllerCase, DeadlineExceeded) {
+    MockInferController controller;
+    ASSERT_TRUE(controller.startup(30000, 1));
+
+    // 已经过期的任务不做预处理
+    auto expired = controller.commit(1, (int)JobPriority::Normal, std::chrono::steady_clock::now());
+    ASSERT_THROW(expired.get(), JobDeadlineExceeded);
+    ASSERT_EQ(controller.num_preprocess, 0);
+
+    // 在队列中等待时过期的任务不进入推理
+    auto blocker = controller.commit(2);
+    iLogger::sleep(2);
+    auto late = controller.commit(3, (int)JobPriority::High, std::chrono::steady_clock::now() + std::chrono::milliseconds(5));
+    auto ok   = controller.commit(4, (int)JobPriority::Low, std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    ASSERT_THROW(late.get(), JobDeadlineExceeded);
+    ASSERT_EQ(ok.get(), 8);
+    ASSERT_EQ(blocker.get(), 4);
+    ASSERT_EQ(controller.num_expired_jobs(), 1);
+    ASSERT_EQ(controller.num_batches, 2);
+
+    auto batch = controller.commits({5, 6}, (int)JobPriority::Low, std::chrono::steady_clock::now());
+    for (auto& result : batch) ASSERT_THROW(result.get(), JobDeadlineExceeded);
+}
+
+// 按泊松过程（指数分布的到达间隔）提交任务，对比不同的最大等待时间下的batch占用率和时延
+TEST(InferControllerBenchMark, PoissonArrivalBatching) {
+    const int num_jobs = 1000;
+    const float qps = 2000;
+    const int max_batch_size = 8;
+
+    for (int delay_us : {0, 1000, 4000}) {
+        MockInferController controller;
+        BatchPolicy policy;
+        policy.max_queue_delay_us = delay_us;
+        controller.set_batch_policy(policy);
+        ASSERT_TRUE(controller.startup(1000, max_batch_size, 1, 100));
+
+        std::mt19937 rng(7);
+        std::exponential_distribution<double> interval_us(qps / 1e6);
+        std::vector<std::shared_future<int>> results(num_jobs);
+        auto begin = iLogger::timestamp_now_float();
+        auto next_arrival = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_jobs; ++i) {
+            next_arrival += std::chrono::microseconds((int64_t)interval_us(rng));
+            std::this_thread::sleep_until(next_arrival);
+            results[i] = controller.commit(i);
+        }
+        for (auto& result : results) result.get();
+
+        auto cost = iLogger::timestamp_now_float() - begin;
+        auto stat = controller.batch_statistics();
+        FMT_INFO("max_queue_delay=%dus, batches=%d, avg batch=%.2f, occupancy=%.1f%%, full=%d, partial=%d, mean latency=%.2f ms, %.1f jobs/s",
+                 delay_us, (int)stat.num_batches, stat.average_batch_size(), stat.occupancy() * 100,
+                 (int)stat.num_full_flush, (int)stat.num_partial_flush, controller.total_latency_us / 1000.0 / num_jobs, num_jobs / cost * 1000);
+    }
+}
+
+TEST(InferControllerBenchMark, WorkerScaling) {
+    const int num_jobs = 512;
+    const int batch_latency_us = 2000;
+    const int max_batch_size = 4;
+    std::vector<int> inputs(num_jobs, 1);
+
+    for (int num_workers : {1, 2, 4}) {
+        MockInferController controller;
+        ASSERT_TRUE(controller.startup(batch_latency_us, max_batch_size, num_workers));
+
+        auto begin = iLogger::timestamp_now_float();
+        std::vector<std::shared_future<int>> results;
+        for (int i = 0; i < num_jobs; ++i) {
+            results.push_back(controller.commit(inputs[i]));
+        }
+        for (auto& result : results) result.get();
+        auto cost = iLogger::timestamp_now_float() - begin;
+        FMT_INFO("workers=%d, %d jobs in %.2f ms, %.1f jobs/s, %d batches",
+                 num_workers, num_jobs, cost, num_jobs / cost * 1000, (int)controller.num_batches);
+    }
+}
+
+// 低优先级的回填任务成批涌入时，周期性提交的高优先级任务的时延
+TEST(InferControllerBenchMark, PriorityUnderBackfill) {
+    const int num_backfill = 400;
+    const int num_critical = 20;
+    const int max_batch_size = 4;
+
+    for (bool use_priority : {false, true}) {
+        MockInferController controller;
+        ASSERT_TRUE(controller.startup(1000, max_batch_size));
+
+        auto never = std::chrono::steady_clock::time_point::max();
+        int backfill_priority = use_priority ? (int)JobPriority::Low : (int)JobPriority::Normal;
+        int critical_priority = use_priority ? (int)JobPriority::High : (int)JobPriority::Normal;
+        std::vector<int> backfill(num_backfill, -1);
+        auto backfill_results = controller.commits(backfill, backfill_priority, never);
+
+        std::vector<std::shared_future<int>> critical_results;
+        for (int i = 0; i < num_critical; ++i) {
+            critical_results.push_back(controller.commit(i, critical_priority, never));
+            iLogger::sleep(2);
+        }
+        for (auto& result : critical_results) result.get();
+        for (auto& result : backfill_results) result.get();
+
+        int64_t critical_latency = 0, backfill_latency = 0;
+        for (auto& item : controller.completed) {
+            if (item.first >= 0) critical_latency += item.second;
+            else                 backfill_latency += item.second;
+        }
+        FMT_INFO("priority lanes=%s, critical mean latency=%.2f ms, backfill mean latency=%.2f ms",
+                 use_priority ? "on" : "off", critical_latency / 1000.0 / num_critical, backfill_latency / 1000.0 / num_backfill);
+    }
+}
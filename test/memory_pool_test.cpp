@@ -0,0 +1,292 @@
+#include <gtest/gtest.h>
+
+#include <memory_pool.hpp>
+#include <ilogger.hpp>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace TRT;
+
+// 记录后端的调用次数，并且可以设置总量上限来模拟显存不足
+class CountingBackend : public MemoryBackend{
+public:
+    virtual void* allocate(MemoryKind kind, int device_id, size_t size) override{
+        if(allocated_bytes + size > capacity) return nullptr;
+
+        void* ptr = malloc(size);
+        sizes[ptr] = size;
+        allocated_bytes += size;
+        num_allocate++;
+        return ptr;
+    }
+
+    virtual void deallocate(MemoryKind kind, int device_id, void* ptr) override{
+        allocated_bytes -= sizes[ptr];
+        sizes.erase(ptr);
+        num_deallocate++;
+        free(ptr);
+    }
+
+    virtual void fill(MemoryKind kind, int device_id, void* ptr, int value, size_t size) override{
+        memset(ptr, value, size);
+    }
+
+    virtual const char* name() const override{return "counting";}
+
+    std::map<void*, size_t> sizes;
+    size_t capacity = (size_t)-1;
+    size_t allocated_bytes = 0;
+    int num_allocate = 0;
+    int num_deallocate = 0;
+};
+
+TEST(MemoryPoolCase, RoundSize) {
+    ASSERT_EQ(MemoryPool::round_size(0), MemoryPool::kMinBlockSize);
+    ASSERT_EQ(MemoryPool::round_size(512), 512);
+    ASSERT_EQ(MemoryPool::round_size(513), 640);
+    ASSERT_EQ(MemoryPool::round_size(1024), 1024);
+    ASSERT_EQ(MemoryPool::round_size(1025), 1280);
+
+    for(size_t size = 1; size < (1 << 24); size = size * 3 / 2 + 1){
+        size_t rounded = MemoryPool::round_size(size);
+        ASSERT_GE(rounded, size);
+        if(size > MemoryPool::kMinBlockSize){
+            ASSERT_LE(rounded, size + size / 4);
+        }
+    }
+}
+
+TEST(MemoryPoolCase, ReuseAndStatistics) {
+    auto backend = std::make_shared<CountingBackend>();
+    MemoryPool pool(backend);
+
+    size_t block_size = 0;
+    void* a = pool.allocate(MemoryKind::Device, 0, 1000, &block_size);
+    ASSERT_NE(a, nullptr);
+    ASSERT_EQ(block_size, MemoryPool::round_size(1000));
+    pool.deallocate(MemoryKind::Device, 0, a, block_size);
+
+    // 同一size class复用同一个block
+    size_t block_size2 = 0;
+    void* b = pool.allocate(MemoryKind::Device, 0, 900, &block_size2);
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(block_size, block_size2);
+    ASSERT_EQ(backend->num_allocate, 1);
+
+    // Host和Device、不同device之间不共享缓存
+    size_t host_block = 0, other_block = 0;
+    void* host  = pool.allocate(MemoryKind::Host, 0, 1000, &host_block);
+    void* other = pool.allocate(MemoryKind::Device, 1, 1000, &other_block);
+    ASSERT_EQ(backend->num_allocate, 3);
+
+    auto stat = pool.statistics(MemoryKind::Device, 0);
+    ASSERT_EQ(stat.hits, 1);
+    ASSERT_EQ(stat.misses, 1);
+    ASSERT_EQ(stat.bytes_in_use, block_size);
+    ASSERT_EQ(stat.bytes_cached, 0);
+
+    pool.deallocate(MemoryKind::Device, 0, b, block_size2);
+    pool.deallocate(MemoryKind::Host, 0, host, host_block);
+    pool.deallocate(MemoryKind::Device, 1, other, other_block);
+    stat = pool.statistics(MemoryKind::Device, 0);
+    ASSERT_EQ(stat.bytes_in_use, 0);
+    ASSERT_EQ(stat.bytes_cached, block_size);
+    ASSERT_EQ(backend->num_deallocate, 0);
+
+    pool.empty_cache();
+    ASSERT_EQ(backend->num_deallocate, 3);
+    ASSERT_EQ(backend->allocated_bytes, 0);
+}
+
+TEST(MemoryPoolCase, CacheLimit) {
+    auto backend = std::make_shared<CountingBackend>();
+    MemoryPool pool(backend);
+    pool.set_cache_limit(MemoryKind::Device, 0, 64 * 1024);
+
+    std::vector<std::pair<void*, size_t>> blocks;
+    for(size_t size : {1024, 4096, 32 * 1024, 48 * 1024}){
+        size_t block_size = 0;
+        void* ptr = pool.allocate(MemoryKind::Device, 0, size, &block_size);
+        blocks.emplace_back(ptr, block_size);
+    }
+    for(auto& item : blocks)
+        pool.deallocate(MemoryKind::Device, 0, item.first, item.second);
+
+    // 超出上限时从最大的block开始释放
+    auto stat = pool.statistics(MemoryKind::Device, 0);
+    ASSERT_LE(stat.bytes_cached, 64 * 1024);
+    ASSERT_EQ(stat.trims, 1);
+    ASSERT_EQ(backend->sizes.size(), 3);
+    ASSERT_EQ(backend->sizes.count(blocks[3].first), 0);
+
+    // 超过上限的单个block直接还给后端
+    size_t block_size = 0;
+    void* big = pool.allocate(MemoryKind::Device, 0, 1024 * 1024, &block_size);
+    pool.deallocate(MemoryKind::Device, 0, big, block_size);
+    ASSERT_EQ(backend->sizes.count(big), 0);
+
+    ASSERT_EQ(pool.trim(MemoryKind::Device, 0, 8192), 32 * 1024);
+    ASSERT_EQ(pool.statistics(MemoryKind::Device, 0).bytes_cached, 4096 + 1024);
+
+    // 上限为0时不缓存
+    pool.set_cache_limit(MemoryKind::Device, 0, 0);
+    ASSERT_EQ(backend->allocated_bytes, 0);
+}
+
+TEST(MemoryPoolCase, TrimOnPressure) {
+    auto backend = std::make_shared<CountingBackend>();
+    backend->capacity = 1024 * 1024;
+    MemoryPool pool(backend);
+
+    size_t small_block = 0;
+    void* small = pool.allocate(MemoryKind::Device, 0, 768 * 1024, &small_block);
+    pool.deallocate(MemoryKind::Device, 0, small, small_block);
+
+    // 缓存占着768KB，再申请512KB超出容量，pool释放缓存后重试成功
+    size_t block_size = 0;
+    void* ptr = pool.allocate(MemoryKind::Device, 0, 512 * 1024, &block_size);
+    ASSERT_NE(ptr, nullptr);
+    ASSERT_EQ(pool.statistics(MemoryKind::Device, 0).bytes_cached, 0);
+
+    // 确实不够时返回nullptr
+    size_t failed_block = 0;
+    ASSERT_EQ(pool.allocate(MemoryKind::Device, 0, 1024 * 1024, &failed_block), nullptr);
+    ASSERT_EQ(failed_block, 0);
+    pool.deallocate(MemoryKind::Device, 0, ptr, block_size);
+}
+
+TEST(MemoryPoolCase, MultiThread) {
+    auto backend = std::make_shared<CountingBackend>();
+    MemoryPool pool(backend);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&pool, t](){
+            for(int i = 0; i < 2000; ++i){
+                size_t size = 512 + ((i * 7 + t) % 16) * 1024;
+                size_t block_size = 0;
+                auto ptr = (unsigned char*)pool.allocate(MemoryKind::Host, 0, size, &block_size);
+                memset(ptr, t, size);
+                for(size_t j = 0; j < size; j += 97)
+                    ASSERT_EQ(ptr[j], t);
+                pool.deallocate(MemoryKind::Host, 0, ptr, block_size);
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+
+    auto stat = pool.statistics(MemoryKind::Host, 0);
+    ASSERT_EQ(stat.hits + stat.misses, 4 * 2000);
+    ASSERT_EQ(stat.bytes_in_use, 0);
+    ASSERT_LE(backend->num_allocate, 4 * 16);
+}
+
+// 释放时记录的事件由测试手动完成，模拟stream上还没执行完的kernel/拷贝
+class EventBackend : public CountingBackend{
+public:
+    struct Event{
+        void* stream;
+        bool done = false;
+    };
+
+    virtual void* record_event(int device_id, void* stream) override{
+        Event* e = new Event();
+        e->stream = stream;
+        events.push_back(e);
+        return e;
+    }
+
+    virtual bool query_event(void* event) override{ return ((Event*)event)->done; }
+
+    virtual void destroy_event(void* event) override{
+        events.erase(std::find(events.begin(), events.end(), (Event*)event));
+        delete (Event*)event;
+    }
+
+    std::vector<Event*> events;
+};
+
+TEST(MemoryPoolCase, ReuseAfterReleaseEvent) {
+    auto backend = std::make_shared<EventBackend>();
+    MemoryPool pool(backend);
+    void* stream = (void*)0x10;
+
+    size_t block_a = 0, block_b = 0;
+    void* a = pool.allocate(MemoryKind::Device, 0, 1000, &block_a);
+    void* b = pool.allocate(MemoryKind::Device, 0, 1000, &block_b);
+    pool.deallocate(MemoryKind::Device, 0, a, block_a, stream);
+    pool.deallocate(MemoryKind::Device, 0, b, block_b, stream);
+    ASSERT_EQ(backend->events.size(), 2u);
+    ASSERT_EQ(backend->events[0]->stream, stream);
+
+    // b最近释放但还在使用，a已经完成，复用a
+    backend->events[0]->done = true;
+    size_t block = 0;
+    ASSERT_EQ(pool.allocate(MemoryKind::Device, 0, 1000, &block), a);
+    ASSERT_EQ(backend->events.size(), 1u);
+
+    // 只剩未完成的b，不等待而是向后端申请新的block
+    size_t block_c = 0;
+    void* c = pool.allocate(MemoryKind::Device, 0, 1000, &block_c);
+    ASSERT_NE(c, b);
+    ASSERT_EQ(backend->num_allocate, 3);
+    auto stat = pool.statistics(MemoryKind::Device, 0);
+    ASSERT_EQ(stat.busy, 1u);
+    ASSERT_EQ(stat.hits, 1u);
+    ASSERT_EQ(stat.misses, 3u);
+
+    // b完成之后可以复用
+    backend->events[0]->done = true;
+    ASSERT_EQ(pool.allocate(MemoryKind::Device, 0, 1000, &block), b);
+    ASSERT_EQ(backend->num_allocate, 3);
+    pool.deallocate(MemoryKind::Device, 0, c, block_c, stream);
+
+    // 还给后端时销毁事件
+    pool.deallocate(MemoryKind::Device, 0, a, block_a, stream);
+    pool.deallocate(MemoryKind::Device, 0, b, block_b, stream);
+    pool.empty_cache();
+    ASSERT_TRUE(backend->events.empty());
+    ASSERT_EQ(backend->allocated_bytes, 0u);
+}
+
+// 模拟OutputParser::parse里每次调用都新建的buffer：申请、写满、释放
+TEST(MemoryPoolBenchMark, AllocateTouchRelease) {
+    const size_t size = 2016 * 2016 * 3 * sizeof(float);
+    const int loops = 50;
+    auto backend = malloc_memory_backend();
+
+    auto touch = [](void* ptr, size_t size){
+        // 每页写一个字节，触发缺页
+        for(size_t i = 0; i < size; i += 4096)
+            ((volatile char*)ptr)[i] = 1;
+    };
+
+    auto begin = iLogger::timestamp_now_float();
+    for(int i = 0; i < loops; ++i){
+        void* ptr = backend->allocate(MemoryKind::Host, 0, size);
+        touch(ptr, size);
+        backend->deallocate(MemoryKind::Host, 0, ptr);
+    }
+    float direct_cost = iLogger::timestamp_now_float() - begin;
+
+    MemoryPool pool(backend);
+    begin = iLogger::timestamp_now_float();
+    for(int i = 0; i < loops; ++i){
+        size_t block_size = 0;
+        void* ptr = pool.allocate(MemoryKind::Host, 0, size, &block_size);
+        touch(ptr, size);
+        pool.deallocate(MemoryKind::Host, 0, ptr, block_size);
+    }
+    float pool_cost = iLogger::timestamp_now_float() - begin;
+
+    auto stat = pool.statistics(MemoryKind::Host, 0);
+    ASSERT_EQ(stat.misses, 1);
+    ASSERT_EQ(stat.hits, loops - 1);
+
+    FMT_INFO("%.1f MB x %d, direct(%s): %.3f ms/iter, pool: %.3f ms/iter, speedup: %.2fx",
+             size / 1024.0f / 1024.0f, loops, backend->name(), direct_cost / loops, pool_cost / loops, direct_cost / pool_cost);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <monopoly_allocator.hpp>
+#include <ilogger.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// 旧版（互斥锁 + 线性查找）的实现，仅作为benchmark的对照组
+template<class _ItemType>
+class LockedMonopolyAllocator{
+public:
+    class MonopolyData{
+    public:
+        std::shared_ptr<_ItemType>& data(){ return data_; }
+        void release(){manager_->release_one(this);}
+
+    private:
+        MonopolyData(LockedMonopolyAllocator* pmanager){manager_ = pmanager;}
+
+    private:
+        friend class LockedMonopolyAllocator;
+        LockedMonopolyAllocator* manager_ = nullptr;
+        std::shared_ptr<_ItemType> data_;
+        bool available_ = true;
+    };
+    typedef std::shared_ptr<MonopolyData> MonopolyDataPointer;
+
+    LockedMonopolyAllocator(int size){
+        capacity_ = size;
+        num_available_ = size;
+        datas_.resize(size);
+        for(int i = 0; i < size; ++i)
+            datas_[i] = std::shared_ptr<MonopolyData>(new MonopolyData(this));
+    }
+
+    MonopolyDataPointer query(int timeout = 10000){
+        std::unique_lock<std::mutex> l(lock_);
+        if(num_available_ == 0){
+            auto state = cv_.wait_for(l, std::chrono::milliseconds(timeout), [&](){
+                return num_available_ > 0;
+            });
+            if(!state || num_available_ == 0)
+                return nullptr;
+        }
+
+        auto item = std::find_if(datas_.begin(), datas_.end(), [](MonopolyDataPointer& item){return item->available_;});
+        if(item == datas_.end())
+            return nullptr;
+
+        (*item)->available_ = false;
+        num_available_--;
+        return *item;
+    }
+
+private:
+    void release_one(MonopolyData* prq){
+        std::unique_lock<std::mutex> l(lock_);
+        if(!prq->available_){
+            prq->available_ = true;
+            num_available_++;
+            cv_.notify_one();
+        }
+    }
+
+private:
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::vector<MonopolyDataPointer> datas_;
+    int capacity_ = 0;
+    int num_available_ = 0;
+};
+
+TEST(MonopolyAllocatorCase, QueryAndRelease) {
+    MonopolyAllocator<int> allocator(4);
+    ASSERT_EQ(allocator.capacity(), 4);
+
+    std::vector<MonopolyAllocator<int>::MonopolyDataPointer> items;
+    for (int i = 0; i < 4; ++i) {
+        auto item = allocator.query(10);
+        ASSERT_NE(item, nullptr);
+        items.push_back(item);
+    }
+    ASSERT_EQ(allocator.num_available(), 0);
+
+    // 每个座位只能被分配一次
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i + 1; j < 4; ++j) {
+            ASSERT_NE(items[i].get(), items[j].get());
+        }
+    }
+
+    items[2]->release();
+    items[2]->release(); // 重复release不应该重复入链表
+    ASSERT_EQ(allocator.num_available(), 1);
+    ASSERT_EQ(allocator.query(10).get(), items[2].get());
+    ASSERT_EQ(allocator.query(10), nullptr);
+}
+
+TEST(MonopolyAllocatorCase, TimeoutHonoured) {
+    MonopolyAllocator<int> allocator(1);
+    auto item = allocator.query();
+    ASSERT_NE(item, nullptr);
+
+    auto begin = iLogger::timestamp_now();
+    ASSERT_EQ(allocator.query(50), nullptr);
+    auto cost = iLogger::timestamp_now() - begin;
+    ASSERT_GE(cost, 45);
+    ASSERT_LT(cost, 1000);
+}
+
+TEST(MonopolyAllocatorCase, ParkedWaiterWakeUp) {
+    MonopolyAllocator<int> allocator(1, 0);
+    auto item = allocator.query();
+    ASSERT_NE(item, nullptr);
+
+    std::thread releaser([&](){
+        iLogger::sleep(20);
+        item->release();
+    });
+    auto waited = allocator.query(5000);
+    releaser.join();
+    ASSERT_NE(waited, nullptr);
+}
+
+TEST(MonopolyAllocatorCase, ExclusiveOwnership) {
+    const int capacity = 8;
+    const int num_thread = 16;
+    const int loops = 5000;
+    MonopolyAllocator<int> allocator(capacity);
+    std::atomic<int> violations{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_thread; ++t) {
+        threads.emplace_back([&](){
+            for (int i = 0; i < loops; ++i) {
+                auto item = allocator.query();
+                ASSERT_NE(item, nullptr);
+                auto& data = item->data();
+                if (data == nullptr) data = std::make_shared<int>(0);
+                if (++(*data) != 1) violations++;
+                --(*data);
+                item->release();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    ASSERT_EQ(violations, 0);
+    ASSERT_EQ(allocator.num_available(), capacity);
+}
+
+template<typename Allocator>
+static double allocator_throughput(Allocator& allocator, int num_producer, int loops) {
+    std::vector<std::thread> threads;
+    auto begin = iLogger::timestamp_now_float();
+    for (int t = 0; t < num_producer; ++t) {
+        threads.emplace_back([&](){
+            for (int i = 0; i < loops; ++i) {
+                auto item = allocator.query();
+                if (item) item->release();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    auto cost = iLogger::timestamp_now_float() - begin;
+    return num_producer * loops / cost; // ops/ms
+}
+
+TEST(MonopolyAllocatorBenchMark, LockFreeVsLocked) {
+    const int capacity = 32;
+    const int total_ops = 640000;
+    for (int num_producer : {1, 8, 64}) {
+        int loops = total_ops / num_producer;
+        LockedMonopolyAllocator<int> locked(capacity);
+        MonopolyAllocator<int> lock_free(capacity);
+        double locked_ops = allocator_throughput(locked, num_producer, loops);
+        double lock_free_ops = allocator_throughput(lock_free, num_producer, loops);
+        FMT_INFO("producers=%d, locked: %.1f ops/ms, lock-free: %.1f ops/ms, speedup: %.2fx",
+                 num_producer, locked_ops, lock_free_ops, lock_free_ops / locked_ops);
+    }
+}
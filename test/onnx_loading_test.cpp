@@ -0,0 +1,292 @@
+#include <gtest/gtest.h>
+
+#include <onnx_parser/MappedFile.hpp>
+#include <onnx_parser/ImporterContext.hpp>
+#include <onnx/onnx_pb.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <ilogger.hpp>
+#include <fstream>
+#include <string.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace onnx2trt;
+
+// 合成模型：num_weights个float初始化器，每个weight_bytes字节的raw_data，外加一个Conv节点引用它们
+static onnx::ModelProto make_model(int num_weights, size_t weight_bytes) {
+    onnx::ModelProto model;
+    model.set_ir_version(onnx::IR_VERSION);
+    model.set_producer_name("onnx_loading_test");
+    model.add_opset_import()->set_version(11);
+
+    auto graph = model.mutable_graph();
+    graph->set_name("synthetic");
+    for (int i = 0; i < num_weights; ++i) {
+        auto weight = graph->add_initializer();
+        weight->set_name("weight" + std::to_string(i));
+        weight->set_data_type(onnx::TensorProto::FLOAT);
+        weight->add_dims(weight_bytes / sizeof(float));
+
+        std::string data(weight_bytes, '\0');
+        for (size_t j = 0; j < weight_bytes; j += 4096) data[j] = (char)(i + j / 4096);
+        weight->set_raw_data(std::move(data));
+
+        auto node = graph->add_node();
+        node->set_op_type("Conv");
+        node->add_input("x");
+        node->add_input(weight->name());
+        node->add_output("y" + std::to_string(i));
+    }
+    return model;
+}
+
+static void save_model(const onnx::ModelProto& model, const std::string& file) {
+    std::string data;
+    model.SerializeToString(&data);
+    iLogger::save_file(file, data);
+}
+
+// 改动前parseFromFile的做法：流式解析一次取元信息，再整体读入vector解析第二次，两份模型同时存活
+static bool legacy_load(const std::string& file, onnx::ModelProto& metadata, onnx::ModelProto& model) {
+    {
+        std::ifstream stream(file, std::ios::in | std::ios::binary);
+        google::protobuf::io::IstreamInputStream raw_input(&stream);
+        google::protobuf::io::CodedInputStream coded_input(&raw_input);
+        coded_input.SetTotalBytesLimit(std::numeric_limits<int>::max());
+        if (!metadata.ParseFromCodedStream(&coded_input)) return false;
+    }
+
+    std::ifstream onnx_file(file, std::ios::binary | std::ios::ate);
+    std::vector<char> onnx_buf(onnx_file.tellg());
+    onnx_file.seekg(0, std::ios::beg);
+    onnx_file.read(onnx_buf.data(), onnx_buf.size());
+
+    google::protobuf::io::ArrayInputStream raw_input(onnx_buf.data(), onnx_buf.size());
+    google::protobuf::io::CodedInputStream coded_input(&raw_input);
+    coded_input.SetTotalBytesLimit(std::numeric_limits<int>::max());
+    return model.ParseFromCodedStream(&coded_input);
+}
+
+// 峰值常驻内存（VmHWM），单位MB
+static double peak_rss_mb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stod(line.substr(6)) / 1024.0;
+    }
+    return 0;
+}
+
+// 把峰值重置为当前常驻内存，内核不支持时返回false
+static bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    return clear_refs && (clear_refs << "5").flush();
+}
+
+TEST(OnnxLoadingCase, MappedFile) {
+    auto directory = iLogger::format("mapped_file_test_%d/", (int)iLogger::timestamp_now());
+    auto file = directory + "data.bin";
+    ASSERT_FALSE(MappedFile(file).isOpen());
+
+    std::string data(100000, '\0');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (char)(i * 31);
+    ASSERT_TRUE(iLogger::save_file(file, data));
+
+    MappedFile mapped(file);
+    ASSERT_TRUE(mapped.isOpen());
+    ASSERT_EQ(mapped.size(), data.size());
+    ASSERT_EQ(std::string((const char*)mapped.data(), mapped.size()), data);
+
+    // 释放的页再次访问时从文件重新读入
+    mapped.release(0, mapped.size());
+    ASSERT_EQ(std::string((const char*)mapped.data(), mapped.size()), data);
+
+    ASSERT_TRUE(iLogger::save_file(file, ""));
+    MappedFile empty(file);
+    ASSERT_TRUE(empty.isOpen());
+    ASSERT_EQ(empty.size(), 0u);
+    iLogger::rmtree(directory);
+}
+
+TEST(OnnxLoadingCase, ParseFromMappedFile) {
+    auto directory = iLogger::format("onnx_loading_test_%d/", (int)iLogger::timestamp_now());
+    auto file = directory + "model.onnx";
+    auto model = make_model(3, 100003 * sizeof(float));
+    save_model(model, file);
+
+    MappedFile mapped(file);
+    onnx::ModelProto parsed;
+    bool is_text = true;
+    ASSERT_TRUE(parseFromMappedFile(mapped, &parsed, &is_text));
+    ASSERT_FALSE(is_text);
+    ASSERT_EQ(parsed.SerializeAsString(), model.SerializeAsString());
+
+    // 块边界落在字段中间、解析过程中释放已消费的页
+    for (int block_size : {1, 7, 4096, 65537}) {
+        MappedInputStream input(mapped, block_size);
+        google::protobuf::io::CodedInputStream coded_input(&input);
+        onnx::ModelProto blocks;
+        ASSERT_TRUE(blocks.ParseFromCodedStream(&coded_input)) << block_size;
+        ASSERT_EQ(blocks.SerializeAsString(), model.SerializeAsString()) << block_size;
+    }
+
+    // 文本格式的模型
+    auto text_model = make_model(2, 64);
+    std::string text;
+    ASSERT_TRUE(google::protobuf::TextFormat::PrintToString(text_model, &text));
+    ASSERT_TRUE(iLogger::save_file(file, text));
+    MappedFile mapped_text(file);
+    ASSERT_TRUE(parseFromMappedFile(mapped_text, &parsed, &is_text));
+    ASSERT_TRUE(is_text);
+    ASSERT_EQ(parsed.SerializeAsString(), text_model.SerializeAsString());
+
+    ASSERT_TRUE(iLogger::save_file(file, "not a model {"));
+    MappedFile garbage(file);
+    ASSERT_FALSE(parseFromMappedFile(garbage, &parsed));
+    iLogger::rmtree(directory);
+}
+
+class SilentLogger : public nvinfer1::ILogger {
+public:
+    virtual void log(Severity severity, const char* msg) noexcept override {}
+};
+
+// 权重在外部文件[offset, offset + length)中的initializer
+static onnx::TensorProto make_external_tensor(int64_t offset, int64_t length, int numel, int data_type = onnx::TensorProto::FLOAT) {
+    onnx::TensorProto tensor;
+    tensor.set_name("external");
+    tensor.set_data_type(data_type);
+    tensor.add_dims(numel);
+    tensor.set_data_location(onnx::TensorProto::EXTERNAL);
+    std::vector<std::pair<std::string, std::string>> entries = {
+        {"location", "weights.bin"}, {"offset", std::to_string(offset)}, {"length", std::to_string(length)}};
+    for (auto& item : entries) {
+        auto entry = tensor.add_external_data();
+        entry->set_key(item.first);
+        entry->set_value(item.second);
+    }
+    return tensor;
+}
+
+/* weights.bin的布局，共99字节：
+   [0, 64)   16个float，4字节对齐
+   [66, 82)  4个float，不对齐
+   [83, 99)  2个int64，不对齐，一直到文件末尾
+*/
+TEST(OnnxLoadingCase, ExternalWeights) {
+    auto directory = iLogger::format("external_weights_test_%d/", (int)iLogger::timestamp_now());
+    float aligned[16], misaligned[4] = {-1.0f, -2.0f, -3.0f, -4.0f};
+    int64_t int64_values[2] = {7, -3};
+    for (int i = 0; i < 16; ++i) aligned[i] = i * 0.5f;
+
+    std::string data(99, '\0');
+    memcpy(&data[0], aligned, sizeof(aligned));
+    memcpy(&data[66], misaligned, sizeof(misaligned));
+    memcpy(&data[83], int64_values, sizeof(int64_values));
+    ASSERT_TRUE(iLogger::save_file(directory + "weights.bin", data));
+
+    // location相对于模型文件所在目录
+    SilentLogger logger;
+    ImporterContext ctx(nullptr, &logger);
+    ctx.setOnnxFileLocation(directory + "model.onnx");
+    auto mapped = ctx.mapExternalFile(directory + "weights.bin");
+    ASSERT_NE(mapped, nullptr);
+    ASSERT_EQ(mapped->size(), data.size());
+    auto in_mapping = [&](const void* p) { return p >= mapped->data() && p < mapped->data() + mapped->size(); };
+
+    // offset/length的范围检查，length为0表示一直到文件末尾
+    uint8_t const* ptr = nullptr;
+    size_t size = 0;
+    ASSERT_TRUE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 8, 0, ptr, size));
+    ASSERT_EQ(ptr, mapped->data() + 8);
+    ASSERT_EQ(size, 91u);
+    ASSERT_TRUE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 99, 0, ptr, size));
+    ASSERT_EQ(size, 0u);
+    ASSERT_TRUE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 83, 16, ptr, size));
+    ASSERT_EQ(size, 16u);
+    ASSERT_FALSE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 100, 0, ptr, size));
+    ASSERT_FALSE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 84, 16, ptr, size));
+    ASSERT_FALSE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), -1, 4, ptr, size));
+    ASSERT_FALSE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 0, -1, ptr, size));
+    ASSERT_FALSE(parseExternalWeights(&ctx, "weights.bin", ctx.getOnnxFileLocation(), 1, std::numeric_limits<int64_t>::max(), ptr, size));
+    ASSERT_FALSE(parseExternalWeights(&ctx, "missing.bin", ctx.getOnnxFileLocation(), 0, 4, ptr, size));
+
+    // 对齐的float直接使用映射中的数据
+    ShapedWeights weights;
+    ASSERT_TRUE(convertOnnxWeights(make_external_tensor(0, 64, 16), &weights, &ctx));
+    ASSERT_EQ(weights.type, onnx::TensorProto::FLOAT);
+    ASSERT_EQ(weights.count(), 16u);
+    ASSERT_TRUE(in_mapping(weights.values));
+    for (int i = 0; i < 16; ++i) ASSERT_EQ(weights.at<float>(i), aligned[i]);
+
+    // 不对齐的拷贝到对齐的临时权重中
+    ASSERT_TRUE(convertOnnxWeights(make_external_tensor(66, 16, 4), &weights, &ctx));
+    ASSERT_FALSE(in_mapping(weights.values));
+    ASSERT_EQ((uintptr_t)weights.values % sizeof(float), 0u);
+    for (int i = 0; i < 4; ++i) ASSERT_EQ(weights.at<float>(i), misaligned[i]);
+
+    // 不对齐的int64先拷贝再转换为int32，length为0时读到文件末尾正好是两个元素
+    ASSERT_TRUE(convertOnnxWeights(make_external_tensor(83, 0, 2, onnx::TensorProto::INT64), &weights, &ctx));
+    ASSERT_EQ(weights.type, onnx::TensorProto::INT32);
+    ASSERT_EQ(weights.at<int32_t>(0), 7);
+    ASSERT_EQ(weights.at<int32_t>(1), -3);
+
+    // 数据的字节数与形状不符、越界
+    ASSERT_FALSE(convertOnnxWeights(make_external_tensor(66, 0, 4), &weights, &ctx));
+    ASSERT_FALSE(convertOnnxWeights(make_external_tensor(0, 60, 16), &weights, &ctx));
+    ASSERT_FALSE(convertOnnxWeights(make_external_tensor(90, 16, 4), &weights, &ctx));
+    ASSERT_FALSE(convertOnnxWeights(make_external_tensor(99, 0, 4), &weights, &ctx));
+    iLogger::rmtree(directory);
+}
+
+// 8 x 32MB权重的合成模型，比较两次解析的旧流程与单次映射解析的耗时和峰值内存
+TEST(OnnxLoadingBenchMark, ParseTimeAndPeakMemory) {
+    const int num_weights = 8;
+    const size_t weight_bytes = 32 << 20;
+    auto directory = iLogger::format("onnx_loading_benchmark_%d/", (int)iLogger::timestamp_now());
+    auto file = directory + "model.onnx";
+    {
+        auto model = make_model(num_weights, weight_bytes);
+        save_model(model, file);
+    }
+    double file_mb = iLogger::file_size(file) / 1024.0 / 1024.0;
+
+    bool can_reset = reset_peak_rss();
+    double base_rss = peak_rss_mb();
+    auto begin = iLogger::timestamp_now_float();
+    size_t legacy_bytes = 0;
+    {
+        onnx::ModelProto metadata, model;
+        ASSERT_TRUE(legacy_load(file, metadata, model));
+        legacy_bytes = model.ByteSizeLong();
+    }
+    float legacy_cost = iLogger::timestamp_now_float() - begin;
+    double legacy_peak = peak_rss_mb() - base_rss;
+
+    reset_peak_rss();
+    base_rss = peak_rss_mb();
+    begin = iLogger::timestamp_now_float();
+    size_t mapped_bytes = 0;
+    {
+        onnx::ModelProto model;
+        MappedFile mapped(file);
+        ASSERT_TRUE(parseFromMappedFile(mapped, &model));
+        mapped_bytes = model.ByteSizeLong();
+    }
+    float mapped_cost = iLogger::timestamp_now_float() - begin;
+    double mapped_peak = peak_rss_mb() - base_rss;
+    ASSERT_EQ(mapped_bytes, legacy_bytes);
+
+    FMT_INFO("model %.1f MB, legacy two-pass: %.1f ms / +%.1f MB peak, mapped single-pass: %.1f ms / +%.1f MB peak",
+             file_mb, legacy_cost, legacy_peak, mapped_cost, mapped_peak);
+
+    // 旧流程峰值约为模型的三倍（两份模型加读入的文件），单次解析不超过模型加一个块
+    if (can_reset) {
+        ASSERT_LT(mapped_peak, legacy_peak);
+        ASSERT_LT(mapped_peak, file_mb * 1.5);
+    }
+    iLogger::rmtree(directory);
+}
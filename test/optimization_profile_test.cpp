@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <infer/optimization_profile.hpp>
+#include <vector>
+
+using namespace TRT;
+
+static ProfileShapes make_profile(std::vector<int> min, std::vector<int> opt, std::vector<int> max) {
+    ProfileShapes profile;
+    profile.min = {min};
+    profile.opt = {opt};
+    profile.max = {max};
+    return profile;
+}
+
+TEST(OptimizationProfileCase, Contains) {
+    auto profile = make_profile({1, 3, 320, 320}, {4, 3, 640, 640}, {8, 3, 1280, 1280});
+    ASSERT_TRUE(profile.contains({{1, 3, 320, 320}}));
+    ASSERT_TRUE(profile.contains({{8, 3, 1280, 1280}}));
+    ASSERT_TRUE(profile.contains({{2, 3, 640, 480}}));
+    ASSERT_FALSE(profile.contains({{9, 3, 640, 640}}));
+    ASSERT_FALSE(profile.contains({{1, 3, 1920, 1080}}));
+
+    // 维度个数、输入个数不同
+    ASSERT_FALSE(profile.contains({{1, 3, 640}}));
+    ASSERT_FALSE(profile.contains({{1, 3, 640, 640}, {1, 3, 640, 640}}));
+}
+
+TEST(OptimizationProfileCase, SelectClosestOpt) {
+    // 低延迟的单张配置 + 高吞吐的批量配置
+    std::vector<ProfileShapes> profiles = {
+        make_profile({1, 3, 640, 640}, {1, 3, 640, 640}, {2, 3, 640, 640}),
+        make_profile({1, 3, 640, 640}, {8, 3, 640, 640}, {16, 3, 640, 640}),
+    };
+
+    ASSERT_EQ(select_optimization_profile(profiles, {{1, 3, 640, 640}}), 0);
+    ASSERT_EQ(select_optimization_profile(profiles, {{2, 3, 640, 640}}), 0);
+    ASSERT_EQ(select_optimization_profile(profiles, {{4, 3, 640, 640}}), 1);
+    ASSERT_EQ(select_optimization_profile(profiles, {{8, 3, 640, 640}}), 1);
+    ASSERT_EQ(select_optimization_profile(profiles, {{17, 3, 640, 640}}), -1);
+    ASSERT_EQ(select_optimization_profile({}, {{1, 3, 640, 640}}), -1);
+
+    // 距离相同时选下标小的
+    profiles.push_back(profiles[1]);
+    ASSERT_EQ(select_optimization_profile(profiles, {{8, 3, 640, 640}}), 1);
+}
+
+TEST(OptimizationProfileCase, SpatialDims) {
+    std::vector<ProfileShapes> profiles = {
+        make_profile({1, 3, 320, 320}, {1, 3, 640, 640}, {1, 3, 1280, 1280}),
+        make_profile({1, 3, 1280, 1280}, {1, 3, 1920, 1920}, {1, 3, 2560, 2560}),
+    };
+
+    ASSERT_EQ(select_optimization_profile(profiles, {{1, 3, 480, 640}}), 0);
+    ASSERT_EQ(select_optimization_profile(profiles, {{1, 3, 2048, 2048}}), 1);
+
+    // 两个配置都能容纳，1280更接近第一个配置的opt 640 x 640
+    ASSERT_EQ(select_optimization_profile(profiles, {{1, 3, 1280, 1280}}), 0);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <detection.h>
+#include <ilogger.hpp>
+#include "detection_outputs.hpp"
+#include <vector>
+
+using namespace Detection;
+typedef App::ParserRegistry<DetResult> Registry;
+
+TEST(ParserRegistryCase, BuiltinParsers) {
+    auto& registry = Registry::instance();
+    ASSERT_EQ(registry.get("amirstan_plugin"), std::dynamic_pointer_cast<App::BaseParser<DetResult>>(amirstan_det_plg_parser));
+    ASSERT_EQ(registry.get("mmdeploy_plugin"), std::dynamic_pointer_cast<App::BaseParser<DetResult>>(mmdeploy_det_plg_parser));
+    ASSERT_EQ(registry.get("yolo"), std::dynamic_pointer_cast<App::BaseParser<DetResult>>(yolo_det_parser));
+    ASSERT_EQ(registry.get("unknown"), nullptr);
+
+    // 同名的parser不能重复注册
+    ASSERT_FALSE(registry.add(std::make_shared<MMDeployDetectionParser>()));
+}
+
+TEST(ParserRegistryCase, FindByOutputs) {
+    auto& registry = Registry::instance();
+    auto mmdeploy = make_mmdeploy_output(2);
+    ASSERT_EQ(Registry::signature(mmdeploy), "Float32[100x5],Int32[100]");
+    ASSERT_STREQ(registry.find(mmdeploy)->get_plugin_name(), "mmdeploy_plugin");
+
+    // 签名相同、batch不同时直接命中缓存
+    ASSERT_STREQ(registry.find(make_mmdeploy_output(7))->get_plugin_name(), "mmdeploy_plugin");
+    ASSERT_STREQ(registry.find(make_amirstan_output(1))->get_plugin_name(), "amirstan_plugin");
+    ASSERT_STREQ(registry.find({make_host_tensor({1, 25200, 85}, TRT::DataType::Float)})->get_plugin_name(), "yolo");
+    ASSERT_EQ(registry.find({make_host_tensor({1, 3}, TRT::DataType::UInt8)}), nullptr);
+}
+
+TEST(ParserRegistryCase, StaticParserMatchesVirtual) {
+    auto output = make_mmdeploy_output(3);
+    std::vector<std::shared_ptr<DetResult>> result;
+    ASSERT_EQ(Registry::instance().find(output)->parse(output, result), 0);
+
+    DetectionArena arena;
+    ASSERT_EQ(StaticDetectionParser<MMDeployDecoder>().parse(output, arena), 3);
+    for (int i = 0; i < 3; ++i) {
+        auto view = arena.view(i);
+        ASSERT_EQ(view.size(), result[i]->size());
+        for (int j = 0; j < view.size(); ++j) {
+            ASSERT_EQ(view[j].left, result[i]->bbox(j).left);
+            ASSERT_EQ(view[j].label, result[i]->bbox(j).label);
+        }
+    }
+}
+
+// 同一份输出分别用：buffer tensor + buffer2struct（原来的方式）、BaseParser指针的虚函数parse、StaticDetectionParser解析
+TEST(ParserRegistryBenchMark, ParseThroughput) {
+    const int batch_size = 16, loops = 2000;
+    auto run = [&](const char* name, std::vector<std::shared_ptr<TRT::Tensor>> output, std::shared_ptr<DetectionParser> parser,
+                   int (*static_parse)(std::vector<std::shared_ptr<TRT::Tensor>>&, DetectionArena&)) {
+        std::shared_ptr<App::BaseParser<DetResult>> base = parser;
+        float sum = 0;
+
+        auto begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops / 10; ++loop) {
+            std::vector<std::shared_ptr<DetResult>> result;
+            parser->App::OutputParser<DetResult>::parse(output, result);
+            sum += result[0]->size();
+        }
+        float buffer_cost = (iLogger::timestamp_now_float() - begin) / (loops / 10);
+
+        begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            std::vector<std::shared_ptr<DetResult>> result;
+            base->parse(output, result);
+            sum += result[0]->size();
+        }
+        float virtual_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        DetectionArena arena;
+        begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            static_parse(output, arena);
+            sum += arena.count(0);
+        }
+        float static_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        FMT_INFO("%s batch %d: buffer2struct %.0f batch/s, virtual parse %.0f batch/s, static parse %.0f batch/s, sum = %.0f",
+                 name, batch_size, 1000 / buffer_cost, 1000 / virtual_cost, 1000 / static_cost, sum);
+    };
+
+    run("mmdeploy", make_mmdeploy_output(batch_size), mmdeploy_det_plg_parser,
+        [](std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) { return StaticDetectionParser<MMDeployDecoder>().parse(output, arena); });
+    run("amirstan", make_amirstan_output(batch_size), amirstan_det_plg_parser,
+        [](std::vector<std::shared_ptr<TRT::Tensor>>& output, DetectionArena& arena) { return StaticDetectionParser<AmirstanDecoder>().parse(output, arena); });
+}
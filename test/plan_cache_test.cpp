@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <builder/plan_cache.hpp>
+#include <onnx/onnx_pb.h>
+#include <ilogger.hpp>
+#include <string>
+#include <vector>
+
+using namespace TRT;
+
+static std::string make_cache_directory(const char* name) {
+    auto directory = iLogger::format("plan_cache_test_%s_%d/", name, (int)iLogger::timestamp_now());
+    iLogger::rmtree(directory, true);
+    return directory;
+}
+
+TEST(PlanCacheCase, SHA256) {
+    ASSERT_EQ(sha256_hex("", 0), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    ASSERT_EQ(sha256_hex("abc", 3), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    // 56字节，padding跨越两个块
+    const char* text = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    ASSERT_EQ(sha256_hex(text, strlen(text)), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // 分多次update与一次计算结果相同
+    std::string million(1000000, 'a');
+    SHA256 sha;
+    for (size_t i = 0; i < million.size(); i += 777) sha.update(million.data() + i, std::min<size_t>(777, million.size() - i));
+    ASSERT_EQ(sha.hex_digest(), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    auto directory = make_cache_directory("sha");
+    ASSERT_TRUE(iLogger::save_file(directory + "model.onnx", million));
+    ASSERT_EQ(sha256_file(directory + "model.onnx"), sha256_hex(million.data(), million.size()));
+    ASSERT_EQ(sha256_file(directory + "not_exists.onnx"), "");
+    iLogger::rmtree(directory);
+}
+
+TEST(PlanCacheCase, KeyDerivation) {
+    PlanKey base;
+    base.onnx_hash          = sha256_hex("model", 5);
+    base.mode               = "FP16";
+    base.max_batch_size     = 8;
+    base.inputs_dims        = {{1, 3, 640, 640}};
+    base.max_workspace_size = 1ul << 30;
+    base.plugins            = {"DCNv2/1", "BatchedNMS_TRT/1"};
+    base.device             = "sm_86 TRT8.2.2";
+    ASSERT_EQ(base.key().size(), 64u);
+    ASSERT_EQ(base.key(), base.key());
+
+    // 插件注册的顺序不影响key
+    auto reordered = base;
+    std::swap(reordered.plugins[0], reordered.plugins[1]);
+    ASSERT_EQ(reordered.key(), base.key());
+
+    std::vector<PlanKey> changed(9, base);
+    changed[0].onnx_hash          = sha256_hex("model2", 6);
+    changed[1].mode               = "FP32";
+    changed[2].max_batch_size     = 16;
+    changed[3].inputs_dims        = {{1, 3, 640, 480}};
+    changed[4].max_workspace_size = 1ul << 28;
+    changed[5].plugins.push_back("ScatterND/1");
+    changed[6].device             = "sm_87 TRT8.2.2";
+    changed[7].extra              = "calibrator=1234";
+    changed[8].external_data      = {sha256_hex("weights", 7)};
+    for (auto& key : changed) ASSERT_NE(key.key(), base.key()) << key.canonical();
+
+    // 维度的分隔不会产生歧义
+    auto a = base, b = base;
+    a.inputs_dims = {{1, 23}};
+    b.inputs_dims = {{12, 3}};
+    ASSERT_NE(a.key(), b.key());
+}
+
+// 两个初始化器在同一个外部文件中，Constant节点的属性引用另一个文件
+TEST(PlanCacheCase, ExternalDataFiles) {
+    onnx::ModelProto model;
+    auto graph = model.mutable_graph();
+    auto external = [](onnx::TensorProto* tensor, const std::string& location) {
+        tensor->set_data_location(onnx::TensorProto::EXTERNAL);
+        auto entry = tensor->add_external_data();
+        entry->set_key("location");
+        entry->set_value(location);
+    };
+    external(graph->add_initializer(), "weights.bin");
+    external(graph->add_initializer(), "weights.bin");
+    graph->add_initializer()->set_raw_data("inline");
+    auto attribute = graph->add_node()->add_attribute();
+    attribute->set_name("value");
+    external(attribute->mutable_t(), "constant.bin");
+
+    std::string data;
+    model.SerializeToString(&data);
+    auto directory = make_cache_directory("external");
+    ASSERT_TRUE(iLogger::save_file(directory + "model.onnx", data));
+
+    std::vector<std::string> files;
+    ASSERT_TRUE(onnx_external_data_files(directory + "model.onnx", files));
+    ASSERT_EQ(files, (std::vector<std::string>{directory + "constant.bin", directory + "weights.bin"}));
+    ASSERT_TRUE(onnx_external_data_locations(data.data(), data.size(), files));
+    ASSERT_EQ(files, (std::vector<std::string>{"constant.bin", "weights.bin"}));
+
+    // 没有外部数据的模型
+    graph->clear_initializer();
+    graph->clear_node();
+    model.SerializeToString(&data);
+    ASSERT_TRUE(onnx_external_data_locations(data.data(), data.size(), files));
+    ASSERT_TRUE(files.empty());
+    ASSERT_FALSE(onnx_external_data_files(directory + "missing.onnx", files));
+    iLogger::rmtree(directory);
+}
+
+TEST(PlanCacheCase, StoreAndLoad) {
+    auto directory = make_cache_directory("store");
+    PlanCache cache(directory);
+    std::vector<uint8_t> plan(1000, 7), loaded;
+
+    ASSERT_FALSE(cache.load("k0", loaded));
+    ASSERT_TRUE(cache.save("k0", plan.data(), plan.size()));
+    ASSERT_TRUE(cache.contains("k0"));
+    ASSERT_TRUE(cache.load("k0", loaded));
+    ASSERT_EQ(loaded, plan);
+    ASSERT_FALSE(cache.save("empty", nullptr, 0));
+
+    // 覆盖写入，不残留临时文件
+    plan.assign(500, 9);
+    ASSERT_TRUE(cache.save("k0", plan.data(), plan.size()));
+    ASSERT_TRUE(cache.load("k0", loaded));
+    ASSERT_EQ(loaded, plan);
+    ASSERT_EQ(iLogger::find_files(directory, "*").size(), 1u);
+
+    // 空文件视为损坏，读取失败并删除
+    ASSERT_TRUE(iLogger::save_file(cache.file("broken"), std::string()));
+    ASSERT_FALSE(cache.load("broken", loaded));
+    ASSERT_FALSE(cache.contains("broken"));
+
+    ASSERT_TRUE(cache.remove("k0"));
+    ASSERT_EQ(cache.keys().size(), 0u);
+    iLogger::rmtree(directory);
+}
+
+TEST(PlanCacheCase, LRUEviction) {
+    auto directory = make_cache_directory("lru");
+    std::vector<uint8_t> plan(1000, 1);
+    {
+        PlanCache cache(directory);
+        for (auto key : {"a", "b", "c"}) ASSERT_TRUE(cache.save(key, plan.data(), plan.size()));
+        ASSERT_EQ(cache.keys(), (std::vector<std::string>{"a", "b", "c"}));
+
+        // 读取a之后，b变成最久未使用
+        std::vector<uint8_t> loaded;
+        ASSERT_TRUE(cache.load("a", loaded));
+        ASSERT_EQ(cache.keys(), (std::vector<std::string>{"b", "c", "a"}));
+        ASSERT_EQ(cache.total_size(), 3000u);
+    }
+
+    // 限制2500字节，写入d时需要淘汰b、c
+    PlanCache cache(directory, 2500);
+    ASSERT_TRUE(cache.save("d", plan.data(), plan.size()));
+    ASSERT_EQ(cache.keys(), (std::vector<std::string>{"a", "d"}));
+    ASSERT_LE(cache.total_size(), 2500u);
+
+    // 单个文件超过上限时仍然保留最新的一个
+    std::vector<uint8_t> big(4000, 2);
+    ASSERT_TRUE(cache.save("e", big.data(), big.size()));
+    ASSERT_EQ(cache.keys(), std::vector<std::string>{"e"});
+    iLogger::rmtree(directory);
+}
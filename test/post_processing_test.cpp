@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include <post_processing.h>
+#include <preprocess_kernel_cpu.hpp>
+#include <ilogger.hpp>
+#include <random>
+#include <vector>
+
+using namespace PostProcessing;
+using Detection::BBox;
+
+// 随机框，聚集在少数几个中心附近以产生大量重叠，confidence互不相同
+static std::vector<BBox> random_bboxes(int n, int num_classes, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> center(0, 1000), jitter(-20, 20), size(20, 120);
+    std::vector<float> centers_x(32), centers_y(32);
+    for (int i = 0; i < 32; ++i) {
+        centers_x[i] = center(rng);
+        centers_y[i] = center(rng);
+    }
+
+    std::vector<BBox> bboxes;
+    for (int i = 0; i < n; ++i) {
+        float cx = centers_x[i % 32] + jitter(rng);
+        float cy = centers_y[i % 32] + jitter(rng);
+        float w = size(rng), h = size(rng);
+        float confidence = (float)(n - i) / n * 0.999f;
+        bboxes.emplace_back(cx - w / 2, cy - h / 2, cx + w / 2, cy + h / 2, confidence, (float)(rng() % num_classes));
+    }
+    std::shuffle(bboxes.begin(), bboxes.end(), rng);
+    return bboxes;
+}
+
+// 与tutorial中nms_kernel语义相同的O(n^2)实现：被同类、更高分且重叠的框抑制
+static std::vector<BBox> reference_nms(std::vector<BBox> bboxes, float iou_threshold, bool class_agnostic) {
+    std::sort(bboxes.begin(), bboxes.end(), [](const BBox& a, const BBox& b) { return a.confidence > b.confidence; });
+    std::vector<BBox> keep;
+    for (auto& b : bboxes) {
+        bool removed = false;
+        for (auto& k : keep) {
+            if ((class_agnostic || k.label == b.label) && box_iou(k, b) > iou_threshold) {
+                removed = true;
+                break;
+            }
+        }
+        if (!removed) keep.emplace_back(b);
+    }
+    return keep;
+}
+
+static void expect_same_bboxes(const std::vector<BBox>& a, const std::vector<BBox>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i].left, b[i].left);
+        ASSERT_EQ(a[i].top, b[i].top);
+        ASSERT_EQ(a[i].confidence, b[i].confidence);
+        ASSERT_EQ(a[i].label, b[i].label);
+    }
+}
+
+TEST(PostProcessingCase, IoU) {
+    ASSERT_FLOAT_EQ(box_iou(BBox(0, 0, 10, 10, 1, 0), BBox(5, 0, 15, 10, 1, 0)), 50.0f / 150.0f);
+    ASSERT_EQ(box_iou(BBox(0, 0, 10, 10, 1, 0), BBox(10, 0, 20, 10, 1, 0)), 0.0f);
+    ASSERT_EQ(box_iou(BBox(0, 0, 0, 0, 1, 0), BBox(0, 0, 0, 0, 1, 0)), 0.0f);
+
+    // AVX2和标量结果一致，包括尾部不足8个的部分
+    auto bboxes = random_bboxes(1003, 1, 1);
+    std::vector<float> left, top, right, bottom;
+    for (auto& b : bboxes) {
+        left.push_back(b.left); top.push_back(b.top); right.push_back(b.right); bottom.push_back(b.bottom);
+    }
+    std::vector<float> simd(bboxes.size()), scalar(bboxes.size());
+    box_iou(bboxes[0], left.data(), top.data(), right.data(), bottom.data(), bboxes.size(), simd.data());
+    CPUKernel::set_avx2_enabled(false);
+    box_iou(bboxes[0], left.data(), top.data(), right.data(), bottom.data(), bboxes.size(), scalar.data());
+    CPUKernel::set_avx2_enabled(true);
+    for (size_t i = 0; i < bboxes.size(); ++i) {
+        ASSERT_FLOAT_EQ(simd[i], scalar[i]);
+        ASSERT_FLOAT_EQ(scalar[i], box_iou(bboxes[0], bboxes[i]));
+    }
+}
+
+TEST(PostProcessingCase, FilterTopK) {
+    auto bboxes = random_bboxes(1000, 3, 2);
+    filter_topk(bboxes, 0.5f, 100);
+    ASSERT_EQ(bboxes.size(), 100u);
+    ASSERT_NEAR(bboxes.front().confidence, 0.999f, 1e-6);
+    for (size_t i = 1; i < bboxes.size(); ++i) {
+        ASSERT_GT(bboxes[i - 1].confidence, bboxes[i].confidence);
+    }
+
+    // 通过阈值的不足top_k个
+    bboxes = random_bboxes(1000, 3, 2);
+    filter_topk(bboxes, 0.9f, 500);
+    ASSERT_EQ(bboxes.size(), 100u);
+    ASSERT_GE(bboxes.back().confidence, 0.9f);
+}
+
+TEST(PostProcessingCase, NMS) {
+    auto bboxes = random_bboxes(3000, 5, 3);
+    for (bool agnostic : {false, true}) {
+        auto keep = nms(bboxes, 0.45f, agnostic);
+        expect_same_bboxes(keep, reference_nms(bboxes, 0.45f, agnostic));
+
+        auto limited = nms(bboxes, 0.45f, agnostic, 10);
+        keep.resize(10);
+        expect_same_bboxes(limited, keep);
+    }
+
+    // 按类别抑制时保留的框更多
+    ASSERT_GT(nms(bboxes, 0.45f, false).size(), nms(bboxes, 0.45f, true).size());
+    ASSERT_TRUE(nms({}, 0.45f).empty());
+}
+
+TEST(PostProcessingCase, SoftNMS) {
+    std::vector<BBox> bboxes{
+        BBox(0, 0, 10, 10, 0.9f, 0),
+        BBox(1, 0, 11, 10, 0.8f, 0),    // 与第一个的IoU = 90 / 110
+        BBox(100, 100, 110, 110, 0.7f, 0),
+        BBox(1, 0, 11, 10, 0.6f, 1)     // 不同类不衰减
+    };
+    float iou = 90.0f / 110.0f;
+
+    auto linear = soft_nms(bboxes, 0.3f, 0.5f, 0.01f, SoftNMSMethod::Linear);
+    ASSERT_EQ(linear.size(), 4u);
+    ASSERT_EQ(linear[0].confidence, 0.9f);
+    ASSERT_EQ(linear[1].confidence, 0.7f);
+    ASSERT_EQ(linear[2].confidence, 0.6f);
+    ASSERT_FLOAT_EQ(linear[3].confidence, 0.8f * (1 - iou));
+
+    auto gaussian = soft_nms(bboxes, 0.3f, 0.5f, 0.01f, SoftNMSMethod::Gaussian);
+    ASSERT_EQ(gaussian.size(), 4u);
+    ASSERT_FLOAT_EQ(gaussian[3].confidence, 0.8f * expf(-iou * iou / 0.5f));
+
+    // 衰减后低于score_threshold被丢弃；不区分类别时第四个框也被衰减
+    ASSERT_EQ(soft_nms(bboxes, 0.3f, 0.5f, 0.2f, SoftNMSMethod::Linear).size(), 3u);
+    ASSERT_EQ(soft_nms(bboxes, 0.3f, 0.5f, 0.2f, SoftNMSMethod::Linear, true).size(), 2u);
+}
+
+TEST(PostProcessingCase, BatchedNMS) {
+    const int batch_size = 3, num_bboxes = 2000, num_classes = 4;
+    TRT::Tensor predict(std::vector<int>{batch_size, num_bboxes, 4 + num_classes});
+    std::vector<std::vector<BBox>> expect;
+    NMSParam param;
+    param.confidence_threshold = 0.3f;
+    param.top_k = 500;
+    param.box_format = BoxFormat::CXCYWH;
+
+    for (int ibatch = 0; ibatch < batch_size; ++ibatch) {
+        auto bboxes = random_bboxes(num_bboxes, num_classes, 10 + ibatch);
+        for (int i = 0; i < num_bboxes; ++i) {
+            auto& b = bboxes[i];
+            float* pitem = predict.cpu<float>(ibatch, i);
+            pitem[0] = (b.left + b.right) / 2;
+            pitem[1] = (b.top + b.bottom) / 2;
+            pitem[2] = b.right - b.left;
+            pitem[3] = b.bottom - b.top;
+            for (int c = 0; c < num_classes; ++c) {
+                pitem[4 + c] = c == (int)b.label ? b.confidence : b.confidence * 0.1f;
+            }
+        }
+        filter_topk(bboxes, param.confidence_threshold, param.top_k);
+        expect.emplace_back(reference_nms(bboxes, param.iou_threshold, false));
+    }
+
+    std::vector<std::shared_ptr<Detection::DetResult>> result;
+    ASSERT_EQ(batched_nms(predict, param, result), 0);
+    ASSERT_EQ(result.size(), (size_t)batch_size);
+    for (int ibatch = 0; ibatch < batch_size; ++ibatch) {
+        auto keep = result[ibatch]->immutable_bboxes();
+        ASSERT_EQ(keep.size(), std::min<size_t>(expect[ibatch].size(), param.max_output));
+        for (size_t i = 0; i < keep.size(); ++i) {
+            ASSERT_NEAR(keep[i].left, expect[ibatch][i].left, 1e-3);
+            ASSERT_NEAR(keep[i].bottom, expect[ibatch][i].bottom, 1e-3);
+            ASSERT_EQ(keep[i].confidence, expect[ibatch][i].confidence);
+            ASSERT_EQ(keep[i].label, expect[ibatch][i].label);
+        }
+    }
+
+    TRT::Tensor wrong(std::vector<int>{1, 10, 4});
+    ASSERT_EQ(batched_nms(wrong, param, result), -1);
+}
+
+// 候选数从1k到100k，分别统计 过滤+top-K、NMS 的耗时
+TEST(PostProcessingBenchMark, CandidateSweep) {
+    for (int n : {1000, 10000, 100000}) {
+        auto bboxes = random_bboxes(n, 80, n);
+        float costs[3] = {0};
+        size_t kept[3] = {0};
+
+        for (int avx2 = 0; avx2 < 2; ++avx2) {
+            CPUKernel::set_avx2_enabled(avx2 == 1);
+            auto begin = iLogger::timestamp_now_float();
+            kept[avx2] = nms(bboxes, 0.45f, true).size();
+            costs[avx2] = iLogger::timestamp_now_float() - begin;
+        }
+
+        auto begin = iLogger::timestamp_now_float();
+        auto candidates = bboxes;
+        filter_topk(candidates, 0.25f, 1000);
+        kept[2] = nms(candidates, 0.45f, false, Detection::MAX_IMAGE_BBOX).size();
+        costs[2] = iLogger::timestamp_now_float() - begin;
+
+        FMT_INFO("N = %d, agnostic nms scalar: %.2f ms, avx2: %.2f ms (keep %d), filter + top-1000 + nms: %.2f ms (keep %d)",
+                 n, costs[0], costs[1], (int)kept[1], costs[2], (int)kept[2]);
+        ASSERT_EQ(kept[0], kept[1]);
+    }
+}
@@ -0,0 +1,317 @@
+#include <gtest/gtest.h>
+
+#include <preprocess_kernel_cpu.hpp>
+#include <trt_tensor.hpp>
+#include <opencv2/opencv.hpp>
+#include <ilogger.hpp>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+static const float kMean[] = {123.675f, 116.28f, 103.53f};
+static const float kStd[]  = {58.395f, 57.12f, 57.375f};
+
+// 原Tensor::set_norm_mat的OpenCV实现：resize -> cvtColor -> convertTo -> split -> (x - mean) / std
+static void opencv_norm(const cv::Mat& image, int width, int height, float* dst) {
+    cv::Mat inputframe = image;
+    if (inputframe.size() != cv::Size(width, height))
+        cv::resize(inputframe, inputframe, cv::Size(width, height));
+    cv::cvtColor(inputframe, inputframe, cv::COLOR_BGR2RGB);
+    inputframe.convertTo(inputframe, CV_32F);
+
+    cv::Mat ms[3];
+    for (int c = 0; c < 3; ++c)
+        ms[c] = cv::Mat(height, width, CV_32F, dst + c * width * height);
+    cv::split(inputframe, ms);
+    for (int c = 0; c < 3; ++c)
+        ms[c] = (ms[c] - kMean[c]) / kStd[c];
+}
+
+static void fused_norm(const cv::Mat& image, int width, int height, float* dst) {
+    auto norm = CPUKernel::Norm::mean_std(kMean, kStd, 1.0f, CPUKernel::ChannelType::Invert);
+    CPUKernel::resize_bilinear_and_normalize(image.data, image.step, image.cols, image.rows, dst, width, height, norm);
+}
+
+static cv::Mat random_image(int width, int height) {
+    cv::Mat image(height, width, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+    return image;
+}
+
+// 两者都是11位定点的双线性插值，区别只在舍入方式，换算回像素值后误差不超过1
+TEST(PreprocessKernelCPUCase, MatchOpenCV) {
+    int sizes[][4] = {
+        {1920, 1080, 640, 640}, {1920, 1080, 1024, 1024}, {640, 480, 640, 480},
+        {320, 240, 640, 480},   {1000, 1000, 500, 500},   {97, 53, 211, 131}
+    };
+    for (auto& size : sizes) {
+        cv::Mat image = random_image(size[0], size[1]);
+        int width = size[2], height = size[3];
+        std::vector<float> expect(3 * width * height), output(expect.size());
+        opencv_norm(image, width, height, expect.data());
+        fused_norm(image, width, height, output.data());
+
+        float max_diff = 0;
+        int exact = 0;
+        for (int i = 0; i < expect.size(); ++i) {
+            float diff = fabs(expect[i] - output[i]) * kStd[i / (width * height)];
+            max_diff = std::max(max_diff, diff);
+            if (diff < 1e-3f) exact++;
+        }
+        INFO("%dx%d -> %dx%d, max diff: %.4f pixel, exact: %.2f%%", size[0], size[1], width, height, max_diff, exact * 100.0f / expect.size());
+        ASSERT_LE(max_diff, 1.0f + 1e-3f);
+        if (size[0] == width && size[1] == height)
+            ASSERT_LE(max_diff, 1e-3f);
+    }
+}
+
+TEST(PreprocessKernelCPUCase, ScalarEqualsSIMD) {
+    if (!CPUKernel::avx2_enabled()) {
+        INFOW("AVX2 is not supported, skip");
+        return;
+    }
+
+    cv::Mat image = random_image(1280, 720);
+    std::vector<CPUKernel::Norm> norms{
+        CPUKernel::Norm::mean_std(kMean, kStd, 1 / 255.0f, CPUKernel::ChannelType::Invert),
+        CPUKernel::Norm::alpha_beta(1 / 255.0f, 0.5f),
+        CPUKernel::Norm::None()
+    };
+    for (auto& norm : norms) {
+        std::vector<float> simd(3 * 333 * 517), scalar(simd.size());
+        CPUKernel::resize_bilinear_and_normalize(image.data, image.step, image.cols, image.rows, simd.data(), 333, 517, norm);
+        CPUKernel::set_avx2_enabled(false);
+        CPUKernel::resize_bilinear_and_normalize(image.data, image.step, image.cols, image.rows, scalar.data(), 333, 517, norm);
+        CPUKernel::set_avx2_enabled(true);
+        ASSERT_EQ(simd, scalar);
+    }
+}
+
+TEST(PreprocessKernelCPUBenchMark, FusedVsOpenCV) {
+    const int loops = 20;
+    cv::Mat image = random_image(1920, 1080);
+
+    for (int size : {640, 1024, 2016}) {
+        std::vector<float> output(3 * size * size);
+
+        auto begin = iLogger::timestamp_now_float();
+        for (int i = 0; i < loops; ++i) opencv_norm(image, size, size, output.data());
+        float opencv_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        CPUKernel::set_avx2_enabled(false);
+        begin = iLogger::timestamp_now_float();
+        for (int i = 0; i < loops; ++i) fused_norm(image, size, size, output.data());
+        float scalar_cost = (iLogger::timestamp_now_float() - begin) / loops;
+        CPUKernel::set_avx2_enabled(true);
+
+        begin = iLogger::timestamp_now_float();
+        for (int i = 0; i < loops; ++i) fused_norm(image, size, size, output.data());
+        float simd_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+        INFO("1920x1080 -> %dx%d, opencv: %.2f ms, fused scalar: %.2f ms, fused %s: %.2f ms, speedup: %.2fx",
+             size, size, opencv_cost, scalar_cost, CPUKernel::avx2_enabled() ? "avx2" : "scalar", simd_cost, opencv_cost / simd_cost);
+    }
+}
+
+static std::vector<uint8_t> random_bgr(int width, int height, int line_size, unsigned seed) {
+    std::vector<uint8_t> image((size_t)line_size * height);
+    srand(seed);
+    for (auto& v : image) v = rand() % 256;
+    return image;
+}
+
+// 恒等仿射变换：输出等于原图做通道交换和归一化
+TEST(PreprocessKernelCPUCase, WarpAffineIdentity) {
+    const int width = 67, height = 45, line_size = width * 3 + 4;
+    auto image = random_bgr(width, height, line_size, 1);
+    float matrix[] = {1, 0, 0, 0, 1, 0};
+    auto norm = CPUKernel::Norm::alpha_beta(1.0f, 0.0f, CPUKernel::ChannelType::Invert);
+
+    std::vector<float> output(3 * width * height);
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), line_size, width, height, output.data(), width, height, matrix, 114, norm);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                ASSERT_EQ(output[(2 - c) * width * height + y * width + x], image[y * line_size + x * 3 + c]);
+            }
+        }
+    }
+
+    // 整体平移到图像外，全部为const_value
+    float outside[] = {1, 0, 1000, 0, 1, 0};
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), line_size, width, height, output.data(), width, height, outside, 114, CPUKernel::Norm::None());
+    for (float v : output) ASSERT_EQ(v, 114);
+}
+
+// 最后一行为[0, 0, 1]的透视变换与仿射变换结果一致
+TEST(PreprocessKernelCPUCase, WarpPerspectiveAsAffine) {
+    const int width = 320, height = 240;
+    auto image = random_bgr(width, height, width * 3, 2);
+    float affine[]      = {0.8f, 0.1f, -12.5f, -0.05f, 1.2f, 7.25f};
+    float perspective[] = {0.8f, 0.1f, -12.5f, -0.05f, 1.2f, 7.25f, 0, 0, 1};
+    auto norm = CPUKernel::Norm::mean_std(kMean, kStd, 1.0f, CPUKernel::ChannelType::Invert);
+
+    std::vector<float> a(3 * 256 * 200), b(a.size());
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), width * 3, width, height, a.data(), 256, 200, affine, 114, norm);
+    CPUKernel::warp_perspective(image.data(), width * 3, width, height, b.data(), 256, 200, perspective, 114, norm);
+    ASSERT_EQ(a, b);
+}
+
+// focus输出是plane输出的重排：x[..., ::2, ::2], x[..., 1::2, ::2], x[..., ::2, 1::2], x[..., 1::2, 1::2]
+TEST(PreprocessKernelCPUCase, WarpAffineFocusLayout) {
+    const int width = 100, height = 80, dst_width = 64, dst_height = 48;
+    auto image = random_bgr(width, height, width * 3, 3);
+    float focus[] = {1.5f, -3.0f, 2.0f};
+    float plane[] = {1.5f, 0, -3.0f, 0, 1.5f, 2.0f};
+    auto norm = CPUKernel::Norm::alpha_beta(1 / 255.0f, 0.0f);
+
+    std::vector<float> a(3 * dst_width * dst_height), b(a.size());
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), width * 3, width, height, a.data(), dst_width, dst_height, plane, 0, norm);
+    CPUKernel::warp_affine_bilinear_and_normalize_focus(image.data(), width * 3, width, height, b.data(), dst_width, dst_height, focus, 0, norm);
+
+    int fw = dst_width / 2, fh = dst_height / 2;
+    for (int p = 0; p < 3; ++p) {
+        for (int y = 0; y < dst_height; ++y) {
+            for (int x = 0; x < dst_width; ++x) {
+                int fc = ((x % 2) << 1) | (y % 2);
+                ASSERT_EQ(b[((fc * 3 + p) * fh + y / 2) * fw + x / 2], a[(p * dst_height + y) * dst_width + x]);
+            }
+        }
+    }
+}
+
+// 多线程切块与单线程结果逐位一致
+TEST(PreprocessKernelCPUCase, ThreadsDeterministic) {
+    const int width = 1280, height = 720;
+    auto image = random_bgr(width, height, width * 3, 4);
+    auto norm = CPUKernel::Norm::mean_std(kMean, kStd, 1 / 255.0f, CPUKernel::ChannelType::Invert);
+    float matrix[] = {0.5f, 0, 10, 0, 0.5f, 20};
+
+    std::vector<float> resize_single(3 * 640 * 640), resize_multi(resize_single.size());
+    std::vector<float> warp_single(resize_single.size()), warp_multi(resize_single.size());
+    CPUKernel::set_num_threads(1);
+    CPUKernel::resize_bilinear_and_normalize(image.data(), width * 3, width, height, resize_single.data(), 640, 640, norm);
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), width * 3, width, height, warp_single.data(), 640, 640, matrix, 114, norm);
+    CPUKernel::set_num_threads(4);
+    CPUKernel::resize_bilinear_and_normalize(image.data(), width * 3, width, height, resize_multi.data(), 640, 640, norm);
+    CPUKernel::warp_affine_bilinear_and_normalize_plane(image.data(), width * 3, width, height, warp_multi.data(), 640, 640, matrix, 114, norm);
+    CPUKernel::set_num_threads(0);
+
+    ASSERT_EQ(resize_single, resize_multi);
+    ASSERT_EQ(warp_single, warp_multi);
+}
+
+TEST(PreprocessKernelCPUCase, NormFeature) {
+    const int num_feature = 37, feature_length = 512;
+    std::vector<float> features(num_feature * feature_length);
+    for (int i = 0; i < features.size(); ++i) features[i] = sinf(i * 0.37f) * (1 + i % 7);
+    std::vector<float> origin(features);
+
+    CPUKernel::norm_feature(features.data(), num_feature, feature_length);
+    for (int i = 0; i < num_feature; ++i) {
+        double sum = 0, l2 = 0;
+        for (int k = 0; k < feature_length; ++k) {
+            sum += features[i * feature_length + k] * features[i * feature_length + k];
+            l2  += origin[i * feature_length + k] * origin[i * feature_length + k];
+        }
+        ASSERT_NEAR(sum, 1.0, 1e-4);
+        ASSERT_NEAR(features[i * feature_length + 3], origin[i * feature_length + 3] / sqrt(l2), 1e-5);
+    }
+}
+
+TEST(PreprocessKernelCPUCase, NV12ToBGR) {
+    const int width = 4, height = 2, linesize = 8;
+    // 前两个像素共用uv(128, 128)：黑、白；后两个像素共用uv(240, 110)，偏蓝
+    uint8_t y[]  = {16, 235, 41, 81, 0, 0, 0, 0,
+                    16, 235, 41, 81, 0, 0, 0, 0};
+    uint8_t uv[] = {128, 128, 240, 110, 0, 0, 0, 0};
+    std::vector<uint8_t> bgr(width * height * 3);
+    CPUKernel::convert_nv12_to_bgr_invoke(y, uv, width, height, linesize, bgr.data());
+
+    uint8_t expect[][3] = {{0, 0, 0}, {254, 254, 254}, {255, 0, 0}, {255, 46, 46}};
+    for (int row = 0; row < height; ++row) {
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                ASSERT_NEAR(bgr[(row * width + x) * 3 + c], expect[x][c], 1) << "x=" << x << ", c=" << c;
+            }
+        }
+    }
+}
+
+// 有GPU时，CPU与CUDA两个后端的结果交叉对比：resize为定点插值，期望逐位一致；warp为浮点插值，允许1个像素值的误差
+TEST(PreprocessKernelCPUCase, CrossCheckCUDA) {
+    if (!PreprocessKernel::has_backend(PreprocessKernel::Backend::CUDA)) {
+        INFOW("No CUDA device, skip");
+        return;
+    }
+
+    auto& cpu = PreprocessKernel::cpu_kernels();
+    auto& gpu = PreprocessKernel::cuda_kernels();
+    const int width = 1280, height = 720, dst_width = 640, dst_height = 384;
+    auto image = random_bgr(width, height, width * 3, 5);
+    auto norm  = CPUKernel::Norm::mean_std(kMean, kStd, 1.0f, CPUKernel::ChannelType::Invert);
+
+    TRT::Tensor src(std::vector<int>{height, width, 3}, TRT::DataType::UInt8);
+    memcpy(src.cpu<uint8_t>(), image.data(), image.size());
+    TRT::Tensor gpu_output(std::vector<int>{3, dst_height, dst_width});
+    TRT::Tensor cpu_output(std::vector<int>{3, dst_height, dst_width});
+
+    TRT::Tensor matrix(std::vector<int>{9});
+    float affine[] = {2.0f, 0.1f, -3.5f, -0.05f, 1.9f, 4.25f, 0, 0, 1};
+    memcpy(matrix.cpu<float>(), affine, sizeof(affine));
+
+    // 返回换算到像素值的最大误差
+    auto max_pixel_diff = [&]() {
+        float max_diff = 0;
+        const float* a = cpu_output.cpu<float>();
+        const float* b = gpu_output.to_cpu().cpu<float>();
+        for (int i = 0; i < cpu_output.numel(); ++i)
+            max_diff = std::max(max_diff, fabs(a[i] - b[i]) * kStd[i / (dst_width * dst_height)]);
+        return max_diff;
+    };
+
+    cpu.resize_bilinear_and_normalize(src.cpu<uint8_t>(), width * 3, width, height, cpu_output.cpu<float>(), dst_width, dst_height, norm, nullptr);
+    gpu.resize_bilinear_and_normalize(src.gpu<uint8_t>(), width * 3, width, height, gpu_output.gpu<float>(), dst_width, dst_height, norm, nullptr);
+    float resize_diff = max_pixel_diff();
+
+    cpu.warp_affine_bilinear_and_normalize_plane(src.cpu<uint8_t>(), width * 3, width, height, cpu_output.cpu<float>(), dst_width, dst_height, matrix.cpu<float>(), 114, norm, nullptr);
+    gpu.warp_affine_bilinear_and_normalize_plane(src.gpu<uint8_t>(), width * 3, width, height, gpu_output.gpu<float>(), dst_width, dst_height, matrix.gpu<float>(), 114, norm, nullptr);
+    float affine_diff = max_pixel_diff();
+
+    cpu.warp_perspective(src.cpu<uint8_t>(), width * 3, width, height, cpu_output.cpu<float>(), dst_width, dst_height, matrix.cpu<float>(), 114, norm, nullptr);
+    gpu.warp_perspective(src.gpu<uint8_t>(), width * 3, width, height, gpu_output.gpu<float>(), dst_width, dst_height, matrix.gpu<float>(), 114, norm, nullptr);
+    float perspective_diff = max_pixel_diff();
+
+    cpu.warp_affine_bilinear_and_normalize_focus(src.cpu<uint8_t>(), width * 3, width, height, cpu_output.cpu<float>(), dst_width, dst_height, matrix.cpu<float>(), 114, norm, nullptr);
+    gpu.warp_affine_bilinear_and_normalize_focus(src.gpu<uint8_t>(), width * 3, width, height, gpu_output.gpu<float>(), dst_width, dst_height, matrix.gpu<float>(), 114, norm, nullptr);
+    float focus_diff = max_pixel_diff();
+
+    INFO("cpu vs cuda, max pixel diff: resize %.4f, affine %.4f, perspective %.4f, focus %.4f", resize_diff, affine_diff, perspective_diff, focus_diff);
+    ASSERT_LE(resize_diff, 1e-3f);
+    ASSERT_LE(affine_diff, 1.0f + 1e-3f);
+    ASSERT_LE(perspective_diff, 1.0f + 1e-3f);
+    ASSERT_LE(focus_diff, 1.0f + 1e-3f);
+
+    // norm_feature：feature_length需为32的倍数
+    TRT::Tensor features(std::vector<int>{16, 256});
+    for (int i = 0; i < features.numel(); ++i) features.cpu<float>()[i] = sinf(i * 0.11f);
+    std::vector<float> cpu_features(features.cpu<float>(), features.cpu<float>() + features.numel());
+    cpu.norm_feature(cpu_features.data(), 16, 256, nullptr);
+    gpu.norm_feature(features.gpu<float>(), 16, 256, nullptr);
+    features.to_cpu();
+    for (int i = 0; i < features.numel(); ++i)
+        ASSERT_NEAR(features.cpu<float>()[i], cpu_features[i], 1e-5f);
+
+    // nv12
+    TRT::Tensor nv12(std::vector<int>{height * 3 / 2, width}, TRT::DataType::UInt8);
+    memcpy(nv12.cpu<uint8_t>(), image.data(), nv12.numel());
+    TRT::Tensor gpu_bgr(std::vector<int>{height, width, 3}, TRT::DataType::UInt8);
+    std::vector<uint8_t> cpu_bgr(gpu_bgr.numel());
+    cpu.convert_nv12_to_bgr_invoke(nv12.cpu<uint8_t>(), nv12.cpu<uint8_t>() + width * height, width, height, width, cpu_bgr.data(), nullptr);
+    gpu.convert_nv12_to_bgr_invoke(nv12.gpu<uint8_t>(), nv12.gpu<uint8_t>() + width * height, width, height, width, gpu_bgr.gpu<uint8_t>(), nullptr);
+    gpu_bgr.to_cpu();
+    for (int i = 0; i < cpu_bgr.size(); ++i)
+        ASSERT_NEAR(cpu_bgr[i], gpu_bgr.cpu<uint8_t>()[i], 1);
+}
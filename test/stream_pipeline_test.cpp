@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+
+#include <infer/stream_pipeline.hpp>
+#include <ilogger.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace TRT;
+
+/* CPU上模拟CUDA的stream和event：每个stream一个线程按顺序执行任务
+   event记录时分配一个递增的代数，执行到该位置时标记完成；等待时只等记录那一刻的代数
+*/
+class FakeStreamBackend : public StreamBackend {
+public:
+    struct Event {
+        std::mutex lock;
+        std::condition_variable cv;
+        long long recorded = 0;
+        long long completed = 0;
+
+        void wait(long long target) {
+            std::unique_lock<std::mutex> l(lock);
+            cv.wait(l, [&]() { return completed >= target; });
+        }
+    };
+
+    struct Stream {
+        std::mutex lock;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        bool run = true;
+        std::thread worker;
+
+        Stream() { worker = std::thread(&Stream::loop, this); }
+        ~Stream() {
+            {
+                std::unique_lock<std::mutex> l(lock);
+                run = false;
+            }
+            cv.notify_all();
+            worker.join();
+        }
+
+        void push(const std::function<void()>& task) {
+            {
+                std::unique_lock<std::mutex> l(lock);
+                tasks.push_back(task);
+            }
+            cv.notify_all();
+        }
+
+        void loop() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> l(lock);
+                    cv.wait(l, [&]() { return !run || !tasks.empty(); });
+                    if (tasks.empty()) return;
+                    task = tasks.front();
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+
+    // 在stream上异步执行一个CPU函数，相当于kernel或者memcpyAsync
+    void launch(StageStream stream, const std::function<void()>& func) { ((Stream*)stream)->push(func); }
+
+    virtual StageStream create_stream() override { return new Stream(); }
+    virtual void destroy_stream(StageStream stream) override { delete (Stream*)stream; }
+    virtual StageEvent create_event() override { return new Event(); }
+    virtual void destroy_event(StageEvent event) override { delete (Event*)event; }
+
+    virtual void record_event(StageEvent event, StageStream stream) override {
+        Event* e = (Event*)event;
+        long long generation = 0;
+        {
+            std::unique_lock<std::mutex> l(e->lock);
+            generation = ++e->recorded;
+        }
+        launch(stream, [e, generation]() {
+            // 持有锁通知，等待者返回后可能立即销毁event
+            std::unique_lock<std::mutex> l(e->lock);
+            e->completed = std::max(e->completed, generation);
+            e->cv.notify_all();
+        });
+    }
+
+    virtual void stream_wait_event(StageStream stream, StageEvent event) override {
+        Event* e = (Event*)event;
+        long long target = recorded(e);
+        launch(stream, [e, target]() { e->wait(target); });
+    }
+
+    virtual void event_synchronize(StageEvent event) override {
+        Event* e = (Event*)event;
+        e->wait(recorded(e));
+    }
+
+    virtual bool event_query(StageEvent event) override {
+        Event* e = (Event*)event;
+        std::unique_lock<std::mutex> l(e->lock);
+        return e->completed >= e->recorded;
+    }
+
+private:
+    static long long recorded(Event* e) {
+        std::unique_lock<std::mutex> l(e->lock);
+        return e->recorded;
+    }
+};
+
+// 每次提交：host输入 -> 槽位的"device"输入 -> 槽位的"device"输出(x * 2 + 1) -> 槽位的host输出
+struct FakeBuffers {
+    std::vector<int> device_input, device_output, host_output;
+    explicit FakeBuffers(int num_slots) : device_input(num_slots, -1), device_output(num_slots, -1), host_output(num_slots, -1) {}
+};
+
+TEST(StagePipelineCase, ResultsAndExpiry) {
+    auto backend = std::make_shared<FakeStreamBackend>();
+    StagePipeline pipeline(backend, 3);
+    FakeBuffers buffers(3);
+    FakeStreamBackend* fake = backend.get();
+
+    for (int k = 0; k < 10; ++k) {
+        long long sequence = pipeline.submit(
+            [&, k](int slot, StageStream stream) { fake->launch(stream, [&, k, slot]() { buffers.device_input[slot] = k; }); },
+            [&](int slot, StageStream stream) {
+                fake->launch(stream, [&, slot]() { buffers.device_output[slot] = buffers.device_input[slot] * 2 + 1; });
+            },
+            [&](int slot, StageStream stream) { fake->launch(stream, [&, slot]() { buffers.host_output[slot] = buffers.device_output[slot]; }); });
+        ASSERT_EQ(sequence, k);
+        ASSERT_EQ(pipeline.slot(sequence), k % 3);
+
+        // 上一批在下一次提交之前读取，结果还没有被覆盖
+        if (k > 0) {
+            ASSERT_TRUE(pipeline.wait_stage(k - 1));
+            ASSERT_EQ(buffers.host_output[pipeline.slot(k - 1)], (k - 1) * 2 + 1);
+        }
+    }
+
+    ASSERT_TRUE(pipeline.wait_stage(9));
+    ASSERT_TRUE(pipeline.query(9));
+    ASSERT_EQ(buffers.host_output[pipeline.slot(9)], 19);
+
+    // 7、8、9还占着槽位，6之前的已经被覆盖
+    ASSERT_FALSE(pipeline.expired(7));
+    ASSERT_TRUE(pipeline.expired(6));
+    ASSERT_FALSE(pipeline.wait_stage(6));
+    ASSERT_FALSE(pipeline.query(2));
+    ASSERT_FALSE(pipeline.wait_stage(10));
+}
+
+TEST(StagePipelineCase, StageDependencies) {
+    // 用逻辑时钟记录每个阶段的开始和结束，检查跨stream的依赖
+    auto backend = std::make_shared<FakeStreamBackend>();
+    FakeStreamBackend* fake = backend.get();
+    const int num_slots = 3, num_jobs = 24;
+    std::atomic<int> clock{0};
+    std::vector<int> begin[NUM_STAGE], end[NUM_STAGE];
+    for (int s = 0; s < NUM_STAGE; ++s) {
+        begin[s].assign(num_jobs, -1);
+        end[s].assign(num_jobs, -1);
+    }
+
+    {
+        StagePipeline pipeline(backend, num_slots);
+        auto stage = [&](int istage, int k) {
+            return [&, istage, k](int slot, StageStream stream) {
+                fake->launch(stream, [&, istage, k]() {
+                    begin[istage][k] = clock++;
+                    std::this_thread::sleep_for(std::chrono::microseconds(200 * (1 + (k * 7 + istage) % 3)));
+                    end[istage][k] = clock++;
+                });
+            };
+        };
+
+        for (int k = 0; k < num_jobs; ++k) {
+            pipeline.submit(stage(0, k), stage(1, k), stage(2, k));
+        }
+        // 析构时等待所有任务完成
+    }
+
+    for (int k = 0; k < num_jobs; ++k) {
+        ASSERT_GT(begin[1][k], end[0][k]);
+        ASSERT_GT(begin[2][k], end[1][k]);
+        if (k >= num_slots) {
+            // 输入缓冲区被上一轮的compute读完才能上传，输出缓冲区被上一轮的download读完才能计算
+            ASSERT_GT(begin[0][k], end[1][k - num_slots]);
+            ASSERT_GT(begin[1][k], end[2][k - num_slots]);
+        }
+    }
+}
+
+// 第k批的compute要等到第k + 1批的upload开始后才结束，download同理等第k + 1批的compute开始
+// 流水线正确重叠时这些等待都会被满足，串行执行时只能等到超时，不依赖耗时统计
+TEST(StagePipelineCase, StagesOverlap) {
+    auto backend = std::make_shared<FakeStreamBackend>();
+    FakeStreamBackend* fake = backend.get();
+    const int num_jobs = 12;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<bool> started[NUM_STAGE], overlapped[NUM_STAGE];
+    for (int s = 0; s < NUM_STAGE; ++s) {
+        started[s].assign(num_jobs, false);
+        overlapped[s].assign(num_jobs, false);
+    }
+
+    auto stage = [&](int istage, int k) {
+        return [&, istage, k](int slot, StageStream stream) {
+            fake->launch(stream, [&, istage, k]() {
+                std::unique_lock<std::mutex> l(lock);
+                started[istage][k] = true;
+                cv.notify_all();
+                if (istage == 0 || k + 1 == num_jobs) return;
+
+                overlapped[istage][k] = cv.wait_for(l, std::chrono::seconds(5), [&]() { return started[istage - 1][k + 1]; });
+            });
+        };
+    };
+
+    StagePipeline pipeline(backend, 3);
+    for (int k = 0; k < num_jobs; ++k) {
+        long long sequence = pipeline.submit(stage(0, k), stage(1, k), stage(2, k));
+
+        // 同forward_async，返回前等待上传完成
+        ASSERT_TRUE(pipeline.wait_stage(sequence, Stage::Upload));
+    }
+    pipeline.synchronize();
+
+    for (int k = 0; k + 1 < num_jobs; ++k) {
+        ASSERT_TRUE(overlapped[1][k]) << "compute " << k << " did not overlap upload " << k + 1;
+        ASSERT_TRUE(overlapped[2][k]) << "download " << k << " did not overlap compute " << k + 1;
+    }
+}
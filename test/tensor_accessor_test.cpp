@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <trt_tensor.hpp>
+#include <ilogger.hpp>
+#include <vector>
+
+using namespace TRT;
+
+static std::shared_ptr<Tensor> make_tensor(const std::vector<int>& dims) {
+    auto tensor = std::make_shared<Tensor>(dims, DataType::Float);
+    float* data = tensor->cpu<float>();
+    for (int i = 0; i < tensor->numel(); ++i) data[i] = (float)i;
+    return tensor;
+}
+
+TEST(TensorAccessorCase, MatchesAt) {
+    auto tensor = make_tensor({2, 3, 4, 5});
+    auto acc4 = tensor->accessor<float, 4>();
+    ASSERT_EQ(acc4.data(), tensor->cpu<float>());
+    ASSERT_EQ(acc4.size(2), 4);
+    ASSERT_EQ(acc4.stride(0), 60u);
+    for (int n = 0; n < 2; ++n)
+        for (int c = 0; c < 3; ++c)
+            for (int h = 0; h < 4; ++h)
+                for (int w = 0; w < 5; ++w)
+                    ASSERT_EQ(&acc4(n, c, h, w), &tensor->at<float>(n, c, h, w));
+
+    // 前若干维的子块首地址
+    ASSERT_EQ(acc4.ptr(1), tensor->cpu<float>(1));
+    ASSERT_EQ(acc4.ptr(1, 2), tensor->cpu<float>(1, 2));
+    ASSERT_EQ(acc4.ptr(), tensor->cpu<float>());
+
+    // 通过访问器写入
+    acc4(1, 2, 3, 4) = -1;
+    ASSERT_EQ(tensor->at<float>(1, 2, 3, 4), -1);
+
+    // 同样大小的其他类型，同at<int>
+    auto labels = tensor->accessor<int, 4>();
+    ASSERT_EQ((void*)&labels(1, 0, 0, 0), (void*)&acc4(1, 0, 0, 0));
+
+    // const tensor得到只读的访问器
+    const Tensor& const_tensor = *tensor;
+    auto const_acc = const_tensor.accessor<float, 4>();
+    ASSERT_EQ(const_acc(1, 2, 3, 4), -1);
+}
+
+TEST(TensorAccessorCase, Rows) {
+    auto tensor = make_tensor({2, 6, 4});
+    auto acc = tensor->accessor<float, 3>();
+
+    auto row = acc.row(1, 2);
+    ASSERT_EQ(row.size(), 4);
+    ASSERT_EQ(row.data(), tensor->cpu<float>(1, 2));
+    ASSERT_EQ(row.end() - row.begin(), 4);
+    ASSERT_EQ(row[3], tensor->at<float>(1, 2, 3));
+
+    int irow = 0;
+    for (auto r : acc.rows(1)) {
+        ASSERT_EQ(r.data(), tensor->cpu<float>(1, irow));
+        float expect = (float)(24 + irow * 4);
+        for (float v : r) ASSERT_EQ(v, expect++);
+        ++irow;
+    }
+    ASSERT_EQ(irow, 6);
+    ASSERT_EQ(acc.rows(1).size(), 6);
+    ASSERT_EQ(acc.rows(0)[5].data(), tensor->cpu<float>(0, 5));
+}
+
+TEST(TensorAccessorCase, NonContiguousView) {
+    auto tensor = make_tensor({2, 6, 4});
+    auto view = TensorView(tensor).slice(1, 1, 4);
+    auto acc  = view.accessor<float, 3>();
+    ASSERT_EQ(acc.size(1), 3);
+    for (int n = 0; n < 2; ++n)
+        for (int c = 0; c < 3; ++c)
+            for (int w = 0; w < 4; ++w)
+                ASSERT_EQ(acc(n, c, w), tensor->at<float>(n, c + 1, w));
+
+    // 每张图只遍历切片内的3行，行之间跨过parent的stride
+    int irow = 0;
+    for (auto r : acc.rows(1)) {
+        ASSERT_EQ(r[0], tensor->at<float>(1, irow + 1, 0));
+        ++irow;
+    }
+    ASSERT_EQ(irow, 3);
+}
+
+// 按元素遍历{16, 100, 85}的tensor：Tensor::at、accessor下标、accessor行迭代器
+TEST(TensorAccessorBenchMark, ElementAccess) {
+    const int loops = 20;
+    auto tensor = make_tensor({16, 100, 85});
+    int batch = tensor->size(0), rows = tensor->size(1), cols = tensor->size(2);
+
+    double sum_at = 0;
+    auto begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop)
+        for (int i = 0; i < batch; ++i)
+            for (int j = 0; j < rows; ++j)
+                for (int k = 0; k < cols; ++k)
+                    sum_at += tensor->at<float>(i, j, k);
+    float at_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+    double sum_acc = 0;
+    begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        auto acc = tensor->accessor<float, 3>();
+        for (int i = 0; i < batch; ++i)
+            for (int j = 0; j < rows; ++j)
+                for (int k = 0; k < cols; ++k)
+                    sum_acc += acc(i, j, k);
+    }
+    float accessor_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+    double sum_rows = 0;
+    begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        auto acc = tensor->accessor<float, 3>();
+        for (int i = 0; i < batch; ++i)
+            for (auto row : acc.rows(i))
+                for (float v : row)
+                    sum_rows += v;
+    }
+    float rows_cost = (iLogger::timestamp_now_float() - begin) / loops;
+
+    ASSERT_EQ(sum_at, sum_acc);
+    ASSERT_EQ(sum_at, sum_rows);
+    FMT_INFO("%d elements, at: %.3f ms, accessor: %.3f ms (%.1fx), rows: %.3f ms (%.1fx)", tensor->numel(),
+             at_cost, accessor_cost, at_cost / accessor_cost, rows_cost, at_cost / rows_cost);
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <tensor_archive.hpp>
+#include <ilogger.hpp>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace TRT;
+
+static std::string archive_file(const char* name) {
+    return iLogger::format("/tmp/%s_%d.trta", name, (int)getpid());
+}
+
+static std::shared_ptr<Tensor> make_host_tensor(const std::vector<int>& dims, DataType dtype, int seed) {
+    auto tensor = std::make_shared<Tensor>(dims, dtype);
+    tensor->to_cpu(false);
+    auto p = tensor->cpu<unsigned char>();
+    for (int i = 0; i < tensor->bytes(); ++i) p[i] = (unsigned char)(i * 131 + seed);
+    return tensor;
+}
+
+TEST(TensorArchiveCase, CRC32) {
+    // 标准测试向量
+    ASSERT_EQ(crc32("123456789", 9), 0xCBF43926u);
+    ASSERT_EQ(crc32("", 0), 0u);
+
+    // 分块计算与整体计算一致
+    std::vector<unsigned char> data(1000);
+    for (int i = 0; i < (int)data.size(); ++i) data[i] = (unsigned char)(i * 7);
+    uint32_t whole = crc32(data.data(), data.size());
+    ASSERT_EQ(crc32(data.data() + 13, data.size() - 13, crc32(data.data(), 13)), whole);
+}
+
+TEST(TensorArchiveCase, RoundTripAllTypes) {
+    auto file = archive_file("round_trip");
+    std::vector<std::shared_ptr<Tensor>> tensors{
+        make_host_tensor({2, 3, 5, 7}, DataType::Float, 1),
+        make_host_tensor({4, 9}, DataType::Float16, 2),
+        make_host_tensor({17}, DataType::Int32, 3),
+        make_host_tensor({1, 3, 31, 29}, DataType::UInt8, 4),
+        make_host_tensor({0, 5}, DataType::Float, 5)
+    };
+
+    TensorArchiveWriter writer;
+    ASSERT_TRUE(writer.open(file));
+    for (int i = 0; i < (int)tensors.size(); ++i) {
+        ASSERT_TRUE(writer.write(iLogger::format("layer%d.output", i), *tensors[i]));
+    }
+    ASSERT_TRUE(writer.close());
+
+    auto archive = TensorArchive::open(file, true);
+    ASSERT_NE(archive, nullptr);
+    ASSERT_EQ(archive->size(), (int)tensors.size());
+    for (int i = 0; i < (int)tensors.size(); ++i) {
+        auto loaded = archive->tensor(iLogger::format("layer%d.output", i));
+        ASSERT_NE(loaded, nullptr);
+        ASSERT_EQ(loaded->type(), tensors[i]->type());
+        ASSERT_EQ(loaded->dims(), tensors[i]->dims());
+        ASSERT_EQ(loaded->bytes(), tensors[i]->bytes());
+        ASSERT_EQ(0, memcmp(loaded->cpu(), tensors[i]->cpu(), tensors[i]->bytes()));
+
+        // payload按alignment对齐，tensor直接引用映射的内存
+        ASSERT_EQ((size_t)archive->data(i) % archive->alignment(), 0u);
+        if (loaded->bytes() > 0) {
+            ASSERT_EQ(loaded->cpu(), archive->data(i));
+        }
+    }
+
+    // 归档析构后tensor仍然有效
+    auto first = archive->tensor(0);
+    archive.reset();
+    ASSERT_EQ(0, memcmp(first->cpu(), tensors[0]->cpu(), tensors[0]->bytes()));
+
+    // load_from_file读取归档中的第一个tensor
+    Tensor loaded;
+    ASSERT_TRUE(loaded.load_from_file(file));
+    ASSERT_EQ(loaded.dims(), tensors[0]->dims());
+    ASSERT_EQ(0, memcmp(loaded.cpu(), tensors[0]->cpu(), tensors[0]->bytes()));
+    remove(file.c_str());
+}
+
+TEST(TensorArchiveCase, ChunkedAppendAndReopen) {
+    auto file = archive_file("chunked");
+    std::vector<float> data(1000);
+    for (int i = 0; i < (int)data.size(); ++i) data[i] = i * 0.5f;
+
+    TensorArchiveWriter writer;
+    ASSERT_TRUE(writer.open(file, false, 4096));
+    ASSERT_TRUE(writer.begin("chunked", DataType::Float, {10, 100}));
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(writer.append(data.data() + i * 100, 100 * sizeof(float)));
+    }
+    ASSERT_TRUE(writer.end());
+
+    // 大小不符的record被丢弃
+    ASSERT_TRUE(writer.begin("incomplete", DataType::Float, {10, 100}));
+    ASSERT_TRUE(writer.append(data.data(), 10 * sizeof(float)));
+    ASSERT_FALSE(writer.end());
+    ASSERT_FALSE(writer.append(data.data(), sizeof(float)));
+    ASSERT_TRUE(writer.close());
+
+    // 追加写入
+    ASSERT_TRUE(writer.open(file, true));
+    ASSERT_EQ(writer.size(), 1);
+    ASSERT_TRUE(writer.write("appended", DataType::Int32, {3}, std::vector<int>{1, 2, 3}.data()));
+    ASSERT_TRUE(writer.close());
+
+    auto archive = TensorArchive::open(file, true);
+    ASSERT_NE(archive, nullptr);
+    ASSERT_EQ(archive->size(), 2);
+    ASSERT_EQ(archive->alignment(), 4096u);
+    ASSERT_EQ(archive->find("incomplete"), -1);
+    ASSERT_EQ(0, memcmp(archive->tensor("chunked")->cpu(), data.data(), data.size() * sizeof(float)));
+    ASSERT_EQ(archive->tensor("appended")->at<int>(2), 3);
+    remove(file.c_str());
+}
+
+TEST(TensorArchiveCase, CorruptedAndUnclosed) {
+    auto file = archive_file("corrupted");
+    auto tensor = make_host_tensor({64, 64}, DataType::Float, 7);
+    {
+        TensorArchiveWriter writer;
+        ASSERT_TRUE(writer.open(file));
+        ASSERT_TRUE(writer.write("a", *tensor));
+        ASSERT_TRUE(writer.write("b", *tensor));
+        ASSERT_TRUE(writer.close());
+    }
+
+    // 改掉第二个tensor的一个字节
+    auto archive = TensorArchive::open(file);
+    size_t offset = archive->entry(1).offset;
+    archive.reset();
+    FILE* f = fopen(file.c_str(), "r+b");
+    fseek(f, offset + 100, SEEK_SET);
+    fputc(0x5A ^ tensor->cpu<unsigned char>()[100], f);
+    fclose(f);
+
+    archive = TensorArchive::open(file);
+    ASSERT_NE(archive, nullptr);
+    ASSERT_TRUE(archive->verify(0));
+    ASSERT_FALSE(archive->verify(1));
+    ASSERT_EQ(TensorArchive::open(file, true), nullptr);
+
+    // 进程在写第二个tensor时退出：没有Index和Footer，第二个record不完整，逐个扫描record
+    auto unclosed = archive_file("unclosed");
+    {
+        TensorArchiveWriter writer;
+        ASSERT_TRUE(writer.open(unclosed));
+        ASSERT_TRUE(writer.write("a", *tensor));
+        ASSERT_TRUE(writer.write("b", *tensor));
+        ASSERT_TRUE(writer.close());
+    }
+    ASSERT_EQ(0, truncate(unclosed.c_str(), offset + 1000));
+
+    archive = TensorArchive::open(unclosed, true);
+    ASSERT_NE(archive, nullptr);
+    ASSERT_EQ(archive->size(), 1);
+    ASSERT_EQ(archive->entry(0).name, "a");
+    remove(file.c_str());
+    remove(unclosed.c_str());
+}
+
+// dump大量中间tensor的写入和mmap读取吞吐
+TEST(TensorArchiveBenchMark, WriteAndMap) {
+    auto file = archive_file("benchmark");
+    const int num_tensors = 1000;
+    auto tensor = make_host_tensor({1, 64, 32, 32}, DataType::Float, 9);
+
+    auto begin = iLogger::timestamp_now_float();
+    TensorArchiveWriter writer;
+    ASSERT_TRUE(writer.open(file));
+    for (int i = 0; i < num_tensors; ++i) {
+        ASSERT_TRUE(writer.write(iLogger::format("blob_%d", i), *tensor));
+    }
+    ASSERT_TRUE(writer.close());
+    float write_cost = iLogger::timestamp_now_float() - begin;
+
+    begin = iLogger::timestamp_now_float();
+    auto archive = TensorArchive::open(file);
+    float sum = 0;
+    for (int i = 0; i < num_tensors; ++i) {
+        sum += archive->tensor(i)->at<float>(0, 0, 0, 0);
+    }
+    float map_cost = iLogger::timestamp_now_float() - begin;
+
+    begin = iLogger::timestamp_now_float();
+    for (int i = 0; i < num_tensors; ++i) {
+        ASSERT_TRUE(archive->verify(i));
+    }
+    float verify_cost = iLogger::timestamp_now_float() - begin;
+
+    float mb = num_tensors * tensor->bytes() / 1024.0f / 1024.0f;
+    FMT_INFO("%d tensors, %.1f MB, write: %.1f ms (%.0f MB/s), open + %d views: %.2f ms, crc32 verify: %.1f ms (%.0f MB/s), sum = %f",
+             num_tensors, mb, write_cost, mb / write_cost * 1000, num_tensors, map_cost, verify_cost, mb / verify_cost * 1000, sum);
+    remove(file.c_str());
+}
@@ -0,0 +1,282 @@
+#include <gtest/gtest.h>
+
+#include <preprocess_kernel_cpu.hpp>
+#include <trt_tensor.hpp>
+#include <ilogger.hpp>
+#include <math.h>
+#include <string.h>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace TRT;
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// half的数学定义，用于检查half_to_float
+static float reference_half_to_float(uint16_t h) {
+    int sign = h >> 15, exponent = (h >> 10) & 31, mantissa = h & 1023;
+    float value;
+    if (exponent == 0)       value = ldexpf((float)mantissa, -24);
+    else if (exponent == 31) value = mantissa ? NAN : INFINITY;
+    else                     value = ldexpf((float)(mantissa | 1024), exponent - 25);
+    return sign ? -value : value;
+}
+
+static bool is_half_nan(uint16_t h) {
+    return (h & 0x7C00) == 0x7C00 && (h & 0x03FF) != 0;
+}
+
+// 各个SIMD路径与标量实现的结果
+static std::vector<uint16_t> to_half_with(const std::vector<float>& src, bool f16c, bool avx512) {
+    std::vector<uint16_t> dst(src.size());
+    CPUKernel::set_f16c_enabled(f16c);
+    CPUKernel::set_avx512_enabled(avx512);
+    CPUKernel::convert_float_to_half(src.data(), dst.data(), src.size());
+    CPUKernel::set_f16c_enabled(true);
+    CPUKernel::set_avx512_enabled(true);
+    return dst;
+}
+
+static std::vector<uint32_t> to_float_bits_with(const std::vector<uint16_t>& src, bool f16c, bool avx512) {
+    std::vector<float> dst(src.size());
+    CPUKernel::set_f16c_enabled(f16c);
+    CPUKernel::set_avx512_enabled(avx512);
+    CPUKernel::convert_half_to_float(src.data(), dst.data(), src.size());
+    CPUKernel::set_f16c_enabled(true);
+    CPUKernel::set_avx512_enabled(true);
+
+    std::vector<uint32_t> bits(dst.size());
+    memcpy(bits.data(), dst.data(), dst.size() * sizeof(float));
+    return bits;
+}
+
+TEST(TensorConvertCase, HalfToFloatExhaustive) {
+    for (uint32_t h = 0; h < 65536; ++h) {
+        float value = CPUKernel::half_to_float(h);
+        if (is_half_nan(h)) {
+            ASSERT_TRUE(std::isnan(value)) << h;
+            // 转回half得到置了quiet位的同一个NaN
+            ASSERT_EQ(CPUKernel::float_to_half(value), h | 0x0200) << h;
+        } else {
+            ASSERT_EQ(float_bits(value), float_bits(reference_half_to_float(h))) << h;
+            ASSERT_EQ(CPUKernel::float_to_half(value), h) << h;
+        }
+    }
+}
+
+TEST(TensorConvertCase, FloatToHalfRoundToNearestEven) {
+    // 相邻两个half的中点舍入到尾数为偶数的一个，中点两侧各差1ulp的float舍入到更近的一个
+    for (uint32_t h = 0; h < 0x7BFF; ++h) {
+        for (uint32_t sign : {0u, 0x8000u}) {
+            uint16_t low = h | sign, high = (h + 1) | sign;
+            float mid = (CPUKernel::half_to_float(low) + CPUKernel::half_to_float(high)) / 2;
+            float toward_low  = sign ? nextafterf(mid, INFINITY) : nextafterf(mid, -INFINITY);
+            float toward_high = sign ? nextafterf(mid, -INFINITY) : nextafterf(mid, INFINITY);
+            ASSERT_EQ(CPUKernel::float_to_half(mid), (h & 1) ? high : low) << h;
+            ASSERT_EQ(CPUKernel::float_to_half(toward_low), low) << h;
+            ASSERT_EQ(CPUKernel::float_to_half(toward_high), high) << h;
+        }
+    }
+
+    // 最大的有限值65504，65520及以上为inf
+    ASSERT_EQ(CPUKernel::float_to_half(65504.0f), 0x7BFF);
+    ASSERT_EQ(CPUKernel::float_to_half(nextafterf(65520.0f, 0)), 0x7BFF);
+    ASSERT_EQ(CPUKernel::float_to_half(65520.0f), 0x7C00);
+    ASSERT_EQ(CPUKernel::float_to_half(-1e10f), 0xFC00);
+    ASSERT_EQ(CPUKernel::float_to_half(INFINITY), 0x7C00);
+
+    // 最小的非规格化数2^-24，它的一半舍入到0
+    ASSERT_EQ(CPUKernel::float_to_half(ldexpf(1, -25)), 0x0000);
+    ASSERT_EQ(CPUKernel::float_to_half(nextafterf(ldexpf(1, -25), 1)), 0x0001);
+    ASSERT_EQ(CPUKernel::float_to_half(-ldexpf(1, -30)), 0x8000);
+    ASSERT_EQ(CPUKernel::float_to_half(bits_float(0x00000001)), 0x0000);
+
+    // float_to_float16/float16_to_float使用同一实现
+    ASSERT_EQ(float_to_float16(0.1f)._, CPUKernel::float_to_half(0.1f));
+    ASSERT_EQ(float16_to_float(float_to_float16(-2.5f)), -2.5f);
+}
+
+TEST(TensorConvertCase, SIMDEqualsScalar) {
+    if (!CPUKernel::f16c_enabled()) {
+        INFO("F16C is not supported, skip");
+        return;
+    }
+
+    // 所有half、随机的float位模式（包括NaN、inf、非规格化数），长度不是向量宽度的整数倍
+    std::vector<uint16_t> halves(65536 + 7);
+    for (size_t i = 0; i < halves.size(); ++i) halves[i] = (uint16_t)i;
+
+    std::mt19937 rng(7);
+    std::vector<float> floats(1 << 20 | 13);
+    for (auto& value : floats) value = bits_float(rng());
+    for (size_t i = 0; i < halves.size(); ++i) floats[i] = CPUKernel::half_to_float(halves[i]) * 1.0001f;
+
+    auto scalar_half  = to_half_with(floats, false, false);
+    auto scalar_float = to_float_bits_with(halves, false, false);
+    ASSERT_EQ(to_half_with(floats, true, false), scalar_half);
+    ASSERT_EQ(to_float_bits_with(halves, true, false), scalar_float);
+
+    if (CPUKernel::avx512_enabled()) {
+        ASSERT_EQ(to_half_with(floats, true, true), scalar_half);
+        ASSERT_EQ(to_float_bits_with(halves, true, true), scalar_float);
+    }
+}
+
+static const DataType kTypes[] = {DataType::Float, DataType::Float16, DataType::Int32, DataType::UInt8};
+
+// 以double表示的每种类型的值，按convert_data_type的规则逐个转换得到期望结果
+static double read_value(const void* data, DataType type, size_t i) {
+    switch (type) {
+        case DataType::Float:   return ((const float*)data)[i];
+        case DataType::Float16: return CPUKernel::half_to_float(((const uint16_t*)data)[i]);
+        case DataType::Int32:   return ((const int*)data)[i];
+        case DataType::UInt8:   return ((const uint8_t*)data)[i];
+        default: return 0;
+    }
+}
+
+static void write_expected(void* data, DataType type, size_t i, double value) {
+    auto saturate = [](double v, double low, double high) {
+        return v != v ? 0 : (v < low ? low : (v > high ? high : trunc(v)));
+    };
+    switch (type) {
+        case DataType::Float:   ((float*)data)[i] = (float)value; break;
+        case DataType::Float16: ((uint16_t*)data)[i] = CPUKernel::float_to_half((float)value); break;
+        case DataType::Int32:   ((int*)data)[i] = (int)saturate(value, std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max()); break;
+        case DataType::UInt8:   ((uint8_t*)data)[i] = (uint8_t)saturate(value, 0, 255); break;
+        default: break;
+    }
+}
+
+static std::vector<uint8_t> make_values(DataType type, size_t count) {
+    std::vector<uint8_t> data(count * data_type_size(type));
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> dist(-300, 300);
+    for (size_t i = 0; i < count; ++i) {
+        float value = i % 97 == 0 ? NAN : (i % 89 == 0 ? 3e9f : dist(rng));
+        if (type == DataType::Float)        ((float*)data.data())[i] = value;
+        else if (type == DataType::Float16) ((uint16_t*)data.data())[i] = CPUKernel::float_to_half(value);
+        else if (type == DataType::Int32)   ((int*)data.data())[i] = i % 97 == 0 ? std::numeric_limits<int>::max() : (i % 89 == 0 ? std::numeric_limits<int>::lowest() : (int)(value * 1000));
+        else                                data[i] = (uint8_t)(rng() & 0xFF);
+    }
+    return data;
+}
+
+TEST(TensorConvertCase, AllPairsInPlaceAndOutOfPlace) {
+    // 大于原地转换的中转块，并且不是它的整数倍
+    for (size_t count : {1, 5, 4096, 100003}) {
+        for (DataType src_type : kTypes) {
+            auto src = make_values(src_type, count);
+            for (DataType dst_type : kTypes) {
+                size_t dst_bytes = count * data_type_size(dst_type);
+                std::vector<uint8_t> expected(dst_bytes);
+                for (size_t i = 0; i < count; ++i)
+                    write_expected(expected.data(), dst_type, i, read_value(src.data(), src_type, i));
+
+                std::vector<uint8_t> out_of_place(dst_bytes);
+                ASSERT_TRUE(convert_data_type(src.data(), src_type, out_of_place.data(), dst_type, count));
+                ASSERT_EQ(out_of_place, expected) << data_type_string(src_type) << " -> " << data_type_string(dst_type) << " x " << count;
+
+                std::vector<uint8_t> in_place(std::max(src.size(), dst_bytes));
+                memcpy(in_place.data(), src.data(), src.size());
+                ASSERT_TRUE(convert_data_type(in_place.data(), src_type, in_place.data(), dst_type, count));
+                in_place.resize(dst_bytes);
+                ASSERT_EQ(in_place, expected) << "in place " << data_type_string(src_type) << " -> " << data_type_string(dst_type) << " x " << count;
+            }
+        }
+    }
+
+    float value = 1;
+    ASSERT_FALSE(convert_data_type(&value, DataType::Unknow, &value, DataType::Float, 1));
+}
+
+TEST(TensorConvertCase, ThreadsDeterministic) {
+    const size_t count = 3 << 20;
+    auto src = make_values(DataType::Float, count);
+    std::vector<uint16_t> single(count), multiple(count);
+
+    CPUKernel::set_num_threads(1);
+    CPUKernel::convert_float_to_half((const float*)src.data(), single.data(), count);
+    CPUKernel::set_num_threads(4);
+    CPUKernel::convert_float_to_half((const float*)src.data(), multiple.data(), count);
+    CPUKernel::set_num_threads(0);
+    ASSERT_EQ(single, multiple);
+}
+
+TEST(TensorConvertCase, TensorConvertTo) {
+    Tensor tensor({2, 3, 17, 19}, DataType::Float);
+    float* data = tensor.cpu<float>();
+    for (int i = 0; i < tensor.count(); ++i) data[i] = i * 0.25f - 100;
+
+    // 缩小时原地转换，host内存不变
+    void* host = tensor.cpu();
+    tensor.to_half();
+    ASSERT_EQ(tensor.type(), DataType::Float16);
+    ASSERT_EQ(tensor.bytes(), tensor.count() * 2);
+    ASSERT_EQ(tensor.cpu(), host);
+    for (int i = 0; i < tensor.count(); ++i)
+        ASSERT_EQ(float16_to_float(tensor.cpu<float16>()[i]), i * 0.25f - 100);
+
+    // 原来的内存放得下，也是原地转换
+    tensor.to_float();
+    ASSERT_EQ(tensor.cpu(), host);
+    for (int i = 0; i < tensor.count(); ++i) ASSERT_EQ(tensor.cpu<float>()[i], i * 0.25f - 100);
+
+    tensor.convert_to(DataType::Int32);
+    ASSERT_EQ(tensor.at<int>(1, 2, 3, 4), (int)(tensor.offset(1, 2, 3, 4) * 0.25f - 100));
+    tensor.convert_to(DataType::UInt8);
+    ASSERT_EQ(tensor.at<uint8_t>(0, 0, 0, 0), 0);
+    ASSERT_EQ(tensor.at<uint8_t>(1, 2, 16, 18), 255);
+
+    // 从UInt8放大为Float需要更大的内存：双缓冲转换后交换
+    Tensor small({4, 1000}, DataType::UInt8);
+    for (int i = 0; i < small.count(); ++i) small.cpu<uint8_t>()[i] = i % 251;
+    small.to_float();
+    ASSERT_EQ(small.type(), DataType::Float);
+    ASSERT_GE(small.get_data()->cpu_size(), small.count() * sizeof(float));
+    for (int i = 0; i < small.count(); ++i) ASSERT_EQ(small.cpu<float>()[i], (float)(i % 251));
+}
+
+// 16M个元素，比较逐元素标量、单线程SIMD和多线程SIMD的吞吐，按读写的总字节数计算
+TEST(TensorConvertBenchMark, Throughput) {
+    const size_t count = 16 << 20;
+    const int loops = 5;
+    auto src = make_values(DataType::Float, count);
+    std::vector<uint16_t> halves(count);
+    std::vector<float> floats(count);
+    const double gigabytes = count * (sizeof(float) + sizeof(uint16_t)) / 1e9;
+
+    auto measure = [&](bool simd, int threads, double& to_half_gbs, double& to_float_gbs) {
+        CPUKernel::set_f16c_enabled(simd);
+        CPUKernel::set_num_threads(threads);
+        auto begin = iLogger::timestamp_now_float();
+        for (int i = 0; i < loops; ++i) CPUKernel::convert_float_to_half((const float*)src.data(), halves.data(), count);
+        to_half_gbs = gigabytes * loops / ((iLogger::timestamp_now_float() - begin) / 1000);
+
+        begin = iLogger::timestamp_now_float();
+        for (int i = 0; i < loops; ++i) CPUKernel::convert_half_to_float(halves.data(), floats.data(), count);
+        to_float_gbs = gigabytes * loops / ((iLogger::timestamp_now_float() - begin) / 1000);
+    };
+
+    double scalar_half, scalar_float, simd_half, simd_float, threads_half, threads_float;
+    measure(false, 1, scalar_half, scalar_float);
+    measure(true, 1, simd_half, simd_float);
+    measure(true, 0, threads_half, threads_float);
+    CPUKernel::set_f16c_enabled(true);
+    CPUKernel::set_num_threads(0);
+
+    const char* isa = CPUKernel::avx512_enabled() ? "avx512" : (CPUKernel::f16c_enabled() ? "f16c" : "scalar");
+    FMT_INFO("float->half GB/s: scalar %.2f, %s %.2f, %d threads %.2f", scalar_half, isa, simd_half, CPUKernel::num_threads(), threads_half);
+    FMT_INFO("half->float GB/s: scalar %.2f, %s %.2f, %d threads %.2f", scalar_float, isa, simd_float, CPUKernel::num_threads(), threads_float);
+}
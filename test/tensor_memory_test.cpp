@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <trt_tensor.hpp>
+#include <ilogger.hpp>
+#include <vector>
+#include <string.h>
+#include <cmath>
+
+using namespace TRT;
+
+// 用malloc后端的独立内存池，不依赖GPU，也不影响全局pool
+static std::shared_ptr<MixMemory> make_host_memory(std::shared_ptr<MemoryPool> pool, MemoryInit init) {
+    auto memory = std::make_shared<MixMemory>(CURRENT_DEVICE_ID, pool);
+    memory->set_init(init);
+    return memory;
+}
+
+// 先把一个block写成0xAB还给pool，之后同样大小的申请会拿到这个block
+static void leave_garbage(std::shared_ptr<MemoryPool> pool, size_t size) {
+    size_t block_size = 0;
+    void* ptr = pool->allocate(MemoryKind::Host, 0, size, &block_size);
+    memset(ptr, 0xAB, block_size);
+    pool->deallocate(MemoryKind::Host, 0, ptr, block_size);
+}
+
+static bool all_bytes_equal(const void* ptr, size_t size, unsigned char value) {
+    auto p = (const unsigned char*)ptr;
+    for (size_t i = 0; i < size; ++i) {
+        if (p[i] != value) return false;
+    }
+    return true;
+}
+
+TEST(TensorMemoryCase, InitPolicy) {
+    const size_t size = 10000;
+    auto pool = std::make_shared<MemoryPool>(malloc_memory_backend());
+
+    leave_garbage(pool, size);
+    auto zero = make_host_memory(pool, MemoryInit::Zero);
+    ASSERT_TRUE(all_bytes_equal(zero->cpu(size), size, 0));
+    zero->release_all();
+
+    leave_garbage(pool, size);
+    auto uninitialized = make_host_memory(pool, MemoryInit::Uninitialized);
+    ASSERT_TRUE(all_bytes_equal(uninitialized->cpu(size), size, 0xAB));
+    uninitialized->release_all();
+
+    leave_garbage(pool, size);
+    auto poison = make_host_memory(pool, MemoryInit::PoisonInDebug);
+#ifdef NDEBUG
+    ASSERT_TRUE(all_bytes_equal(poison->cpu(size), size, 0xAB));
+#else
+    ASSERT_TRUE(all_bytes_equal(poison->cpu(size), size, 0xFF));
+    ASSERT_TRUE(std::isnan(((float*)poison->cpu())[0]));
+#endif
+}
+
+TEST(TensorMemoryCase, FillBatchSkipsCleanSlots) {
+    auto pool = std::make_shared<MemoryPool>(malloc_memory_backend());
+    Tensor tensor(std::vector<int>{4, 3, 8, 8}, DataType::Float, make_host_memory(pool, MemoryInit::Uninitialized));
+    const int slot = 3 * 8 * 8;
+
+    tensor.to_cpu(false);
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(tensor.is_dirty(i));
+
+    tensor.fill_batch(0, 4);
+    for (int i = 0; i < 4; ++i) ASSERT_FALSE(tensor.is_dirty(i));
+    ASSERT_TRUE(all_bytes_equal(tensor.cpu(), tensor.bytes(), 0));
+
+    // 通过copy_from_cpu写入的槽位自动标记为dirty
+    std::vector<float> image(slot, 1.0f);
+    tensor.copy_from_cpu(tensor.offset(1), image.data(), slot);
+    ASSERT_TRUE(tensor.is_dirty(1));
+    ASSERT_FALSE(tensor.is_dirty(2));
+
+    // 通过指针直接写入不会被发现，clean的槽位被跳过
+    tensor.at<float>(3, 0, 0, 0) = 7.0f;
+    tensor.fill_batch(1, 4);
+    ASSERT_EQ(tensor.at<float>(1, 2, 7, 7), 0.0f);
+    ASSERT_EQ(tensor.at<float>(3, 0, 0, 0), 7.0f);
+
+    tensor.mark_dirty(3, 4).fill_batch(1, 4);
+    ASSERT_EQ(tensor.at<float>(3, 0, 0, 0), 0.0f);
+
+    // 按字节填充其他值，已经是0的槽位需要重新填充
+    tensor.fill_batch(2, 4, 0xFF);
+    ASSERT_TRUE(std::isnan(tensor.at<float>(2, 0, 0, 0)));
+    ASSERT_EQ(tensor.at<float>(1, 0, 0, 0), 0.0f);
+
+    // batch变小不重新申请内存，槽位状态保留；每个槽位的大小变化后全部未知
+    tensor.resize_single_dim(0, 2);
+    ASSERT_FALSE(tensor.is_dirty(1));
+    tensor.resize(4, 3, 4, 4);
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(tensor.is_dirty(i));
+}
+
+// 模拟每次输入变大时重新申请2016x2016x3的float输入，比较清零和不初始化的申请耗时
+TEST(TensorMemoryBenchMark, AllocationLatency) {
+    const size_t size = 2016 * 2016 * 3 * sizeof(float);
+    const int loops = 20;
+    auto pool = std::make_shared<MemoryPool>(malloc_memory_backend());
+
+    float costs[2] = {0};
+    MemoryInit inits[2] = {MemoryInit::Zero, MemoryInit::Uninitialized};
+    for (int i = 0; i < 2; ++i) {
+        auto memory = make_host_memory(pool, inits[i]);
+
+        // 第一次申请包含缺页的开销，不计入
+        memory->cpu(size);
+        memory->release_cpu();
+
+        auto begin = iLogger::timestamp_now_float();
+        for (int loop = 0; loop < loops; ++loop) {
+            memory->cpu(size);
+            memory->release_cpu();
+        }
+        costs[i] = (iLogger::timestamp_now_float() - begin) / loops;
+    }
+
+    FMT_INFO("%.1f MB per allocation, %s: %.3f ms, %s: %.3f ms",
+             size / 1024.0f / 1024.0f, memory_init_string(inits[0]), costs[0], memory_init_string(inits[1]), costs[1]);
+}
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+
+#include <trt_tensor.hpp>
+#include <ilogger.hpp>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace TRT;
+
+/* CPU上模拟的拷贝后端，单线程、结果确定：copy_async只排队，同步时才执行到对应的位置
+   事件记录时记下stream上已排队的拷贝数，完成条件是这些拷贝都已执行
+   waits只统计真正需要等待（还有未执行的拷贝）的同步，每次等待额外花费latency_us模拟stream同步的开销
+*/
+class FakeTransferBackend : public TransferBackend {
+public:
+    struct Copy {
+        void* dst;
+        const void* src;
+        size_t size;
+    };
+
+    struct Event {
+        CUStream stream = nullptr;
+        size_t position = 0;
+    };
+
+    int copies = 0;
+    int waits  = 0;
+    int events = 0;
+    int latency_us = 0;
+
+    size_t executed(CUStream stream) { return executed_[stream]; }
+
+    virtual void copy_async(MemoryKind dst_kind, void* dst, const void* src, size_t size, int device_id, CUStream stream) override {
+        queued_[stream].push_back({dst, src, size});
+        ++copies;
+    }
+
+    virtual void stream_synchronize(int device_id, CUStream stream) override { run(stream, queued_[stream].size()); }
+    virtual TransferEvent create_event(int device_id) override { ++events; return new Event(); }
+    virtual void destroy_event(TransferEvent event) override { delete (Event*)event; }
+
+    virtual void record_event(TransferEvent event, CUStream stream) override {
+        Event* e    = (Event*)event;
+        e->stream   = stream;
+        e->position = queued_[stream].size();
+    }
+
+    virtual void event_synchronize(TransferEvent event) override {
+        Event* e = (Event*)event;
+        run(e->stream, e->position);
+    }
+
+    virtual bool event_query(TransferEvent event) override {
+        Event* e = (Event*)event;
+        return executed_[e->stream] >= e->position;
+    }
+
+private:
+    void run(CUStream stream, size_t position) {
+        size_t& done = executed_[stream];
+        if (done >= position) return;
+
+        ++waits;
+        if (latency_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
+        auto& queue = queued_[stream];
+        for (; done < position; ++done) memcpy(queue[done].dst, queue[done].src, queue[done].size);
+    }
+
+private:
+    std::map<CUStream, std::vector<Copy>> queued_;
+    std::map<CUStream, size_t> executed_;
+};
+
+// 测试期间替换全局的拷贝后端
+struct ScopedTransferBackend {
+    std::shared_ptr<TransferBackend> previous;
+    explicit ScopedTransferBackend(std::shared_ptr<TransferBackend> backend) : previous(transfer_backend()) { set_transfer_backend(backend); }
+    ~ScopedTransferBackend() { set_transfer_backend(previous); }
+};
+
+static CUStream fake_stream(int i) { return (CUStream)(size_t)(0x1000 + i); }
+
+// malloc内存池上的tensor，数据在"device"上，第i个元素为base + i
+static std::shared_ptr<Tensor> make_device_tensor(const std::vector<int>& dims, float base, CUStream stream) {
+    auto pool   = std::make_shared<MemoryPool>(malloc_memory_backend());
+    auto tensor = std::make_shared<Tensor>(dims, DataType::Float, std::make_shared<MixMemory>(CURRENT_DEVICE_ID, pool));
+    tensor->set_stream(stream);
+    float* device = tensor->to_gpu(false).gpu<float>();
+    for (int i = 0; i < tensor->numel(); ++i) device[i] = base + i;
+    return tensor;
+}
+
+static bool host_equals(const std::shared_ptr<Tensor>& tensor, float base) {
+    const float* host = (const float*)tensor->get_data()->cpu();
+    for (int i = 0; i < tensor->numel(); ++i) {
+        if (host[i] != base + i) return false;
+    }
+    return true;
+}
+
+TEST(TensorTransferCase, AsyncDownloadDefersWait) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    auto tensor = make_device_tensor({4, 100}, 1, fake_stream(0));
+    auto handle = tensor->to_cpu_async();
+    ASSERT_FALSE(handle.empty());
+    ASSERT_FALSE(handle.ready());
+    ASSERT_EQ(tensor->head(), DataHead::Host);
+    ASSERT_TRUE(tensor->transfer_pending());
+    ASSERT_FALSE(host_equals(tensor, 1));
+
+    // 访问host数据时等待这次下载
+    ASSERT_EQ(tensor->cpu<float>()[399], 400);
+    ASSERT_TRUE(handle.ready());
+    ASSERT_FALSE(tensor->transfer_pending());
+    ASSERT_EQ(backend->waits, 1);
+    ASSERT_EQ(backend->copies, 1);
+
+    // 数据头已经是Host，不再拷贝
+    ASSERT_TRUE(tensor->to_cpu_async().empty());
+    ASSERT_EQ(backend->copies, 1);
+}
+
+TEST(TensorTransferCase, GroupDownloadWaitsOncePerStream) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    std::vector<std::shared_ptr<Tensor>> outputs;
+    for (int i = 0; i < 4; ++i) outputs.push_back(make_device_tensor({2, 50}, i * 1000.0f, fake_stream(0)));
+    outputs.push_back(make_device_tensor({3}, 7, fake_stream(1)));
+    outputs.push_back(nullptr);
+
+    auto handle = to_cpu_async(outputs);
+    ASSERT_EQ(backend->copies, 5);
+    ASSERT_EQ(backend->events, 2);
+    ASSERT_FALSE(handle.ready());
+
+    handle.wait();
+    ASSERT_TRUE(handle.ready());
+    ASSERT_EQ(backend->waits, 2);
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(host_equals(outputs[i], i * 1000.0f));
+    ASSERT_TRUE(host_equals(outputs[4], 7));
+
+    // 之后逐个访问不再等待
+    for (int i = 0; i < 4; ++i) ASSERT_EQ(outputs[i]->cpu<float>()[1], i * 1000.0f + 1);
+    ASSERT_EQ(backend->waits, 2);
+
+    // 逐个to_cpu时每个输出同步一次
+    for (int i = 0; i < 4; ++i) outputs[i]->to_gpu(false);
+    for (int i = 0; i < 4; ++i) outputs[i]->to_cpu();
+    ASSERT_EQ(backend->waits, 6);
+}
+
+TEST(TensorTransferCase, GroupIncludesEarlierPending) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    auto first  = make_device_tensor({10}, 0, fake_stream(0));
+    auto second = make_device_tensor({10}, 100, fake_stream(1));
+    first->to_cpu_async();
+
+    // first已经在下载，句柄也要等待它
+    auto handle = to_cpu_async({first, second});
+    ASSERT_EQ(backend->copies, 2);
+    handle.wait();
+    ASSERT_TRUE(host_equals(first, 0));
+    ASSERT_TRUE(host_equals(second, 100));
+}
+
+TEST(TensorTransferCase, AsyncUpload) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    auto pool   = std::make_shared<MemoryPool>(malloc_memory_backend());
+    auto tensor = std::make_shared<Tensor>(std::vector<int>{16}, DataType::Float, std::make_shared<MixMemory>(CURRENT_DEVICE_ID, pool));
+    tensor->set_stream(fake_stream(0));
+    tensor->set_to(3);
+
+    auto handle = tensor->to_gpu_async();
+    ASSERT_EQ(tensor->head(), DataHead::Device);
+    ASSERT_FALSE(handle.ready());
+    ASSERT_FALSE(tensor->transfer_pending());
+    handle.wait();
+    ASSERT_EQ(((float*)tensor->get_data()->gpu())[15], 3);
+
+    // 下载排在上传之后
+    tensor->gpu<float>()[0] = 5;
+    ASSERT_EQ(tensor->to_cpu().cpu<float>()[0], 5);
+    ASSERT_EQ(backend->copies, 2);
+}
+
+TEST(TensorTransferCase, HeadStateMachineWithoutCopy) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    // 没有任何数据时只切换数据头
+    auto pool = std::make_shared<MemoryPool>(malloc_memory_backend());
+    Tensor empty(std::vector<int>{8}, DataType::Float, std::make_shared<MixMemory>(CURRENT_DEVICE_ID, pool));
+    auto handle = empty.to_cpu_async();
+    ASSERT_TRUE(handle.empty());
+    ASSERT_TRUE(handle.ready());
+    ASSERT_EQ(empty.head(), DataHead::Host);
+
+    auto tensor = make_device_tensor({8}, 0, fake_stream(0));
+    tensor->to_cpu(false);
+    ASSERT_EQ(tensor->head(), DataHead::Host);
+    ASSERT_EQ(backend->copies, 0);
+
+    // resize变大后device上的旧内存放不下，不能作为拷贝源
+    tensor->to_gpu(false);
+    tensor->resize(64);
+    tensor->to_cpu();
+    ASSERT_EQ(backend->copies, 0);
+    ASSERT_EQ(backend->waits, 0);
+}
+
+TEST(TensorTransferCase, ReleaseWaitsPending) {
+    auto backend = std::make_shared<FakeTransferBackend>();
+    ScopedTransferBackend scoped(backend);
+
+    auto tensor = make_device_tensor({32}, 0, fake_stream(0));
+    tensor->to_cpu_async();
+    ASSERT_EQ(backend->executed(fake_stream(0)), 0u);
+    tensor->release();
+    ASSERT_EQ(backend->executed(fake_stream(0)), 1u);
+    ASSERT_FALSE(tensor->transfer_pending());
+}
+
+// 4个输出的检测模型，每次stream同步固定200us：逐个to_cpu与一起下载只等一次
+TEST(TensorTransferBenchMark, MultiOutputDownload) {
+    const int loops = 50;
+    auto backend = std::make_shared<FakeTransferBackend>();
+    backend->latency_us = 200;
+    ScopedTransferBackend scoped(backend);
+
+    std::vector<std::shared_ptr<Tensor>> outputs{
+        make_device_tensor({16, 1}, 0, fake_stream(0)),
+        make_device_tensor({16, 100, 4}, 0, fake_stream(0)),
+        make_device_tensor({16, 100}, 0, fake_stream(0)),
+        make_device_tensor({16, 100}, 0, fake_stream(0))
+    };
+
+    auto begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        for (auto& output : outputs) output->to_gpu(false);
+        for (auto& output : outputs) output->to_cpu();
+    }
+    float sequential_cost = (iLogger::timestamp_now_float() - begin) / loops;
+    int sequential_waits  = backend->waits;
+
+    begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        for (auto& output : outputs) output->to_gpu(false);
+        to_cpu_async(outputs).wait();
+    }
+    float group_cost = (iLogger::timestamp_now_float() - begin) / loops;
+    int group_waits  = backend->waits - sequential_waits;
+
+    ASSERT_EQ(sequential_waits, loops * (int)outputs.size());
+    ASSERT_EQ(group_waits, loops);
+    FMT_INFO("%d outputs, sequential to_cpu: %.3f ms (%d waits), group download: %.3f ms (%d waits)",
+             (int)outputs.size(), sequential_cost, sequential_waits / loops, group_cost, group_waits / loops);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <trt_tensor.hpp>
+#include <ilogger.hpp>
+#include <vector>
+
+using namespace TRT;
+
+// 用malloc后端的独立内存池，不依赖GPU
+static std::shared_ptr<Tensor> make_tensor(const std::vector<int>& dims) {
+    auto pool   = std::make_shared<MemoryPool>(malloc_memory_backend());
+    auto tensor = std::make_shared<Tensor>(dims, DataType::Float, std::make_shared<MixMemory>(CURRENT_DEVICE_ID, pool));
+    float* data = tensor->cpu<float>();
+    for (int i = 0; i < tensor->numel(); ++i) data[i] = (float)i;
+    return tensor;
+}
+
+TEST(TensorViewCase, BatchSlotSharesMemory) {
+    auto tensor = make_tensor({4, 3, 5});
+    auto slot   = TensorView(tensor).batch_slot(2);
+    ASSERT_FALSE(slot.empty());
+    ASSERT_EQ(slot.dims(), std::vector<int>({1, 3, 5}));
+    ASSERT_TRUE(slot.is_contiguous());
+    ASSERT_EQ(slot.byte_offset(), 2 * 15 * sizeof(float));
+    ASSERT_EQ(slot.cpu<float>(), tensor->cpu<float>(2));
+    ASSERT_EQ(slot.at<float>(0, 1, 2), tensor->at<float>(2, 1, 2));
+
+    // 通过视图写入，parent能看到，并且只标记对应的槽位
+    tensor->fill_batch(0, 4, 0);
+    slot.at<float>(0, 0, 0) = 7;
+    slot.mark_dirty();
+    ASSERT_EQ(tensor->at<float>(2, 0, 0), 7);
+    ASSERT_TRUE(tensor->is_dirty(2));
+    ASSERT_FALSE(tensor->is_dirty(1));
+    ASSERT_FALSE(tensor->is_dirty(3));
+}
+
+TEST(TensorViewCase, SliceInnerAxis) {
+    auto tensor = make_tensor({2, 6, 4});
+    auto view   = TensorView(tensor).slice(1, 2, 5);
+    ASSERT_EQ(view.dims(), std::vector<int>({2, 3, 4}));
+    ASSERT_FALSE(view.is_contiguous());
+    for (int n = 0; n < 2; ++n)
+        for (int c = 0; c < 3; ++c)
+            for (int w = 0; w < 4; ++w)
+                ASSERT_EQ(view.at<float>(n, c, w), tensor->at<float>(n, c + 2, w));
+
+    // 视图上继续切片
+    auto nested = view.slice(0, 1, 2).slice(2, 1, 3);
+    ASSERT_EQ(nested.dims(), std::vector<int>({1, 3, 2}));
+    ASSERT_EQ(nested.at<float>(0, 2, 1), tensor->at<float>(1, 4, 2));
+
+    // 拷贝跟随parent的stream和workspace
+    auto workspace = std::make_shared<MixMemory>();
+    tensor->set_stream((CUStream)0x1234).set_workspace(workspace);
+    auto copied = nested.clone();
+    ASSERT_EQ(copied->dims(), nested.dims());
+    ASSERT_EQ(copied->get_stream(), tensor->get_stream());
+    ASSERT_EQ(copied->get_workspace(), workspace);
+    for (int c = 0; c < 3; ++c)
+        for (int w = 0; w < 2; ++w)
+            ASSERT_EQ(copied->at<float>(0, c, w), tensor->at<float>(1, c + 2, w + 1));
+
+    // 非连续的视图只标记覆盖到的槽位
+    tensor->fill_batch(0, 2, 0);
+    view.slice(0, 0, 1).mark_dirty();
+    ASSERT_TRUE(tensor->is_dirty(0));
+    ASSERT_FALSE(tensor->is_dirty(1));
+}
+
+TEST(TensorViewCase, Reshape) {
+    auto tensor = make_tensor({4, 2, 3});
+    auto slot   = TensorView(tensor).batch_slot(1).reshape(-1, 3);
+    ASSERT_EQ(slot.dims(), std::vector<int>({2, 3}));
+    ASSERT_EQ(slot.cpu<float>(), tensor->cpu<float>(1));
+    ASSERT_EQ(slot.at<float>(1, 2), tensor->at<float>(1, 1, 2));
+
+    auto flat = TensorView(tensor).reshape(24);
+    ASSERT_EQ(flat.at<float>(23), 23);
+
+    // numel不同、多个-1、不连续的视图
+    ASSERT_TRUE(TensorView(tensor).reshape(5, 5).empty());
+    ASSERT_TRUE(TensorView(tensor).reshape(-1, -1).empty());
+    ASSERT_TRUE(TensorView(tensor).reshape(-1, 5).empty());
+    ASSERT_TRUE(TensorView(tensor).slice(2, 0, 2).reshape(16).empty());
+    ASSERT_FALSE(TensorView(tensor).slice(2, 0, 2).clone()->empty());
+}
+
+TEST(TensorViewCase, InvalidSlice) {
+    auto tensor = make_tensor({4, 3});
+    TensorView view(tensor);
+    ASSERT_TRUE(view.slice(2, 0, 1).empty());
+    ASSERT_TRUE(view.slice(0, 3, 5).empty());
+    ASSERT_TRUE(view.slice(0, 2, 1).empty());
+    ASSERT_TRUE(view.batch_slot(-1).empty());
+    ASSERT_TRUE(TensorView().slice(0, 0, 1).empty());
+    ASSERT_TRUE(TensorView(nullptr).empty());
+
+    // 空切片是合法的
+    auto none = view.slice(0, 4, 4);
+    ASSERT_FALSE(none.empty());
+    ASSERT_EQ(none.numel(), 0);
+}
+
+TEST(TensorViewCase, KeepsParentAlive) {
+    auto tensor = make_tensor({3, 8});
+    std::weak_ptr<Tensor> weak = tensor;
+    auto memory = tensor->get_data();
+    std::vector<TensorView> slots;
+    for (int i = 0; i < 3; ++i) slots.push_back(TensorView(tensor).batch_slot(i));
+
+    // 只剩视图引用parent时，数据仍然有效
+    tensor.reset();
+    ASSERT_FALSE(weak.expired());
+    ASSERT_EQ(slots[2].at<float>(0, 5), 21);
+    ASSERT_EQ(slots[2].parent()->get_data(), memory);
+
+    slots.clear();
+    ASSERT_TRUE(weak.expired());
+}
+
+TEST(TensorViewCase, HostRoundTripThroughParent) {
+    auto tensor = make_tensor({2, 4});
+    auto slot   = TensorView(tensor).batch_slot(1);
+
+    // 数据头由parent管理，视图访问cpu时parent会先同步到host
+    tensor->to_gpu();
+    ASSERT_EQ(tensor->head(), DataHead::Device);
+    ASSERT_EQ(slot.at<float>(0, 3), 7);
+    ASSERT_EQ(tensor->head(), DataHead::Host);
+}
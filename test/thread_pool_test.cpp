@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <thread_pool.hpp>
+#include <app.hpp>
+#include <ilogger.hpp>
+#include <atomic>
+#include <vector>
+#include <string.h>
+
+TEST(ThreadPoolCase, CommitReturnsResult) {
+    ThreadPool pool(2);
+    ASSERT_EQ(pool.size(), 2);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 16; ++i) {
+        results.push_back(pool.commit([i]() { return i * i; }));
+    }
+    for (int i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i].get(), i * i);
+    }
+}
+
+TEST(ThreadPoolCase, ParallelForCoversRange) {
+    ThreadPool pool(4);
+    for (int grain : {1, 3, 100}) {
+        std::vector<std::atomic<int>> visits(257);
+        for (auto& v : visits) v = 0;
+        pool.parallel_for(0, (int)visits.size(), [&](int i) { visits[i]++; }, grain);
+        for (auto& v : visits) ASSERT_EQ(v, 1);
+    }
+    pool.parallel_for(5, 5, [](int) { FAIL(); });
+}
+
+TEST(ThreadPoolCase, NestedParallelFor) {
+    // 外层占满线程池后，内层parallel_for仍然可以由调用者线程完成
+    ThreadPool pool(2);
+    std::atomic<int> sum{0};
+    pool.parallel_for(0, 8, [&](int) {
+        pool.parallel_for(0, 8, [&](int j) { sum += j; });
+    });
+    ASSERT_EQ(sum, 8 * 28);
+}
+
+// 没有动态batch的engine：不足min_batch的块padding到min_batch，padding的槽位清零，没有被写过的槽位不重复清理
+TEST(ThreadPoolCase, FillInputBatchPadding) {
+    const int width = 32, height = 16;
+    std::array<float, 3> mean{0.0f, 0.0f, 0.0f};
+    std::array<float, 3> std{1.0f, 1.0f, 1.0f};
+
+    std::vector<uint8_t> pixels(width * height * 3);
+    for (int i = 0; i < pixels.size(); i += 3) {
+        pixels[i + 0] = 10; pixels[i + 1] = 20; pixels[i + 2] = 30;
+    }
+    std::vector<cv::Mat> images(3, cv::Mat(height, width, CV_8UC3, pixels.data(), width * 3));
+
+    TRT::Tensor tensor(std::vector<int>{4, 3, height, width});
+    tensor.set_memory_init(TRT::MemoryInit::Uninitialized);
+    memset(tensor.cpu(), 0xFF, tensor.bytes());
+    tensor.mark_dirty();
+
+    ThreadPool pool(2);
+    App::Engine<App::Result>::fill_input_batch(tensor, images, 0, 2, mean, std, pool, 4);
+    ASSERT_EQ(tensor.batch(), 4);
+    ASSERT_FLOAT_EQ(tensor.at<float>(1, 0, 0, 0), 30.0f);
+    ASSERT_TRUE(tensor.is_dirty(0));
+    ASSERT_TRUE(tensor.is_dirty(1));
+    for (int n = 2; n < 4; ++n) {
+        ASSERT_FALSE(tensor.is_dirty(n));
+        for (int i = 0; i < tensor.count(1); ++i) ASSERT_EQ(tensor.cpu<float>(n)[i], 0.0f);
+    }
+
+    // 第2个槽位被有效数据覆盖，只剩第3个需要padding，它保持清零的状态
+    App::Engine<App::Result>::fill_input_batch(tensor, images, 0, 3, mean, std, pool, 4);
+    ASSERT_TRUE(tensor.is_dirty(2));
+    ASSERT_FALSE(tensor.is_dirty(3));
+    ASSERT_FLOAT_EQ(tensor.at<float>(2, 2, 0, 0), 10.0f);
+
+    // 动态batch的engine不需要padding，batch维等于有效的数量
+    App::Engine<App::Result>::fill_input_batch(tensor, images, 0, 3, mean, std, pool);
+    ASSERT_EQ(tensor.batch(), 3);
+}
+
+// 只用CPU：对比逐张set_norm_mat和线程池并行预处理一个batch的吞吐
+TEST(ThreadPoolBenchMark, BatchPreprocess) {
+    const int batch = 16;
+    const int width = 1024, height = 1024;
+    const int loops = 5;
+    std::array<float, 3> mean{123.675f, 116.28f, 103.53f};
+    std::array<float, 3> std{58.395f, 57.12f, 57.375f};
+
+    std::vector<cv::Mat> images(batch);
+    for (int i = 0; i < batch; ++i) {
+        images[i] = cv::Mat(1080, 1920, CV_8UC3);
+        cv::randu(images[i], cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+
+    // 引用普通host内存，不依赖GPU
+    std::vector<float> host(batch * 3 * width * height);
+    TRT::Tensor tensor(TRT::DataType::Float);
+    tensor.reference_data({batch, 3, height, width}, host.data(), host.size() * sizeof(float), nullptr, 0, TRT::DataType::Float);
+
+    auto begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        for (int i = 0; i < batch; ++i) {
+            tensor.set_norm_mat(i, images[i], mean.data(), std.data());
+        }
+    }
+    float serial_cost = iLogger::timestamp_now_float() - begin;
+    std::vector<float> serial_result(host);
+
+    ThreadPool pool;
+    begin = iLogger::timestamp_now_float();
+    for (int loop = 0; loop < loops; ++loop) {
+        App::Engine<App::Result>::fill_input_batch(tensor, images, 0, batch, mean, std, pool);
+    }
+    float pool_cost = iLogger::timestamp_now_float() - begin;
+    ASSERT_EQ(serial_result, host);
+
+    FMT_INFO("batch=%d, %dx%d -> %dx%d, serial: %.1f images/s, thread pool(%d): %.1f images/s, speedup: %.2fx",
+             batch, 1920, 1080, width, height, batch * loops / serial_cost * 1000,
+             pool.size(), batch * loops / pool_cost * 1000, serial_cost / pool_cost);
+}
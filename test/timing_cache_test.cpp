@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <builder/timing_cache.hpp>
+#include <ilogger.hpp>
+#include <string>
+#include <vector>
+
+using namespace TRT;
+
+static const char* DEVICE = "sm_86 NVIDIA GeForce RTX 3090 TRT8.2.2";
+
+static std::vector<uint8_t> make_timings(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) data[i] = (uint8_t)(i * 131 + 7);
+    return data;
+}
+
+TEST(TimingCacheCase, EncodeDecode) {
+    auto timings = make_timings(4097);
+    auto file_data = encode_timing_cache(DEVICE, timings.data(), timings.size());
+
+    std::vector<uint8_t> decoded;
+    ASSERT_EQ(decode_timing_cache(file_data, DEVICE, decoded), TimingCacheStatus::Success);
+    ASSERT_EQ(decoded, timings);
+
+    // 其他设备或者其他版本的TensorRT
+    ASSERT_EQ(decode_timing_cache(file_data, "sm_87 Orin TRT8.4.1", decoded), TimingCacheStatus::Mismatch);
+    ASSERT_TRUE(decoded.empty());
+}
+
+TEST(TimingCacheCase, Corrupted) {
+    auto timings = make_timings(1024);
+    auto file_data = encode_timing_cache(DEVICE, timings.data(), timings.size());
+    std::vector<uint8_t> decoded;
+
+    // 任意位置截断都不会越界读取
+    for (size_t size = 0; size < file_data.size(); size += 37) {
+        std::vector<uint8_t> truncated(file_data.begin(), file_data.begin() + size);
+        ASSERT_EQ(decode_timing_cache(truncated, DEVICE, decoded), TimingCacheStatus::Corrupted) << size;
+    }
+
+    auto flipped = file_data;
+    flipped[flipped.size() - 100] ^= 0x01;
+    ASSERT_EQ(decode_timing_cache(flipped, DEVICE, decoded), TimingCacheStatus::Corrupted);
+
+    // 直接保存的TensorRT原始数据，没有头部
+    ASSERT_EQ(decode_timing_cache(timings, DEVICE, decoded), TimingCacheStatus::Corrupted);
+
+    // 设备字段被破坏且长度超出文件
+    auto bad_length = file_data;
+    bad_length[12] = 0xFF;
+    bad_length[13] = 0xFF;
+    ASSERT_EQ(decode_timing_cache(bad_length, DEVICE, decoded), TimingCacheStatus::Corrupted);
+}
+
+TEST(TimingCacheCase, SaveAndLoad) {
+    auto directory = iLogger::format("timing_cache_test_%d/", (int)iLogger::timestamp_now());
+    auto file = directory + "sub/model.timing";
+    std::vector<uint8_t> loaded;
+    ASSERT_EQ(load_timing_cache(file, DEVICE, loaded), TimingCacheStatus::NotExists);
+
+    auto timings = make_timings(10000);
+    ASSERT_TRUE(save_timing_cache(file, DEVICE, timings.data(), timings.size()));
+    ASSERT_EQ(load_timing_cache(file, DEVICE, loaded), TimingCacheStatus::Success);
+    ASSERT_EQ(loaded, timings);
+
+    // 覆盖写入后读到的是新的完整内容，不留下临时文件
+    auto merged = make_timings(12000);
+    ASSERT_TRUE(save_timing_cache(file, DEVICE, merged.data(), merged.size()));
+    ASSERT_EQ(load_timing_cache(file, DEVICE, loaded), TimingCacheStatus::Success);
+    ASSERT_EQ(loaded, merged);
+    ASSERT_EQ(iLogger::find_files(directory + "sub", "*").size(), 1u);
+
+    ASSERT_TRUE(iLogger::save_file(file, "garbage"));
+    ASSERT_EQ(load_timing_cache(file, DEVICE, loaded), TimingCacheStatus::Corrupted);
+    ASSERT_FALSE(save_timing_cache(file, DEVICE, nullptr, 0));
+    iLogger::rmtree(directory);
+}
@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+
+#include <detection.h>
+#include <post_processing.h>
+#include <preprocess_kernel_cpu.hpp>
+#include <ilogger.hpp>
+#include <cuda_runtime.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace Detection;
+
+struct YoloObject {
+    float cx, cy, width, height, confidence;
+    int label;
+};
+
+/* yolo原始输出[batch, num_bboxes, 5 + num_classes]，每张图放num_objects个物体
+   每个物体附近有5个抖动很小的候选（彼此IoU > 0.45，只有最高分的应该被保留），其他行objectness很低
+*/
+static std::shared_ptr<TRT::Tensor> make_yolo_output(int batch_size, int num_bboxes, int num_classes, int num_objects,
+                                                     std::vector<std::vector<YoloObject>>& objects) {
+    std::mt19937 rng(batch_size * 131 + num_bboxes);
+    std::uniform_real_distribution<float> uniform(0, 1);
+    auto tensor = std::make_shared<TRT::Tensor>(std::vector<int>{batch_size, num_bboxes, 5 + num_classes});
+    tensor->to_cpu(false);
+
+    objects.assign(batch_size, {});
+    for (int ibatch = 0; ibatch < batch_size; ++ibatch) {
+        for (int i = 0; i < num_bboxes; ++i) {
+            float* pitem = tensor->cpu<float>(ibatch, i);
+            pitem[0] = uniform(rng) * 640;
+            pitem[1] = uniform(rng) * 640;
+            pitem[2] = 10 + uniform(rng) * 100;
+            pitem[3] = 10 + uniform(rng) * 100;
+            pitem[4] = uniform(rng) * 0.05f;
+            for (int c = 0; c < num_classes; ++c) pitem[5 + c] = uniform(rng);
+        }
+
+        // 物体放在互不重叠的网格上，候选的行号打散
+        std::vector<int> rows(num_bboxes);
+        for (int i = 0; i < num_bboxes; ++i) rows[i] = i;
+        std::shuffle(rows.begin(), rows.end(), rng);
+        for (int k = 0; k < num_objects; ++k) {
+            YoloObject object{40.0f + (k % 8) * 80, 40.0f + (k / 8) * 80, 50, 40, 0, (int)(rng() % num_classes)};
+            for (int j = 0; j < 5; ++j) {
+                float* pitem = tensor->cpu<float>(ibatch, rows[k * 5 + j]);
+                pitem[0] = object.cx + j;
+                pitem[1] = object.cy - j;
+                pitem[2] = object.width;
+                pitem[3] = object.height;
+                pitem[4] = 0.9f - k * 0.01f - j * 0.001f;
+                for (int c = 0; c < num_classes; ++c) pitem[5 + c] = c == object.label ? 0.95f : 0.1f;
+                if (j == 0) object.confidence = pitem[4] * 0.95f;
+            }
+            objects[ibatch].push_back(object);
+        }
+    }
+    return tensor;
+}
+
+static void expect_objects(const std::shared_ptr<DetResult>& result, const std::vector<YoloObject>& objects, const AffineMatrix& matrix) {
+    ASSERT_EQ(result->size(), (int)objects.size());
+    for (int i = 0; i < result->size(); ++i) {
+        auto& o = objects[i];
+        float left, top, right, bottom;
+        affine_project(matrix.d2i, o.cx - o.width * 0.5f, o.cy - o.height * 0.5f, &left, &top);
+        affine_project(matrix.d2i, o.cx + o.width * 0.5f, o.cy + o.height * 0.5f, &right, &bottom);
+        auto b = result->bbox(i);
+        ASSERT_NEAR(b.left, left, 1e-3);
+        ASSERT_NEAR(b.top, top, 1e-3);
+        ASSERT_NEAR(b.right, right, 1e-3);
+        ASSERT_NEAR(b.bottom, bottom, 1e-3);
+        ASSERT_FLOAT_EQ(b.confidence, o.confidence);
+        ASSERT_EQ(b.label, o.label);
+    }
+}
+
+TEST(YoloParserCase, AffineMatrix) {
+    AffineMatrix matrix(1280, 720, 640, 640);
+    float x, y, ox, oy;
+    affine_project(matrix.i2d, 1280, 720, &x, &y);
+    ASSERT_NEAR(x, 640, 1e-3);
+    ASSERT_NEAR(y, 500, 1e-3);
+    affine_project(matrix.d2i, x, y, &ox, &oy);
+    ASSERT_NEAR(ox, 1280, 1e-3);
+    ASSERT_NEAR(oy, 720, 1e-3);
+
+    // 拉伸，对应Tensor::set_norm_mat
+    AffineMatrix stretch(1280, 720, 640, 640, false);
+    affine_project(stretch.d2i, 320, 320, &ox, &oy);
+    ASSERT_NEAR(ox, 640, 1e-3);
+    ASSERT_NEAR(oy, 360, 1e-3);
+}
+
+TEST(YoloParserCase, CheckValid) {
+    YoloDetectionParser parser;
+    auto output = std::make_shared<TRT::Tensor>(std::vector<int>{1, 100, 85});
+    ASSERT_TRUE(parser.check_valid({output}));
+    ASSERT_STREQ(parser.get_plugin_name(), "yolo");
+    ASSERT_FALSE(parser.check_valid({std::make_shared<TRT::Tensor>(std::vector<int>{1, 100, 5})}));
+    ASSERT_FALSE(parser.check_valid({output, output}));
+}
+
+TEST(YoloParserCase, CPUDecode) {
+    std::vector<std::vector<YoloObject>> objects;
+    std::vector<std::shared_ptr<TRT::Tensor>> output{make_yolo_output(3, 10000, 80, 40, objects)};
+
+    AffineMatrix matrix(1280, 720, 640, 640);
+    YoloParseParams params(0.25f, 0.45f, {AffineMatrix(), matrix});
+
+    for (int num_threads : {1, 4}) {
+        YoloDetectionParser parser(0.25f, 0.45f, num_threads);
+        std::vector<std::shared_ptr<DetResult>> result;
+        ASSERT_EQ(parser.parse(output, result, params), 0);
+        ASSERT_EQ(result.size(), 3u);
+        expect_objects(result[0], objects[0], AffineMatrix());
+        expect_objects(result[1], objects[1], matrix);
+        expect_objects(result[2], objects[2], AffineMatrix());
+
+        // BaseParser的parse不带参数，使用构造时的阈值和单位矩阵
+        result.clear();
+        ASSERT_EQ(parser.parse(output, result), 0);
+        expect_objects(result[1], objects[1], AffineMatrix());
+    }
+
+    // 复用arena
+    YoloDetectionParser parser;
+    DetectionArena arena;
+    ASSERT_EQ(parser.parse(output, arena, params), 3);
+    ASSERT_EQ(arena.count(2), 40);
+    ASSERT_EQ(parser.parse(output, arena), 3);
+}
+
+// 全局的yolo_det_parser被多个Engine共享：每次parse的矩阵只作用于这次调用，并发调用互不影响
+TEST(YoloParserCase, SharedParserParamsPerCall) {
+    std::vector<std::vector<YoloObject>> objects;
+    std::vector<std::shared_ptr<TRT::Tensor>> output{make_yolo_output(2, 4000, 20, 16, objects)};
+    output[0]->to_cpu();
+
+    std::vector<AffineMatrix> matrices{AffineMatrix(1280, 720, 640, 640), AffineMatrix(1920, 1080, 640, 640, false)};
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::shared_ptr<DetResult>>> results(matrices.size());
+    for (int i = 0; i < matrices.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            YoloParseParams params(0.25f, 0.45f, {matrices[i], matrices[i]});
+            for (int loop = 0; loop < 20; ++loop) {
+                results[i].clear();
+                yolo_det_parser->parse(output, results[i], params);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    for (int i = 0; i < matrices.size(); ++i) {
+        ASSERT_EQ(results[i].size(), 2u);
+        expect_objects(results[i][0], objects[0], matrices[i]);
+        expect_objects(results[i][1], objects[1], matrices[i]);
+    }
+    ASSERT_FLOAT_EQ(yolo_det_parser->default_params().confidence_threshold, 0.25f);
+    ASSERT_TRUE(yolo_det_parser->default_params().affine_matrices.empty());
+}
+
+TEST(YoloParserCase, GPUDecode) {
+    int num_devices = 0;
+    if (cudaGetDeviceCount(&num_devices) != cudaSuccess || num_devices == 0) {
+        GTEST_SKIP() << "no cuda device";
+    }
+
+    std::vector<std::vector<YoloObject>> objects;
+    std::vector<std::shared_ptr<TRT::Tensor>> output{make_yolo_output(2, 10000, 80, 30, objects)};
+    output[0]->to_gpu();
+
+    YoloDetectionParser parser(0.25f, 0.45f);
+    AffineMatrix matrix(1920, 1080, 640, 640);
+    YoloParseParams params(0.25f, 0.45f, {matrix});
+
+    std::vector<std::shared_ptr<DetResult>> result;
+    ASSERT_EQ(parser.parse(output, result, params, 1), 0);
+    ASSERT_EQ(result.size(), 2u);
+    expect_objects(result[0], objects[0], matrix);
+    expect_objects(result[1], objects[1], AffineMatrix());
+}
+
+// 超过MAX_CANDIDATES个候选时，gpu与cpu一样按confidence选出进入NMS的候选：物体放在最后几行，前面是大量分数略高于阈值的小框
+TEST(YoloParserCase, GPUCrowdedMatchesCPU) {
+    int num_devices = 0;
+    if (cudaGetDeviceCount(&num_devices) != cudaSuccess || num_devices == 0) {
+        GTEST_SKIP() << "no cuda device";
+    }
+
+    const int num_bboxes = 4000, num_fillers = 3000, num_classes = 4, num_objects = 30;
+    auto tensor = std::make_shared<TRT::Tensor>(std::vector<int>{1, num_bboxes, 5 + num_classes});
+    tensor->to_cpu(false);
+    memset(tensor->cpu(), 0, tensor->bytes());
+    for (int i = 0; i < num_fillers; ++i) {
+        // 1x1的框落在不同的整数坐标上，互相之间以及和物体之间都不会被NMS抑制
+        float* pitem = tensor->cpu<float>(0, i);
+        pitem[0] = i % 60 * 10 + 5;
+        pitem[1] = i / 60 * 10 + 5;
+        pitem[2] = pitem[3] = 1;
+        pitem[4] = 0.3f + i * 1e-5f;
+        pitem[5] = 1;
+    }
+    for (int k = 0; k < num_objects; ++k) {
+        float* pitem = tensor->cpu<float>(0, num_bboxes - 1 - k);
+        pitem[0] = 40 + (k % 8) * 80;
+        pitem[1] = 40 + (k / 8) * 80;
+        pitem[2] = 50;
+        pitem[3] = 40;
+        pitem[4] = 0.9f - k * 0.01f;
+        pitem[5 + k % num_classes] = 1;
+    }
+    std::vector<std::shared_ptr<TRT::Tensor>> output{tensor};
+
+    YoloDetectionParser parser(0.25f, 0.45f);
+    std::vector<std::shared_ptr<DetResult>> cpu_result, gpu_result;
+    ASSERT_EQ(parser.parse(output, cpu_result), 0);
+    output[0]->to_gpu();
+    ASSERT_EQ(parser.parse(output, gpu_result, parser.default_params(), 1), 0);
+
+    ASSERT_EQ(cpu_result[0]->size(), MAX_IMAGE_BBOX);
+    ASSERT_EQ(gpu_result[0]->size(), cpu_result[0]->size());
+    for (int i = 0; i < cpu_result[0]->size(); ++i) {
+        auto a = cpu_result[0]->bbox(i), b = gpu_result[0]->bbox(i);
+        ASSERT_FLOAT_EQ(a.left, b.left);
+        ASSERT_FLOAT_EQ(a.top, b.top);
+        ASSERT_FLOAT_EQ(a.confidence, b.confidence);
+        ASSERT_EQ(a.label, b.label);
+    }
+    // 所有物体都在结果中
+    ASSERT_FLOAT_EQ(gpu_result[0]->bbox(0).confidence, 0.9f);
+    ASSERT_FLOAT_EQ(gpu_result[0]->bbox(num_objects - 1).confidence, 0.9f - (num_objects - 1) * 0.01f);
+}
+
+// yolov5s 640x640的输出：batch 8 x 25200 x 85，比较单线程/多线程、有无AVX2时的decode + NMS耗时
+TEST(YoloParserBenchMark, CPUDecode) {
+    const int batch_size = 8, loops = 10;
+    std::vector<std::vector<YoloObject>> objects;
+    std::vector<std::shared_ptr<TRT::Tensor>> output{make_yolo_output(batch_size, 25200, 80, 64, objects)};
+    DetectionArena arena;
+
+    int hardware_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int num_threads : {1, hardware_threads}) {
+        YoloDetectionParser parser(0.25f, 0.45f, num_threads);
+        for (int avx2 = 0; avx2 < 2; ++avx2) {
+            CPUKernel::set_avx2_enabled(avx2 == 1);
+            parser.parse(output, arena);
+
+            auto begin = iLogger::timestamp_now_float();
+            for (int loop = 0; loop < loops; ++loop) {
+                parser.parse(output, arena);
+            }
+            float cost = (iLogger::timestamp_now_float() - begin) / loops;
+            FMT_INFO("batch %d x 25200 x 85, threads %d, avx2 %s: %.2f ms per batch, %d boxes in image 0",
+                     batch_size, num_threads, avx2 ? "on" : "off", cost, arena.count(0));
+        }
+    }
+    CPUKernel::set_avx2_enabled(true);
+}